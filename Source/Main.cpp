@@ -27,6 +27,7 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "MainWindow.h"
 #include "UI/CustomLookAndFeel.h"
+#include "Processors/ProcessorGraph/PipelineBenchmark.h"
 
 #include <stdio.h>
 #include <fstream>
@@ -40,6 +41,8 @@
   The OpenEphysApplication class own the application's MainWindow (via
   a ScopedPointer).
 
+  Started with "--benchmark", it runs the PipelineBenchmark and quits.
+
   @see MainWindow
 
 */
@@ -87,6 +90,13 @@ public:
 
         mainWindow = new MainWindow();
 
+        if (PipelineBenchmark::isRequested(parameters))
+        {
+            // runs once the window is up, then quits
+            benchmark = new PipelineBenchmark(parameters);
+            benchmark->setUIComponent((UIComponent*) mainWindow->getContentComponent());
+            benchmark->startTimer(1000);
+        }
 
 
     }
@@ -119,6 +129,7 @@ public:
 private:
     ScopedPointer <MainWindow> mainWindow;
     ScopedPointer <CustomLookAndFeel> customLookAndFeel;
+    ScopedPointer <PipelineBenchmark> benchmark;
     std::ofstream console_out;
 };
 
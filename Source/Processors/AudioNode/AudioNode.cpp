@@ -26,7 +26,8 @@
 #include "AudioNode.h"
 
 AudioNode::AudioNode()
-    : GenericProcessor("Audio Node"), audioEditor(0), volume(0.00001f), noiseGateLevel(0.0f)
+    : GenericProcessor("Audio Node"), audioEditor(0), volume(0.00001f), noiseGateLevel(0.0f),
+      destBufferSampleRate(44100.0), estimatedSamples(1024)
 {
 
     settings.numInputs = 4096;
@@ -37,7 +38,11 @@ AudioNode::AudioNode()
 
     nextAvailableChannel = 2; // keep first two channels empty
 
-    tempBuffer = new AudioSampleBuffer(16, 1024);
+    for (int s = 0; s < AUDIO_NODE_MAX_MONITORED; s++)
+    {
+        resamplers.add(new PolyphaseResampler(AUDIO_NODE_RESAMPLER_CAPACITY));
+        slotChannel[s] = -1;
+    }
 
 }
 
@@ -137,12 +142,14 @@ void AudioNode::setParameter(int parameterIndex, float newValue)
     {
 
         channelPointers[currentChannel]->isMonitored = true;
+        monitorChanged.set(1);
 
     }
     else if (parameterIndex == -100)
     {
 
         channelPointers[currentChannel]->isMonitored = false;
+        monitorChanged.set(1);
     }
 
 }
@@ -165,35 +172,47 @@ void AudioNode::prepareToPlay(double sampleRate_, int estimatedSamplesPerBlock)
 
 void AudioNode::recreateBuffers()
 {
-	numSamplesExpected.clear();
-    samplesInBackupBuffer.clear();
-    samplesInOverflowBuffer.clear();
-    ratio.clear();
-    filters.clear();
-    bufferA.clear();
-    bufferB.clear();
-    bufferSwap.clear();
+    // the banks are about to go away
+    for (int s = 0; s < AUDIO_NODE_MAX_MONITORED; s++)
+    {
+        resamplers[s]->setFilterBank(nullptr, 1);
+        slotChannel[s] = -1;
+    }
+
+    filterBanks.clear();
+    channelFilterBank.clear();
+    channelLatency.clear();
 
     for (int i = 0; i < channelPointers.size(); i++)
     {
-        // processor sample rate divided by sound card sample rate
-        numSamplesExpected.add((int)(channelPointers[i]->sampleRate/destBufferSampleRate*float(estimatedSamples)) + 1);
-        samplesInBackupBuffer.add(0);
-        samplesInOverflowBuffer.add(0);
-        sourceBufferSampleRate.add(channelPointers[i]->sampleRate);
+        const double sourceRate = channelPointers[i]->sampleRate;
+
+        int bank = -1;
 
-        filters.add(new Dsp::SmoothedFilterDesign<Dsp::RBJ::Design::LowPass, 1> (1024));
+        for (int b = 0; b < filterBanks.size(); b++)
+        {
+            if (filterBanks[b]->getSourceRate() == sourceRate)
+            {
+                bank = b;
+                break;
+            }
+        }
 
-        ratio.add(float(numSamplesExpected[i])/float(estimatedSamples));
-        updateFilter(i);
+        if (bank < 0)
+        {
+            filterBanks.add(new PolyphaseFilterBank(sourceRate, destBufferSampleRate));
+            bank = filterBanks.size() - 1;
+        }
 
-        bufferA.add(new AudioSampleBuffer(1,10000));
-        bufferB.add(new AudioSampleBuffer(1,10000));
-        bufferSwap.add(false);
+        channelFilterBank.add(bank);
 
+        // processor sample rate divided by sound card sample rate; hold back two
+        // blocks' worth so that uneven source blocks don't starve the output
+        const int samplesPerBlock = (int) std::ceil(sourceRate / destBufferSampleRate * double(estimatedSamples));
+        channelLatency.add(2 * jmax(1, samplesPerBlock));
     }
 
-    tempBuffer->setSize(getNumInputs(), 4096);
+    monitorChanged.set(1);
 }
 
 bool AudioNode::enable()
@@ -202,265 +221,106 @@ bool AudioNode::enable()
 	return true;
 }
 
-void AudioNode::updateFilter(int i)
+void AudioNode::updateMonitoredChannels()
 {
+    // 1. release the slots of channels that are no longer monitored
+    for (int s = 0; s < AUDIO_NODE_MAX_MONITORED; s++)
+    {
+        const int chan = slotChannel[s];
+
+        if (chan >= 0 && (chan >= channelPointers.size() || !channelPointers[chan]->isMonitored))
+        {
+            resamplers[s]->setFilterBank(nullptr, 1);
+            slotChannel[s] = -1;
+        }
+    }
 
-    double cutoffFreq = (ratio[i] > 1.0) ? 2 * destBufferSampleRate  // downsample
-                        : destBufferSampleRate / 2; // upsample
+    // 2. give newly monitored channels a slot; channels that stay monitored keep
+    //    theirs, so they don't glitch
+    for (int i = 0; i < channelPointers.size() && i < channelFilterBank.size(); i++)
+    {
+        if (!channelPointers[i]->isMonitored)
+            continue;
 
-    double sampleFreq = (ratio[i] > 1.0) ? sourceBufferSampleRate[i] // downsample
-                        : destBufferSampleRate;  // upsample
+        int freeSlot = -1;
+        bool hasSlot = false;
 
-    Dsp::Params params;
-    params[0] = sampleFreq; // sample rate
-    params[1] = cutoffFreq; // cutoff frequency
-    params[2] = 1.25; //Q //
+        for (int s = 0; s < AUDIO_NODE_MAX_MONITORED; s++)
+        {
+            if (slotChannel[s] == i)
+            {
+                hasSlot = true;
+                break;
+            }
 
-    filters[i]->setParams(params);
+            if (slotChannel[s] < 0 && freeSlot < 0)
+                freeSlot = s;
+        }
 
+        if (!hasSlot && freeSlot >= 0)
+        {
+            resamplers[freeSlot]->setFilterBank(filterBanks[channelFilterBank[i]], channelLatency[i]);
+            slotChannel[freeSlot] = i;
+        }
+    }
 }
 
 void AudioNode::process(AudioSampleBuffer& buffer,
                         MidiBuffer& events)
 {
-    float gain;
     int valuesNeeded = buffer.getNumSamples(); // samples needed to fill out the buffer
 
-    //std::cout << "Buffer size: " << buffer.getNumChannels() << std::endl;
-
     // clear the left and right channels
     buffer.clear(0,0,buffer.getNumSamples());
     buffer.clear(1,0,buffer.getNumSamples());
 
-    if (1)
+    if (channelPointers.size() > 0) // we have some channels
     {
 
-        AudioSampleBuffer* overflowBuffer;
-        AudioSampleBuffer* backupBuffer;
+        if (monitorChanged.compareAndSetBool(0, 1))
+            updateMonitoredChannels();
 
-        if (channelPointers.size() > 0) // we have some channels
+        // only the monitored channels are touched; the rest are left in the
+        // processors' buffers
+        for (int s = 0; s < AUDIO_NODE_MAX_MONITORED; s++)
         {
+            const int i = slotChannel[s];
 
-            tempBuffer->clear();
-
-            for (int i = 0; i < buffer.getNumChannels()-2; i++) // cycle through them all
-            {
-
-                if (channelPointers[i]->isMonitored)
-                {
-
-                    //std::cout << "Processing channel " << i << std::endl;
+            if (i < 0 || i + 2 >= buffer.getNumChannels())
+                continue;
 
-                    if (!bufferSwap[i])
-                    {
-                        overflowBuffer = bufferA[i];
-                        backupBuffer = bufferB[i];
+            Channel* ch = channelPointers.getUnchecked(i);
 
-                        bufferSwap.set(i,true);
-                    }
-                    else
-                    {
-                        overflowBuffer = bufferB[i];
-                        backupBuffer = bufferA[i];
+            // resampled channels have their own count, under their stream's id
+            std::map<int, int>::const_iterator count = numSamples.find(ch->getStreamId());
 
-                        bufferSwap.set(i,false);
-                    }
+            if (count == numSamples.end())
+                continue;
 
-                    backupBuffer->clear();
+            int samplesAvailable = jmin(count->second, buffer.getNumSamples());
 
-                    samplesInOverflowBuffer.set(i,samplesInBackupBuffer[i]); // size of buffer after last round
-                    samplesInBackupBuffer.set(i,0);
+            resamplers[s]->write(buffer.getReadPointer(i+2), // add 2 to account for output channels
+                                 samplesAvailable);
 
-                    int orphanedSamples = 0;
+            float gain = volume/(float(0x7fff) * ch->bitVolts);
+            // Data are floats in units of microvolts, so dividing by bitVolts and 0x7fff (max value for 16b signed)
+            // rescales to between -1 and +1. Audio output starts So, maximum gain applied to maximum data would be 10.
 
-                    // 1. copy overflow buffer
-
-                    int samplesToCopyFromOverflowBuffer =
-                        ((samplesInOverflowBuffer[i] <= numSamplesExpected[i]) ?
-                         samplesInOverflowBuffer[i] :
-                         numSamplesExpected[i]);
-
-                    //std::cout << "Copying " << samplesToCopyFromOverflowBuffer << " samples from overflow buffer of " << samplesInOverflowBuffer[i] << " samples." << std::endl;
-
-                    if (samplesToCopyFromOverflowBuffer > 0) // need to re-add samples from backup buffer
-                    {
-
-                        tempBuffer->addFrom(i,    // destination channel
-                                            0,                // destination start sample
-                                            *overflowBuffer,  // source
-                                            0,                // source channel
-                                            0,                // source start sample
-                                            samplesToCopyFromOverflowBuffer,    // number of samples
-                                            1.0f              // gain to apply
-                                           );
-
-                        int leftoverSamples = samplesInOverflowBuffer[i] - samplesToCopyFromOverflowBuffer;
-
-                        // std::cout << "Samples remaining in overflow buffer: " << leftoverSamples << std::endl;
-
-                        if (leftoverSamples > 0) // move remaining samples to the backup buffer
-                        {
-
-                            backupBuffer->addFrom(0, // destination channel
-                                                  0,                     // destination start sample
-                                                  *overflowBuffer,       // source
-                                                  0,                     // source channel
-                                                  samplesToCopyFromOverflowBuffer,         // source start sample
-                                                  leftoverSamples,       // number of samples
-                                                  1.0f                   // gain to apply
-                                                 );
-                        }
-
-                        samplesInBackupBuffer.set(i,leftoverSamples);
-                    }
-
-                    gain = volume/(float(0x7fff) * channelPointers[i]->bitVolts);
-                    // Data are floats in units of microvolts, so dividing by bitVolts and 0x7fff (max value for 16b signed)
-                    // rescales to between -1 and +1. Audio output starts So, maximum gain applied to maximum data would be 10.
-
-                    int remainingSamples = numSamplesExpected[i] - samplesToCopyFromOverflowBuffer;
-
-                    int samplesAvailable = numSamples.at(channelPointers[i]->sourceNodeId);
-
-                    int samplesToCopyFromIncomingBuffer = ((remainingSamples <= samplesAvailable) ?
-                                                           remainingSamples :
-                                                           samplesAvailable);
-
-                    //std::cout << "Copying " << samplesToCopyFromIncomingBuffer << " samples from incoming buffer of " << samplesAvailable << " samples." << std::endl;
-
-
-                    if (samplesToCopyFromIncomingBuffer > 0)
-                    {
-
-                        tempBuffer->addFrom(i,       // destination channel
-                                            samplesToCopyFromOverflowBuffer,           // destination start sample
-                                            buffer,      // source
-                                            i+2,           // source channel (add 2 to account for output channels)
-                                            0,           // source start sample
-                                            samplesToCopyFromIncomingBuffer, //  number of samples
-                                            gain       // gain to apply
-                                           );
-
-                        //if (destBufferPos == 0)
-                        //  std::cout << "Temp buffer 0 value: " << *tempBuffer->getReadPointer(i,0) << std::endl;
-
-                    }
-
-                    orphanedSamples = samplesAvailable - samplesToCopyFromIncomingBuffer;
-
-                    // std::cout << "Samples remaining in incoming buffer: " << orphanedSamples << std::endl;
-
-                    if (orphanedSamples > 0 && (samplesInBackupBuffer[i] + orphanedSamples < backupBuffer->getNumSamples()))
-                    {
-
-                        backupBuffer->addFrom(0,                            // destination channel
-                                              samplesInBackupBuffer[i],     // destination start sample
-                                              buffer,                       // source
-                                              i+2,                          // source channel (add 2 to account for output channels)
-                                              remainingSamples,             // source start sample
-                                              orphanedSamples,              //  number of samples
-                                              gain                          // gain to apply
-                                             );
-
-                        samplesInBackupBuffer.set(i, samplesInBackupBuffer[i] + orphanedSamples);
-
-                    }
-
-                    // now that our tempBuffer is ready, we can filter it and copy it into the
-                    // original buffer
-
-                    //std::cout << "Ratio = " << ratio[i] << ", gain = " << gain << std::endl;
-                    //std::cout << "Values needed = " << valuesNeeded << ", channel = " << i << std::endl;
-
-                    if (ratio[i] > 1.00001)
-                    {
-                        // pre-apply filter before downsampling
-                        float* ptr = tempBuffer->getWritePointer(i);
-                        filters[i]->process(numSamplesExpected[i], &ptr);
-                    }
-
-                    // initialize variables
-                    int sourceBufferPos = 0;
-                    int sourceBufferSize = numSamplesExpected[i];
-                    float subSampleOffset = 0.0;
-                    int nextPos = (sourceBufferPos + 1) % sourceBufferSize;
-
-                    int destBufferPos;
-
-                    // code modified from "juce_ResamplingAudioSource.cpp":
-
-                    for (destBufferPos = 0; destBufferPos < valuesNeeded; destBufferPos++)
-                    {
-                        float gain = 1.0;
-                        float alpha = (float) subSampleOffset;
-                        float invAlpha = 1.0f - alpha;
-
-                        // std::cout << "Copying sample " << sourceBufferPos << std::endl;
-
-                        buffer.addFrom(0,    // destChannel
-                                       destBufferPos,  // destSampleOffset
-                                       *tempBuffer,     // source
-                                       i,    // sourceChannel
-                                       sourceBufferPos,// sourceSampleOffset
-                                       1,        // number of samples
-                                       invAlpha*gain);      // gain to apply to source
-
-                        buffer.addFrom(0,    // destChannel
-                                       destBufferPos,   // destSampleOffset
-                                       *tempBuffer,     // source
-                                       i,      // sourceChannel
-                                       nextPos,      // sourceSampleOffset
-                                       1,        // number of samples
-                                       alpha*gain);       // gain to apply to source
-
-                        // if (destBufferPos == 0)
-                        //std::cout << "Output buffer 0 value: " << *buffer.getReadPointer(i+2,destBufferPos) << std::endl;
-
-                        subSampleOffset += ratio[i];
-
-                        while (subSampleOffset >= 1.0)
-                        {
-                            if (++sourceBufferPos >= sourceBufferSize)
-                                sourceBufferPos = 0;
-
-                            nextPos = (sourceBufferPos + 1) % sourceBufferSize;
-                            subSampleOffset -= 1.0;
-                        }
-                    }
-
-                    if (ratio[i] < 0.99999)
-                    {
-                        // apply the filter after upsampling
-                        float* ptr = buffer.getWritePointer(0);
-                        filters[i]->process(destBufferPos, &ptr);
-                    }
-
-                    // now copy the channel into the output zone
-
-                    // buffer.addFrom(0,    // destChannel
-                    //                0,  // destSampleOffset
-                    //                buffer,     // source
-                    //                 i+2,    // sourceChannel
-                    //                 0,// sourceSampleOffset
-                    //                 valuesNeeded,        // number of samples
-                    //                 1.0);      // gain to apply to source
-
-                } // if channelPointers[i]->isMonitored
-            } // end cycling through channels
-
-            // Simple implementation of a "noise gate" on audio output
-            expander.process(buffer.getWritePointer(0), // expand the left channel
-                             buffer.getNumSamples());
-
-            // copy the signal into the right channel (no stereo audio yet!)
-            buffer.addFrom(1,    // destChannel
-                           0,  // destSampleOffset
-                           buffer,     // source
-                           0,    // sourceChannel
-                           0,// sourceSampleOffset
-                           valuesNeeded,        // number of samples
-                           1.0);      // gain to apply to source
+            resamplers[s]->read(buffer.getWritePointer(0), valuesNeeded, gain);
         }
+
+        // Simple implementation of a "noise gate" on audio output
+        expander.process(buffer.getWritePointer(0), // expand the left channel
+                         buffer.getNumSamples());
+
+        // copy the signal into the right channel (no stereo audio yet!)
+        buffer.addFrom(1,    // destChannel
+                       0,  // destSampleOffset
+                       buffer,     // source
+                       0,    // sourceChannel
+                       0,// sourceSampleOffset
+                       valuesNeeded,        // number of samples
+                       1.0);      // gain to apply to source
     }
 }
 
@@ -30,10 +30,13 @@
 
 #include "../GenericProcessor/GenericProcessor.h"
 #include "AudioEditor.h"
-#include "../Dsp/Dsp.h"
+#include "PolyphaseResampler.h"
 
 #include "../Channel/Channel.h"
 
+#define AUDIO_NODE_MAX_MONITORED 32 // channels that can be monitored at once
+#define AUDIO_NODE_RESAMPLER_CAPACITY 32768 // input samples buffered per monitored channel
+
 class AudioEditor;
 
 /**
@@ -54,6 +57,12 @@ class AudioEditor;
   control the channels going to the audio monitor; it all happens in a distributed
   way through the individual processors.
 
+  The incoming channels refer to the processors' own buffers, and only the
+  monitored ones are read. Each monitored channel is assigned one of
+  AUDIO_NODE_MAX_MONITORED PolyphaseResamplers, which converts it to the
+  audio device's rate through a filter bank shared by all channels with
+  the same sample rate.
+
   @see GenericProcessor, AudioEditor
 
 */
@@ -120,13 +129,14 @@ public:
 
     void prepareToPlay(double sampleRate_, int estimatedSamplesPerBlock);
 
-    void updateFilter(int i);
-
 	bool enable();
 
 private:
 	void recreateBuffers();
 
+    /** Gives each monitored channel a resampler; called on the audio thread, doesn't allocate. */
+    void updateMonitoredChannels();
+
     Array<int> leftChan;
     Array<int> rightChan;
     float volume;
@@ -135,29 +145,21 @@ private:
     /** An array of pointers to the channels that feed into the AudioNode. */
     Array<Channel*> channelPointers;
 
-    OwnedArray<AudioSampleBuffer> bufferA;
-    OwnedArray<AudioSampleBuffer> bufferB;
-
-    Array<int> numSamplesExpected;
-
-    Array<int> samplesInBackupBuffer;
-    Array<int> samplesInOverflowBuffer;
-    Array<double> sourceBufferSampleRate;
     double destBufferSampleRate;
 	int estimatedSamples;
 
-    Array<bool> bufferSwap;
-
     Expander expander;
 
-    // sample rate, timebase, and ratio info:
-    Array<double> ratio;
+    // one filter bank per distinct source sample rate
+    OwnedArray<PolyphaseFilterBank> filterBanks;
+    Array<int> channelFilterBank;
+    Array<int> channelLatency;
 
-    // major objects:
-    OwnedArray<Dsp::Filter> filters;
+    // resamplers for the monitored channels; slotChannel is -1 for a free slot
+    OwnedArray<PolyphaseResampler> resamplers;
+    int slotChannel[AUDIO_NODE_MAX_MONITORED];
 
-    // Temporary buffer for data
-    ScopedPointer<AudioSampleBuffer> tempBuffer;
+    Atomic<int> monitorChanged;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioNode);
 
@@ -0,0 +1,326 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cmath>
+
+#include "PolyphaseResampler.h"
+
+#if JUCE_INTEL
+#include <xmmintrin.h>
+#endif
+
+#define STOPBAND_DB 80.0 // attenuation from the stopband edge on
+#define KAISER_BETA 8.0  // 0.1102 * (STOPBAND_DB - 8.7), rounded up
+
+namespace
+{
+
+int greatestCommonDivisor(int a, int b)
+{
+    while (b != 0)
+    {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+// zeroth-order modified Bessel function of the first kind, for the Kaiser window
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+
+// numValues must be a multiple of 4
+inline float dotProduct(const float* a, const float* b, int numValues)
+{
+#if JUCE_INTEL
+    __m128 sum = _mm_setzero_ps();
+
+    for (int i = 0; i < numValues; i += 4)
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+    float partial[4];
+    _mm_storeu_ps(partial, sum);
+
+    return (partial[0] + partial[1]) + (partial[2] + partial[3]);
+#else
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+    for (int i = 0; i < numValues; i += 4)
+    {
+        s0 += a[i] * b[i];
+        s1 += a[i+1] * b[i+1];
+        s2 += a[i+2] * b[i+2];
+        s3 += a[i+3] * b[i+3];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+#endif
+}
+
+}
+
+// ==========================================================
+
+PolyphaseFilterBank::PolyphaseFilterBank(double sourceRate_, double destRate_)
+    : sourceRate(sourceRate_), destRate(destRate_), numPhases(1), step(1), numTaps(4)
+{
+    if (sourceRate <= 0 || destRate <= 0)
+    {
+        // nothing sensible to do; pass samples straight through
+        sourceRate = destRate = jmax(sourceRate, destRate, 1.0);
+    }
+
+    // 1. express the rate change as L/M
+    const int sourceInt = roundToInt(sourceRate);
+    const int destInt = roundToInt(destRate);
+
+    const bool isExact = std::abs(sourceRate - sourceInt) < 1e-6 &&
+                         std::abs(destRate - destInt) < 1e-6;
+
+    if (isExact)
+    {
+        const int divisor = greatestCommonDivisor(sourceInt, destInt);
+
+        numPhases = destInt / divisor;
+        step = sourceInt / divisor;
+    }
+
+    if (!isExact || numPhases > POLYPHASE_MAX_PHASES)
+    {
+        numPhases = POLYPHASE_MAX_PHASES;
+        step = jmax(1, roundToInt(numPhases * sourceRate / destRate));
+
+        const int divisor = greatestCommonDivisor(numPhases, step);
+
+        numPhases /= divisor;
+        step /= divisor;
+
+        std::cout << "Approximating a rate change of " << sourceRate << " -> " << destRate
+                  << " Hz as " << numPhases << "/" << step << std::endl;
+    }
+
+    // 2. the transition runs from the end of the passband to the lower Nyquist
+    //    frequency (in cycles per upsampled sample); a Kaiser window needs about
+    //    (A - 7.95) / (14.36 * width) taps for A dB over a transition that wide
+    const double stopband = 0.5 * jmin(1.0, destRate / sourceRate) / numPhases;
+    const double transition = (1.0 - POLYPHASE_PASSBAND) * stopband;
+    const double kaiserLength = (STOPBAND_DB - 7.95) / (14.36 * transition);
+
+    numTaps = (int) std::ceil(kaiserLength / numPhases);
+    numTaps = jlimit(4, POLYPHASE_MAX_TAPS, (numTaps + 3) & ~3);
+
+    // 3. design the prototype at L times the input rate, with the cutoff in the
+    //    middle of the transition the taps allow
+    const int length = numPhases * numTaps;
+    const double achievedTransition = (STOPBAND_DB - 7.95) / (14.36 * length);
+    const double cutoff = stopband - 0.5 * achievedTransition;
+    const double centre = 0.5 * (length - 1);
+
+    if (cutoff < 0.5 * stopband)
+        std::cout << "Resampling " << sourceRate << " -> " << destRate
+                  << " Hz needs more than " << POLYPHASE_MAX_TAPS << " taps; the passband will roll off early" << std::endl;
+    const double windowNorm = besselI0(KAISER_BETA);
+
+    HeapBlock<double> prototype;
+    prototype.calloc(length);
+
+    for (int n = 0; n < length; n++)
+    {
+        const double t = n - centre;
+        const double x = 2.0 * double_Pi * cutoff * t;
+        const double sinc = (std::abs(t) < 1e-9) ? 1.0 : std::sin(x) / x;
+
+        const double r = (length > 1) ? (2.0 * n / (length - 1) - 1.0) : 0.0;
+        const double window = besselI0(KAISER_BETA * std::sqrt(jmax(0.0, 1.0 - r * r))) / windowNorm;
+
+        prototype[n] = sinc * window;
+    }
+
+    // 4. split it into phases, oldest input sample first, with unity gain at DC
+    coefficients.calloc(length);
+
+    for (int p = 0; p < numPhases; p++)
+    {
+        float* phaseCoefficients = coefficients + p * numTaps;
+        double sum = 0;
+
+        for (int k = 0; k < numTaps; k++)
+            sum += prototype[p + k * numPhases];
+
+        if (std::abs(sum) < 1e-12)
+            sum = 1.0;
+
+        for (int j = 0; j < numTaps; j++)
+            phaseCoefficients[j] = (float) (prototype[p + (numTaps - 1 - j) * numPhases] / sum);
+    }
+
+}
+
+// ==========================================================
+
+PolyphaseResampler::PolyphaseResampler(int capacity_)
+    : bank(nullptr), capacity(capacity_ + POLYPHASE_MAX_TAPS), historySize(0),
+      readIndex(0), writeIndex(0), phase(0), latency(1), primed(false),
+      numUnderruns(0), numOverruns(0)
+{
+    input.calloc(capacity);
+}
+
+void PolyphaseResampler::setFilterBank(const PolyphaseFilterBank* bank_, int latencySamples)
+{
+    bank = bank_;
+
+    // leave room for the backlog allowed before skipping ahead
+    latency = jlimit(1, jmax(1, (capacity - POLYPHASE_MAX_TAPS) / 5), latencySamples);
+
+    reset();
+}
+
+void PolyphaseResampler::reset()
+{
+    historySize = (bank != nullptr) ? bank->getNumTaps() - 1 : 0;
+
+    FloatVectorOperations::clear(input, historySize);
+
+    readIndex = historySize;
+    writeIndex = historySize;
+    phase = 0;
+    primed = false;
+}
+
+void PolyphaseResampler::write(const float* source, int numSamples)
+{
+    if (bank == nullptr || numSamples <= 0)
+        return;
+
+    if (writeIndex + numSamples > capacity)
+    {
+        // move the samples still needed (including the filter history) to the front
+        const int keep = jmin(readIndex - historySize, writeIndex);
+
+        memmove(input, input + keep, (writeIndex - keep) * sizeof(float));
+
+        readIndex -= keep;
+        writeIndex -= keep;
+    }
+
+    if (writeIndex + numSamples > capacity)
+    {
+        // a block bigger than the whole FIFO; keep its newest samples
+        const int drop = writeIndex + numSamples - capacity;
+
+        source += drop;
+        numSamples -= drop;
+        numOverruns++;
+    }
+
+    FloatVectorOperations::copy(input + writeIndex, source, numSamples);
+    writeIndex += numSamples;
+}
+
+int PolyphaseResampler::read(float* dest, int numSamples, float gain)
+{
+    if (bank == nullptr)
+        return 0;
+
+    if (!primed)
+    {
+        if (writeIndex - readIndex < latency)
+            return 0;
+
+        primed = true;
+    }
+
+    const int numPhases = bank->getNumPhases();
+    const int step = bank->getStep();
+    const int numTaps = bank->getNumTaps();
+
+    int produced = 0;
+
+    while (produced < numSamples && readIndex < writeIndex)
+    {
+        dest[produced++] += gain * dotProduct(bank->getPhase(phase),
+                                              input + readIndex - historySize,
+                                              numTaps);
+
+        phase += step;
+        readIndex += phase / numPhases;
+        phase %= numPhases;
+    }
+
+    if (produced < numSamples)
+    {
+        // ran dry; wait for the latency to build up again
+        primed = false;
+        numUnderruns++;
+    }
+    else if (writeIndex - readIndex > 4 * latency)
+    {
+        // the source runs ahead of the output; don't let the delay grow
+        readIndex = writeIndex - latency;
+        numOverruns++;
+    }
+
+    return produced;
+}
+
+int PolyphaseResampler::readAvailable(float* dest, int maxSamples)
+{
+    if (bank == nullptr)
+        return 0;
+
+    const int numPhases = bank->getNumPhases();
+    const int step = bank->getStep();
+    const int numTaps = bank->getNumTaps();
+
+    int produced = 0;
+
+    while (produced < maxSamples && readIndex < writeIndex)
+    {
+        dest[produced++] = dotProduct(bank->getPhase(phase),
+                                      input + readIndex - historySize,
+                                      numTaps);
+
+        phase += step;
+        readIndex += phase / numPhases;
+        phase %= numPhases;
+    }
+
+    return produced;
+}
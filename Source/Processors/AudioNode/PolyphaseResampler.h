@@ -0,0 +1,199 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __POLYPHASERESAMPLER_H_3A7C91E4__
+#define __POLYPHASERESAMPLER_H_3A7C91E4__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+#define POLYPHASE_MAX_PHASES 1024
+#define POLYPHASE_PASSBAND 0.8   // fraction of the lower Nyquist frequency that is kept flat
+#define POLYPHASE_MAX_TAPS 2048  // taps per phase; enough to decimate by 40 with the full stopband
+
+/**
+
+  Windowed-sinc filter bank for converting between two sample rates.
+
+  The rate change is expressed as a ratio L/M (upsample by L, keep every
+  Mth sample). The prototype low-pass filter runs at L times the input rate
+  and is split into L phases, so that each output sample only needs the
+  dot product of one phase with the most recent input samples.
+
+  The passband ends at POLYPHASE_PASSBAND of the lower of the two Nyquist
+  frequencies and the stopband starts at that Nyquist frequency, which removes
+  the imaging of upsampling and the aliasing of downsampling in the same
+  filter. The number of taps follows from the width of that transition, so it
+  grows with the decimation factor (e.g. 1508 taps for 30 kHz -> 1 kHz). If
+  that would take more than POLYPHASE_MAX_TAPS per phase, the transition is
+  widened into the passband rather than past the Nyquist frequency. Rates whose
+  ratio needs more than POLYPHASE_MAX_PHASES phases are approximated by the
+  closest ratio that doesn't.
+
+  Banks are read-only once built, so one bank can serve any number of
+  PolyphaseResamplers.
+
+  @see PolyphaseResampler
+
+*/
+
+class PolyphaseFilterBank
+{
+public:
+
+    /** Designs the filter bank. Not real-time safe. */
+    PolyphaseFilterBank(double sourceRate, double destRate);
+
+    double getSourceRate() const
+    {
+        return sourceRate;
+    }
+    double getDestRate() const
+    {
+        return destRate;
+    }
+
+    /** The upsampling factor L (also the number of phases). */
+    int getNumPhases() const
+    {
+        return numPhases;
+    }
+
+    /** The decimation factor M. */
+    int getStep() const
+    {
+        return step;
+    }
+
+    /** The number of taps per phase (a multiple of 4). */
+    int getNumTaps() const
+    {
+        return numTaps;
+    }
+
+    /** Coefficients for one phase, ordered oldest input sample first. */
+    const float* getPhase(int phase) const
+    {
+        return coefficients + phase * numTaps;
+    }
+
+private:
+
+    double sourceRate;
+    double destRate;
+
+    int numPhases;
+    int step;
+    int numTaps;
+
+    HeapBlock<float> coefficients;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PolyphaseFilterBank);
+
+};
+
+/**
+
+  Streams one channel through a PolyphaseFilterBank.
+
+  Input arrives in blocks of whatever size the source delivers and output is
+  pulled in blocks of the size the consumer needs. In between, the input is
+  kept in a FIFO. Output starts once the FIFO holds the latency given to
+  setFilterBank(). If the input runs dry, the missing output is left silent
+  and the FIFO fills up to the latency again. If the input backs up past
+  four times the latency, it skips ahead so that the delay doesn't grow.
+
+  The FIFO is allocated by the constructor. Nothing after that allocates, so
+  setFilterBank(), write() and read() can all be called on the audio thread.
+
+  For block processing, where the amount of output should follow the input,
+  readAvailable() takes everything the input allows instead; the phase carries
+  over to the next block.
+
+  @see PolyphaseFilterBank, AudioNode, ResamplingNode
+
+*/
+
+class PolyphaseResampler
+{
+public:
+
+    /** Allocates room for capacity input samples (plus the filter history). */
+    PolyphaseResampler(int capacity);
+
+    /** Switches to a different bank (which must outlive its use here) and resets the stream. */
+    void setFilterBank(const PolyphaseFilterBank* bank, int latencySamples);
+
+    const PolyphaseFilterBank* getFilterBank() const
+    {
+        return bank;
+    }
+
+    /** Clears the FIFO and the filter history. */
+    void reset();
+
+    /** Appends input samples to the FIFO. */
+    void write(const float* source, int numSamples);
+
+    /** Adds up to numSamples output samples, multiplied by gain, to dest.
+        Returns the number that came from real input. */
+    int read(float* dest, int numSamples, float gain);
+
+    /** Writes (rather than adds) every output sample the input in the FIFO allows,
+        up to maxSamples, without waiting for the latency. Returns the number written. */
+    int readAvailable(float* dest, int maxSamples);
+
+    /** Number of times the output had to be padded with silence. */
+    int getNumUnderruns() const
+    {
+        return numUnderruns;
+    }
+
+    /** Number of times input was skipped because the FIFO backed up. */
+    int getNumOverruns() const
+    {
+        return numOverruns;
+    }
+
+private:
+
+    const PolyphaseFilterBank* bank;
+
+    HeapBlock<float> input;
+    int capacity;
+    int historySize;
+
+    int readIndex;  // newest input sample under the filter
+    int writeIndex; // where the next input sample goes
+    int phase;
+
+    int latency;
+    bool primed;
+
+    int numUnderruns;
+    int numOverruns;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PolyphaseResampler);
+
+};
+
+#endif  // __POLYPHASERESAMPLER_H_3A7C91E4__
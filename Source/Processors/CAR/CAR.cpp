@@ -26,7 +26,9 @@
 
 
 #include <stdio.h>
+#include <algorithm>
 #include "CAR.h"
+#include "CAREditor.h"
     
 CAR::CAR()
     : GenericProcessor("Common Avg Ref") //, threshold(200.0), state(true)
@@ -37,58 +39,501 @@ CAR::CAR()
 
     avgBuffer = AudioSampleBuffer(1,10000); // 1-dimensional buffer to hold the avg
 
+    currentGain = -1.0f;
+    targetGain = -1.0f;
+
+    referenceMode = MEAN_REFERENCE;
+    groupSpec = "all";
+    processMode = MEAN_REFERENCE;
+    layout = nullptr;
+
+    tile.malloc(CAR_MEDIAN_NETWORK_MAX * CAR_TILE_SIZE);
+
+    networkStart[0] = 0;
+    networkLength[0] = 0;
+
+    for (int n = 1; n <= CAR_MEDIAN_NETWORK_MAX; n++)
+    {
+        networkStart[n] = networkPairs.size() / 2;
+        buildMedianNetwork(n, networkPairs);
+        networkLength[n] = networkPairs.size() / 2 - networkStart[n];
+    }
+
 }
 
 CAR::~CAR()
 {
+    delete layout;
+    delete pendingLayout.get();
+    delete retiredLayout.get();
+}
+
+AudioProcessorEditor* CAR::createEditor()
+{
+    editor = new CAREditor(this, true);
+
+    return editor;
+}
+
+void CAR::updateSettings()
+{
+    updateLayout();
+}
+
+void CAR::setReferenceMode(int mode)
+{
+    referenceMode = mode;
+
+    queueParameterChange(1, (float) mode, 0);
+}
+
+int CAR::getReferenceMode()
+{
+    return referenceMode;
+}
+
+void CAR::setGroups(const String& groups)
+{
+    groupSpec = groups.trim();
+
+    updateLayout();
+}
+
+String CAR::getGroups()
+{
+    return groupSpec;
+}
+
+void CAR::setExcludedChannels(const String& channelList)
+{
+    excludeSpec = channelList.trim();
 
+    updateLayout();
 }
 
+String CAR::getExcludedChannels()
+{
+    return excludeSpec;
+}
+
+void CAR::updateLayout()
+{
+    int numChannels = getNumInputs();
+
+    Array<int> groupSizes;
+
+    if (!groupSpec.equalsIgnoreCase("all") && groupSpec.isNotEmpty())
+    {
+        StringArray tokens;
+        tokens.addTokens(groupSpec, ",", "");
 
+        for (int i = 0; i < tokens.size(); i++)
+        {
+            int size = tokens[i].trim().getIntValue();
+
+            if (size > 0)
+                groupSizes.add(size);
+        }
+    }
+
+    Array<int> excluded = parseChannelList(excludeSpec);
+
+    Array<int> channelGroup; // -1 if the channel isn't referenced
+
+    int group = 0;
+    int channelsLeftInGroup = groupSizes.size() > 0 ? groupSizes[0] : numChannels;
+
+    for (int n = 0; n < numChannels; n++)
+    {
+        if (channelsLeftInGroup == 0)
+        {
+            group++;
+
+            // a single size repeats; a list ends after its last group
+            if (groupSizes.size() == 1)
+                channelsLeftInGroup = groupSizes[0];
+            else if (group < groupSizes.size())
+                channelsLeftInGroup = groupSizes[group];
+            else
+                group = -1;
+        }
+
+        channelGroup.add(group);
+
+        if (group >= 0)
+            channelsLeftInGroup--;
+    }
+
+    GroupLayout* newLayout = new GroupLayout();
+    newLayout->numChannels = numChannels;
+    newLayout->numGroups = 0;
+    newLayout->memberStart.malloc(numChannels + 2);
+    newLayout->members.malloc(numChannels + 1);
+    newLayout->referenceStart.malloc(numChannels + 2);
+    newLayout->references.malloc(numChannels + 1);
+    newLayout->column.malloc(numChannels + 1);
+    newLayout->referencePointers.malloc(numChannels + 1);
+
+    int* memberStart = newLayout->memberStart;
+    int* referenceStart = newLayout->referenceStart;
+
+    for (int n = 0; n < numChannels; n++)
+        newLayout->numGroups = jmax(newLayout->numGroups, channelGroup[n] + 1);
+
+    // counting sort of the channels by group, keeping them in order within each group
+    for (int g = 0; g <= newLayout->numGroups; g++)
+    {
+        memberStart[g] = 0;
+        referenceStart[g] = 0;
+    }
+
+    for (int n = 0; n < numChannels; n++)
+    {
+        if (channelGroup[n] < 0)
+            continue;
+
+        memberStart[channelGroup[n] + 1]++;
+
+        if (!excluded.contains(n))
+            referenceStart[channelGroup[n] + 1]++;
+    }
+
+    for (int g = 0; g < newLayout->numGroups; g++)
+    {
+        memberStart[g + 1] += memberStart[g];
+        referenceStart[g + 1] += referenceStart[g];
+    }
+
+    // placing each channel advances its group's start to the next group's...
+    for (int n = 0; n < numChannels; n++)
+    {
+        const int g = channelGroup[n];
+
+        if (g < 0)
+            continue;
+
+        newLayout->members[memberStart[g]++] = n;
+
+        if (!excluded.contains(n))
+            newLayout->references[referenceStart[g]++] = n;
+    }
+
+    // ...so shift them back
+    for (int g = newLayout->numGroups; g > 0; g--)
+    {
+        memberStart[g] = memberStart[g - 1];
+        referenceStart[g] = referenceStart[g - 1];
+    }
+
+    memberStart[0] = 0;
+    referenceStart[0] = 0;
+
+    // whatever process() is done with, and a layout it never picked up
+    delete retiredLayout.exchange(nullptr);
+    delete pendingLayout.exchange(newLayout);
+
+    queueParameterChange(1, (float) referenceMode, 0);
+}
+
+void CAR::takePendingLayout()
+{
+    // the layout being replaced can only be handed back once the last one has been deleted
+    if (pendingLayout.get() == nullptr || retiredLayout.get() != nullptr)
+        return;
+
+    retiredLayout = layout;
+    layout = pendingLayout.exchange(nullptr);
+}
+
+Array<int> CAR::parseChannelList(const String& channelList)
+{
+    Array<int> channelNumbers;
+
+    StringArray tokens;
+    tokens.addTokens(channelList, ",", "");
+
+    for (int i = 0; i < tokens.size(); i++)
+    {
+        String token = tokens[i].trim();
+
+        if (token.isEmpty())
+            continue;
+
+        int first = token.upToFirstOccurrenceOf("-", false, false).trim().getIntValue();
+        int last = token.contains("-") ? token.fromFirstOccurrenceOf("-", false, false).trim().getIntValue() : first;
+
+        for (int chan = jmax(first, 1); chan <= last; chan++)
+            channelNumbers.addIfNotAlreadyThere(chan - 1);
+    }
+
+    return channelNumbers;
+}
+
+void CAR::buildMedianNetwork(int n, Array<int>& pairs)
+{
+    int size = 1;
+
+    while (size < n)
+        size *= 2;
+
+    Array<int> network;
+
+    // comparators that touch inputs past n never swap anything (think of
+    // those inputs as +infinity), so they are left out
+    for (int p = 1; p < size; p *= 2)
+    {
+        for (int k = p; k >= 1; k /= 2)
+        {
+            for (int j = k % p; j <= size - 1 - k; j += 2 * k)
+            {
+                for (int i = 0; i <= jmin(k - 1, size - j - k - 1); i++)
+                {
+                    if ((i + j) / (p * 2) == (i + j + k) / (p * 2) && i + j + k < n)
+                    {
+                        network.add(i + j);
+                        network.add(i + j + k);
+                    }
+                }
+            }
+        }
+    }
+
+    // working backwards from the middle output(s), keep only the comparators
+    // that can change them
+    Array<bool> needed;
+    needed.insertMultiple(0, false, n);
+    needed.set(n / 2, true);
+
+    if (n % 2 == 0)
+        needed.set(n / 2 - 1, true);
+
+    Array<bool> keep;
+    keep.insertMultiple(0, false, network.size() / 2);
+
+    for (int c = network.size() / 2 - 1; c >= 0; c--)
+    {
+        int a = network[2 * c];
+        int b = network[2 * c + 1];
+
+        if (needed[a] || needed[b])
+        {
+            keep.set(c, true);
+            needed.set(a, true);
+            needed.set(b, true);
+        }
+    }
+
+    for (int c = 0; c < keep.size(); c++)
+    {
+        if (keep[c])
+        {
+            pairs.add(network[2 * c]);
+            pairs.add(network[2 * c + 1]);
+        }
+    }
+}
 
 void CAR::setParameter(int parameterIndex, float newValue)
 {
     editor->updateParameterButtons(parameterIndex);
     // std::cout << "Setting CAR Gain" << std::endl;
 
-    if (currentChannel >= 0)
+    if (currentChannel >= 0 && parameterIndex == 0)
     {
         Parameter& p =  parameters.getReference(parameterIndex);
         p.setValue(newValue, currentChannel);
+
+        queueParameterChange(parameterIndex, newValue, currentChannel);
+    }
+}
+
+void CAR::applyParameterChange(const ParameterChange& change)
+{
+    if (change.parameterIndex == 0)
+    {
+        // just use channel 0, since we can't have individual channel settings at the moment
+        if (change.channel == 0)
+            targetGain = -1.0f * change.value / 100.0f;
+    }
+    else if (change.parameterIndex == 1)
+    {
+        processMode = (int) change.value;
+    }
+}
+
+void CAR::computeMean(AudioSampleBuffer& buffer, const GroupLayout& layout, int group, int start, int numSamples, float* ref)
+{
+    const int* references = layout.references;
+    const int first = layout.referenceStart[group];
+    const int numReferences = layout.referenceStart[group + 1] - first;
+
+    FloatVectorOperations::copy(ref, buffer.getReadPointer(references[first], start), numSamples);
+
+    for (int k = 1; k < numReferences; k++)
+        FloatVectorOperations::add(ref, buffer.getReadPointer(references[first + k], start), numSamples);
+
+    FloatVectorOperations::multiply(ref, 1.0f / float(numReferences), numSamples);
+}
+
+void CAR::computeMedian(AudioSampleBuffer& buffer, GroupLayout& layout, int group, int start, int numSamples, float* ref)
+{
+    const int* references = layout.references;
+    float* column = layout.column;
+    const float** referencePointers = layout.referencePointers;
+    const int first = layout.referenceStart[group];
+    const int numReferences = layout.referenceStart[group + 1] - first;
+    const int middle = numReferences / 2;
+
+    if (numReferences <= CAR_MEDIAN_NETWORK_MAX)
+    {
+        for (int k = 0; k < numReferences; k++)
+            FloatVectorOperations::copy(tile + k * CAR_TILE_SIZE,
+                                        buffer.getReadPointer(references[first + k], start),
+                                        numSamples);
+
+        // each comparator orders two rows, for every sample of the tile at once
+        const int* pairs = networkPairs.getRawDataPointer() + 2 * networkStart[numReferences];
+
+        for (int c = 0; c < networkLength[numReferences]; c++)
+        {
+            float* lo = tile + pairs[2 * c] * CAR_TILE_SIZE;
+            float* hi = tile + pairs[2 * c + 1] * CAR_TILE_SIZE;
+
+            for (int i = 0; i < numSamples; i++)
+            {
+                const float a = lo[i];
+                const float b = hi[i];
+                lo[i] = jmin(a, b);
+                hi[i] = jmax(a, b);
+            }
+        }
+
+        if (numReferences % 2 == 1)
+        {
+            FloatVectorOperations::copy(ref, tile + middle * CAR_TILE_SIZE, numSamples);
+        }
+        else
+        {
+            FloatVectorOperations::copy(ref, tile + middle * CAR_TILE_SIZE, numSamples);
+            FloatVectorOperations::add(ref, tile + (middle - 1) * CAR_TILE_SIZE, numSamples);
+            FloatVectorOperations::multiply(ref, 0.5f, numSamples);
+        }
+    }
+    else
+    {
+        for (int k = 0; k < numReferences; k++)
+            referencePointers[k] = buffer.getReadPointer(references[first + k], start);
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            for (int k = 0; k < numReferences; k++)
+                column[k] = referencePointers[k][i];
+
+            std::nth_element(column, column + middle, column + numReferences);
+
+            if (numReferences % 2 == 1)
+                ref[i] = column[middle];
+            else // the other middle value is the largest of the lower half
+                ref[i] = 0.5f * (column[middle] + *std::max_element(column, column + middle));
+        }
     }
 }
 
 void CAR::process(AudioSampleBuffer& buffer,
                   MidiBuffer& events)
 {
-	int nChannels = buffer.getNumChannels();
+    takePendingLayout();
 
-    float gain = -1.0f * float(getParameterVar(0, 0)) / 100.0f; // just use channel 0, since we can't have individual channel settings at the moment
+    if (layout == nullptr)
+        return;
 
-    avgBuffer.clear();
+    const int* memberStart = layout->memberStart;
+    const int* members = layout->members;
+    const int* referenceStart = layout->referenceStart;
+    const int* references = layout->references;
 
-    for (int j = 0; j < nChannels; j++)
-	{
-		avgBuffer.addFrom(0,           // destChannel 
-                          0,           // destStartSample
-                          buffer,      // source
-                          j,           // sourceChannel
-                          0,           // sourceStartSample
-                          buffer.getNumSamples(), // numSamples
-                          1.0f); // gain to apply       
-	}
+    const int nSamples = jmin(buffer.getNumSamples(), avgBuffer.getNumSamples());
+    const int nChannels = jmin(buffer.getNumChannels(), layout->numChannels);
 
-    avgBuffer.applyGain(1.0f/float(nChannels));
+    const float gainStep = (targetGain - currentGain) / float(jmax(nSamples, 1));
 
-    for (int j = 0; j < nChannels; j++)
+    float* ref = avgBuffer.getWritePointer(0);
+
+    for (int g = 0; g < layout->numGroups; g++)
     {
-        buffer.addFrom(j,           // destChannel 
-                       0,           // destStartSample
-                       avgBuffer,   // source
-                       0,           // sourceChannel
-                       0,           // sourceStartSample
-                       buffer.getNumSamples(), // numSamples
-                       gain); // gain to apply            
+        const int numReferences = referenceStart[g + 1] - referenceStart[g];
+
+        if (numReferences == 0 || references[referenceStart[g + 1] - 1] >= nChannels)
+            continue;
+
+        for (int start = 0; start < nSamples; start += CAR_TILE_SIZE)
+        {
+            const int numSamples = jmin(CAR_TILE_SIZE, nSamples - start);
+
+            // the median of one or two channels is their mean
+            if (processMode == MEDIAN_REFERENCE && numReferences > 2)
+                computeMedian(buffer, *layout, g, start, numSamples, ref + start);
+            else
+                computeMean(buffer, *layout, g, start, numSamples, ref + start);
+
+            for (int k = memberStart[g]; k < memberStart[g + 1]; k++)
+            {
+                if (members[k] >= nChannels)
+                    break;
+
+                if (currentGain == targetGain)
+                {
+                    FloatVectorOperations::addWithMultiply(buffer.getWritePointer(members[k], start),
+                                                           ref + start,
+                                                           currentGain,
+                                                           numSamples);
+                }
+                else
+                {
+                    // ramp over one block so a gain change doesn't step the signal
+                    buffer.addFromWithRamp(members[k],    // destChannel
+                                           start,         // destStartSample
+                                           ref + start,   // source
+                                           numSamples,    // numSamples
+                                           currentGain + gainStep * start, // start gain
+                                           currentGain + gainStep * (start + numSamples)); // end gain
+                }
+            }
+        }
     }
 
+    currentGain = targetGain;
+
+}
+
+void CAR::saveCustomParametersToXml(XmlElement* parentElement)
+{
+    XmlElement* mainNode = parentElement->createNewChildElement("REFERENCING");
+    mainNode->setAttribute("mode", referenceMode == MEDIAN_REFERENCE ? "median" : "mean");
+    mainNode->setAttribute("groups", groupSpec);
+    mainNode->setAttribute("exclude", excludeSpec);
+}
+
+void CAR::loadCustomParametersFromXml()
+{
+
+    if (parametersAsXml != nullptr)
+    {
+        forEachXmlChildElement(*parametersAsXml, mainNode)
+        {
+            if (mainNode->hasTagName("REFERENCING"))
+            {
+                referenceMode = mainNode->getStringAttribute("mode") == "median" ? MEDIAN_REFERENCE : MEAN_REFERENCE;
+                groupSpec = mainNode->getStringAttribute("groups", "all");
+                excludeSpec = mainNode->getStringAttribute("exclude");
+
+                updateLayout();
+
+                CAREditor* ed = (CAREditor*) getEditor();
+
+                if (ed != nullptr)
+                    ed->updateSettings();
+            }
+        }
+    }
 }
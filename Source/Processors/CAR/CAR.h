@@ -32,6 +32,9 @@
 #include "../../JuceLibraryCode/JuceHeader.h"
 #include "../GenericProcessor/GenericProcessor.h"
 
+#define CAR_TILE_SIZE 128          // samples referenced at a time
+#define CAR_MEDIAN_NETWORK_MAX 32  // larger groups use nth_element instead of a network
+
 /**
 
     This is a simple filter that subtracts the average of all other channels from 
@@ -41,6 +44,18 @@
 	neuron recordings from microelectrode arrays. J. Neurophys, 2009 for a detailed
 	discussion
 
+    Channels can be split into groups (e.g. one per shank or headstage), each
+    referenced only to itself. Excluded channels (e.g. broken or noisy ones) are
+    still referenced, but left out of their group's reference. The reference is
+    either the mean or, to be robust against artifacts on a few channels, the
+    median of the group at each sample.
+
+    Each group is processed a tile of samples at a time: its reference for the
+    tile is computed and subtracted while the tile is still in the cache. Medians
+    of up to CAR_MEDIAN_NETWORK_MAX channels come from a selection network that
+    works on the whole tile at once.
+
+    @see CAREditor
 	
 */
 
@@ -55,6 +70,19 @@ public:
     /** The class destructor, used to deallocate memory */
     ~CAR();
 
+    enum ReferenceMode
+    {
+        MEAN_REFERENCE = 0,
+        MEDIAN_REFERENCE
+    };
+
+    AudioProcessorEditor* createEditor();
+
+    bool hasEditor() const
+    {
+        return true;
+    }
+
     /** Determines whether the processor is treated as a source. */
     bool isSource()
     {
@@ -86,10 +114,87 @@ public:
         other way, the application will crash.  */
     void setParameter(int parameterIndex, float newValue);
 
+    /** Sets the gain that process() ramps towards over the next block, or the
+        reference mode. */
+    void applyParameterChange(const ParameterChange& change);
+
+    /** Called whenever the signal chain is altered. */
+    void updateSettings();
+
+    void setReferenceMode(int mode);
+    int getReferenceMode();
+
+    /** "all", a group size (e.g. "32"), or the size of each group in
+        order (e.g. "64,64,32"); channels after the last group are left alone. */
+    void setGroups(const String& groups);
+    String getGroups();
+
+    /** Channels left out of the reference, counting from 1 (e.g. "3,17-20"). */
+    void setExcludedChannels(const String& channelList);
+    String getExcludedChannels();
+
+    void saveCustomParametersToXml(XmlElement* parentElement);
+    void loadCustomParametersFromXml();
+
     AudioSampleBuffer avgBuffer;
 
 private:
 
+    /** The channels of every group, and those that make up its reference,
+        sorted by group. Built on the message thread and never changed once
+        process() can see it. */
+    struct GroupLayout
+    {
+        int numChannels;
+        int numGroups;
+        HeapBlock<int> memberStart;
+        HeapBlock<int> members;
+        HeapBlock<int> referenceStart;
+        HeapBlock<int> references;
+
+        HeapBlock<float> column;      // one sample of every channel of a group
+        HeapBlock<const float*> referencePointers;
+    };
+
+    /** Builds the group tables for the current settings and hands them to process(). */
+    void updateLayout();
+
+    /** Makes the next layout current, if there is one and the previous one was deleted. */
+    void takePendingLayout();
+
+    /** Writes the group's reference for samples [start, start + numSamples) into ref. */
+    void computeMean(AudioSampleBuffer& buffer, const GroupLayout& layout, int group, int start, int numSamples, float* ref);
+    void computeMedian(AudioSampleBuffer& buffer, GroupLayout& layout, int group, int start, int numSamples, float* ref);
+
+    /** Batcher's odd-even merge sort for n inputs, pruned to the comparators the
+        median depends on. */
+    static void buildMedianNetwork(int n, Array<int>& pairs);
+
+    static Array<int> parseChannelList(const String& channelList);
+
+    float currentGain; // applied to the average, so <= 0
+    float targetGain;
+
+    // settings, on the message thread
+    int referenceMode;
+    String groupSpec;
+    String excludeSpec;
+
+    // for process()
+    int processMode;
+    GroupLayout* layout;
+
+    // a new layout is published with a single pointer swap; process() hands
+    // back the one it replaces, which is deleted on the message thread
+    Atomic<GroupLayout*> pendingLayout;
+    Atomic<GroupLayout*> retiredLayout;
+
+    HeapBlock<float> tile;        // one row of CAR_TILE_SIZE samples per channel of a network
+
+    Array<int> networkPairs;
+    int networkStart[CAR_MEDIAN_NETWORK_MAX + 1];
+    int networkLength[CAR_MEDIAN_NETWORK_MAX + 1];
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CAR);
 
 };
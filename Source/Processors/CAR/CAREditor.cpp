@@ -0,0 +1,115 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CAREditor.h"
+#include "CAR.h"
+#include <stdio.h>
+
+
+CAREditor::CAREditor(GenericProcessor* parentNode, bool useDefaultParameterEditors=true)
+    : GenericEditor(parentNode, useDefaultParameterEditors)
+
+{
+    desiredWidth = 200;
+
+    modeSelector = new ComboBox("reference mode");
+    modeSelector->setBounds(105,30,80,20);
+    modeSelector->addItem("Mean", CAR::MEAN_REFERENCE + 1);
+    modeSelector->addItem("Median", CAR::MEDIAN_REFERENCE + 1);
+    modeSelector->setSelectedId(CAR::MEAN_REFERENCE + 1, dontSendNotification);
+    modeSelector->addListener(this);
+    modeSelector->setTooltip("Reference each group to its mean, or to its median at each sample");
+    addAndMakeVisible(modeSelector);
+
+    groupsLabel = new Label("groups label", "Groups:");
+    groupsLabel->setBounds(100,55,80,20);
+    groupsLabel->setFont(Font("Small Text", 12, Font::plain));
+    groupsLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(groupsLabel);
+
+    groupsValue = new Label("groups value", "all");
+    groupsValue->setBounds(105,72,80,18);
+    groupsValue->setFont(Font("Default", 15, Font::plain));
+    groupsValue->setColour(Label::textColourId, Colours::white);
+    groupsValue->setColour(Label::backgroundColourId, Colours::grey);
+    groupsValue->setEditable(true);
+    groupsValue->addListener(this);
+    groupsValue->setTooltip("\"all\", a group size (e.g. 32), or the size of each group (e.g. 64,64,32)");
+    addAndMakeVisible(groupsValue);
+
+    excludeLabel = new Label("exclude label", "Exclude:");
+    excludeLabel->setBounds(100,92,80,20);
+    excludeLabel->setFont(Font("Small Text", 12, Font::plain));
+    excludeLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(excludeLabel);
+
+    excludeValue = new Label("exclude value", "");
+    excludeValue->setBounds(105,109,80,18);
+    excludeValue->setFont(Font("Default", 15, Font::plain));
+    excludeValue->setColour(Label::textColourId, Colours::white);
+    excludeValue->setColour(Label::backgroundColourId, Colours::grey);
+    excludeValue->setEditable(true);
+    excludeValue->addListener(this);
+    excludeValue->setTooltip("Channels left out of the reference (e.g. 3,17-20)");
+    addAndMakeVisible(excludeValue);
+
+}
+
+CAREditor::~CAREditor()
+{
+
+}
+
+void CAREditor::updateSettings()
+{
+    CAR* car = (CAR*) getProcessor();
+
+    modeSelector->setSelectedId(car->getReferenceMode() + 1, dontSendNotification);
+    groupsValue->setText(car->getGroups(), dontSendNotification);
+    excludeValue->setText(car->getExcludedChannels(), dontSendNotification);
+}
+
+void CAREditor::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox == modeSelector)
+    {
+        CAR* car = (CAR*) getProcessor();
+        car->setReferenceMode(modeSelector->getSelectedId() - 1);
+    }
+}
+
+void CAREditor::labelTextChanged(Label* label)
+{
+    CAR* car = (CAR*) getProcessor();
+
+    if (label == groupsValue)
+    {
+        car->setGroups(label->getText());
+        label->setText(car->getGroups(), dontSendNotification);
+    }
+    else if (label == excludeValue)
+    {
+        car->setExcludedChannels(label->getText());
+        label->setText(car->getExcludedChannels(), dontSendNotification);
+    }
+}
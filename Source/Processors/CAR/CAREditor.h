@@ -0,0 +1,69 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __CAREDITOR_H_5B2E8F14__
+#define __CAREDITOR_H_5B2E8F14__
+
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../Editors/GenericEditor.h"
+
+/**
+
+  User interface for the CAR processor: the gain, the reference (mean or
+  median), how channels are grouped and which channels are excluded.
+
+  @see CAR
+
+*/
+
+class CAREditor : public GenericEditor,
+    public Label::Listener,
+    public ComboBox::Listener
+{
+public:
+    CAREditor(GenericProcessor* parentNode, bool useDefaultParameterEditors);
+    virtual ~CAREditor();
+
+    void labelTextChanged(Label* label);
+    void comboBoxChanged(ComboBox* comboBox);
+
+    /** Shows the processor's current mode, groups and excluded channels. */
+    void updateSettings();
+
+private:
+
+    ScopedPointer<ComboBox> modeSelector;
+
+    ScopedPointer<Label> groupsLabel;
+    ScopedPointer<Label> groupsValue;
+    ScopedPointer<Label> excludeLabel;
+    ScopedPointer<Label> excludeValue;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CAREditor);
+
+};
+
+
+
+#endif  // __CAREDITOR_H_5B2E8F14__
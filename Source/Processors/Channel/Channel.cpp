@@ -38,6 +38,8 @@ void Channel::reset()
     sampleRate = 44100.0f;
     bitVolts = 1.0f;
     sourceNodeId = -1;
+    streamId = -1;
+    decimation = 1.0f;
     isMonitored = false;
     isEnabled = true;
     recordIndex = -1;
@@ -60,6 +62,8 @@ Channel::Channel(const Channel& ch)
     bitVolts = ch.bitVolts;
     type = ch.type;
     sourceNodeId = ch.sourceNodeId;
+    streamId = ch.streamId;
+    decimation = ch.decimation;
     isMonitored = ch.isMonitored;
     isEnabled = ch.isEnabled;
     recordIndex = ch.recordIndex;
@@ -78,6 +82,17 @@ float Channel::getBitVolts()
     return bitVolts;
 }
 
+int Channel::getStreamId()
+{
+    return (streamId > -1) ? streamId : sourceNodeId;
+}
+
+int Channel::getStreamId(int nodeId, int sourceNodeId)
+{
+    // node IDs fit in a byte (they are sent as one in events)
+    return ((nodeId & 0xff) << 8) | (sourceNodeId & 0xff);
+}
+
 void Channel::setBitVolts(float bv)
 {
     bitVolts = bv;
@@ -98,6 +98,14 @@ public:
     /** Returns the bitVolts value for this channel. */
     float getBitVolts();
 
+    /** The key of the sample counts and timestamps that apply to this channel
+        (in GenericProcessor::numSamples and timestamps). */
+    int getStreamId();
+
+    /** The key for a stream that processor nodeId derives from a source's
+        stream, e.g. by resampling it. Never clashes with a node ID. */
+    static int getStreamId(int nodeId, int sourceNodeId);
+
     // -------- OTHER METHODS ---------//
 
     /** Restores the default settings for a given channel. */
@@ -130,6 +138,13 @@ public:
     /** ID of source node. This is crucial for properly updating timestamps and sample counts. */
     int sourceNodeId;
 
+    /** Set when the channel's sample counts and timestamps no longer come from the
+        source node (e.g. after a ResamplingNode); -1 otherwise. */
+    int streamId;
+
+    /** Source sample rate divided by this channel's sample rate. */
+    float decimation;
+
     /** Toggled when audio monitoring of this channel is enabled or disabled. */
     bool isMonitored;
 
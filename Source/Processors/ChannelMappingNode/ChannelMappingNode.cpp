@@ -44,6 +44,25 @@ ChannelMappingNode::ChannelMappingNode()
         referenceChannels.set(i, -1);
     }
 
+    ops.malloc(MAPPING_MAX_CHANNELS);
+    savedChannels.malloc(MAPPING_MAX_CHANNELS);
+    savedSlot.malloc(MAPPING_MAX_CHANNELS);
+    outputOps.malloc(MAPPING_MAX_CHANNELS);
+    numReaders.malloc(MAPPING_MAX_CHANNELS);
+    readyOps.malloc(MAPPING_MAX_CHANNELS);
+    isScheduled.malloc(MAPPING_MAX_CHANNELS);
+
+    processReferenceArray.malloc(MAPPING_MAX_CHANNELS);
+    processReferenceChannels.malloc(NUM_REFERENCES);
+    processChannelArray.malloc(MAPPING_MAX_CHANNELS);
+    processEnabledChannels.malloc(MAPPING_MAX_CHANNELS);
+    copyMappingForProcess();
+
+    numOps = 0;
+    numSaved = 0;
+    numMappingInputs = 0;
+    mappingChanged = true;
+
 }
 
 ChannelMappingNode::~ChannelMappingNode()
@@ -88,6 +107,157 @@ void ChannelMappingNode::updateSettings()
 	    }
 	}
 
+    numMappingInputs = jmin(getNumInputs(), MAPPING_MAX_CHANNELS);
+    copyMappingForProcess();
+    compileMapping();
+
+}
+
+void ChannelMappingNode::copyMappingForProcess()
+{
+    for (int i = 0; i < MAPPING_MAX_CHANNELS; i++)
+    {
+        processReferenceArray[i] = i < referenceArray.size() ? referenceArray[i] : -1;
+        processChannelArray[i] = i < channelArray.size() ? channelArray[i] : i;
+        processEnabledChannels[i] = i < enabledChannelArray.size() ? enabledChannelArray[i] : true;
+    }
+
+    for (int i = 0; i < NUM_REFERENCES; i++)
+        processReferenceChannels[i] = referenceChannels[i];
+}
+
+void ChannelMappingNode::compileMapping()
+{
+    mappingChanged = false;
+
+    // one op per output, in the same order as the channels in updateSettings()
+    int numOutputs = 0;
+
+    for (int i = 0; i < MAPPING_MAX_CHANNELS && numOutputs < jmin(settings.numOutputs, numMappingInputs); i++)
+    {
+        int realChan = processChannelArray[i];
+
+        if (realChan < 0 || realChan >= numMappingInputs || !processEnabledChannels[realChan])
+            continue;
+
+        MappingOp& op = outputOps[numOutputs];
+        op.dest = numOutputs;
+        op.source = realChan;
+        op.reference = -1;
+        op.sourceSaved = false;
+        op.referenceSaved = false;
+
+        const int ref = processReferenceArray[realChan];
+
+        if ((ref > -1) && (ref < NUM_REFERENCES) && (processReferenceChannels[ref] > -1)
+            && (processReferenceChannels[ref] < numMappingInputs))
+        {
+            op.reference = processReferenceChannels[ref];
+        }
+
+        numOutputs++;
+    }
+
+    // an output that is its own source with no reference is left alone, so it
+    // never overwrites anything and nothing needs to wait for it
+    for (int n = 0; n < numOutputs; n++)
+    {
+        numReaders[n] = 0;
+        isScheduled[n] = (outputOps[n].source == n && outputOps[n].reference < 0);
+    }
+
+    for (int n = 0; n < numMappingInputs; n++)
+        savedSlot[n] = -1;
+
+    // an op has to wait until every other op reading its channel has run
+    // (reading its own channel is fine, since it goes sample by sample)
+    for (int n = 0; n < numOutputs; n++)
+    {
+        if (isScheduled[n])
+            continue;
+
+        const MappingOp& op = outputOps[n];
+
+        if (op.source < numOutputs && op.source != n && !isScheduled[op.source])
+            numReaders[op.source]++;
+
+        if (op.reference > -1 && op.reference < numOutputs && op.reference != n && !isScheduled[op.reference])
+            numReaders[op.reference]++;
+    }
+
+    int numReady = 0;
+    int firstReady = 0;
+    int nextCandidate = 0;
+
+    numOps = 0;
+    numSaved = 0;
+
+    for (int n = 0; n < numOutputs; n++)
+    {
+        if (!isScheduled[n] && numReaders[n] == 0)
+        {
+            isScheduled[n] = true;
+            readyOps[numReady++] = n;
+        }
+    }
+
+    while (true)
+    {
+        if (firstReady == numReady)
+        {
+            // the rest wait on each other: copy one channel out so its op can go
+            while (nextCandidate < numOutputs && isScheduled[nextCandidate])
+                nextCandidate++;
+
+            if (nextCandidate == numOutputs)
+                break;
+
+            savedSlot[nextCandidate] = numSaved;
+            savedChannels[numSaved++] = nextCandidate;
+
+            isScheduled[nextCandidate] = true;
+            readyOps[numReady++] = nextCandidate;
+        }
+
+        const MappingOp& op = outputOps[readyOps[firstReady++]];
+        ops[numOps++] = op;
+
+        const int channelsRead[2] = { op.source, op.reference };
+
+        for (int k = 0; k < 2; k++)
+        {
+            const int chan = channelsRead[k];
+
+            if (chan < 0 || chan >= numOutputs || chan == op.dest
+                || isScheduled[chan] || savedSlot[chan] > -1)
+                continue;
+
+            if (--numReaders[chan] == 0)
+            {
+                isScheduled[chan] = true;
+                readyOps[numReady++] = chan;
+            }
+        }
+    }
+
+    // every read of a saved channel comes from its copy
+    for (int n = 0; n < numOps; n++)
+    {
+        MappingOp& op = ops[n];
+
+        if (savedSlot[op.source] > -1)
+        {
+            op.source = savedSlot[op.source];
+            op.sourceSaved = true;
+        }
+
+        if (op.reference > -1 && savedSlot[op.reference] > -1)
+        {
+            op.reference = savedSlot[op.reference];
+            op.referenceSaved = true;
+        }
+    }
+
 }
 
 
@@ -115,51 +285,107 @@ void ChannelMappingNode::setParameter(int parameterIndex, float newValue)
         channelArray.set(currentChannel, (int) newValue);
     }
 
+    queueParameterChange(parameterIndex, newValue, currentChannel);
+
+}
+
+void ChannelMappingNode::applyParameterChange(const ParameterChange& change)
+{
+    const int chan = change.channel;
+
+    if (change.parameterIndex == 2)
+    {
+        const int ref = (int) change.value;
+
+        if (ref >= 0 && ref < NUM_REFERENCES)
+            processReferenceChannels[ref] = chan;
+    }
+    else if (change.parameterIndex == 4 || chan < 0 || chan >= MAPPING_MAX_CHANNELS)
+    {
+        return;
+    }
+    else if (change.parameterIndex == 1)
+    {
+        processReferenceArray[chan] = (int) change.value;
+    }
+    else if (change.parameterIndex == 3)
+    {
+        processEnabledChannels[chan] = (change.value != 0);
+    }
+    else
+    {
+        processChannelArray[chan] = (int) change.value;
+    }
+
+    mappingChanged = true;
 }
 
 void ChannelMappingNode::process(AudioSampleBuffer& buffer,
                                  MidiBuffer& midiMessages)
 {
-    int j=0;
-    int i=0;
-    int realChan;
+    if (mappingChanged)
+        compileMapping();
+
+    if (numOps == 0)
+        return;
 
-    // use copy constructor to set the data to refer to
-    channelBuffer = buffer;
+    int nSamples = 0;
 
-   // buffer.clear();
+    for (int n = 0; n < numOps; n++)
+        nSamples = jmax(nSamples, getNumSamples(ops[n].dest));
 
-    while (j < settings.numOutputs)
+    // blocks longer than the scratch buffer are mapped in pieces; every
+    // sample is independent, so each piece can run the whole list
+    const int chunkSize = channelBuffer.getNumSamples();
+
+    for (int start = 0; start < nSamples; start += chunkSize)
     {
-        realChan = channelArray[i];
-        if ((realChan < channelBuffer.getNumChannels()) && (enabledChannelArray[realChan]))
+        const int chunkSamples = jmin(chunkSize, nSamples - start);
+
+        // channels that would be overwritten before they are read
+        for (int n = 0; n < numSaved; n++)
+        {
+            channelBuffer.copyFrom(n, // destChannel
+                                   0, // destStartSample
+                                   buffer, // source
+                                   savedChannels[n], // sourceChannel
+                                   start, // sourceStartSample
+                                   chunkSamples); // numSamples
+        }
+
+        for (int n = 0; n < numOps; n++)
         {
-            // copy it back into the buffer according to the channel mapping
-            buffer.copyFrom(j, // destChannel
-                           0, // destStartSample
-                           channelBuffer.getReadPointer(realChan), // source
-                           getNumSamples(j), // numSamples
-                           1.0f // gain to apply to source (positive for original signal)
-                          );
-
-            // now do the referencing
-            if ((referenceArray[realChan] > -1) && (referenceChannels[referenceArray[realChan]] > -1)
-                && (referenceChannels[referenceArray[realChan]] < channelBuffer.getNumChannels()))
+            const MappingOp& op = ops[n];
+            const int numSamples = jmin(chunkSamples, getNumSamples(op.dest) - start);
+
+            if (numSamples <= 0)
+                continue;
+
+            float* dest = buffer.getWritePointer(op.dest, start);
+            const float* source = op.sourceSaved ? channelBuffer.getReadPointer(op.source)
+                                  : buffer.getReadPointer(op.source, start);
+
+            if (op.reference < 0)
+            {
+                FloatVectorOperations::copy(dest, source, numSamples);
+            }
+            else
             {
-                buffer.addFrom(j, // destChannel
-                               0, // destStartSample
-                               channelBuffer, // source
-                               referenceChannels[referenceArray[realChan]], // sourceChannel
-                               0, // sourceStartSample
-                               getNumSamples(j), // numSamples
-                               -1.0f // gain to apply to source (negative for reference)
-                              );
+                const float* reference = op.referenceSaved ? channelBuffer.getReadPointer(op.reference)
+                                         : buffer.getReadPointer(op.reference, start);
+
+                if (source == dest)
+                {
+                    FloatVectorOperations::subtract(dest, reference, numSamples);
+                }
+                else
+                {
+                    // copy and reference in one pass
+                    for (int i = 0; i < numSamples; i++)
+                        dest[i] = source[i] - reference[i];
+                }
             }
-            j++;
         }
-        i++;
-
     }
 
 }
-
@@ -30,6 +30,8 @@
 
 #include "../GenericProcessor/GenericProcessor.h"
 
+#define MAPPING_MAX_CHANNELS 1024
+
 
 /**
 
@@ -38,6 +40,13 @@
   Allows the user to select a subset of channels, remap their order, and reference them against
   any other channel.
 
+  The mapping is compiled into a list of operations whenever it changes, rather than
+  being worked out for every buffer. Outputs are written in place, in an order that
+  lets each one read its inputs before they are overwritten. Only channels caught in
+  a cycle (e.g. two swapped channels) are copied to a scratch buffer first. Outputs
+  that keep their own channel and have no reference are skipped, so an identity map
+  costs nothing.
+
   @see GenericProcessor
 
 */
@@ -53,6 +62,10 @@ public:
     void process(AudioSampleBuffer& buffer, MidiBuffer& midiMessages);
     void setParameter(int parameterIndex, float newValue);
 
+    /** Applies a change to the copies of the mapping used by process(), and marks
+        the operation list as out of date; it's rebuilt before the next buffer. */
+    void applyParameterChange(const ParameterChange& change);
+
     AudioProcessorEditor* createEditor();
 
     bool hasEditor() const
@@ -64,14 +77,52 @@ public:
 
 private:
 
+    /** Writes output channel "dest" from input channel "source", minus "reference"
+        if it's not -1. A saved source or reference is read from its slot in the
+        scratch buffer instead. */
+    struct MappingOp
+    {
+        int dest;
+        int source;
+        int reference;
+        bool sourceSaved;
+        bool referenceSaved;
+    };
+
+    /** Rebuilds the operation list from the process() copies of the mapping. Doesn't allocate. */
+    void compileMapping();
+
+    /** Copies the mapping arrays for process(); only called while it isn't running. */
+    void copyMappingForProcess();
+
     Array<int> referenceArray;
     Array<int> referenceChannels;
     Array<int> channelArray;
     Array<bool> enabledChannelArray;
 
+    // copies of the arrays above for process(), updated by applyParameterChange()
+    HeapBlock<int> processReferenceArray;
+    HeapBlock<int> processReferenceChannels;
+    HeapBlock<int> processChannelArray;
+    HeapBlock<bool> processEnabledChannels;
+
     bool editorIsConfigured;
 
-    AudioSampleBuffer channelBuffer;
+    AudioSampleBuffer channelBuffer; // scratch copies of the saved channels
+
+    HeapBlock<MappingOp> ops;     // in the order they run
+    HeapBlock<int> savedChannels; // input channel held in each scratch slot
+    HeapBlock<int> savedSlot;     // scratch slot of each input channel, or -1
+    int numOps;
+    int numSaved;
+    int numMappingInputs;
+    bool mappingChanged;
+
+    // used while compiling
+    HeapBlock<MappingOp> outputOps; // indexed by output channel
+    HeapBlock<int> numReaders;      // unscheduled ops still reading each output's channel
+    HeapBlock<int> readyOps;
+    HeapBlock<bool> isScheduled;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ChannelMappingNode);
 
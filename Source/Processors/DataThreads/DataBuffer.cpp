@@ -70,6 +70,39 @@ void DataBuffer::addToBuffer(float* data, int64* timestamps, uint64* eventCodes,
     abstractFifo.finishedWrite(numItems);
 }
 
+int DataBuffer::addBlockToBuffer(const AudioSampleBuffer& data, const int64* timestamps, const uint64* eventCodes, int numItems)
+{
+    int startIndex1, blockSize1, startIndex2, blockSize2;
+    abstractFifo.prepareToWrite(numItems, startIndex1, blockSize1, startIndex2, blockSize2);
+
+    const int numChannels = jmin(numChans, data.getNumChannels());
+
+    for (int chan = 0; chan < numChannels; chan++)
+    {
+        if (blockSize1 > 0)
+            buffer.copyFrom(chan, startIndex1, data, chan, 0, blockSize1);
+
+        if (blockSize2 > 0)
+            buffer.copyFrom(chan, startIndex2, data, chan, blockSize1, blockSize2);
+    }
+
+    if (blockSize1 > 0)
+    {
+        memcpy(timestampBuffer + startIndex1, timestamps, blockSize1 * sizeof(int64));
+        memcpy(eventCodeBuffer + startIndex1, eventCodes, blockSize1 * sizeof(uint64));
+    }
+
+    if (blockSize2 > 0)
+    {
+        memcpy(timestampBuffer + startIndex2, timestamps + blockSize1, blockSize2 * sizeof(int64));
+        memcpy(eventCodeBuffer + startIndex2, eventCodes + blockSize1, blockSize2 * sizeof(uint64));
+    }
+
+    abstractFifo.finishedWrite(blockSize1 + blockSize2);
+
+    return blockSize1 + blockSize2;
+}
+
 int DataBuffer::getNumSamples()
 {
     return abstractFifo.getNumReady();
@@ -47,6 +47,10 @@ public:
     /** Add an array of floats to the buffer.*/
     void addToBuffer(float* data, int64* ts, uint64* eventCodes, int numItems);
 
+    /** Adds numItems samples of every channel at once (one timestamp and event
+        code per sample). Returns the number that fit in the buffer.*/
+    int addBlockToBuffer(const AudioSampleBuffer& data, const int64* ts, const uint64* eventCodes, int numItems);
+
     /** Returns the number of samples currently available in the buffer.*/
     int getNumSamples();
 
@@ -0,0 +1,178 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include "ImpedanceAnalyzer.h"
+
+#include <math.h>
+
+#define RADIANS_TO_DEGREES  57.2957795132
+
+ImpedanceAnalyzer::ImpedanceAnalyzer(int numStreams_)
+    : pool(jlimit(1, numStreams_ > 0 ? numStreams_ : 1, SystemStats::getNumCpus())),
+      numStreams(numStreams_), startIndex(0), length(0), currentSlot(IMPEDANCE_NUM_SLOTS - 1)
+{
+
+}
+
+ImpedanceAnalyzer::~ImpedanceAnalyzer()
+{
+    waitForAll();
+}
+
+void ImpedanceAnalyzer::prepare(double sampleRate, double frequency, int startIndex_, int length_)
+{
+    waitForAll();
+
+    startIndex = startIndex_;
+    length = length_;
+
+    cosine.malloc(length);
+    sine.malloc(length);
+    windows.malloc(IMPEDANCE_NUM_SLOTS * numStreams * length);
+
+    fillOscillator(cosine, sine, startIndex, length, 2.0 * double_Pi * frequency / sampleRate);
+}
+
+void ImpedanceAnalyzer::beginRead()
+{
+    currentSlot = (currentSlot + 1) % IMPEDANCE_NUM_SLOTS;
+
+    OwnedArray<AnalysisJob>& slotJobs = jobs[currentSlot];
+
+    for (int i = 0; i < slotJobs.size(); i++)
+        pool.waitForJobToFinish(slotJobs[i], -1);
+
+    slotJobs.clear();
+}
+
+double* ImpedanceAnalyzer::getWindow(int stream)
+{
+    return windows + (currentSlot * numStreams + stream) * length;
+}
+
+void ImpedanceAnalyzer::analyse(int stream, double* magnitude, double* phase)
+{
+    AnalysisJob* job = new AnalysisJob(*this, getWindow(stream), magnitude, phase);
+
+    jobs[currentSlot].add(job);
+    pool.addJob(job, false);
+}
+
+void ImpedanceAnalyzer::waitForAll()
+{
+    for (int s = 0; s < IMPEDANCE_NUM_SLOTS; s++)
+    {
+        for (int i = 0; i < jobs[s].size(); i++)
+            pool.waitForJobToFinish(jobs[s][i], -1);
+
+        jobs[s].clear();
+    }
+}
+
+int ImpedanceAnalyzer::getStartIndex() const
+{
+    return startIndex;
+}
+
+int ImpedanceAnalyzer::getLength() const
+{
+    return length;
+}
+
+void ImpedanceAnalyzer::amplitudeOfFrequency(double& realComponent, double& imagComponent,
+                                             const double* samples, const double* cosine,
+                                             const double* sine, int length)
+{
+    // four partial sums, so the additions don't wait on each other
+    double sumI[4] = { 0.0, 0.0, 0.0, 0.0 };
+    double sumQ[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+    int t = 0;
+
+    for (; t + 4 <= length; t += 4)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            sumI[j] += samples[t + j] * cosine[t + j];
+            sumQ[j] += samples[t + j] * sine[t + j];
+        }
+    }
+
+    for (; t < length; t++)
+    {
+        sumI[0] += samples[t] * cosine[t];
+        sumQ[0] += samples[t] * sine[t];
+    }
+
+    const double meanI = (sumI[0] + sumI[1] + sumI[2] + sumI[3]) / (double) length;
+    const double meanQ = (sumQ[0] + sumQ[1] + sumQ[2] + sumQ[3]) / (double) length;
+
+    realComponent = 2.0 * meanI;
+    imagComponent = 2.0 * meanQ;
+}
+
+void ImpedanceAnalyzer::fillOscillator(double* cosine, double* sine, int startIndex,
+                                       int length, double k)
+{
+    const double cosK = cos(k);
+    const double sinK = sin(k);
+
+    double c = 0.0;
+    double s = 0.0;
+
+    for (int t = 0; t < length; t++)
+    {
+        if (t % IMPEDANCE_OSCILLATOR_RESEED == 0)
+        {
+            c = cos(k * (startIndex + t));
+            s = sin(k * (startIndex + t));
+        }
+
+        cosine[t] = c;
+        sine[t] = -s;
+
+        const double next = c * cosK - s * sinK;
+        s = s * cosK + c * sinK;
+        c = next;
+    }
+}
+
+ImpedanceAnalyzer::AnalysisJob::AnalysisJob(ImpedanceAnalyzer& analyzer_, const double* samples_,
+                                             double* magnitude_, double* phase_)
+    : ThreadPoolJob("Impedance analysis"), analyzer(analyzer_), samples(samples_),
+      magnitude(magnitude_), phase(phase_)
+{
+
+}
+
+ThreadPoolJob::JobStatus ImpedanceAnalyzer::AnalysisJob::runJob()
+{
+    double iComponent, qComponent;
+
+    amplitudeOfFrequency(iComponent, qComponent, samples, analyzer.cosine,
+                         analyzer.sine, analyzer.length);
+
+    *magnitude = sqrt(iComponent * iComponent + qComponent * qComponent);
+    *phase = RADIANS_TO_DEGREES * atan2(qComponent, iComponent);
+
+    return jobHasFinished;
+}
@@ -0,0 +1,124 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef __IMPEDANCEANALYZER_H_6E2B9D41__
+#define __IMPEDANCEANALYZER_H_6E2B9D41__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+#define IMPEDANCE_NUM_SLOTS 2          // reads that can be analysed at once
+#define IMPEDANCE_OSCILLATOR_RESEED 256 // samples between exact values of the oscillator
+
+/**
+
+  Measures the amplitude and phase of the test signal during an electrode
+  impedance test.
+
+  The reference sine and cosine are generated once per test by a recursive
+  oscillator (a rotation by the test frequency each sample, reseeded now
+  and then so it doesn't drift), so measuring a channel is just two dot
+  products with its samples.
+
+  The RHD2000Thread copies the test channel of every stream into a slot,
+  then hands each stream to the thread pool and goes on to the next read
+  from the board. A slot is only refilled once its jobs have finished, so
+  the analysis of one read overlaps with the USB transfer of the next.
+
+  amplitudeOfFrequency() doesn't depend on the board, and can be tried on
+  synthetic data.
+
+  @see RHD2000Thread
+
+*/
+
+class ImpedanceAnalyzer
+{
+public:
+    ImpedanceAnalyzer(int numStreams);
+    ~ImpedanceAnalyzer();
+
+    /** Sets the test frequency and the window that is measured: length
+        samples, starting startIndex samples into each read. */
+    void prepare(double sampleRate, double frequency, int startIndex, int length);
+
+    /** Moves to the next slot, waiting for its previous jobs if needed. */
+    void beginRead();
+
+    /** Where the window of a stream goes, for the current slot. */
+    double* getWindow(int stream);
+
+    /** Analyses a stream of the current slot in the background; the
+        magnitude and the phase (in degrees) are written when it's done. */
+    void analyse(int stream, double* magnitude, double* phase);
+
+    /** Waits until every result has been written. */
+    void waitForAll();
+
+    int getStartIndex() const;
+    int getLength() const;
+
+    /** Correlates samples with the reference oscillator; returns twice the
+        mean of each product, i.e. the real and imaginary amplitude of the
+        frequency component. */
+    static void amplitudeOfFrequency(double& realComponent, double& imagComponent,
+                                     const double* samples, const double* cosine,
+                                     const double* sine, int length);
+
+    /** Fills cosine and sine with cos(k*t) and -sin(k*t) for t = startIndex
+        onwards, where k is the frequency in radians per sample. */
+    static void fillOscillator(double* cosine, double* sine, int startIndex,
+                               int length, double k);
+
+private:
+
+    class AnalysisJob : public ThreadPoolJob
+    {
+    public:
+        AnalysisJob(ImpedanceAnalyzer& analyzer, const double* samples,
+                    double* magnitude, double* phase);
+        JobStatus runJob();
+
+    private:
+        ImpedanceAnalyzer& analyzer;
+        const double* samples;
+        double* magnitude;
+        double* phase;
+    };
+
+    ThreadPool pool;
+
+    int numStreams;
+    int startIndex;
+    int length;
+
+    HeapBlock<double> cosine;
+    HeapBlock<double> sine;
+    HeapBlock<double> windows; // slot-major, then stream-major
+
+    int currentSlot;
+    OwnedArray<AnalysisJob> jobs[IMPEDANCE_NUM_SLOTS];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ImpedanceAnalyzer);
+
+};
+
+#endif  // __IMPEDANCEANALYZER_H_6E2B9D41__
@@ -0,0 +1,247 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "NetworkStreamEditor.h"
+#include "NetworkStreamThread.h"
+#include "../SourceNode/SourceNode.h"
+#include "../../UI/EditorViewport.h"
+
+NetworkStreamEditor::NetworkStreamEditor(GenericProcessor* parentNode,
+                                         NetworkStreamThread* thread_,
+                                         bool useDefaultParameterEditors)
+    : GenericEditor(parentNode, useDefaultParameterEditors), thread(thread_), statusTimer(this)
+{
+    desiredWidth = 200;
+
+    transportSelector = new ComboBox("Transport");
+    transportSelector->setBounds(10,30,85,20);
+#ifdef ZEROMQ
+    transportSelector->addItem("ZeroMQ", NetworkStreamThread::ZEROMQ_TRANSPORT);
+#endif
+    transportSelector->addItem("UDP", NetworkStreamThread::UDP_TRANSPORT);
+    transportSelector->setSelectedId(thread->getTransport(), dontSendNotification);
+    transportSelector->addListener(this);
+    addAndMakeVisible(transportSelector);
+
+    connectButton = new UtilityButton("Connect", Font("Small Text", 13, Font::plain));
+    connectButton->setRadius(3.0f);
+    connectButton->setBounds(105,30,85,20);
+    connectButton->addListener(this);
+    connectButton->setTooltip("Listen for the stream and take its channel count and sample rate");
+    addAndMakeVisible(connectButton);
+
+    hostLabel = new Label("Host", "Host:");
+    hostLabel->setFont(Font("Small Text", 11, Font::plain));
+    hostLabel->setBounds(5,55,45,18);
+    hostLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(hostLabel);
+
+    hostValue = new Label("Host value", thread->getHost());
+    hostValue->setFont(Font("Default", 13, Font::plain));
+    hostValue->setBounds(50,55,140,18);
+    hostValue->setColour(Label::textColourId, Colours::white);
+    hostValue->setColour(Label::backgroundColourId, Colours::grey);
+    hostValue->setEditable(true);
+    hostValue->addListener(this);
+    hostValue->setTooltip("Sender address (ZeroMQ), or local address or multicast group (UDP)");
+    addAndMakeVisible(hostValue);
+
+    portLabel = new Label("Port", "Port:");
+    portLabel->setFont(Font("Small Text", 11, Font::plain));
+    portLabel->setBounds(5,78,45,18);
+    portLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(portLabel);
+
+    portValue = new Label("Port value", String(thread->getPort()));
+    portValue->setFont(Font("Default", 13, Font::plain));
+    portValue->setBounds(50,78,50,18);
+    portValue->setColour(Label::textColourId, Colours::white);
+    portValue->setColour(Label::backgroundColourId, Colours::grey);
+    portValue->setEditable(true);
+    portValue->addListener(this);
+    addAndMakeVisible(portValue);
+
+    latencyLabel = new Label("Latency", "Buffer:");
+    latencyLabel->setFont(Font("Small Text", 11, Font::plain));
+    latencyLabel->setBounds(105,78,45,18);
+    latencyLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(latencyLabel);
+
+    latencyValue = new Label("Latency value", String(thread->getLatency()));
+    latencyValue->setFont(Font("Default", 13, Font::plain));
+    latencyValue->setBounds(150,78,40,18);
+    latencyValue->setColour(Label::textColourId, Colours::white);
+    latencyValue->setColour(Label::backgroundColourId, Colours::grey);
+    latencyValue->setEditable(true);
+    latencyValue->addListener(this);
+    latencyValue->setTooltip("Milliseconds of data held back to absorb network jitter");
+    addAndMakeVisible(latencyValue);
+
+    loopbackButton = new UtilityButton("Loopback", Font("Small Text", 13, Font::plain));
+    loopbackButton->setRadius(3.0f);
+    loopbackButton->setBounds(10,101,85,18);
+    loopbackButton->addListener(this);
+    loopbackButton->setClickingTogglesState(true);
+    loopbackButton->setTooltip("Send a test stream to this host and port");
+    addAndMakeVisible(loopbackButton);
+
+    statusLabel = new Label("Status", thread->getStatus());
+    statusLabel->setFont(Font("Small Text", 11, Font::plain));
+    statusLabel->setBounds(5,120,190,18);
+    statusLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(statusLabel);
+
+}
+
+NetworkStreamEditor::~NetworkStreamEditor()
+{
+
+}
+
+void NetworkStreamEditor::connectToStream(int timeoutMs)
+{
+    thread->connect(timeoutMs);
+
+    updateStatus();
+
+    SourceNode* sn = (SourceNode*) getProcessor();
+
+    if (!sn->tryEnablingEditor())
+        sn->enabledState(false);
+
+    getEditorViewport()->makeEditorVisible(this, false, true);
+}
+
+void NetworkStreamEditor::buttonEvent(Button* button)
+{
+    if (button == connectButton && !acquisitionIsActive)
+    {
+        connectToStream(2000);
+    }
+    else if (button == loopbackButton)
+    {
+        thread->setLoopback(loopbackButton->getToggleState());
+    }
+}
+
+void NetworkStreamEditor::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox == transportSelector)
+    {
+        thread->setTransport((NetworkStreamThread::Transport) transportSelector->getSelectedId());
+
+        // the loopback sender has to follow
+        if (thread->getLoopback())
+            thread->setLoopback(true);
+    }
+}
+
+void NetworkStreamEditor::labelTextChanged(Label* label)
+{
+    if (label == hostValue)
+    {
+        thread->setHost(label->getText().trim());
+    }
+    else if (label == portValue)
+    {
+        const int port = label->getText().getIntValue();
+
+        if (port > 0 && port < 65536)
+            thread->setPort(port);
+        else
+            label->setText(String(thread->getPort()), dontSendNotification);
+    }
+    else if (label == latencyValue)
+    {
+        const int latency = label->getText().getIntValue();
+
+        if (latency > 0)
+            thread->setLatency(latency);
+        else
+            label->setText(String(thread->getLatency()), dontSendNotification);
+    }
+
+    if (label != latencyValue && thread->getLoopback())
+        thread->setLoopback(true);
+}
+
+void NetworkStreamEditor::startAcquisition()
+{
+    GenericEditor::startAcquisition();
+
+    transportSelector->setEnabled(false);
+    hostValue->setEditable(false);
+    portValue->setEditable(false);
+    latencyValue->setEditable(false);
+
+    statusTimer.startTimer(500);
+}
+
+void NetworkStreamEditor::stopAcquisition()
+{
+    GenericEditor::stopAcquisition();
+
+    statusTimer.stopTimer();
+    updateStatus();
+
+    transportSelector->setEnabled(true);
+    hostValue->setEditable(true);
+    portValue->setEditable(true);
+    latencyValue->setEditable(true);
+}
+
+void NetworkStreamEditor::updateStatus()
+{
+    String status = thread->getStatus();
+
+    statusLabel->setText(status, dontSendNotification);
+    statusLabel->setTooltip(status);
+}
+
+void NetworkStreamEditor::saveCustomParameters(XmlElement* xml)
+{
+    xml->setAttribute("Transport", (int) thread->getTransport());
+    xml->setAttribute("Host", thread->getHost());
+    xml->setAttribute("Port", thread->getPort());
+    xml->setAttribute("Latency", thread->getLatency());
+    xml->setAttribute("Int16BitVolts", thread->getInt16BitVolts());
+    xml->setAttribute("Connected", thread->foundInputSource());
+}
+
+void NetworkStreamEditor::loadCustomParameters(XmlElement* xml)
+{
+    thread->setTransport((NetworkStreamThread::Transport) xml->getIntAttribute("Transport", thread->getTransport()));
+    thread->setHost(xml->getStringAttribute("Host", thread->getHost()));
+    thread->setPort(xml->getIntAttribute("Port", thread->getPort()));
+    thread->setLatency(xml->getIntAttribute("Latency", thread->getLatency()));
+    thread->setInt16BitVolts((float) xml->getDoubleAttribute("Int16BitVolts", thread->getInt16BitVolts()));
+
+    transportSelector->setSelectedId(thread->getTransport(), dontSendNotification);
+    hostValue->setText(thread->getHost(), dontSendNotification);
+    portValue->setText(String(thread->getPort()), dontSendNotification);
+    latencyValue->setText(String(thread->getLatency()), dontSendNotification);
+
+    // pick the stream up again so that the saved channel settings apply
+    if (xml->getBoolAttribute("Connected"))
+        connectToStream(1000);
+}
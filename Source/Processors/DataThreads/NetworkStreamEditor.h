@@ -0,0 +1,96 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __NETWORKSTREAMEDITOR_H_5B0F3C2A__
+#define __NETWORKSTREAMEDITOR_H_5B0F3C2A__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../Editors/GenericEditor.h"
+
+class NetworkStreamThread;
+
+/**
+
+  User interface for the "Network Stream" source node.
+
+  @see SourceNode, NetworkStreamThread
+
+*/
+
+class NetworkStreamEditor : public GenericEditor,
+    public ComboBox::Listener,
+    public Label::Listener
+{
+public:
+    NetworkStreamEditor(GenericProcessor* parentNode, NetworkStreamThread* thread, bool useDefaultParameterEditors);
+    virtual ~NetworkStreamEditor();
+
+    void buttonEvent(Button* button);
+    void comboBoxChanged(ComboBox* comboBox);
+    void labelTextChanged(Label* label);
+
+    void startAcquisition();
+    void stopAcquisition();
+
+    void saveCustomParameters(XmlElement* xml);
+    void loadCustomParameters(XmlElement* xml);
+
+private:
+
+    /** Listens for the stream and updates the signal chain with its channels. */
+    void connectToStream(int timeoutMs);
+
+    void updateStatus();
+
+    /** Refreshes the status line during acquisition (GenericEditor's own timer is used for fading). */
+    class StatusTimer : public Timer
+    {
+    public:
+        StatusTimer(NetworkStreamEditor* e) : editor(e) {}
+        void timerCallback()
+        {
+            editor->updateStatus();
+        }
+    private:
+        NetworkStreamEditor* editor;
+    };
+
+    NetworkStreamThread* thread;
+    StatusTimer statusTimer;
+
+    ScopedPointer<ComboBox> transportSelector;
+    ScopedPointer<UtilityButton> connectButton;
+    ScopedPointer<Label> hostLabel;
+    ScopedPointer<Label> hostValue;
+    ScopedPointer<Label> portLabel;
+    ScopedPointer<Label> portValue;
+    ScopedPointer<Label> latencyLabel;
+    ScopedPointer<Label> latencyValue;
+    ScopedPointer<UtilityButton> loopbackButton;
+    ScopedPointer<Label> statusLabel;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NetworkStreamEditor);
+
+};
+
+#endif  // __NETWORKSTREAMEDITOR_H_5B0F3C2A__
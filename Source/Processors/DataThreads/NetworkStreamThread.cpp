@@ -0,0 +1,985 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifdef ZEROMQ
+
+#ifdef WIN32
+    #include "../../Resources/windows-libs/ZeroMQ/include/zmq.h"
+#else
+    #include <zmq.h>
+#endif
+
+#endif
+
+#include "NetworkStreamThread.h"
+#include "../SourceNode/SourceNode.h"
+
+#if JUCE_WINDOWS
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <sys/select.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <netdb.h>
+    #include <unistd.h>
+#endif
+
+//---------------------------------------------------------------------
+// UDP helpers
+
+static void initSockets()
+{
+#if JUCE_WINDOWS
+    static bool initialised = false;
+
+    if (!initialised)
+    {
+        WSADATA wsaData;
+        WSAStartup(MAKEWORD(2, 2), &wsaData);
+        initialised = true;
+    }
+#endif
+}
+
+static void closeUdpSocket(int s)
+{
+#if JUCE_WINDOWS
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+/** Looks up an IPv4 address (in network byte order). */
+static bool resolveAddress(const String& host, uint32& address)
+{
+    struct addrinfo hints;
+    struct addrinfo* info = nullptr;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    if (getaddrinfo(host.toRawUTF8(), nullptr, &hints, &info) != 0 || info == nullptr)
+        return false;
+
+    address = ((struct sockaddr_in*) info->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(info);
+
+    return true;
+}
+
+static bool isMulticastAddress(uint32 address)
+{
+    return (ntohl(address) & 0xF0000000) == 0xE0000000;
+}
+
+static bool isAnyAddress(const String& host)
+{
+    return host.isEmpty() || host == "*";
+}
+
+//---------------------------------------------------------------------
+
+NetworkStreamThread::NetworkStreamThread(SourceNode* sn) : DataThread(sn),
+    transport(UDP_TRANSPORT), host("127.0.0.1"), port(NETWORK_SINK_DEFAULT_PORT),
+    latencyMs(NETWORK_STREAM_DEFAULT_LATENCY), int16BitVolts(0.195f),
+    sourceFound(false), numChannels(0), sampleRate(30000.0f),
+    context(nullptr), subscriber(nullptr), udpSocket(-1),
+    messageSize(NETWORK_STREAM_MAX_MESSAGE_SIZE),
+    stagingSize(0), stagedRead(0), numStaged(0), latencySamples(1),
+    primed(false), releaseStartTicks(0), numReleased(0),
+    haveSequence(false), expectedSequence(0), gapSinceLastContinuous(false),
+    haveTimestamp(false), expectedTimestamp(0), lastTimestamp(0), lastNumSamples(0), timestampStep(1),
+    numPendingEvents(0), eventState(0)
+{
+
+#ifdef ZEROMQ
+    transport = ZEROMQ_TRANSPORT;
+    context = zmq_ctx_new();
+#endif
+
+    initSockets();
+
+    message.malloc(messageSize);
+
+    dataBuffer = new DataBuffer(1, 10000); // resized once the stream is found
+
+}
+
+NetworkStreamThread::~NetworkStreamThread()
+{
+    stopAcquisition();
+
+    loopback = nullptr;
+
+    closeSocket();
+
+#ifdef ZEROMQ
+    if (context != nullptr)
+        zmq_ctx_term(context);
+#endif
+
+}
+
+bool NetworkStreamThread::foundInputSource()
+{
+    return sourceFound;
+}
+
+int NetworkStreamThread::getNumHeadstageOutputs()
+{
+    return numChannels;
+}
+
+int NetworkStreamThread::getNumEventChannels()
+{
+    return NETWORK_STREAM_NUM_EVENT_CHANNELS;
+}
+
+float NetworkStreamThread::getSampleRate()
+{
+    return sampleRate;
+}
+
+float NetworkStreamThread::getBitVolts(Channel* chan)
+{
+    return int16BitVolts;
+}
+
+void NetworkStreamThread::setTransport(Transport t)
+{
+    transport = t;
+}
+
+NetworkStreamThread::Transport NetworkStreamThread::getTransport()
+{
+    return transport;
+}
+
+void NetworkStreamThread::setHost(const String& host_)
+{
+    host = host_;
+}
+
+String NetworkStreamThread::getHost()
+{
+    return host;
+}
+
+void NetworkStreamThread::setPort(int port_)
+{
+    port = port_;
+}
+
+int NetworkStreamThread::getPort()
+{
+    return port;
+}
+
+void NetworkStreamThread::setLatency(int milliseconds)
+{
+    latencyMs = jmax(1, milliseconds);
+}
+
+int NetworkStreamThread::getLatency()
+{
+    return latencyMs;
+}
+
+void NetworkStreamThread::setInt16BitVolts(float bitVolts)
+{
+    int16BitVolts = bitVolts;
+}
+
+float NetworkStreamThread::getInt16BitVolts()
+{
+    return int16BitVolts;
+}
+
+int NetworkStreamThread::getNumGaps()
+{
+    return numGaps.get();
+}
+
+int NetworkStreamThread::getNumMissingMessages()
+{
+    return numMissingMessages.get();
+}
+
+int NetworkStreamThread::getNumFilledSamples()
+{
+    return numFilledSamples.get();
+}
+
+int NetworkStreamThread::getNumUnderruns()
+{
+    return numUnderruns.get();
+}
+
+String NetworkStreamThread::getStatus()
+{
+    if (!sourceFound)
+        return "Not connected";
+
+    String status = String(numChannels) + " ch at " + String(sampleRate, 0) + " Hz";
+
+    if (numGaps.get() > 0)
+        status += ", " + String(numGaps.get()) + " gaps";
+
+    if (numUnderruns.get() > 0)
+        status += ", " + String(numUnderruns.get()) + " underruns";
+
+    return status;
+}
+
+void NetworkStreamThread::setLoopback(bool shouldSend)
+{
+    loopback = nullptr;
+
+    if (shouldSend)
+    {
+        loopback = new NetworkStreamSender(transport, host, port);
+        loopback->startThread();
+    }
+}
+
+bool NetworkStreamThread::getLoopback()
+{
+    return loopback != nullptr;
+}
+
+bool NetworkStreamThread::openSocket()
+{
+    closeSocket();
+
+    if (transport == ZEROMQ_TRANSPORT)
+    {
+#ifdef ZEROMQ
+        if (context == nullptr)
+            return false;
+
+        subscriber = zmq_socket(context, ZMQ_SUB);
+
+        int linger = 0;
+        zmq_setsockopt(subscriber, ZMQ_LINGER, &linger, sizeof(linger));
+        zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
+
+        String url = "tcp://" + (isAnyAddress(host) ? String("127.0.0.1") : host) + ":" + String(port);
+
+        if (zmq_connect(subscriber, url.toRawUTF8()) != 0)
+        {
+            std::cout << "Network stream could not connect to " << url << ": "
+                      << zmq_strerror(zmq_errno()) << std::endl;
+            closeSocket();
+            return false;
+        }
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    udpSocket = (int) socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    if (udpSocket < 0)
+        return false;
+
+    // lets several receivers on one machine share a multicast stream
+    int reuse = 1;
+    setsockopt(udpSocket, SOL_SOCKET, SO_REUSEADDR, (const char*) &reuse, sizeof(reuse));
+
+    // room for bursts while the thread isn't reading
+    int receiveBufferSize = 4 * 1024 * 1024;
+    setsockopt(udpSocket, SOL_SOCKET, SO_RCVBUF, (const char*) &receiveBufferSize, sizeof(receiveBufferSize));
+
+    uint32 address = htonl(INADDR_ANY);
+
+    if (!isAnyAddress(host) && !resolveAddress(host, address))
+    {
+        std::cout << "Network stream could not resolve " << host << std::endl;
+        closeSocket();
+        return false;
+    }
+
+    const bool multicast = isMulticastAddress(address);
+
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons((uint16) port);
+    local.sin_addr.s_addr = multicast ? htonl(INADDR_ANY) : address;
+
+    if (bind(udpSocket, (struct sockaddr*) &local, sizeof(local)) != 0)
+    {
+        std::cout << "Network stream could not bind to UDP port " << port << std::endl;
+        closeSocket();
+        return false;
+    }
+
+    if (multicast)
+    {
+        struct ip_mreq request;
+        request.imr_multiaddr.s_addr = address;
+        request.imr_interface.s_addr = htonl(INADDR_ANY);
+
+        if (setsockopt(udpSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*) &request, sizeof(request)) != 0)
+        {
+            std::cout << "Network stream could not join multicast group " << host << std::endl;
+            closeSocket();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void NetworkStreamThread::closeSocket()
+{
+#ifdef ZEROMQ
+    if (subscriber != nullptr)
+        zmq_close(subscriber);
+#endif
+
+    subscriber = nullptr;
+
+    if (udpSocket >= 0)
+        closeUdpSocket(udpSocket);
+
+    udpSocket = -1;
+}
+
+int NetworkStreamThread::receive(int timeoutMs)
+{
+    if (transport == ZEROMQ_TRANSPORT)
+    {
+#ifdef ZEROMQ
+        if (subscriber == nullptr)
+            return -1;
+
+        zmq_pollitem_t item;
+        item.socket = subscriber;
+        item.fd = 0;
+        item.events = ZMQ_POLLIN;
+        item.revents = 0;
+
+        const int ready = zmq_poll(&item, 1, timeoutMs);
+
+        if (ready <= 0)
+            return ready;
+
+        zmq_msg_t msg;
+        zmq_msg_init(&msg);
+
+        int numBytes = zmq_msg_recv(&msg, subscriber, ZMQ_DONTWAIT);
+
+        if (numBytes > messageSize)
+        {
+            // a NetworkSink with many channels sends more than one datagram's worth
+            messageSize = numBytes;
+            message.realloc(messageSize);
+        }
+
+        if (numBytes > 0)
+            memcpy(message, zmq_msg_data(&msg), numBytes);
+
+        zmq_msg_close(&msg);
+
+        return jmax(0, numBytes);
+#else
+        return -1;
+#endif
+    }
+
+    if (udpSocket < 0)
+        return -1;
+
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(udpSocket, &readSet);
+
+    struct timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+
+    const int ready = select(udpSocket + 1, &readSet, nullptr, nullptr, &timeout);
+
+    if (ready <= 0)
+        return ready;
+
+    const int numBytes = (int) recv(udpSocket, (char*) message.getData(), messageSize, 0);
+
+    return numBytes < 0 ? -1 : numBytes;
+}
+
+bool NetworkStreamThread::connect(int timeoutMs)
+{
+    disconnect();
+
+    if (!openSocket())
+        return false;
+
+    const uint32 start = Time::getMillisecondCounter();
+
+    while (Time::getMillisecondCounter() - start < (uint32) timeoutMs)
+    {
+        const int numBytes = receive(50);
+
+        if (numBytes < 0)
+            break;
+
+        NetworkMessageHeader header;
+
+        if (numBytes > 0 && header.read(message, numBytes)
+            && header.type == NetworkSink::CONTINUOUS_MESSAGE
+            && header.numChannels > 0 && header.sampleRate > 0)
+        {
+            numChannels = header.numChannels;
+            sampleRate = header.sampleRate;
+            sourceFound = true;
+
+            dataBuffer->resize(numChannels, 10000);
+
+            std::cout << "Network stream found: " << numChannels << " channels at "
+                      << sampleRate << " Hz." << std::endl;
+
+            return true;
+        }
+    }
+
+    std::cout << "No network stream found on port " << port << std::endl;
+
+    closeSocket();
+
+    return false;
+}
+
+void NetworkStreamThread::disconnect()
+{
+    closeSocket();
+    sourceFound = false;
+}
+
+void NetworkStreamThread::resetStream()
+{
+    latencySamples = jmax(1, int(latencyMs * sampleRate / 1000.0f));
+
+    stagingSize = jmax(4 * latencySamples, 8192);
+
+    staged.malloc(stagingSize * numChannels);
+    stagedTimestamps.malloc(stagingSize);
+    stagedEventCodes.malloc(stagingSize);
+
+    stagedRead = 0;
+    numStaged = 0;
+
+    primed = false;
+    numReleased = 0;
+
+    haveSequence = false;
+    gapSinceLastContinuous = false;
+    haveTimestamp = false;
+    lastNumSamples = 0;
+    timestampStep = 1;
+
+    numPendingEvents = 0;
+    eventState = 0;
+
+    numGaps.set(0);
+    numMissingMessages.set(0);
+    numFilledSamples.set(0);
+    numUnderruns.set(0);
+}
+
+bool NetworkStreamThread::startAcquisition()
+{
+    if (!sourceFound)
+        return false;
+
+    if (subscriber == nullptr && udpSocket < 0 && !openSocket())
+        return false;
+
+    // throw away whatever queued up while we weren't acquiring
+    while (receive(0) > 0)
+    {
+    }
+
+    resetStream();
+
+    dataBuffer->clear();
+
+    startThread();
+
+    return true;
+}
+
+bool NetworkStreamThread::stopAcquisition()
+{
+    if (isThreadRunning())
+    {
+        signalThreadShouldExit();
+    }
+
+    if (!waitForThreadToExit(500))
+    {
+        std::cout << "Network stream thread failed to exit, continuing anyway..." << std::endl;
+    }
+
+    dataBuffer->clear();
+
+    return true;
+}
+
+bool NetworkStreamThread::updateBuffer()
+{
+    // wait briefly for the next message, then take whatever else has arrived
+    int numBytes = receive(1);
+    int numMessages = 0;
+
+    while (numBytes > 0)
+    {
+        handleMessage(numBytes);
+
+        if (++numMessages == 64)
+            break;
+
+        numBytes = receive(0);
+    }
+
+    if (numBytes < 0)
+    {
+        std::cout << "Network stream socket error." << std::endl;
+        return false;
+    }
+
+    releaseSamples();
+
+    return true;
+}
+
+void NetworkStreamThread::handleMessage(int numBytes)
+{
+    NetworkMessageHeader header;
+
+    if (!header.read(message, numBytes))
+        return;
+
+    if (haveSequence)
+    {
+        const int32 difference = (int32)(header.sequenceNumber - expectedSequence);
+
+        if (difference < 0 && difference > -256)
+        {
+            // late or duplicated; its samples have already been filled in
+            return;
+        }
+        else if (difference < 0)
+        {
+            // the sender has restarted
+            haveTimestamp = false;
+        }
+        else if (difference > 0)
+        {
+            ++numGaps;
+            numMissingMessages += difference;
+            gapSinceLastContinuous = true;
+        }
+    }
+
+    haveSequence = true;
+    expectedSequence = header.sequenceNumber + 1;
+
+    const uint8* payload = message + NETWORK_SINK_HEADER_SIZE;
+    const int payloadBytes = numBytes - NETWORK_SINK_HEADER_SIZE;
+
+    if (header.type == NetworkSink::CONTINUOUS_MESSAGE)
+    {
+        if (header.numChannels == numChannels)
+            stageContinuous(header, payload, payloadBytes);
+    }
+    else if (header.type == NetworkSink::EVENT_MESSAGE)
+    {
+        if (payloadBytes >= 4 && payload[1] < NETWORK_STREAM_NUM_EVENT_CHANNELS
+            && numPendingEvents < NETWORK_STREAM_MAX_PENDING_EVENTS)
+        {
+            PendingEvent& event = pendingEvents[numPendingEvents++];
+            event.timestamp = header.timestamp;
+            event.channel = payload[1];
+            event.on = (payload[0] != 0);
+        }
+    }
+}
+
+void NetworkStreamThread::stageContinuous(const NetworkMessageHeader& header,
+                                          const uint8* payload, int payloadBytes)
+{
+    const int numSamples = header.numSamples;
+    const int bytesPerSample = (header.format == 1) ? 4 : 2;
+
+    if (payloadBytes < numChannels * 2 + numChannels * numSamples * bytesPerSample)
+        return;
+
+    const uint8* samples = payload + numChannels * 2;
+    const int64 ts = header.timestamp;
+
+    if (haveTimestamp)
+    {
+        if (!gapSinceLastContinuous)
+        {
+            // the sender may decimate, so learn how far its timestamps advance per sample
+            if (lastNumSamples > 0 && ts > lastTimestamp)
+                timestampStep = jmax((int64) 1, (ts - lastTimestamp) / lastNumSamples);
+        }
+        else
+        {
+            // fill what was lost, so that later samples keep their timestamps
+            const int64 numMissing = (ts - expectedTimestamp) / timestampStep;
+
+            if (numMissing > 0 && numMissing <= (int64) sampleRate)
+            {
+                for (int64 i = 0; i < numMissing; i++)
+                    zeromem(stageSample(expectedTimestamp + i * timestampStep), sizeof(float) * numChannels);
+
+                numFilledSamples += (int) numMissing;
+            }
+        }
+    }
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        float* dest = stageSample(ts + i * timestampStep);
+
+        if (bytesPerSample == 4)
+        {
+            for (int c = 0; c < numChannels; c++)
+                memcpy(dest + c, samples + (c * numSamples + i) * 4, 4);
+        }
+        else
+        {
+            for (int c = 0; c < numChannels; c++)
+            {
+                int16 value;
+                memcpy(&value, samples + (c * numSamples + i) * 2, 2);
+                dest[c] = value * int16BitVolts;
+            }
+        }
+    }
+
+    haveTimestamp = true;
+    gapSinceLastContinuous = false;
+    lastTimestamp = ts;
+    lastNumSamples = numSamples;
+    expectedTimestamp = ts + numSamples * timestampStep;
+}
+
+float* NetworkStreamThread::stageSample(int64 ts)
+{
+    if (numStaged == stagingSize)
+    {
+        // nothing is being released; drop the oldest sample
+        stagedRead = (stagedRead + 1) % stagingSize;
+        numStaged--;
+    }
+
+    // apply events up to this sample, in the order they arrived
+    int numLeft = 0;
+
+    for (int e = 0; e < numPendingEvents; e++)
+    {
+        const PendingEvent& event = pendingEvents[e];
+
+        if (event.timestamp <= ts)
+        {
+            if (event.on)
+                eventState |= (uint64(1) << event.channel);
+            else
+                eventState &= ~(uint64(1) << event.channel);
+        }
+        else
+        {
+            pendingEvents[numLeft++] = event;
+        }
+    }
+
+    numPendingEvents = numLeft;
+
+    const int index = (stagedRead + numStaged) % stagingSize;
+
+    stagedTimestamps[index] = ts;
+    stagedEventCodes[index] = eventState;
+    numStaged++;
+
+    return staged + index * numChannels;
+}
+
+void NetworkStreamThread::releaseSamples()
+{
+    if (!primed)
+    {
+        if (numStaged < latencySamples)
+            return;
+
+        primed = true;
+        releaseStartTicks = Time::getHighResolutionTicks();
+        numReleased = 0;
+    }
+
+    const double elapsed = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks()
+                                                              - releaseStartTicks);
+
+    int64 numDue = (int64)(elapsed * sampleRate) - numReleased;
+    bool restartClock = false;
+
+    if (numStaged - numDue > 2 * latencySamples)
+    {
+        // the sender's clock is faster than ours; catch up
+        numDue = numStaged - latencySamples;
+        restartClock = true;
+    }
+    else if (numDue > numStaged)
+    {
+        // ran dry: wait until the buffer has filled up again
+        ++numUnderruns;
+        numDue = numStaged;
+        primed = false;
+    }
+
+    for (int64 i = 0; i < numDue; i++)
+    {
+        dataBuffer->addToBuffer(staged + stagedRead * numChannels,
+                                stagedTimestamps + stagedRead,
+                                stagedEventCodes + stagedRead,
+                                1);
+
+        stagedRead = (stagedRead + 1) % stagingSize;
+    }
+
+    numStaged -= (int) numDue;
+    numReleased += numDue;
+
+    if (restartClock)
+    {
+        releaseStartTicks = Time::getHighResolutionTicks();
+        numReleased = 0;
+    }
+}
+
+//---------------------------------------------------------------------
+
+NetworkStreamSender::NetworkStreamSender(NetworkStreamThread::Transport transport_, const String& host_,
+                                         int port_, int numChannels_, float sampleRate_)
+    : Thread("Network Stream Sender"), transport(transport_), host(host_), port(port_),
+      numChannels(numChannels_), sampleRate(sampleRate_),
+      context(nullptr), publisher(nullptr), udpSocket(-1), destinationAddress(0)
+{
+    initSockets();
+}
+
+NetworkStreamSender::~NetworkStreamSender()
+{
+    stopThread(1000);
+}
+
+bool NetworkStreamSender::openSocket()
+{
+    if (transport == NetworkStreamThread::ZEROMQ_TRANSPORT)
+    {
+#ifdef ZEROMQ
+        context = zmq_ctx_new();
+        publisher = zmq_socket(context, ZMQ_PUB);
+
+        int linger = 0;
+        zmq_setsockopt(publisher, ZMQ_LINGER, &linger, sizeof(linger));
+
+        String url = "tcp://*:" + String(port);
+
+        if (zmq_bind(publisher, url.toRawUTF8()) != 0)
+        {
+            std::cout << "Network stream sender could not bind to " << url << ": "
+                      << zmq_strerror(zmq_errno()) << std::endl;
+            closeSocket();
+            return false;
+        }
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    if (isAnyAddress(host))
+        destinationAddress = htonl(INADDR_LOOPBACK);
+    else if (!resolveAddress(host, destinationAddress))
+        return false;
+
+    udpSocket = (int) socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    return udpSocket >= 0;
+}
+
+void NetworkStreamSender::closeSocket()
+{
+#ifdef ZEROMQ
+    if (publisher != nullptr)
+        zmq_close(publisher);
+
+    if (context != nullptr)
+        zmq_ctx_term(context);
+#endif
+
+    publisher = nullptr;
+    context = nullptr;
+
+    if (udpSocket >= 0)
+        closeUdpSocket(udpSocket);
+
+    udpSocket = -1;
+}
+
+void NetworkStreamSender::send(const uint8* data, int numBytes)
+{
+#ifdef ZEROMQ
+    if (publisher != nullptr)
+    {
+        zmq_send(publisher, data, numBytes, ZMQ_DONTWAIT);
+        return;
+    }
+#endif
+
+    if (udpSocket >= 0)
+    {
+        struct sockaddr_in destination;
+        memset(&destination, 0, sizeof(destination));
+        destination.sin_family = AF_INET;
+        destination.sin_port = htons((uint16) port);
+        destination.sin_addr.s_addr = destinationAddress;
+
+        sendto(udpSocket, (const char*) data, numBytes, 0,
+               (struct sockaddr*) &destination, sizeof(destination));
+    }
+}
+
+void NetworkStreamSender::run()
+{
+    if (!openSocket())
+    {
+        std::cout << "Network stream sender could not open its socket." << std::endl;
+        return;
+    }
+
+    // every message has to fit in one datagram
+    const int samplesPerMessage = jmin(256, (NETWORK_STREAM_MAX_MESSAGE_SIZE - NETWORK_SINK_HEADER_SIZE
+                                             - 2 * numChannels) / (2 * numChannels));
+
+    HeapBlock<uint8> buffer(NETWORK_SINK_HEADER_SIZE + 2 * numChannels
+                            + 2 * numChannels * samplesPerMessage);
+
+    uint8* indices = buffer + NETWORK_SINK_HEADER_SIZE;
+    uint8* samples = indices + 2 * numChannels;
+
+    for (int c = 0; c < numChannels; c++)
+    {
+        const uint16 index = (uint16) c;
+        memcpy(indices + c * 2, &index, 2);
+    }
+
+    const float bitVolts = 0.195f;
+    const int64 ttlHalfPeriod = (int64)(sampleRate / 2);
+
+    Random random;
+    NetworkMessageHeader header;
+    uint32 sequenceNumber = 0;
+    int64 timestamp = 0;
+
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    while (!threadShouldExit())
+    {
+        const double elapsed = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+
+        if (timestamp + samplesPerMessage > (int64)(elapsed * sampleRate))
+        {
+            wait(1);
+            continue;
+        }
+
+        // a 1 Hz square wave on event channel 0
+        const int64 firstEdge = ((timestamp + ttlHalfPeriod - 1) / ttlHalfPeriod) * ttlHalfPeriod;
+
+        for (int64 edge = firstEdge; edge < timestamp + samplesPerMessage; edge += ttlHalfPeriod)
+        {
+            uint8 eventMessage[NETWORK_SINK_HEADER_SIZE + 4];
+
+            header.type = NetworkSink::EVENT_MESSAGE;
+            header.format = 0;
+            header.numChannels = 0;
+            header.numSamples = 0;
+            header.sequenceNumber = sequenceNumber++;
+            header.sampleRate = sampleRate;
+            header.timestamp = edge;
+            header.write(eventMessage);
+
+            eventMessage[NETWORK_SINK_HEADER_SIZE] = ((edge / ttlHalfPeriod) % 2 == 0) ? 1 : 0;
+            eventMessage[NETWORK_SINK_HEADER_SIZE + 1] = 0;
+            eventMessage[NETWORK_SINK_HEADER_SIZE + 2] = 0;
+            eventMessage[NETWORK_SINK_HEADER_SIZE + 3] = 0;
+
+            send(eventMessage, sizeof(eventMessage));
+        }
+
+        // a sine wave at a different frequency on each channel, plus noise
+        for (int c = 0; c < numChannels; c++)
+        {
+            const double frequency = 5.0 + 3.0 * c;
+
+            for (int i = 0; i < samplesPerMessage; i++)
+            {
+                const double t = (timestamp + i) / sampleRate;
+                const float microvolts = 100.0f * (float) std::sin(2.0 * double_Pi * frequency * t)
+                                         + 10.0f * (random.nextFloat() - 0.5f);
+
+                const int16 value = (int16) roundFloatToInt(microvolts / bitVolts);
+                memcpy(samples + (c * samplesPerMessage + i) * 2, &value, 2);
+            }
+        }
+
+        header.type = NetworkSink::CONTINUOUS_MESSAGE;
+        header.format = 0;
+        header.numChannels = (uint16) numChannels;
+        header.numSamples = (uint32) samplesPerMessage;
+        header.sequenceNumber = sequenceNumber++;
+        header.sampleRate = sampleRate;
+        header.timestamp = timestamp;
+        header.write(buffer);
+
+        send(buffer, NETWORK_SINK_HEADER_SIZE + 2 * numChannels + 2 * numChannels * samplesPerMessage);
+
+        timestamp += samplesPerMessage;
+    }
+
+    closeSocket();
+}
@@ -0,0 +1,258 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __NETWORKSTREAMTHREAD_H_8E2D4A16__
+#define __NETWORKSTREAMTHREAD_H_8E2D4A16__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DataThread.h"
+#include "../NetworkSink/NetworkSink.h"
+
+#define NETWORK_STREAM_DEFAULT_LATENCY 20     // ms of data held back to absorb network jitter
+#define NETWORK_STREAM_MAX_MESSAGE_SIZE 65536 // bytes; a UDP message has to fit in one datagram
+#define NETWORK_STREAM_NUM_EVENT_CHANNELS 8
+#define NETWORK_STREAM_MAX_PENDING_EVENTS 64
+
+class SourceNode;
+class NetworkStreamSender;
+
+/**
+
+  Receives continuous data published by a NetworkSink on another machine
+  (or by a NetworkStreamSender), over ZeroMQ or UDP.
+
+  Press "Connect" in the editor to listen for the stream; the number of
+  channels and the sample rate are taken from the first continuous message.
+  UDP streams can be unicast or multicast (any address in 224.0.0.0/4 is
+  joined as a multicast group); every message has to fit in one datagram.
+
+  Incoming samples are held back for a few milliseconds (the latency
+  setting) and then released at the stream's sample rate, so that bursty
+  arrival doesn't turn into uneven buffers downstream. If the sender's
+  clock runs fast, the backlog is released early; if data stops arriving,
+  the buffer fills up again before playing out.
+
+  The sender's timestamps are passed through. Gaps in the sequence numbers
+  are counted, and missing samples (detected from the timestamps) are
+  filled with zeros so that later samples keep their timestamps. TTL
+  events are turned into event channel states at the matching sample.
+
+  @see DataThread, NetworkSink, NetworkStreamEditor
+
+*/
+
+class NetworkStreamThread : public DataThread
+{
+
+public:
+
+    NetworkStreamThread(SourceNode* sn);
+    ~NetworkStreamThread();
+
+    bool updateBuffer();
+
+    /** Returns true once a stream has been found by connect(). */
+    bool foundInputSource();
+
+    bool startAcquisition();
+    bool stopAcquisition();
+
+    int getNumHeadstageOutputs();
+    int getNumEventChannels();
+
+    float getSampleRate();
+    float getBitVolts(Channel* chan);
+
+    enum Transport
+    {
+        ZEROMQ_TRANSPORT = 1,
+        UDP_TRANSPORT
+    };
+
+    void setTransport(Transport t);
+    Transport getTransport();
+
+    /** For ZeroMQ, the host to connect to; for UDP, the address to
+        listen on (empty or "*" for any) or a multicast group. */
+    void setHost(const String& host);
+    String getHost();
+
+    void setPort(int port);
+    int getPort();
+
+    void setLatency(int milliseconds);
+    int getLatency();
+
+    /** Microvolts per bit of int16 streams. */
+    void setInt16BitVolts(float bitVolts);
+    float getInt16BitVolts();
+
+    /** Waits up to timeoutMs for the stream and takes its format from the
+        first continuous message. */
+    bool connect(int timeoutMs);
+
+    /** Closes the socket; foundInputSource() returns false afterwards. */
+    void disconnect();
+
+    /** Starts or stops a NetworkStreamSender publishing on the current
+        transport and port, for testing on a single machine. */
+    void setLoopback(bool shouldSend);
+    bool getLoopback();
+
+    int getNumGaps();
+    int getNumMissingMessages();
+    int getNumFilledSamples();
+    int getNumUnderruns();
+
+    String getStatus();
+
+private:
+
+    bool openSocket();
+    void closeSocket();
+
+    /** Waits up to timeoutMs for a message; returns its size, 0 if nothing
+        arrived and -1 on a socket error. */
+    int receive(int timeoutMs);
+
+    void handleMessage(int numBytes);
+    void stageContinuous(const NetworkMessageHeader& header, const uint8* payload, int payloadBytes);
+
+    /** Appends a sample to the jitter buffer and returns where its values go. */
+    float* stageSample(int64 ts);
+
+    void releaseSamples();
+    void resetStream();
+
+    // settings
+    Transport transport;
+    String host;
+    int port;
+    int latencyMs;
+    float int16BitVolts;
+
+    // stream format, from connect()
+    bool sourceFound;
+    int numChannels;
+    float sampleRate;
+
+    void* context;
+    void* subscriber;
+    int udpSocket;
+
+    HeapBlock<uint8> message;
+    int messageSize;
+
+    // jitter buffer: interleaved samples waiting to be released
+    HeapBlock<float> staged;
+    HeapBlock<int64> stagedTimestamps;
+    HeapBlock<uint64> stagedEventCodes;
+    int stagingSize;
+    int stagedRead;
+    int numStaged;
+    int latencySamples;
+
+    bool primed;
+    int64 releaseStartTicks;
+    int64 numReleased;
+
+    // sequence and timestamp tracking
+    bool haveSequence;
+    uint32 expectedSequence;
+    bool gapSinceLastContinuous;
+    bool haveTimestamp;
+    int64 expectedTimestamp;
+    int64 lastTimestamp;
+    int lastNumSamples;
+    int64 timestampStep;
+
+    struct PendingEvent
+    {
+        int64 timestamp;
+        int channel;
+        bool on;
+    };
+
+    PendingEvent pendingEvents[NETWORK_STREAM_MAX_PENDING_EVENTS];
+    int numPendingEvents;
+    uint64 eventState;
+
+    Atomic<int> numGaps;
+    Atomic<int> numMissingMessages;
+    Atomic<int> numFilledSamples;
+    Atomic<int> numUnderruns;
+
+    ScopedPointer<NetworkStreamSender> loopback;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NetworkStreamThread);
+
+};
+
+/**
+
+  Publishes a synthetic stream (sine waves plus noise, and a 1 Hz TTL on
+  event channel 0) in the NetworkSink message format, paced in real time.
+
+  Used as a loopback source for testing NetworkStreamThread without a
+  second machine.
+
+  @see NetworkStreamThread
+
+*/
+
+class NetworkStreamSender : public Thread
+{
+public:
+
+    NetworkStreamSender(NetworkStreamThread::Transport transport, const String& host, int port,
+                        int numChannels = 16, float sampleRate = 30000.0f);
+    ~NetworkStreamSender();
+
+    void run();
+
+private:
+
+    bool openSocket();
+    void closeSocket();
+    void send(const uint8* data, int numBytes);
+
+    NetworkStreamThread::Transport transport;
+    String host;
+    int port;
+    int numChannels;
+    float sampleRate;
+
+    void* context;
+    void* publisher;
+    int udpSocket;
+    uint32 destinationAddress;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NetworkStreamSender);
+
+};
+
+#endif  // __NETWORKSTREAMTHREAD_H_8E2D4A16__
@@ -0,0 +1,259 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "NeuralSimulatorEditor.h"
+#include "NeuralSimulatorThread.h"
+#include "../../UI/EditorViewport.h"
+
+NeuralSimulatorEditor::NeuralSimulatorEditor(GenericProcessor* parentNode,
+                                             NeuralSimulatorThread* thread_,
+                                             bool useDefaultParameterEditors)
+    : GenericEditor(parentNode, useDefaultParameterEditors), thread(thread_), statusTimer(this)
+{
+    desiredWidth = 220;
+
+    channelSelector = new ComboBox("Channels");
+    channelSelector->setBounds(10,30,95,20);
+
+    const int channelCounts[] = {16, 32, 64, 128, 256, 384, 512, 1024};
+
+    for (int i = 0; i < 8; i++)
+        channelSelector->addItem(String(channelCounts[i]) + " ch", channelCounts[i]); // id = number of channels
+
+    channelSelector->setSelectedId(thread->getNumChannels(), dontSendNotification);
+    channelSelector->addListener(this);
+    addAndMakeVisible(channelSelector);
+
+    rateSelector = new ComboBox("Sample rate");
+    rateSelector->setBounds(115,30,95,20);
+    rateSelector->addItem("20 kHz", 20000); // id = sample rate
+    rateSelector->addItem("25 kHz", 25000);
+    rateSelector->addItem("30 kHz", 30000);
+    rateSelector->setSelectedId(roundToInt(thread->getSampleRate()), dontSendNotification);
+    rateSelector->addListener(this);
+    addAndMakeVisible(rateSelector);
+
+    unitsValue = addValue("Units:", String(thread->getNumUnits()), 5, 55,
+                          "Number of simulated units");
+    seedValue = addValue("Seed:", String(thread->getSeed()), 110, 55,
+                         "The same seed always produces the same data");
+    noiseValue = addValue("Noise:", String(thread->getNoiseLevel()), 5, 78,
+                          "RMS of the background noise (uV)");
+    lfpValue = addValue("LFP:", String(thread->getLfpAmplitude()), 110, 78,
+                        "Amplitude of the LFP oscillations (uV)");
+
+    groundTruthButton = new UtilityButton("Ground truth", Font("Small Text", 13, Font::plain));
+    groundTruthButton->setRadius(3.0f);
+    groundTruthButton->setBounds(10,101,95,18);
+    groundTruthButton->addListener(this);
+    groundTruthButton->setClickingTogglesState(true);
+    groundTruthButton->setTooltip("Write every simulated spike and event to a file");
+    addAndMakeVisible(groundTruthButton);
+
+    statusLabel = new Label("Status", thread->getStatus());
+    statusLabel->setFont(Font("Small Text", 11, Font::plain));
+    statusLabel->setBounds(5,120,210,18);
+    statusLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(statusLabel);
+
+}
+
+NeuralSimulatorEditor::~NeuralSimulatorEditor()
+{
+
+}
+
+Label* NeuralSimulatorEditor::addValue(const String& name, const String& value, int x, int y, const String& tooltip)
+{
+    Label* caption = new Label(name, name);
+    caption->setFont(Font("Small Text", 11, Font::plain));
+    caption->setBounds(x,y,45,18);
+    caption->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(caption);
+    captions.add(caption);
+
+    Label* label = new Label(name + " value", value);
+    label->setFont(Font("Default", 13, Font::plain));
+    label->setBounds(x+45,y,55,18);
+    label->setColour(Label::textColourId, Colours::white);
+    label->setColour(Label::backgroundColourId, Colours::grey);
+    label->setEditable(true);
+    label->addListener(this);
+    label->setTooltip(tooltip);
+    addAndMakeVisible(label);
+
+    return label;
+}
+
+void NeuralSimulatorEditor::updateSignalChain()
+{
+    updateStatus();
+
+    getEditorViewport()->makeEditorVisible(this, false, true);
+}
+
+void NeuralSimulatorEditor::buttonEvent(Button* button)
+{
+    if (button == groundTruthButton)
+    {
+        if (groundTruthButton->getToggleState())
+        {
+            FileChooser fc("Write the ground truth to...",
+                           File::getCurrentWorkingDirectory().getChildFile("ground_truth.csv"),
+                           "*.csv",
+                           true);
+
+            if (fc.browseForFileToSave(false))
+                thread->setGroundTruthFile(fc.getResult());
+            else
+                groundTruthButton->setToggleState(false, dontSendNotification);
+        }
+        else
+        {
+            thread->setGroundTruthFile(File::nonexistent);
+        }
+
+        groundTruthButton->setTooltip(thread->getGroundTruthFile().getFullPathName());
+    }
+}
+
+void NeuralSimulatorEditor::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox == channelSelector)
+    {
+        thread->setNumChannels(channelSelector->getSelectedId());
+        updateSignalChain();
+    }
+    else if (comboBox == rateSelector)
+    {
+        thread->setSampleRate((float) rateSelector->getSelectedId());
+        updateSignalChain();
+    }
+}
+
+void NeuralSimulatorEditor::labelTextChanged(Label* label)
+{
+    if (label == unitsValue)
+    {
+        const int units = label->getText().getIntValue();
+
+        if (units >= 0)
+            thread->setNumUnits(units);
+
+        label->setText(String(thread->getNumUnits()), dontSendNotification);
+    }
+    else if (label == seedValue)
+    {
+        thread->setSeed(label->getText().getIntValue());
+        label->setText(String(thread->getSeed()), dontSendNotification);
+    }
+    else if (label == noiseValue)
+    {
+        thread->setNoiseLevel(label->getText().getFloatValue());
+        label->setText(String(thread->getNoiseLevel()), dontSendNotification);
+    }
+    else if (label == lfpValue)
+    {
+        thread->setLfpAmplitude(label->getText().getFloatValue());
+        label->setText(String(thread->getLfpAmplitude()), dontSendNotification);
+    }
+
+    updateStatus();
+}
+
+void NeuralSimulatorEditor::startAcquisition()
+{
+    GenericEditor::startAcquisition();
+
+    channelSelector->setEnabled(false);
+    rateSelector->setEnabled(false);
+    unitsValue->setEditable(false);
+    seedValue->setEditable(false);
+    noiseValue->setEditable(false);
+    lfpValue->setEditable(false);
+    groundTruthButton->setEnabled(false);
+
+    statusTimer.startTimer(500);
+}
+
+void NeuralSimulatorEditor::stopAcquisition()
+{
+    GenericEditor::stopAcquisition();
+
+    statusTimer.stopTimer();
+    updateStatus();
+
+    channelSelector->setEnabled(true);
+    rateSelector->setEnabled(true);
+    unitsValue->setEditable(true);
+    seedValue->setEditable(true);
+    noiseValue->setEditable(true);
+    lfpValue->setEditable(true);
+    groundTruthButton->setEnabled(true);
+}
+
+void NeuralSimulatorEditor::updateStatus()
+{
+    String status = thread->getStatus();
+
+    statusLabel->setText(status, dontSendNotification);
+    statusLabel->setTooltip(status);
+}
+
+void NeuralSimulatorEditor::saveCustomParameters(XmlElement* xml)
+{
+    xml->setAttribute("NumChannels", thread->getNumChannels());
+    xml->setAttribute("SampleRate", thread->getSampleRate());
+    xml->setAttribute("NumUnits", thread->getNumUnits());
+    xml->setAttribute("Seed", thread->getSeed());
+    xml->setAttribute("NoiseLevel", thread->getNoiseLevel());
+    xml->setAttribute("LfpAmplitude", thread->getLfpAmplitude());
+    xml->setAttribute("GroundTruth", thread->getGroundTruthFile().getFullPathName());
+}
+
+void NeuralSimulatorEditor::loadCustomParameters(XmlElement* xml)
+{
+    thread->setNumChannels(xml->getIntAttribute("NumChannels", thread->getNumChannels()));
+    thread->setSampleRate((float) xml->getDoubleAttribute("SampleRate", thread->getSampleRate()));
+    thread->setNumUnits(xml->getIntAttribute("NumUnits", thread->getNumUnits()));
+    thread->setSeed(xml->getIntAttribute("Seed", thread->getSeed()));
+    thread->setNoiseLevel((float) xml->getDoubleAttribute("NoiseLevel", thread->getNoiseLevel()));
+    thread->setLfpAmplitude((float) xml->getDoubleAttribute("LfpAmplitude", thread->getLfpAmplitude()));
+
+    const String groundTruth = xml->getStringAttribute("GroundTruth");
+
+    if (groundTruth.isNotEmpty() && File::isAbsolutePath(groundTruth))
+        thread->setGroundTruthFile(File(groundTruth));
+    else
+        thread->setGroundTruthFile(File::nonexistent);
+
+    channelSelector->setSelectedId(thread->getNumChannels(), dontSendNotification);
+    rateSelector->setSelectedId(roundToInt(thread->getSampleRate()), dontSendNotification);
+    unitsValue->setText(String(thread->getNumUnits()), dontSendNotification);
+    seedValue->setText(String(thread->getSeed()), dontSendNotification);
+    noiseValue->setText(String(thread->getNoiseLevel()), dontSendNotification);
+    lfpValue->setText(String(thread->getLfpAmplitude()), dontSendNotification);
+    groundTruthButton->setToggleState(thread->getGroundTruthFile() != File::nonexistent, dontSendNotification);
+
+    updateSignalChain();
+}
@@ -0,0 +1,98 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __NEURALSIMULATOREDITOR_H_94A0D6F3__
+#define __NEURALSIMULATOREDITOR_H_94A0D6F3__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../Editors/GenericEditor.h"
+
+class NeuralSimulatorThread;
+
+/**
+
+  User interface for the "Neural Simulator" source node.
+
+  @see SourceNode, NeuralSimulatorThread
+
+*/
+
+class NeuralSimulatorEditor : public GenericEditor,
+    public ComboBox::Listener,
+    public Label::Listener
+{
+public:
+    NeuralSimulatorEditor(GenericProcessor* parentNode, NeuralSimulatorThread* thread, bool useDefaultParameterEditors);
+    virtual ~NeuralSimulatorEditor();
+
+    void buttonEvent(Button* button);
+    void comboBoxChanged(ComboBox* comboBox);
+    void labelTextChanged(Label* label);
+
+    void startAcquisition();
+    void stopAcquisition();
+
+    void saveCustomParameters(XmlElement* xml);
+    void loadCustomParameters(XmlElement* xml);
+
+private:
+
+    /** Adds a caption and an editable value at the given position. */
+    Label* addValue(const String& name, const String& value, int x, int y, const String& tooltip);
+
+    /** Propagates a new channel count or sample rate down the signal chain. */
+    void updateSignalChain();
+
+    void updateStatus();
+
+    /** Refreshes the status line during acquisition (GenericEditor's own timer is used for fading). */
+    class StatusTimer : public Timer
+    {
+    public:
+        StatusTimer(NeuralSimulatorEditor* e) : editor(e) {}
+        void timerCallback()
+        {
+            editor->updateStatus();
+        }
+    private:
+        NeuralSimulatorEditor* editor;
+    };
+
+    NeuralSimulatorThread* thread;
+    StatusTimer statusTimer;
+
+    ScopedPointer<ComboBox> channelSelector;
+    ScopedPointer<ComboBox> rateSelector;
+    OwnedArray<Label> captions;
+    ScopedPointer<Label> unitsValue;
+    ScopedPointer<Label> seedValue;
+    ScopedPointer<Label> noiseValue;
+    ScopedPointer<Label> lfpValue;
+    ScopedPointer<UtilityButton> groundTruthButton;
+    ScopedPointer<Label> statusLabel;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NeuralSimulatorEditor);
+
+};
+
+#endif  // __NEURALSIMULATOREDITOR_H_94A0D6F3__
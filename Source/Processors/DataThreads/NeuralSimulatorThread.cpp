@@ -0,0 +1,653 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cmath>
+#include <stdarg.h>
+
+#include "NeuralSimulatorThread.h"
+#include "../SourceNode/SourceNode.h"
+
+NeuralSimulatorThread::NeuralSimulatorThread(SourceNode* sn) : DataThread(sn),
+    numChannels(64), sampleRate(30000.0f), numUnits(32), seed(1),
+    noiseLevel(10.0f), lfpAmplitude(150.0f),
+    trialInterval(30000), trialDuration(15000), realTime(true),
+    templateLength(48), refractoryPeriod(60),
+    noiseWhite(0), noiseColored(0), noiseCoefficient(0),
+    block(64, NEURAL_SIMULATOR_BLOCK_SIZE),
+    numGenerated(0), startTicks(0), generationTicks(0), lastEventCode(0),
+    load(0)
+{
+
+    dataBuffer = new DataBuffer(numChannels, 10000);
+
+}
+
+NeuralSimulatorThread::~NeuralSimulatorThread()
+{
+    stopAcquisition();
+}
+
+bool NeuralSimulatorThread::foundInputSource()
+{
+    return true;
+}
+
+int NeuralSimulatorThread::getNumHeadstageOutputs()
+{
+    return numChannels;
+}
+
+int NeuralSimulatorThread::getNumEventChannels()
+{
+    return NEURAL_SIMULATOR_NUM_EVENT_CHANNELS;
+}
+
+float NeuralSimulatorThread::getSampleRate()
+{
+    return sampleRate;
+}
+
+float NeuralSimulatorThread::getBitVolts(Channel* chan)
+{
+    return 0.195f; // same as the RHD2000 headstages
+}
+
+void NeuralSimulatorThread::setNumChannels(int numChannels_)
+{
+    if (isThreadRunning())
+        return;
+
+    numChannels = jlimit(1, NEURAL_SIMULATOR_MAX_CHANNELS, numChannels_);
+
+    dataBuffer->resize(numChannels, 10000);
+    block.setSize(numChannels, NEURAL_SIMULATOR_BLOCK_SIZE);
+}
+
+int NeuralSimulatorThread::getNumChannels()
+{
+    return numChannels;
+}
+
+void NeuralSimulatorThread::setSampleRate(float sampleRate_)
+{
+    if (isThreadRunning() || sampleRate_ <= 0)
+        return;
+
+    sampleRate = sampleRate_;
+
+    // one trial per second, lasting half a second
+    trialInterval = roundToInt(sampleRate);
+    trialDuration = trialInterval / 2;
+}
+
+void NeuralSimulatorThread::setNumUnits(int numUnits_)
+{
+    numUnits = jmax(0, numUnits_);
+}
+
+int NeuralSimulatorThread::getNumUnits()
+{
+    return numUnits;
+}
+
+void NeuralSimulatorThread::setSeed(int seed_)
+{
+    seed = seed_;
+}
+
+int NeuralSimulatorThread::getSeed()
+{
+    return seed;
+}
+
+void NeuralSimulatorThread::setNoiseLevel(float microvolts)
+{
+    noiseLevel = jmax(0.0f, microvolts);
+}
+
+float NeuralSimulatorThread::getNoiseLevel()
+{
+    return noiseLevel;
+}
+
+void NeuralSimulatorThread::setLfpAmplitude(float microvolts)
+{
+    lfpAmplitude = jmax(0.0f, microvolts);
+}
+
+float NeuralSimulatorThread::getLfpAmplitude()
+{
+    return lfpAmplitude;
+}
+
+void NeuralSimulatorThread::setGroundTruthFile(const File& file)
+{
+    groundTruthFile = file;
+}
+
+File NeuralSimulatorThread::getGroundTruthFile()
+{
+    return groundTruthFile;
+}
+
+void NeuralSimulatorThread::setRealTime(bool shouldRunInRealTime)
+{
+    if (isThreadRunning())
+        return;
+
+    realTime = shouldRunInRealTime;
+}
+
+float NeuralSimulatorThread::getLoad()
+{
+    return load;
+}
+
+String NeuralSimulatorThread::getStatus()
+{
+    String status = String(numChannels) + " ch, " + String(numUnits) + " units";
+
+    if (isThreadRunning())
+    {
+        status += ", load " + String(roundToInt(load * 100.0f)) + "%";
+
+        if (numOverflows.get() > 0)
+            status += ", " + String(numOverflows.get()) + " stalls";
+    }
+
+    if (groundTruthWritten != File::nonexistent)
+        status += ", " + String(numSpikes.get()) + " spikes in " + groundTruthWritten.getFileName();
+
+    return status;
+}
+
+//---------------------------------------------------------------------
+// random numbers
+
+uint64 NeuralSimulatorThread::splitMix(uint64& state)
+{
+    // used to derive independent seeds from one seed
+    uint64 z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64 NeuralSimulatorThread::nextRandom(uint64& state)
+{
+    // xorshift64*
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+float NeuralSimulatorThread::uniform(uint64& state)
+{
+    // in (0, 1]
+    return float((nextRandom(state) >> 40) + 1) / float(1 << 24);
+}
+
+//---------------------------------------------------------------------
+
+void NeuralSimulatorThread::initialise()
+{
+    uint64 state = (uint64) seed;
+
+    templateLength = jlimit(8, NEURAL_SIMULATOR_MAX_TEMPLATE_LENGTH, roundToInt(0.0016 * sampleRate));
+    refractoryPeriod = jmax((int64) templateLength, (int64) (0.002 * sampleRate));
+
+    // 1. gaussian noise table (Box-Muller)
+    noiseTable.malloc(NEURAL_SIMULATOR_NOISE_TABLE_SIZE);
+
+    for (int i = 0; i < NEURAL_SIMULATOR_NOISE_TABLE_SIZE; i += 2)
+    {
+        uint64 r = splitMix(state);
+        const double u1 = uniform(r);
+        const double u2 = uniform(r);
+        const double radius = std::sqrt(-2.0 * std::log(u1));
+
+        noiseTable[i] = float(radius * std::cos(2.0 * double_Pi * u2));
+        noiseTable[i+1] = float(radius * std::sin(2.0 * double_Pi * u2));
+    }
+
+    channelRandom.malloc(numChannels);
+    channelFilterState.calloc(numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+        channelRandom[c] = splitMix(state) | 1; // xorshift state must not be zero
+
+    // white noise plus a copy low-passed at 300 Hz, scaled to the requested RMS
+    noiseCoefficient = float(std::exp(-2.0 * double_Pi * 300.0 / sampleRate));
+
+    const double white = 0.6;
+    const double colored = 0.8;
+    const double innovation = std::sqrt(1.0 - noiseCoefficient * noiseCoefficient);
+    const double norm = 1.0 / std::sqrt(white * white + colored * colored + 2.0 * white * colored * innovation);
+
+    noiseWhite = float(noiseLevel * white * norm);
+    noiseColored = float(noiseLevel * colored * norm);
+
+    // 2. LFP: delta everywhere, theta reversing polarity along the probe,
+    //    gamma in the middle of the probe
+    oscillatorFrequency[0] = 2.0f;
+    oscillatorFrequency[1] = 8.0f;
+    oscillatorFrequency[2] = 40.0f;
+
+    oscillatorAmplitude[0] = 0.5f * lfpAmplitude;
+    oscillatorAmplitude[1] = lfpAmplitude;
+    oscillatorAmplitude[2] = 0.25f * lfpAmplitude;
+
+    oscillatorWeights.malloc(NEURAL_SIMULATOR_NUM_OSCILLATORS * numChannels);
+    oscillators.malloc(NEURAL_SIMULATOR_NUM_OSCILLATORS * NEURAL_SIMULATOR_BLOCK_SIZE);
+
+    for (int c = 0; c < numChannels; c++)
+    {
+        const float depth = (numChannels > 1) ? float(c) / float(numChannels - 1) : 0.0f;
+
+        oscillatorWeights[c] = 1.0f;
+        oscillatorWeights[numChannels + c] = std::cos(float(double_Pi) * 1.5f * depth);
+        oscillatorWeights[2 * numChannels + c] = std::exp(-(depth - 0.5f) * (depth - 0.5f) / 0.05f);
+    }
+
+    // 3. units
+    units.clear();
+    templates.malloc(jmax(1, numUnits) * templateLength);
+
+    for (int u = 0; u < numUnits; u++)
+    {
+        uint64 r = splitMix(state) | 1;
+
+        Unit* unit = new Unit();
+
+        unit->peakChannel = int(nextRandom(r) % (uint64) numChannels);
+        unit->amplitude = 60.0f + 190.0f * uniform(r);
+        unit->baseRate = 1.0f + 9.0f * uniform(r);
+        unit->trialRate = unit->baseRate * (1.5f + 3.0f * uniform(r));
+        unit->preferredCondition = int(nextRandom(r) & 1);
+
+        const float spread = 1.0f + 1.5f * uniform(r); // in channels
+
+        unit->firstChannel = jmax(0, unit->peakChannel - NEURAL_SIMULATOR_FOOTPRINT);
+        unit->numChannels = jmin(numChannels - 1, unit->peakChannel + NEURAL_SIMULATOR_FOOTPRINT)
+                            - unit->firstChannel + 1;
+
+        for (int k = 0; k < unit->numChannels; k++)
+        {
+            const float distance = float(unit->firstChannel + k - unit->peakChannel);
+            unit->weights[k] = unit->amplitude * std::exp(-distance * distance / (2.0f * spread * spread));
+        }
+
+        // biphasic waveform: a sharp trough followed by a broader, smaller peak
+        float* waveform = templates + u * templateLength;
+
+        const float L = float(templateLength);
+        const float t0 = 0.3f * L;
+        const float s0 = L * (0.04f + 0.03f * uniform(r));
+        const float t1 = t0 + L * (0.2f + 0.15f * uniform(r));
+        const float s1 = L * (0.12f + 0.08f * uniform(r));
+        const float ratio = 0.2f + 0.3f * uniform(r);
+
+        float minimum = 0;
+
+        for (int i = 0; i < templateLength; i++)
+        {
+            const float t = float(i);
+            float v = -std::exp(-(t - t0) * (t - t0) / (2.0f * s0 * s0))
+                      + ratio * std::exp(-(t - t1) * (t - t1) / (2.0f * s1 * s1));
+
+            // taper the last 30% so that the waveform ends at zero
+            if (t > 0.7f * L)
+            {
+                const float taper = std::cos(0.5f * float(double_Pi) * (t - 0.7f * L) / (0.3f * L));
+                v *= taper * taper;
+            }
+
+            waveform[i] = v;
+            minimum = jmin(minimum, v);
+        }
+
+        if (minimum < 0)
+            FloatVectorOperations::multiply(waveform, -1.0f / minimum, templateLength);
+
+        unit->random = nextRandom(r) | 1;
+        unit->lastSpike = -1;
+        unit->nextSpike = 0;
+        unit->nextSpike = drawInterval(*unit, 0) - refractoryPeriod;
+
+        units.add(unit);
+    }
+
+    block.setSize(numChannels, NEURAL_SIMULATOR_BLOCK_SIZE);
+
+    numGenerated = 0;
+    generationTicks = 0;
+    lastEventCode = 0;
+    numSpikes.set(0);
+    numOverflows.set(0);
+    load = 0;
+}
+
+bool NeuralSimulatorThread::isInTrial(int64 sampleIndex, int& condition)
+{
+    // the first trial starts half an interval in
+    const int64 offset = sampleIndex - trialInterval / 2;
+
+    if (offset < 0 || (offset % trialInterval) >= trialDuration)
+        return false;
+
+    uint64 state = (uint64) seed * 0x9E3779B97F4A7C15ULL + (uint64) (offset / trialInterval);
+    condition = int(splitMix(state) & 1);
+
+    return true;
+}
+
+int64 NeuralSimulatorThread::drawInterval(Unit& unit, int64 sampleIndex)
+{
+    int condition;
+    const bool preferred = isInTrial(sampleIndex, condition) && condition == unit.preferredCondition;
+    const float rate = preferred ? unit.trialRate : unit.baseRate;
+
+    return refractoryPeriod + (int64) (-std::log(uniform(unit.random)) * sampleRate / rate);
+}
+
+//---------------------------------------------------------------------
+
+bool NeuralSimulatorThread::startAcquisition()
+{
+    initialise();
+    openGroundTruth();
+
+    dataBuffer->clear();
+
+    startTicks = Time::getHighResolutionTicks();
+
+    if (realTime)
+        startThread();
+
+    return true;
+}
+
+bool NeuralSimulatorThread::stopAcquisition()
+{
+    if (isThreadRunning())
+    {
+        signalThreadShouldExit();
+    }
+
+    if (!waitForThreadToExit(500))
+    {
+        std::cout << "Neural simulator thread failed to exit, continuing anyway..." << std::endl;
+    }
+
+    closeGroundTruth();
+
+    dataBuffer->clear();
+
+    return true;
+}
+
+bool NeuralSimulatorThread::updateBuffer()
+{
+    const int64 now = Time::getHighResolutionTicks();
+
+    int64 numDue = (int64) (Time::highResolutionTicksToSeconds(now - startTicks) * sampleRate) - numGenerated;
+
+    if (numDue < NEURAL_SIMULATOR_BLOCK_SIZE)
+    {
+        sleep(1);
+        return true;
+    }
+
+    if (numDue > (int64) sampleRate)
+    {
+        // more than a second behind; skip ahead instead of bursting
+        startTicks += Time::secondsToHighResolutionTicks(double(numDue - NEURAL_SIMULATOR_BLOCK_SIZE) / sampleRate);
+        numDue = NEURAL_SIMULATOR_BLOCK_SIZE;
+        ++numOverflows;
+    }
+
+    for (int n = 0; n < 8 && numDue >= NEURAL_SIMULATOR_BLOCK_SIZE; n++)
+    {
+        generateBlock();
+
+        if (dataBuffer->addBlockToBuffer(block, blockTimestamps, blockEventCodes,
+                                         NEURAL_SIMULATOR_BLOCK_SIZE) < NEURAL_SIMULATOR_BLOCK_SIZE)
+            ++numOverflows;
+
+        numDue -= NEURAL_SIMULATOR_BLOCK_SIZE;
+    }
+
+    load = float(double(generationTicks) / double(jmax((int64) 1, now - startTicks)));
+
+    return true;
+}
+
+void NeuralSimulatorThread::fillBuffer(int numSamples)
+{
+    while (dataBuffer->getNumSamples() < numSamples)
+    {
+        generateBlock();
+
+        if (dataBuffer->addBlockToBuffer(block, blockTimestamps, blockEventCodes,
+                                         NEURAL_SIMULATOR_BLOCK_SIZE) < NEURAL_SIMULATOR_BLOCK_SIZE)
+        {
+            ++numOverflows;
+            break;
+        }
+    }
+}
+
+void NeuralSimulatorThread::generateBlock()
+{
+    const int64 start = Time::getHighResolutionTicks();
+    const int64 blockStart = numGenerated;
+    const int numSamples = NEURAL_SIMULATOR_BLOCK_SIZE;
+
+    // 1. trial markers
+    for (int i = 0; i < numSamples; i++)
+    {
+        int condition = 0;
+        const uint64 code = isInTrial(blockStart + i, condition) ? (1 | (condition << 1)) : 0;
+
+        blockTimestamps[i] = blockStart + i;
+        blockEventCodes[i] = code;
+
+        if (code != lastEventCode)
+        {
+            for (int c = 0; c < 2; c++)
+            {
+                if (((code ^ lastEventCode) >> c) & 1)
+                    writeGroundTruthLine("event,%lld,%d,%d\n", (long long) (blockStart + i), c, int((code >> c) & 1));
+            }
+
+            lastEventCode = code;
+        }
+    }
+
+    // 2. one block of each oscillator, computed from the absolute sample index
+    for (int o = 0; o < NEURAL_SIMULATOR_NUM_OSCILLATORS; o++)
+    {
+        float* osc = oscillators + o * numSamples;
+        const double cyclesPerSample = oscillatorFrequency[o] / sampleRate;
+        const double phase = 0.25 * o; // so the peaks don't line up
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            const double cycles = std::fmod(cyclesPerSample * double(blockStart + i) + phase, 1.0);
+            osc[i] = oscillatorAmplitude[o] * float(std::sin(2.0 * double_Pi * cycles));
+        }
+    }
+
+    // 3. noise and LFP, channel by channel
+    for (int c = 0; c < numChannels; c++)
+    {
+        float* dest = block.getWritePointer(c);
+
+        addNoise(c, dest);
+
+        for (int o = 0; o < NEURAL_SIMULATOR_NUM_OSCILLATORS; o++)
+            FloatVectorOperations::addWithMultiply(dest, oscillators + o * numSamples,
+                                                   oscillatorWeights[o * numChannels + c], numSamples);
+    }
+
+    // 4. spikes
+    for (int u = 0; u < units.size(); u++)
+        addSpikes(*units.getUnchecked(u), u);
+
+    numGenerated += numSamples;
+    generationTicks += Time::getHighResolutionTicks() - start;
+}
+
+void NeuralSimulatorThread::addNoise(int chan, float* dest)
+{
+    uint64 random = channelRandom[chan];
+    float filtered = channelFilterState[chan];
+
+    const float a = noiseCoefficient;
+    const float b = std::sqrt(1.0f - a * a);
+
+    for (int i = 0; i < NEURAL_SIMULATOR_BLOCK_SIZE; i++)
+    {
+        const float g = noiseTable[nextRandom(random) >> 48];
+
+        filtered = a * filtered + b * g;
+        dest[i] = noiseWhite * g + noiseColored * filtered;
+    }
+
+    channelRandom[chan] = random;
+    channelFilterState[chan] = filtered;
+}
+
+void NeuralSimulatorThread::addSpikes(Unit& unit, int unitIndex)
+{
+    const int64 blockStart = numGenerated;
+    const int64 blockEnd = blockStart + NEURAL_SIMULATOR_BLOCK_SIZE;
+    const float* waveform = templates + unitIndex * templateLength;
+
+    // the tail of a spike that started in the last block (the refractory
+    // period is at least a template long, so there's only ever one)
+    if (unit.lastSpike >= 0 && unit.lastSpike < blockStart)
+        renderSpike(unit, waveform, unit.lastSpike, blockStart);
+
+    while (unit.nextSpike < blockEnd)
+    {
+        const int64 spikeStart = unit.nextSpike;
+
+        renderSpike(unit, waveform, spikeStart, blockStart);
+
+        writeGroundTruthLine("spike,%lld,%d,%d\n", (long long) spikeStart, unitIndex, unit.peakChannel);
+        ++numSpikes;
+
+        unit.lastSpike = spikeStart;
+        unit.nextSpike = spikeStart + drawInterval(unit, spikeStart);
+    }
+}
+
+void NeuralSimulatorThread::renderSpike(const Unit& unit, const float* waveform, int64 spikeStart, int64 blockStart)
+{
+    const int64 first = jmax(spikeStart, blockStart);
+    const int64 last = jmin(spikeStart + templateLength, blockStart + NEURAL_SIMULATOR_BLOCK_SIZE);
+    const int numSamples = int(last - first);
+
+    if (numSamples <= 0)
+        return;
+
+    const int destOffset = int(first - blockStart);
+    const int sourceOffset = int(first - spikeStart);
+
+    for (int k = 0; k < unit.numChannels; k++)
+        FloatVectorOperations::addWithMultiply(block.getWritePointer(unit.firstChannel + k) + destOffset,
+                                               waveform + sourceOffset, unit.weights[k], numSamples);
+}
+
+//---------------------------------------------------------------------
+// ground truth
+
+void NeuralSimulatorThread::openGroundTruth()
+{
+    groundTruth = nullptr;
+    groundTruthWritten = File::nonexistent;
+
+    if (groundTruthFile == File::nonexistent)
+        return;
+
+    File file = groundTruthFile.exists() ? groundTruthFile.getNonexistentSibling() : groundTruthFile;
+
+    groundTruth = new FileOutputStream(file, 65536);
+
+    if (groundTruth->failedToOpen())
+    {
+        std::cout << "Could not open " << file.getFullPathName() << " for the ground truth." << std::endl;
+        groundTruth = nullptr;
+        return;
+    }
+
+    groundTruthWritten = file;
+
+    std::cout << "Writing ground truth to " << file.getFullPathName() << std::endl;
+
+    writeGroundTruthLine("# Neural Simulator ground truth\n");
+    writeGroundTruthLine("# seed %d, %d channels, %g Hz, %g uV per bit, %d-sample templates\n",
+                         seed, numChannels, double(sampleRate), double(getBitVolts(nullptr)), templateLength);
+    writeGroundTruthLine("# timestamps are samples since the start of acquisition; channels count from 0\n");
+    writeGroundTruthLine("# unit,<unit>,<peak channel>,<amplitude uV>,<base rate Hz>,<trial rate Hz>,<preferred condition>\n");
+
+    for (int u = 0; u < units.size(); u++)
+    {
+        const Unit* unit = units[u];
+
+        writeGroundTruthLine("unit,%d,%d,%.2f,%.3f,%.3f,%d\n", u, unit->peakChannel, double(unit->amplitude),
+                             double(unit->baseRate), double(unit->trialRate), unit->preferredCondition);
+    }
+
+    writeGroundTruthLine("# spike,<timestamp>,<unit>,<peak channel>\n");
+    writeGroundTruthLine("# event,<timestamp>,<event channel>,<state> (channel 0: trial, channel 1: condition 1)\n");
+    writeGroundTruthLine("# lines are in timestamp order between blocks of %d samples, not within them\n",
+                         NEURAL_SIMULATOR_BLOCK_SIZE);
+}
+
+void NeuralSimulatorThread::closeGroundTruth()
+{
+    if (groundTruth != nullptr)
+    {
+        groundTruth->flush();
+        groundTruth = nullptr;
+    }
+}
+
+void NeuralSimulatorThread::writeGroundTruthLine(const char* format, ...)
+{
+    if (groundTruth == nullptr)
+        return;
+
+    char line[256];
+
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (length > 0)
+        groundTruth->write(line, jmin(length, (int) sizeof(line) - 1));
+}
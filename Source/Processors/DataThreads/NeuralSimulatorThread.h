@@ -0,0 +1,225 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __NEURALSIMULATORTHREAD_H_C71B5E02__
+#define __NEURALSIMULATORTHREAD_H_C71B5E02__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+#include <stdio.h>
+
+#include "DataThread.h"
+
+#define NEURAL_SIMULATOR_BLOCK_SIZE 256         // samples generated at a time
+#define NEURAL_SIMULATOR_MAX_CHANNELS 1024
+#define NEURAL_SIMULATOR_NUM_EVENT_CHANNELS 8
+#define NEURAL_SIMULATOR_MAX_TEMPLATE_LENGTH 64 // samples
+#define NEURAL_SIMULATOR_FOOTPRINT 4            // channels on either side of a unit's peak channel
+#define NEURAL_SIMULATOR_NOISE_TABLE_SIZE 65536
+#define NEURAL_SIMULATOR_NUM_OSCILLATORS 3
+
+class SourceNode;
+
+/**
+
+  Generates realistic multichannel data without any hardware, for testing
+  and load-testing the signal chain.
+
+  Every channel gets the sum of:
+
+  - colored background noise (white noise plus a low-passed copy of it).
+  - LFP oscillations (delta, theta and gamma) whose amplitude and polarity
+    change smoothly along the probe.
+  - spikes from a set of simulated units. Each unit has its own biphasic
+    template, peak channel and spatial footprint over the neighbouring
+    channels.
+
+  TTL event channel 0 is high during each trial and channel 1 is high
+  during trials of the second condition. Units fire faster during trials
+  of their preferred condition, so the stream can also drive the PSTH.
+
+  All randomness comes from the seed, and data is generated in fixed
+  blocks, so the same settings always produce exactly the same samples,
+  spikes and events. If a ground-truth file is set, every spike (unit and
+  peak channel) and every event is written to it along with the unit
+  parameters. Spike detection and sorting can then be scored against it.
+
+  Samples are released in real time. getLoad() reports the fraction of
+  that time spent generating data. The PipelineBenchmark turns real time
+  off and generates each block on demand instead.
+
+  @see DataThread, NeuralSimulatorEditor, PipelineBenchmark
+
+*/
+
+class NeuralSimulatorThread : public DataThread
+{
+
+public:
+
+    NeuralSimulatorThread(SourceNode* sn);
+    ~NeuralSimulatorThread();
+
+    bool updateBuffer();
+
+    /** Always true; there's nothing to connect to. */
+    bool foundInputSource();
+
+    bool startAcquisition();
+    bool stopAcquisition();
+
+    int getNumHeadstageOutputs();
+    int getNumEventChannels();
+
+    float getSampleRate();
+    float getBitVolts(Channel* chan);
+
+    /** Changes the number of channels; not while acquiring. */
+    void setNumChannels(int numChannels);
+    int getNumChannels();
+
+    void setSampleRate(float sampleRate);
+
+    void setNumUnits(int numUnits);
+    int getNumUnits();
+
+    void setSeed(int seed);
+    int getSeed();
+
+    /** RMS of the background noise, in microvolts. */
+    void setNoiseLevel(float microvolts);
+    float getNoiseLevel();
+
+    /** Peak amplitude of the LFP oscillations, in microvolts. */
+    void setLfpAmplitude(float microvolts);
+    float getLfpAmplitude();
+
+    /** Where to write the ground truth; File::nonexistent turns it off.
+        An existing file is never overwritten; a numbered sibling is used instead. */
+    void setGroundTruthFile(const File& file);
+    File getGroundTruthFile();
+
+    /** When off, startAcquisition() doesn't start the thread and data is
+        only generated by fillBuffer(), as fast as it is asked for. */
+    void setRealTime(bool shouldRunInRealTime);
+
+    /** Generates blocks until at least numSamples samples are waiting in the buffer. */
+    void fillBuffer(int numSamples);
+
+    /** Fraction of real time spent generating data during acquisition. */
+    float getLoad();
+
+    String getStatus();
+
+private:
+
+    struct Unit
+    {
+        int peakChannel;
+        int firstChannel;
+        int numChannels;
+        float weights[2 * NEURAL_SIMULATOR_FOOTPRINT + 1]; // amplitude on each channel of the footprint
+
+        float amplitude;
+        float baseRate;
+        float trialRate;
+        int preferredCondition;
+
+        uint64 random;
+        int64 lastSpike;
+        int64 nextSpike;
+    };
+
+    /** Builds the units, templates and per-channel state from the seed. Not real-time safe. */
+    void initialise();
+
+    void generateBlock();
+    void addNoise(int chan, float* dest);
+    void addSpikes(Unit& unit, int unitIndex);
+    void renderSpike(const Unit& unit, const float* waveform, int64 spikeStart, int64 blockStart);
+
+    /** Samples until the unit's next spike, given the trial state at sampleIndex. */
+    int64 drawInterval(Unit& unit, int64 sampleIndex);
+
+    bool isInTrial(int64 sampleIndex, int& condition);
+
+    void openGroundTruth();
+    void closeGroundTruth();
+    void writeGroundTruthLine(const char* format, ...);
+
+    static uint64 splitMix(uint64& state);
+    static uint64 nextRandom(uint64& state);
+    static float uniform(uint64& state);
+
+    // settings
+    int numChannels;
+    float sampleRate;
+    int numUnits;
+    int seed;
+    float noiseLevel;
+    float lfpAmplitude;
+    int trialInterval; // samples
+    int trialDuration; // samples
+    File groundTruthFile;
+    bool realTime;
+
+    // generated from the seed
+    OwnedArray<Unit> units;
+    HeapBlock<float> templates;
+    int templateLength;
+    int64 refractoryPeriod;
+
+    HeapBlock<float> noiseTable;
+    HeapBlock<uint64> channelRandom;
+    HeapBlock<float> channelFilterState;
+    float noiseWhite;
+    float noiseColored;
+    float noiseCoefficient;
+
+    float oscillatorFrequency[NEURAL_SIMULATOR_NUM_OSCILLATORS];
+    float oscillatorAmplitude[NEURAL_SIMULATOR_NUM_OSCILLATORS];
+    HeapBlock<float> oscillatorWeights; // oscillator-major, one weight per channel
+    HeapBlock<float> oscillators;       // one block of each oscillator
+
+    // output
+    AudioSampleBuffer block;
+    int64 blockTimestamps[NEURAL_SIMULATOR_BLOCK_SIZE];
+    uint64 blockEventCodes[NEURAL_SIMULATOR_BLOCK_SIZE];
+
+    int64 numGenerated;
+    int64 startTicks;
+    int64 generationTicks;
+    uint64 lastEventCode;
+
+    ScopedPointer<FileOutputStream> groundTruth;
+    File groundTruthWritten;
+
+    Atomic<int> numSpikes;
+    Atomic<int> numOverflows;
+    float load;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NeuralSimulatorThread);
+
+};
+
+#endif  // __NEURALSIMULATORTHREAD_H_C71B5E02__
@@ -42,24 +42,6 @@
 #define REGISTER_59_MISO_A  53
 #define REGISTER_59_MISO_B  58
 
-// Allocates memory for a 3-D array of doubles.
-void allocateDoubleArray3D(std::vector<std::vector<std::vector<double> > >& array3D,
-                           int xSize, int ySize, int zSize)
-{
-    int i, j;
-
-    if (xSize == 0) return;
-    array3D.resize(xSize);
-    for (i = 0; i < xSize; ++i)
-    {
-        array3D[i].resize(ySize);
-        for (j = 0; j < ySize; ++j)
-        {
-            array3D[i][j].resize(zSize);
-        }
-    }
-}
-
 RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
     chipRegisters(30000.0f),
     numChannels(0),
@@ -119,11 +101,6 @@ RHD2000Thread::RHD2000Thread(SourceNode* sn) : DataThread(sn),
         // automatically find connected headstages
         scanPorts(); // things would appear to run more smoothly if this were done after the editor has been created
 
-        // to perform electrode impedance measurements at very low frequencies.
-        const int maxNumBlocks = 120;
-        int numStreams = 8;
-        allocateDoubleArray3D(amplifierPreFilter, numStreams, 32, SAMPLES_PER_DATA_BLOCK * maxNumBlocks);
-
         // probably better to do this with a thread, but a timer works for now:
         // startTimer(10); // initialize the board in the background
         dacStream = new int[8];
@@ -1683,116 +1660,43 @@ float RHD2000Thread::updateImpedanceFrequency(float desiredImpedanceFreq, bool&
 }
 
 
-// Reads numBlocks blocks of raw USB data stored in a queue of Rhd2000DataBlock
-// objects, loads this data into this SignalProcessor object, scaling the raw
-// data to generate waveforms with units of volts or microvolts.
-int RHD2000Thread::loadAmplifierData(queue<Rhd2000DataBlock>& dataQueue,
-                                     int numBlocks, int numDataStreams)
-{
-
-    int block, t, channel, stream, i, j;
-    int indexAmp = 0;
-    int indexAux = 0;
-    int indexSupply = 0;
-    int indexAdc = 0;
-    int indexDig = 0;
-    int numWordsWritten = 0;
-
-    int bufferIndex;
-    int16 tempQint16;
-    uint16 tempQuint16;
-    int32 tempQint32;
-
-    bool triggerFound = false;
-    const double AnalogTriggerThreshold = 1.65;
-
-
-    for (block = 0; block < numBlocks; ++block)
-    {
-
-        // Load and scale RHD2000 amplifier waveforms
-        // (sampled at amplifier sampling rate)
-        for (t = 0; t < SAMPLES_PER_DATA_BLOCK; ++t)
-        {
-            for (channel = 0; channel < 32; ++channel)
-            {
-                for (stream = 0; stream < numDataStreams; ++stream)
-                {
-                    // Amplifier waveform units = microvolts
-                    amplifierPreFilter[stream][channel][indexAmp] = 0.195 *
-                                                                    (dataQueue.front().amplifierData[stream][channel][t] - 32768);
-                }
-            }
-            ++indexAmp;
-        }
-        // We are done with this Rhd2000DataBlock object; remove it from dataQueue
-        dataQueue.pop();
-    }
-
-    return 0;
-}
-
 #define PI  3.14159265359
 #define TWO_PI  6.28318530718
 #define DEGREES_TO_RADIANS  0.0174532925199
 #define RADIANS_TO_DEGREES  57.2957795132
 
-// Return the magnitude and phase (in degrees) of a selected frequency component (in Hz)
-// for a selected amplifier channel on the selected USB data stream.
-void RHD2000Thread::measureComplexAmplitude(std::vector<std::vector<std::vector<double>>>& measuredMagnitude,
-                                            std::vector<std::vector<std::vector<double>>>& measuredPhase,
-                                            int capIndex, int stream, int chipChannel, int numBlocks,
-                                            double sampleRate, double frequency, int numPeriods)
+// Copies the test channel of the selected streams out of numBlocks blocks of
+// raw USB data, scaled to microvolts. Only the analyzer's window is copied;
+// the blocks are removed from the queue.
+void RHD2000Thread::loadImpedanceWindows(queue<Rhd2000DataBlock>& dataQueue, int numBlocks,
+                                         int chipChannel, const Array<int>& selectedStreams,
+                                         ImpedanceAnalyzer& analyzer)
 {
-    int period = (sampleRate / frequency);
-    int startIndex = 0;
-    int endIndex = startIndex + numPeriods * period - 1;
+    const int startIndex = analyzer.getStartIndex();
+    const int endIndex = startIndex + analyzer.getLength();
 
-    // Move the measurement window to the end of the waveform to ignore start-up transient.
-    while (endIndex < SAMPLES_PER_DATA_BLOCK * numBlocks - period)
+    for (int block = 0; block < numBlocks && !dataQueue.empty(); ++block)
     {
-        startIndex += period;
-        endIndex += period;
-    }
-
-    double iComponent, qComponent;
+        const int blockStart = block * SAMPLES_PER_DATA_BLOCK;
+        const int first = jmax(startIndex, blockStart);
+        const int last = jmin(endIndex, blockStart + SAMPLES_PER_DATA_BLOCK);
 
-    // Measure real (iComponent) and imaginary (qComponent) amplitude of frequency component.
-    amplitudeOfFreqComponent(iComponent, qComponent, amplifierPreFilter[stream][chipChannel],
-                             startIndex, endIndex, sampleRate, frequency);
-    // Calculate magnitude and phase from real (I) and imaginary (Q) components.
-    measuredMagnitude[stream][chipChannel][capIndex] =
-        sqrt(iComponent * iComponent + qComponent * qComponent);
-    measuredPhase[stream][chipChannel][capIndex] =
-        RADIANS_TO_DEGREES *atan2(qComponent, iComponent);
-}
+        for (int i = 0; i < selectedStreams.size(); ++i)
+        {
+            const int stream = selectedStreams[i];
+            const vector<int>& raw = dataQueue.front().amplifierData[stream][chipChannel];
+            double* window = analyzer.getWindow(stream);
 
-// Returns the real and imaginary amplitudes of a selected frequency component in the vector
-// data, between a start index and end index.
-void RHD2000Thread::amplitudeOfFreqComponent(double& realComponent, double& imagComponent,
-                                             const std::vector<double>& data, int startIndex,
-                                             int endIndex, double sampleRate, double frequency)
-{
-    int length = endIndex - startIndex + 1;
-    const double k = TWO_PI * frequency / sampleRate;  // precalculate for speed
+            // Amplifier waveform units = microvolts
+            for (int t = first; t < last; ++t)
+                window[t - startIndex] = 0.195 * (raw[t - blockStart] - 32768);
+        }
 
-    // Perform correlation with sine and cosine waveforms.
-    double meanI = 0.0;
-    double meanQ = 0.0;
-    for (int t = startIndex; t <= endIndex; ++t)
-    {
-        meanI += data.at(t) * cos(k * t);
-        meanQ += data.at(t) * -1.0 * sin(k * t);
+        // We are done with this Rhd2000DataBlock object; remove it from dataQueue
+        dataQueue.pop();
     }
-    meanI /= (double) length;
-    meanQ /= (double) length;
-
-    realComponent = 2.0 * meanI;
-    imagComponent = 2.0 * meanQ;
 }
 
-
-
 // Given a measured complex impedance that is the result of an electrode impedance in parallel
 // with a parasitic capacitance (i.e., due to the amplifier input capacitance and other
 // capacitances associated with the chip bondpads), this function factors out the effect of the
@@ -1929,7 +1833,29 @@ void RHD2000Thread::runImpedanceTest(Array<int>& streams, Array<int>& channels,
         }
     }
 
+    // The streams measured on the first and on the second read of each channel
+    Array<int> firstReadStreams, secondReadStreams;
+    for (stream = 0; stream < numdataStreams; ++stream)
+    {
+        if (chipId[stream] != CHIP_ID_RHD2164_B)
+            firstReadStreams.add(stream);
+        else
+            secondReadStreams.add(stream);
+    }
+
+    // Move the measurement window to the end of the waveform to ignore start-up transient.
+    int periodSamples = (boardSampleRate / actualImpedanceFreq);
+    int startIndex = 0;
+    int endIndex = startIndex + numPeriods * periodSamples - 1;
+    while (endIndex < SAMPLES_PER_DATA_BLOCK * numBlocks - periodSamples)
+    {
+        startIndex += periodSamples;
+        endIndex += periodSamples;
+    }
 
+    // Each read is analysed in the background while the board runs the next one
+    ImpedanceAnalyzer analyzer(numdataStreams);
+    analyzer.prepare(boardSampleRate, actualImpedanceFreq, startIndex, endIndex - startIndex + 1);
 
     double distance, minDistance, current, Cseries;
     double impedanceMagnitude, impedancePhase;
@@ -1987,15 +1913,14 @@ void RHD2000Thread::runImpedanceTest(Array<int>& streams, Array<int>& channels,
             }
             queue<Rhd2000DataBlock> dataQueue;
             evalBoard->readDataBlocks(numBlocks, dataQueue);
-            loadAmplifierData(dataQueue, numBlocks, numdataStreams);
-            for (stream = 0; stream < numdataStreams; ++stream)
+
+            analyzer.beginRead();
+            loadImpedanceWindows(dataQueue, numBlocks, channel, firstReadStreams, analyzer);
+            for (int i = 0; i < firstReadStreams.size(); ++i)
             {
-                if (chipId[stream] != CHIP_ID_RHD2164_B)
-                {
-                    measureComplexAmplitude(measuredMagnitude, measuredPhase,
-                                            capRange, stream, channel,  numBlocks, boardSampleRate,
-                                            actualImpedanceFreq, numPeriods);
-                }
+                stream = firstReadStreams[i];
+                analyzer.analyse(stream, &measuredMagnitude[stream][channel][capRange],
+                                 &measuredPhase[stream][channel][capRange]);
             }
 
             // If an RHD2164 chip is plugged in, we have to set the Zcheck select register to channels 32-63
@@ -2014,21 +1939,21 @@ void RHD2000Thread::runImpedanceTest(Array<int>& streams, Array<int>& channels,
 
                 }
                 evalBoard->readDataBlocks(numBlocks, dataQueue);
-                loadAmplifierData(dataQueue, numBlocks, numdataStreams);
 
-                for (stream = 0; stream < evalBoard->getNumEnabledDataStreams(); ++stream)
+                analyzer.beginRead();
+                loadImpedanceWindows(dataQueue, numBlocks, channel, secondReadStreams, analyzer);
+                for (int i = 0; i < secondReadStreams.size(); ++i)
                 {
-                    if (chipId[stream] == CHIP_ID_RHD2164_B)
-                    {
-                        measureComplexAmplitude(measuredMagnitude, measuredPhase,
-                                                capRange, stream, channel,  numBlocks, boardSampleRate,
-                                                actualImpedanceFreq, numPeriods);
-                    }
+                    stream = secondReadStreams[i];
+                    analyzer.analyse(stream, &measuredMagnitude[stream][channel][capRange],
+                                     &measuredPhase[stream][channel][capRange]);
                 }
             }
         }
     }
 
+    analyzer.waitForAll();
+
     streams.clear();
     channels.clear();
     magnitudes.clear();
@@ -37,6 +37,7 @@
 #include "rhythm-api/okFrontPanelDLL.h"
 
 #include "DataThread.h"
+#include "ImpedanceAnalyzer.h"
 #include "../GenericProcessor/GenericProcessor.h"
 
 #define MAX_NUM_DATA_STREAMS 8
@@ -93,15 +94,6 @@ public:
 
     void scanPorts();
     float updateImpedanceFrequency(float desiredImpedanceFreq, bool &impedanceFreqValid);
-    int loadAmplifierData(queue<Rhd2000DataBlock> &dataQueue,
-                                       int numBlocks, int numDataStreams);
-    void measureComplexAmplitude(std::vector<std::vector<std::vector<double>>> &measuredMagnitude,
-                                            std::vector<std::vector<std::vector<double>>> &measuredPhase,
-                                              int capIndex, int stream, int chipChannel, int numBlocks,
-                                              double sampleRate, double frequency, int numPeriods);
-    void amplitudeOfFreqComponent(double &realComponent, double &imagComponent,
-                                               const std::vector<double> &data, int startIndex,
-                                               int endIndex, double sampleRate, double frequency);
     int getNumEventChannels();
 
     void assignAudioOut(int dacChannel, int dataChannel);
@@ -129,7 +121,9 @@ private:
     Rhd2000Registers chipRegisters;
     Rhd2000DataBlock* dataBlock;
 
-    std::vector<std::vector<std::vector<double>>> amplifierPreFilter;
+    /** Copies the impedance test channel of the selected streams into the analyzer. */
+    void loadImpedanceWindows(queue<Rhd2000DataBlock>& dataQueue, int numBlocks, int chipChannel,
+                              const Array<int>& selectedStreams, ImpedanceAnalyzer& analyzer);
     Array<int> numChannelsPerDataStream;
     void factorOutParallelCapacitance(double &impedanceMagnitude, double &impedancePhase,
                                               double frequency, double parasiticCapacitance);
@@ -377,6 +377,19 @@ void GenericEditor::paint(Graphics& g)
         // else
         g.drawText(displayName, 6, 5, 500, 15, Justification::left, false);
 
+        // processing time of recent blocks (mean / p99)
+        if (acquisitionIsActive)
+        {
+            String summary = getProcessor()->getProfile().getSummary();
+
+            if (summary.isNotEmpty())
+            {
+                g.setFont(10);
+                g.drawText(summary, 6, 5, getWidth()-14, 15, Justification::right, false);
+                g.setFont(14);
+            }
+        }
+
     }
     else
     {
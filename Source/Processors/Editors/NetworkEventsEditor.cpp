@@ -75,6 +75,16 @@ NetworkEventsEditor::NetworkEventsEditor(GenericProcessor* parentNode, bool useD
     labelPort->addListener(this);
     addAndMakeVisible(labelPort);
 
+	socketSelector = new ComboBox("Socket type");
+	socketSelector->setBounds(20,108,150,18);
+	socketSelector->addItem("REP", NetworkEvents::REP_SOCKET);
+	socketSelector->addItem("ROUTER", NetworkEvents::ROUTER_SOCKET);
+	socketSelector->addItem("PULL", NetworkEvents::PULL_SOCKET);
+	socketSelector->setSelectedId(p->getSocketType(), dontSendNotification);
+	socketSelector->setTooltip("REP answers one request at a time; ROUTER serves many clients; PULL takes messages without replying");
+	socketSelector->addListener(this);
+	addAndMakeVisible(socketSelector);
+
     setEnabledState(false);
 
 }
@@ -116,6 +126,23 @@ void NetworkEventsEditor::setLabelColor(juce::Colour color)
 }
 
 
+void NetworkEventsEditor::comboBoxChanged(ComboBox* comboBox)
+{
+	if (comboBox == socketSelector)
+	{
+		NetworkEvents *p= (NetworkEvents *)getProcessor();
+		p->setSocketType((NetworkEvents::SocketType) socketSelector->getSelectedId());
+	}
+}
+
+void NetworkEventsEditor::updateSettings()
+{
+	NetworkEvents *p= (NetworkEvents *)getProcessor();
+
+	labelPort->setText(String(p->urlport), dontSendNotification);
+	socketSelector->setSelectedId(p->getSocketType(), dontSendNotification);
+}
+
 void NetworkEventsEditor::labelTextChanged(juce::Label *label)
 {
 	if (label == labelPort)
@@ -33,13 +33,13 @@ class NetworkEvents;
 
 /**
 
-  User interface for the "FileReader" source node.
+  User interface for the "Network Events" source node.
 
-  @see SourceNode, FileReaderThread
+  @see NetworkEvents
 
 */
 
-class NetworkEventsEditor : public GenericEditor,public Label::Listener
+class NetworkEventsEditor : public GenericEditor,public Label::Listener, public ComboBox::Listener
 {
 public:
     NetworkEventsEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors);
@@ -47,12 +47,17 @@ public:
 
     void buttonEvent(Button* button);
 	void labelTextChanged(juce::Label *);
+	void comboBoxChanged(ComboBox* comboBox);
 	void setLabelColor(juce::Colour color);
+
+	/** Shows the processor's current port and socket type. */
+	void updateSettings();
 private:
 
 	ScopedPointer<UtilityButton> restartConnection;
     ScopedPointer<Label> urlLabel;
 	ScopedPointer<Label> labelPort;
+	ScopedPointer<ComboBox> socketSelector;
 
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NetworkEventsEditor);
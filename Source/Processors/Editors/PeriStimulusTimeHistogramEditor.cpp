@@ -1131,17 +1131,13 @@ void GenericPlot::paintSpikeRaster(Graphics &g)
 void GenericPlot::paintSpikes(Graphics &g)
 {
 	//tictoc.Tic(15);
-	std::vector<XYline> lines = tcb->getUnitConditionCurves(electrodeID, subID);
+	std::vector<XYline> lines = tcb->getUnitConditionCurves(electrodeID, subID, smoothPlot ? guassianStandardDeviationMS : 0);
 	int numTrials = tcb->getNumTrialsInUnit(electrodeID, subID);
 	mlp->setAuxiliaryString( String(numTrials) + " trials");
 
 	mlp->clearplot();
 	for (int k=0;k<lines.size();k++)
 	{
-		if (smoothPlot)
-		{
-			lines[k].smooth(smoothKernel);
-		}
 		mlp->plotxy(lines[k]);
 	}
 	//tictoc.Toc(15);
@@ -1167,7 +1163,7 @@ void GenericPlot::paintLFPraster(Graphics &g)
 void GenericPlot::paintLFP(Graphics &g)
 {
 	//tictoc.Tic(13);
-	std::vector<XYline> lines = tcb->getElectrodeConditionCurves(electrodeID, subID);
+	std::vector<XYline> lines = tcb->getElectrodeConditionCurves(electrodeID, subID, smoothPlot ? guassianStandardDeviationMS : 0);
 	mlp->clearplot();
 
 	int numTrials = tcb->getNumTrialsInChannel(electrodeID, subID);
@@ -1175,10 +1171,6 @@ void GenericPlot::paintLFP(Graphics &g)
 
 	for (int k=0;k<lines.size();k++)
 	{
-		if (smoothPlot)
-		{
-			lines[k].smooth(smoothKernel);
-		}
 		mlp->plotxy(lines[k]);
 	}
 	//tictoc.Toc(13);
@@ -1286,24 +1278,8 @@ void GenericPlot::resetAxes()
 
 void GenericPlot::buildSmoothKernel(float gaussianStandardDeviationMS_)
 {
+	// the smoothing itself is done (and cached) by the TrialCircularBuffer
 	guassianStandardDeviationMS = gaussianStandardDeviationMS_;
-	// assume each bin correponds to one millisecond.
-	// build the gaussian kernel
-	int numKernelBins = 2*(int)(guassianStandardDeviationMS*3.5)+1; // +- 3.5 standard deviations.
-	int zeroIndex = (numKernelBins-1)/2;
-	smoothKernel.resize(numKernelBins); 
-	float sumZ = 0;
-	for (int k=0;k<numKernelBins;k++) 
-	{
-		float z = float(k-zeroIndex);
-		smoothKernel[k] = exp(- (z*z)/(2*guassianStandardDeviationMS*guassianStandardDeviationMS));
-		sumZ+=smoothKernel[k];
-	}
-	// normalize kernel
-	for (int k=0;k<numKernelBins;k++) 
-	{
-		smoothKernel[k] /= sumZ;
-	}
 }
 
 void GenericPlot::handleEventFromMatlabLikePlot(String event)
@@ -254,7 +254,6 @@ private:
 	bool inPanMode;
 	float guassianStandardDeviationMS;
 	String plotName;
-	std::vector<float> smoothKernel; 
 };
 
 
@@ -28,12 +28,14 @@
 
 
 EventDetector::EventDetector()
-    : GenericProcessor("Event Detector"), threshold(200.0), bufferZone(5.0f), state(false)
+    : GenericProcessor("Event Detector")
 
 {
 
     parameters.add(Parameter("thresh", 0.0, 500.0, 200.0, 0));
 
+    crossings.malloc(CROSSING_CHUNK_SIZE);
+
 }
 
 EventDetector::~EventDetector()
@@ -50,39 +52,77 @@ void EventDetector::setParameter(int parameterIndex, float newValue)
     Parameter& p =  parameters.getReference(parameterIndex);
     p.setValue(newValue, 0);
 
-    threshold = newValue;
+    queueParameterChange(parameterIndex, newValue, currentChannel);
 
     //std::cout << float(p[0]) << std::endl;
 
 }
 
+void EventDetector::applyParameterChange(const ParameterChange& change)
+{
+    const int chan = (change.channel < 0) ? 0 : change.channel;
+
+    if (change.parameterIndex == 0 && chan < thresholds.size())
+    {
+        thresholds.set(chan, change.value);
+        watched.set(chan, true);
+    }
+}
+
+void EventDetector::updateSettings()
+{
+    // thresholds are kept when channels are added or removed
+    while (thresholds.size() < getNumInputs())
+    {
+        thresholds.add(200.0f);
+        watched.add(thresholds.size() == 1);
+    }
+
+    thresholds.removeRange(getNumInputs(), thresholds.size() - getNumInputs());
+    watched.removeRange(getNumInputs(), watched.size() - getNumInputs());
+
+    detector.setNumChannels(getNumInputs());
+}
+
+bool EventDetector::enable()
+{
+    detector.reset();
+
+    return true;
+}
+
 void EventDetector::process(AudioSampleBuffer& buffer,
                             MidiBuffer& events)
 {
 
-    //std::cout << *buffer.getReadPointer(0, 0) << std::endl;
-
+    const int nChannels = jmin(buffer.getNumChannels(), detector.getNumChannels());
 
-    for (int i = 0; i < getNumSamples(channels[0]->sourceNodeId); i++)
+    for (int chan = 0; chan < nChannels; chan++)
     {
+        if (!watched[chan])
+            continue;
 
-        if ((*buffer.getReadPointer(0, i) < -threshold) && !state)
-        {
-
-            // generate midi event
-            //std::cout << "Value = " << *buffer.getSampleData(0, i) << std::endl;
-            addEvent(events, TTL, i);
+        const float* data = buffer.getReadPointer(chan);
+        const int nSamples = jmin(getNumSamples(chan), buffer.getNumSamples());
 
-            state = true;
+        const float level = -thresholds[chan];
 
-        }
-        else if ((*buffer.getReadPointer(0, i) > -threshold + bufferZone)  && state)
+        for (int start = 0; start < nSamples; start += CROSSING_CHUNK_SIZE)
         {
-            state = false;
+            bool triggered = detector.isTriggered(chan);
+
+            const int numCrossings = detector.findLevelCrossings(chan, data + start,
+                                                                 jmin(CROSSING_CHUNK_SIZE, nSamples - start),
+                                                                 level, level + EVENT_DETECTOR_HYSTERESIS,
+                                                                 crossings);
+
+            // the state toggles at every crossing
+            for (int i = 0; i < numCrossings; i++)
+            {
+                triggered = !triggered;
+                addEvent(events, TTL, start + crossings[i], triggered ? 1 : 0, (uint8) jmin(chan, 255));
+            }
         }
-
-
     }
 
-
 }
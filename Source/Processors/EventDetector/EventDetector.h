@@ -26,12 +26,21 @@
 
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "../GenericProcessor/GenericProcessor.h"
+#include "../PhaseDetector/CrossingDetector.h"
+
+#define EVENT_DETECTOR_HYSTERESIS 5.0f // the signal must come back this far before the next event
 
 /**
 
   Searches for threshold crossings and sends out TTL events.
 
-  @see GenericProcessor
+  A channel triggers when it goes below -threshold, sending an "on" event
+  with the channel's number, and re-arms (sending "off") once it comes
+  back above -threshold + EVENT_DETECTOR_HYSTERESIS. Channel 0 is watched
+  by default; setting the threshold on other channels adds them. Crossings
+  are found by a CrossingDetector, at their exact sample in the block.
+
+  @see GenericProcessor, CrossingDetector
 
 */
 
@@ -46,11 +55,19 @@ public:
     void process(AudioSampleBuffer& buffer, MidiBuffer& midiMessages);
     void setParameter(int parameterIndex, float newValue);
 
+    void applyParameterChange(const ParameterChange& change);
+
+    void updateSettings();
+
+    bool enable();
+
 private:
 
-    float threshold;
-    float bufferZone;
-    bool state;
+    Array<float> thresholds; // by channel
+    Array<bool> watched;     // by channel
+
+    CrossingDetector detector;
+    HeapBlock<int> crossings;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EventDetector);
 
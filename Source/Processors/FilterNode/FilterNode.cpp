@@ -47,6 +47,7 @@ FilterNode::FilterNode()
 
     // parameters.add(Parameter("high cut",highCutValues, 2, 1));
     applyOnADC = false;
+    numProcessChannels = 0;
 }
 
 FilterNode::~FilterNode()
@@ -182,6 +183,18 @@ void FilterNode::updateSettings()
             setFilterParameters(lc, hc, n);
         }
 
+        numProcessChannels = lowCuts.size();
+        processLowCuts.malloc(numProcessChannels);
+        processHighCuts.malloc(numProcessChannels);
+        processFilterChannel.malloc(numProcessChannels);
+
+        for (int n = 0; n < numProcessChannels; n++)
+        {
+            processLowCuts[n] = lowCuts[n];
+            processHighCuts[n] = highCuts[n];
+            processFilterChannel[n] = shouldFilterChannel[n];
+        }
+
     }
 
     setApplyOnADC(applyOnADC);
@@ -239,10 +252,6 @@ void FilterNode::setParameter(int parameterIndex, float newValue)
             highCuts.set(currentChannel,newValue);
         }
 
-        setFilterParameters(lowCuts[currentChannel],
-                            highCuts[currentChannel],
-                            currentChannel);
-
         editor->updateParameterButtons(parameterIndex);
 
     }
@@ -258,6 +267,34 @@ void FilterNode::setParameter(int parameterIndex, float newValue)
         }
 
     }
+
+    // the filters themselves are only touched between blocks
+    queueParameterChange(parameterIndex, newValue, currentChannel);
+}
+
+void FilterNode::applyParameterChange(const ParameterChange& change)
+{
+    const int chan = change.channel;
+
+    if (chan < 0 || chan >= numProcessChannels)
+        return;
+
+    if (change.parameterIndex < 2)
+    {
+        if (change.parameterIndex == 0)
+            processLowCuts[chan] = change.value;
+        else
+            processHighCuts[chan] = change.value;
+
+        // SmoothedFilterDesign interpolates to the new coefficients
+        setFilterParameters(processLowCuts[chan],
+                            processHighCuts[chan],
+                            chan);
+    }
+    else
+    {
+        processFilterChannel[chan] = (change.value != 0);
+    }
 }
 
 void FilterNode::process(AudioSampleBuffer& buffer,
@@ -266,7 +303,7 @@ void FilterNode::process(AudioSampleBuffer& buffer,
 
     for (int n = 0; n < getNumOutputs(); n++)
     {
-        if (shouldFilterChannel[n])
+        if (n < numProcessChannels && processFilterChannel[n])
         {
             float* ptr = buffer.getWritePointer(n);
             filters[n]->process(getNumSamples(n), &ptr);
@@ -324,9 +361,9 @@ void FilterNode::loadCustomChannelParametersFromXml(XmlElement* channelInfo, boo
                 lowCuts.set(channelNum, subNode->getDoubleAttribute("lowcut",defaultLowCut));
                 shouldFilterChannel.set(channelNum, subNode->getBoolAttribute("shouldFilter",true));
 
-                setFilterParameters(lowCuts[channelNum],
-                                    highCuts[channelNum],
-                                    channelNum);
+                queueParameterChange(0, lowCuts[channelNum], channelNum);
+                queueParameterChange(1, highCuts[channelNum], channelNum);
+                queueParameterChange(2, shouldFilterChannel[channelNum] ? 1.0f : 0.0f, channelNum);
 
             }
         }
@@ -334,3 +371,38 @@ void FilterNode::loadCustomChannelParametersFromXml(XmlElement* channelInfo, boo
 
 
 }
+
+bool FilterNode::saveCustomChannelParametersToSnapshot(OutputStream& stream)
+{
+    stream.writeInt(highCuts.size());
+
+    for (int i = 0; i < highCuts.size(); i++)
+    {
+        stream.writeDouble(highCuts[i]);
+        stream.writeDouble(lowCuts[i]);
+        stream.writeBool(shouldFilterChannel[i]);
+    }
+
+    return true;
+}
+
+bool FilterNode::loadCustomChannelParametersFromSnapshot(InputStream& stream)
+{
+    const int numChannels = stream.readInt();
+
+    if (numChannels != highCuts.size())
+        return false;
+
+    for (int i = 0; i < numChannels; i++)
+    {
+        highCuts.set(i, stream.readDouble());
+        lowCuts.set(i, stream.readDouble());
+        shouldFilterChannel.set(i, stream.readBool());
+
+        queueParameterChange(0, lowCuts[i], i);
+        queueParameterChange(1, highCuts[i], i);
+        queueParameterChange(2, shouldFilterChannel[i] ? 1.0f : 0.0f, i);
+    }
+
+    return true;
+}
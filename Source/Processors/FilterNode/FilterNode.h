@@ -48,6 +48,7 @@ public:
 
     void process(AudioSampleBuffer& buffer, MidiBuffer& midiMessages);
     void setParameter(int parameterIndex, float newValue);
+    void applyParameterChange(const ParameterChange& change);
 
     AudioProcessorEditor* createEditor();
 
@@ -66,6 +67,9 @@ public:
 
     void loadCustomChannelParametersFromXml(XmlElement* channelInfo, bool isEventChannel);
 
+    bool saveCustomChannelParametersToSnapshot(OutputStream& stream);
+    bool loadCustomChannelParametersFromSnapshot(InputStream& stream);
+
     void setApplyOnADC(bool state);
 private:
 
@@ -73,6 +77,11 @@ private:
     OwnedArray<Dsp::Filter> filters;
     Array<bool> shouldFilterChannel;
 
+    // copies of the settings above for process(), updated by applyParameterChange()
+    HeapBlock<double> processLowCuts, processHighCuts;
+    HeapBlock<bool> processFilterChannel;
+    int numProcessChannels;
+
     bool applyOnADC;
     double defaultLowCut;
     double defaultHighCut;
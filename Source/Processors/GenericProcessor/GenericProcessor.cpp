@@ -89,11 +89,58 @@ void GenericProcessor::setParameter(int parameterIndex, float newValue)
     std::cout << "Setting parameter" << std::endl;
 
     if (currentChannel >= 0)
+        queueParameterChange(parameterIndex, newValue, currentChannel);
+
+}
+
+void GenericProcessor::queueParameterChange(int parameterIndex, float newValue, int channel, int subChannel)
+{
+    ParameterChange change;
+    change.parameterIndex = parameterIndex;
+    change.channel = channel;
+    change.subChannel = subChannel;
+    change.value = newValue;
+
+    if (parameterQueueActive.get() == 0)
     {
-        Parameter& p =  parameters.getReference(parameterIndex);
-        p.setValue(newValue, currentChannel);
+        applyParameterChange(change);
+        return;
     }
 
+    // the queue is emptied at the start of every block, so it's only full
+    // if thousands of changes arrive at once
+    for (int attempt = 0; !parameterQueue.push(change); attempt++)
+    {
+        if (attempt == 100)
+        {
+            std::cout << getName() << ": parameter queue is full, dropping a change." << std::endl;
+            return;
+        }
+
+        Thread::sleep(1);
+    }
+}
+
+void GenericProcessor::applyParameterChange(const ParameterChange& change)
+{
+    if (change.channel >= 0 && change.parameterIndex < parameters.size())
+    {
+        Parameter& p = parameters.getReference(change.parameterIndex);
+        p.setValue(change.value, change.channel);
+    }
+}
+
+void GenericProcessor::setParameterQueueActive(bool isActive)
+{
+    parameterQueueActive.set(isActive ? 1 : 0);
+
+    if (!isActive)
+    {
+        ParameterChange change;
+
+        while (parameterQueue.pop(change))
+            applyParameterChange(change);
+    }
 }
 
 const String GenericProcessor::getParameterName(int parameterIndex)
@@ -517,18 +564,18 @@ void GenericProcessor::disableEditor()
 /** Used to get the number of samples in a given buffer, for a given channel. */
 int GenericProcessor::getNumSamples(int channelNum)
 {
-    int sourceNodeId, nSamples;
+    int streamId, nSamples;
 
     if (channelNum >= 0 && channelNum < channels.size())
-        sourceNodeId = channels[channelNum]->sourceNodeId;
+        streamId = channels[channelNum]->getStreamId();
     else
         return 0;
 
-    // std::cout << "Requesting samples for channel " << channelNum << " with source node " << sourceNodeId << std::endl;
+    // std::cout << "Requesting samples for channel " << channelNum << " with stream " << streamId << std::endl;
 
     try
     {
-        nSamples = numSamples.at(sourceNodeId);
+        nSamples = numSamples.at(streamId);
     }
     catch (std::exception& e)
     {
@@ -548,12 +595,9 @@ void GenericProcessor::setNumSamples(MidiBuffer& events, int sampleIndex)
     // This amounts to adding a "buffer size" flag at a particular sample number,
     // and a new flag is added each time "setNumSamples" is called.
     // Thus, if the number of samples changes somewhere in the processing pipeline,
-    // the old sample number will remain. This is a problem if the number of
-    // samples gets smaller.
-    // If we allow the sample rate to change (e.g., with a resampling node),
-    // this code will have to be updated. The easiest approach will be for each
-    // processor to ignore any buffer size events that don't come from its
-    // immediate source.
+    // the old sample number will remain. A processor that changes the sample
+    // rate (e.g., a resampling node) gives the affected channels a new stream
+    // instead, and uses the three-argument version below.
     //
 
     uint8 data[4];
@@ -569,20 +613,37 @@ void GenericProcessor::setNumSamples(MidiBuffer& events, int sampleIndex)
                     0); // sample index
 }
 
+void GenericProcessor::setNumSamples(MidiBuffer& events, int sampleIndex, int sourceNodeId)
+{
+    // the fifth byte marks the stream as derived from the source's
+    uint8 data[5];
+
+    int16 si = (int16) sampleIndex;
+
+    data[0] = BUFFER_SIZE;
+    data[1] = nodeId;
+    memcpy(data+2, &si, 2);
+    data[4] = (uint8) sourceNodeId;
+
+    events.addEvent(data, 5, 0);
+
+    numSamples[Channel::getStreamId(nodeId, sourceNodeId)] = sampleIndex;
+}
+
 /** Used to get the timestamp for a given buffer, for a given source node. */
 int64 GenericProcessor::getTimestamp(int channelNum)
 {
-    int sourceNodeId;
+    int streamId;
     int64 ts;
 
     if (channelNum >= 0 && channelNum < channels.size())
-        sourceNodeId = channels[channelNum]->sourceNodeId;
+        streamId = channels[channelNum]->getStreamId();
     else
         return 0;
 
     try
     {
-        ts = timestamps.at(sourceNodeId);
+        ts = timestamps.at(streamId);
     }
     catch (std::exception& e)
     {
@@ -634,15 +695,31 @@ void GenericProcessor::setTimestamp(MidiBuffer& events, int64 timestamp)
 	}
 }
 
+void GenericProcessor::setTimestamp(MidiBuffer& events, int64 timestamp, int sourceNodeId)
+{
+    uint8 data[14];
+
+    data[0] = TIMESTAMP;
+    data[1] = nodeId;
+    data[2] = 0;
+    data[3] = 0;
+    data[4] = 0;
+    data[5] = (uint8) sourceNodeId; // differs from data[1], so it's a derived stream
+    memcpy(data + 6, &timestamp, 8);
+
+    events.addEvent(data, 14, 0);
+
+    timestamps[Channel::getStreamId(nodeId, sourceNodeId)] = timestamp;
+}
+
 int GenericProcessor::processEventBuffer(MidiBuffer& events)
 {
     //
     // This loops through all events in the buffer, and uses the BUFFER_SIZE
-    // events to determine the number of samples in the current buffer. If
-    // there are multiple such events, the one with the highest number of
-    // samples will be used.
-    // This approach is not ideal, as it will become a problem if we allow
-    // the sample rate to change at different points in the signal chain.
+    // and TIMESTAMP events to find the sample count and timestamp of each
+    // stream in the current buffer. Most streams belong to a source node;
+    // processors that change the sample rate of some channels send events
+    // for a derived stream, which carry the source's ID as well as their own.
     //
 
     int numRead = 0;
@@ -676,7 +753,10 @@ int GenericProcessor::processEventBuffer(MidiBuffer& events)
                 uint8 sourceNodeId;
                 memcpy(&sourceNodeId, dataptr + 1, 1);
 
-                numSamples[sourceNodeId] = numRead;
+                if (dataSize >= 5)
+                    numSamples[Channel::getStreamId(sourceNodeId, dataptr[4])] = numRead;
+                else
+                    numSamples[sourceNodeId] = numRead;
 
                 //if (nodeId < 900)
                 //    std::cout << nodeId << " got " << numRead << " samples for " << (int) sourceNodeId << std::endl;
@@ -691,7 +771,10 @@ int GenericProcessor::processEventBuffer(MidiBuffer& events)
                 uint8 sourceNodeId;
                 memcpy(&sourceNodeId, dataptr + 1, 1);
 
-                timestamps[sourceNodeId] = ts;
+                if (dataptr[5] != sourceNodeId)
+                    timestamps[Channel::getStreamId(sourceNodeId, dataptr[5])] = ts;
+                else
+                    timestamps[sourceNodeId] = ts;
 
                 //if (nodeId < 900)
                 //    std::cout << nodeId << " got " << ts << " timestamp for " << (int) sourceNodeId << std::endl;
@@ -789,12 +872,25 @@ void GenericProcessor::addEvent(MidiBuffer& eventBuffer,
 
 void GenericProcessor::processBlock(AudioSampleBuffer& buffer, MidiBuffer& eventBuffer)
 {
+    const int64 startTicks = Time::getHighResolutionTicks();
+    const int64 startAllocations = AllocationCounter::getThreadCount();
+
+    // parameter changes from the message thread only take effect between blocks
+    ParameterChange change;
+
+    while (parameterQueue.pop(change))
+        applyParameterChange(change);
 
-    processEventBuffer(eventBuffer); // extract buffer sizes and timestamps,
+    int nSamples = processEventBuffer(eventBuffer); // extract buffer sizes and timestamps,
     // set flag on all TTL events to zero
 
+    const int numEvents = eventBuffer.getNumEvents();
+
     process(buffer, eventBuffer);
 
+    profile.addBlock(startTicks, Time::getHighResolutionTicks(), nSamples, numEvents,
+                     (int) (AllocationCounter::getThreadCount() - startAllocations));
+
 }
 
 
@@ -932,12 +1028,18 @@ void GenericProcessor::loadFromXml()
 
             }
 
+            // the snapshot, if there is one, replaces the CHANNEL elements
+            bool customLoaded = false;
+            const bool channelsLoaded = loadChannelParametersFromSnapshot(customLoaded);
+
             forEachXmlChildElement(*parametersAsXml, xmlNode)
             {
                 if (xmlNode->hasTagName("CHANNEL"))
                 {
-
-                    loadChannelParametersFromXml(xmlNode);
+                    if (!channelsLoaded)
+                        loadChannelParametersFromXml(xmlNode);
+                    else if (!customLoaded)
+                        loadCustomChannelParametersFromXml(xmlNode);
                 }
                 else if (xmlNode->hasTagName("EVENTCHANNEL"))
                 {
@@ -955,6 +1057,74 @@ void GenericProcessor::loadFromXml()
 
 }
 
+void GenericProcessor::saveToSnapshot(OutputStream& stream)
+{
+    if (isSplitter() || isMerger())
+    {
+        stream.writeInt(-1);
+        return;
+    }
+
+    stream.writeInt(channels.size());
+
+    for (int i = 0; i < channels.size(); i++)
+    {
+        bool p, r, a;
+
+        getEditor()->getChannelSelectionState(i, &p, &r, &a);
+
+        stream.writeByte((char) ((p ? 1 : 0) | (r ? 2 : 0) | (a ? 4 : 0)));
+    }
+
+    MemoryOutputStream custom;
+
+    const bool hasCustom = saveCustomChannelParametersToSnapshot(custom);
+
+    stream.writeBool(hasCustom);
+
+    if (hasCustom)
+        stream.write(custom.getData(), custom.getDataSize());
+}
+
+bool GenericProcessor::loadChannelParametersFromSnapshot(bool& customLoaded)
+{
+    customLoaded = false;
+
+    if (parametersAsSnapshot.getSize() == 0)
+        return false;
+
+    MemoryInputStream stream(parametersAsSnapshot, false);
+
+    const int numChannels = stream.readInt();
+
+    // the channel count can differ from the saved one, e.g. if the source changed
+    if (numChannels != channels.size())
+        return false;
+
+    for (int i = 0; i < numChannels; i++)
+    {
+        const int state = stream.readByte();
+
+        // same channel numbering as loadChannelParametersFromXml()
+        getEditor()->setChannelSelectionState(i - 1, (state & 1) != 0, (state & 2) != 0, (state & 4) != 0);
+    }
+
+    if (stream.readBool())
+        customLoaded = loadCustomChannelParametersFromSnapshot(stream);
+
+    return true;
+}
+
+bool GenericProcessor::saveCustomChannelParametersToSnapshot(OutputStream& stream)
+{
+    return false;
+}
+
+bool GenericProcessor::loadCustomChannelParametersFromSnapshot(InputStream& stream)
+{
+    return false;
+}
+
 void GenericProcessor::loadChannelParametersFromXml(XmlElement* channelInfo, bool isEventChannel)
 {
 
@@ -31,8 +31,10 @@ enum ChannelType {HEADSTAGE_CHANNEL = 0, AUX_CHANNEL = 1, ADC_CHANNEL = 2, EVENT
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "../Editors/GenericEditor.h"
 #include "../Parameter/Parameter.h"
+#include "../Parameter/ParameterChangeQueue.h"
 #include "../../AccessClass.h"
 #include "../Channel/Channel.h"
+#include "ProcessingProfile.h"
 
 #include <time.h>
 #include <stdio.h>
@@ -95,7 +97,11 @@ public:
 
     /** Allows parameters to change while acquisition is active. If the user wants
     to change ANY variables that are used within the process() method, this must
-    be done through setParameter(). Otherwise the application will crash. */
+    be done through setParameter(). Otherwise the application will crash.
+
+    Called from the message thread. Values used by process() should be changed
+    through queueParameterChange(), which hands them to applyParameterChange()
+    at the start of the next block. */
     virtual void setParameter(int parameterIndex, float newValue);
 
     /** Creates a GenericEditor.*/
@@ -604,6 +610,19 @@ public:
     /** Returns the parameter for a given index.*/
     Parameter& getParameterReference(int parameterIndex);
 
+    /** Applies the change right away while acquisition is stopped. Otherwise
+        queues it, and applyParameterChange() is called by processBlock() before
+        the next block. Call from the message thread only. */
+    void queueParameterChange(int parameterIndex, float newValue, int channel, int subChannel = -1);
+
+    /** Updates the values used by process(); runs on the processing thread during
+        acquisition. The default sets the Parameter's value for the channel. */
+    virtual void applyParameterChange(const ParameterChange& change);
+
+    /** Called by the ProcessorGraph when acquisition starts and stops. Changes still
+        waiting when it stops are applied on the calling thread. */
+    void setParameterQueueActive(bool isActive);
+
     /** Save generic settings to XML (called by all processors).*/
     void saveToXml(XmlElement* parentElement);
 
@@ -628,6 +647,18 @@ public:
     /** Load custom parameters for each channel. */
     virtual void loadCustomChannelParametersFromXml(XmlElement* channelElement, bool isEventChannel=false);
 
+    /** Writes the channel selection states and any custom per-channel arrays
+        for the binary snapshot (see ParameterSnapshot). */
+    void saveToSnapshot(OutputStream& stream);
+
+    /** Saves custom per-channel arrays for the snapshot; returns false if
+        the processor doesn't have any. */
+    virtual bool saveCustomChannelParametersToSnapshot(OutputStream& stream);
+
+    /** Reads what saveCustomChannelParametersToSnapshot() wrote; returns false
+        to load the custom channel parameters from XML instead. */
+    virtual bool loadCustomChannelParametersFromSnapshot(InputStream& stream);
+
     /** handle messages from other processors */
     virtual String interProcessorCommunication(String command)
     {
@@ -637,23 +668,40 @@ public:
     /** Holds loaded parameters */
     XmlElement* parametersAsXml;
 
+    /** This processor's block of the parameter snapshot, if one was loaded with the XML. */
+    MemoryBlock parametersAsSnapshot;
+
     /** When set to false, this disables the sending of sample counts through the event buffer. */
     bool sendSampleCount;
 
+    /** Execution time, samples and events of recent blocks, recorded by processBlock(). */
+    ProcessingProfile& getProfile()
+    {
+        return profile;
+    }
+
     /** Used to get the number of samples in a given buffer, for a given channel. */
     int getNumSamples(int channelNumber);
 
     /** Used to get the number of samples in a given buffer, for a given source node. */
     void setNumSamples(MidiBuffer&, int numSamples);
 
+    /** Sets the sample count of the stream this processor derives from a source's
+        stream (see Channel::getStreamId()), e.g. after resampling some of its channels. */
+    void setNumSamples(MidiBuffer&, int numSamples, int sourceNodeId);
+
     /** Used to get the timestamp for a given buffer, for a given channel. */
     int64 getTimestamp(int channelNumber);
 
     /** Used to set the timestamp for a given buffer, for a given source node. */
     void setTimestamp(MidiBuffer&, int64 timestamp);
 
-    std::map<uint8, int> numSamples;
-    std::map<uint8, int64> timestamps;
+    /** Sets the timestamp of the stream this processor derives from a source's stream. */
+    void setTimestamp(MidiBuffer&, int64 timestamp, int sourceNodeId);
+
+    /** Sample counts and timestamps of the current buffer, by stream (see Channel::getStreamId()). */
+    std::map<int, int> numSamples;
+    std::map<int, int64> timestamps;
 
 private:
 
@@ -668,6 +716,10 @@ private:
     Array<bool> recordStatus;
 	Array<bool> monitorStatus;
 
+    /** Loads the channel parameters from parametersAsSnapshot; returns false if it doesn't
+        match the current channels. customLoaded is false if the custom ones must come from XML. */
+    bool loadChannelParametersFromSnapshot(bool& customLoaded);
+
     /** Extracts sample counts and timestamps from the MidiBuffer. */
     int processEventBuffer(MidiBuffer&);
 
@@ -677,6 +729,11 @@ private:
     bool paramsWereLoaded;
 	bool needsToSendTimestampMessage;
 
+    ProcessingProfile profile;
+
+    ParameterChangeQueue parameterQueue;
+    Atomic<int> parameterQueueActive;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GenericProcessor);
 
 };
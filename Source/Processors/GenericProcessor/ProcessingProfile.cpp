@@ -0,0 +1,309 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ProcessingProfile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#if OPEN_EPHYS_COUNT_ALLOCATIONS
+
+#if JUCE_MSVC
+ #define THREAD_LOCAL __declspec(thread)
+#else
+ #define THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+THREAD_LOCAL int64 threadAllocations = 0;
+}
+
+int64 AllocationCounter::getThreadCount()
+{
+    return threadAllocations;
+}
+
+void* operator new(std::size_t size)
+{
+    ++threadAllocations;
+
+    void* p = std::malloc(size > 0 ? size : 1);
+
+    if (p == nullptr)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) throw()
+{
+    ++threadAllocations;
+
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& nt) throw()
+{
+    return operator new(size, nt);
+}
+
+void operator delete(void* p) throw()
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) throw()
+{
+    std::free(p);
+}
+
+#else
+
+int64 AllocationCounter::getThreadCount()
+{
+    return 0;
+}
+
+#endif
+
+//---------------------------------------------------------------------
+
+ProcessingProfile::ProcessingProfile()
+{
+    durations.calloc(PROFILE_WINDOW_SIZE);
+    samples.calloc(PROFILE_WINDOW_SIZE);
+    events.calloc(PROFILE_WINDOW_SIZE);
+    allocations.calloc(PROFILE_WINDOW_SIZE);
+    trace.calloc(PROFILE_TRACE_SIZE);
+}
+
+ProcessingProfile::~ProcessingProfile()
+{
+
+}
+
+void ProcessingProfile::reset()
+{
+    numBlocks.set(0);
+}
+
+void ProcessingProfile::addBlock(int64 startTicks, int64 endTicks, int numSamples, int numEvents, int numAllocations)
+{
+    const int n = numBlocks.get();
+
+    const int w = n % PROFILE_WINDOW_SIZE;
+    durations[w] = (float)(Time::highResolutionTicksToSeconds(endTicks - startTicks) * 1000.0);
+    samples[w] = numSamples;
+    events[w] = numEvents;
+    allocations[w] = numAllocations;
+
+    TraceEntry& entry = trace[n % PROFILE_TRACE_SIZE];
+    entry.startTicks = startTicks;
+    entry.endTicks = endTicks;
+    entry.thread = Thread::getCurrentThreadId();
+    entry.numSamples = numSamples;
+    entry.numEvents = numEvents;
+
+    numBlocks.set(n + 1);
+}
+
+int ProcessingProfile::getNumBlocks() const
+{
+    return numBlocks.get();
+}
+
+ProcessingStats ProcessingProfile::getStats() const
+{
+    ProcessingStats stats;
+
+    stats.numBlocks = jmin(numBlocks.get(), PROFILE_WINDOW_SIZE);
+    stats.meanMs = 0;
+    stats.p99Ms = 0;
+    stats.maxMs = 0;
+    stats.meanSamples = 0;
+    stats.meanEvents = 0;
+    stats.meanAllocations = 0;
+
+    if (stats.numBlocks == 0)
+        return stats;
+
+    std::vector<float> sorted(durations.getData(), durations.getData() + stats.numBlocks);
+
+    for (int i = 0; i < stats.numBlocks; i++)
+    {
+        stats.meanMs += sorted[i];
+        stats.meanSamples += samples[i];
+        stats.meanEvents += events[i];
+        stats.meanAllocations += allocations[i];
+    }
+
+    stats.meanMs /= stats.numBlocks;
+    stats.meanSamples /= stats.numBlocks;
+    stats.meanEvents /= stats.numBlocks;
+    stats.meanAllocations /= stats.numBlocks;
+
+    std::sort(sorted.begin(), sorted.end());
+
+    stats.p99Ms = sorted[jmin(stats.numBlocks - 1, (int)(0.99 * stats.numBlocks))];
+    stats.maxMs = sorted.back();
+
+    return stats;
+}
+
+String ProcessingProfile::getSummary() const
+{
+    ProcessingStats stats = getStats();
+
+    if (stats.numBlocks == 0)
+        return String::empty;
+
+    return String(stats.meanMs, 2) + " / " + String(stats.p99Ms, 2) + " ms";
+}
+
+void ProcessingProfile::appendTraceEvents(String& json, const String& name, Array<Thread::ThreadID>& threads) const
+{
+    const int n = numBlocks.get();
+    const int numEntries = jmin(n, PROFILE_TRACE_SIZE);
+
+    const String escapedName = name.replace("\\", "\\\\").replace("\"", "\\\"");
+
+    for (int i = n - numEntries; i < n; i++)
+    {
+        const TraceEntry& entry = trace[i % PROFILE_TRACE_SIZE];
+
+        if (!threads.contains(entry.thread))
+            threads.add(entry.thread);
+
+        if (json.isNotEmpty())
+            json << ",\n";
+
+        json << "{\"name\":\"" << escapedName << "\",\"cat\":\"processing\",\"ph\":\"X\""
+             << ",\"ts\":" << String(Time::highResolutionTicksToSeconds(entry.startTicks) * 1.0e6, 1)
+             << ",\"dur\":" << String(Time::highResolutionTicksToSeconds(entry.endTicks - entry.startTicks) * 1.0e6, 1)
+             << ",\"pid\":1,\"tid\":" << String(threads.indexOf(entry.thread))
+             << ",\"args\":{\"samples\":" << String(entry.numSamples)
+             << ",\"events\":" << String(entry.numEvents) << "}}";
+    }
+}
+
+CallbackMonitor::CallbackMonitor()
+{
+    reset();
+}
+
+CallbackMonitor::~CallbackMonitor()
+{
+
+}
+
+void CallbackMonitor::reset()
+{
+    profile.reset();
+
+    startTicks = 0;
+    lastStartTicks = 0;
+    expectedGapTicks = 0;
+
+    periodMs = 0;
+    lastSlackMs = 0;
+    minSlackMs = 0;
+
+    numXruns.set(0);
+}
+
+void CallbackMonitor::callbackStarted()
+{
+    startTicks = Time::getHighResolutionTicks();
+
+    // the device skipped (or badly delayed) a callback
+    if (lastStartTicks > 0 && expectedGapTicks > 0 &&
+        startTicks - lastStartTicks > (int64)(XRUN_GAP_FACTOR * expectedGapTicks))
+    {
+        ++numXruns;
+    }
+
+    lastStartTicks = startTicks;
+}
+
+void CallbackMonitor::callbackFinished(int numSamples, double sampleRate)
+{
+    const int64 endTicks = Time::getHighResolutionTicks();
+
+    if (sampleRate <= 0)
+        return;
+
+    const double elapsedMs = Time::highResolutionTicksToSeconds(endTicks - startTicks) * 1000.0;
+    const bool isFirst = profile.getNumBlocks() == 0;
+
+    periodMs = double(numSamples) / sampleRate * 1000.0;
+    expectedGapTicks = Time::secondsToHighResolutionTicks(periodMs / 1000.0);
+
+    lastSlackMs = periodMs - elapsedMs;
+    minSlackMs = isFirst ? lastSlackMs : jmin(minSlackMs, lastSlackMs);
+
+    // the chain missed the deadline
+    if (lastSlackMs < 0)
+        ++numXruns;
+
+    profile.addBlock(startTicks, endTicks, numSamples, 0);
+}
+
+String CallbackMonitor::getSummary() const
+{
+    ProcessingStats stats = profile.getStats();
+
+    if (stats.numBlocks == 0)
+        return String::empty;
+
+    return "Callback " + String(stats.meanMs, 2) + " ms (p99 " + String(stats.p99Ms, 2)
+           + ") of " + String(periodMs, 2) + " ms, min slack " + String(minSlackMs, 2)
+           + " ms, " + String(numXruns.get()) + " xruns";
+}
+
+int CallbackMonitor::getNumXruns() const
+{
+    return numXruns.get();
+}
+
+const ProcessingProfile& CallbackMonitor::getProfile() const
+{
+    return profile;
+}
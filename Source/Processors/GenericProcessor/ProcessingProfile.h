@@ -0,0 +1,188 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PROCESSINGPROFILE_H_8B2E4F61__
+#define __PROCESSINGPROFILE_H_8B2E4F61__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+#define PROFILE_WINDOW_SIZE 512  // blocks used for the rolling statistics
+#define PROFILE_TRACE_SIZE 8192  // blocks kept for trace export
+#define XRUN_GAP_FACTOR 1.5      // a callback arriving this many periods late counts as an xrun
+
+// replaces the global operator new to count allocations per block; only meant
+// for benchmark builds (e.g. CXXFLAGS=-DOPEN_EPHYS_COUNT_ALLOCATIONS=1)
+#ifndef OPEN_EPHYS_COUNT_ALLOCATIONS
+ #define OPEN_EPHYS_COUNT_ALLOCATIONS 0
+#endif
+
+/** Rolling statistics over the last PROFILE_WINDOW_SIZE blocks. */
+struct ProcessingStats
+{
+    int numBlocks;
+    double meanMs;
+    double p99Ms;
+    double maxMs;
+    double meanSamples;
+    double meanEvents;
+    double meanAllocations;
+};
+
+/**
+
+  Counts the heap allocations made by each thread.
+
+  When OPEN_EPHYS_COUNT_ALLOCATIONS is set, the global operator new is
+  replaced (in ProcessingProfile.cpp) so that every allocation bumps a
+  thread-local counter. Comparing the count before and after a block gives
+  the allocations made by that block, even when other threads allocate at
+  the same time. Otherwise the count is always 0.
+
+  @see ProcessingProfile, PipelineBenchmark
+
+*/
+
+class AllocationCounter
+{
+public:
+    /** Allocations made by the calling thread so far. */
+    static int64 getThreadCount();
+
+    /** Returns true if this build counts allocations. */
+    static bool isEnabled()
+    {
+        return OPEN_EPHYS_COUNT_ALLOCATIONS != 0;
+    }
+};
+
+/**
+
+  Records how long each processing block takes.
+
+  addBlock() is called from the thread that runs the block and never
+  allocates or locks; the statistics and the trace are read from the
+  message thread, so they may be off by a block while acquisition runs.
+
+  @see GenericProcessor, CallbackMonitor
+
+*/
+
+class ProcessingProfile
+{
+public:
+    ProcessingProfile();
+    ~ProcessingProfile();
+
+    /** Forgets all recorded blocks. */
+    void reset();
+
+    /** Records one block. */
+    void addBlock(int64 startTicks, int64 endTicks, int numSamples, int numEvents, int numAllocations = 0);
+
+    /** Number of blocks recorded since the last reset. */
+    int getNumBlocks() const;
+
+    /** Mean, 99th percentile and maximum time over the recent blocks. */
+    ProcessingStats getStats() const;
+
+    /** Short "mean / p99" text for the editors and the graph viewer (empty if nothing was recorded). */
+    String getSummary() const;
+
+    /** Appends the recorded blocks to a Chrome trace ("traceEvents") array. */
+    void appendTraceEvents(String& json, const String& name, Array<Thread::ThreadID>& threads) const;
+
+private:
+
+    struct TraceEntry
+    {
+        int64 startTicks;
+        int64 endTicks;
+        Thread::ThreadID thread;
+        int numSamples;
+        int numEvents;
+    };
+
+    HeapBlock<float> durations;
+    HeapBlock<int> samples;
+    HeapBlock<int> events;
+    HeapBlock<int> allocations;
+    HeapBlock<TraceEntry> trace;
+
+    Atomic<int> numBlocks;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProcessingProfile);
+
+};
+
+/**
+
+  Keeps track of the audio callback against its deadline.
+
+  The slack is the part of the buffer period that is left once the
+  signal chain has run. An xrun is counted when the chain takes longer
+  than the period, or when a callback arrives much later than expected.
+
+  @see ProcessorGraph, ProcessingProfile
+
+*/
+
+class CallbackMonitor
+{
+public:
+    CallbackMonitor();
+    ~CallbackMonitor();
+
+    void reset();
+
+    /** Call at the start of the audio callback. */
+    void callbackStarted();
+
+    /** Call at the end of the audio callback. */
+    void callbackFinished(int numSamples, double sampleRate);
+
+    /** Slack and xrun summary for the graph viewer (empty if no callback has run). */
+    String getSummary() const;
+
+    int getNumXruns() const;
+
+    const ProcessingProfile& getProfile() const;
+
+private:
+    ProcessingProfile profile;
+
+    int64 startTicks;
+    int64 lastStartTicks;
+    int64 expectedGapTicks;
+
+    double periodMs;
+    double lastSlackMs;
+    double minSlackMs;
+
+    Atomic<int> numXruns;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CallbackMonitor);
+
+};
+
+
+#endif  // __PROCESSINGPROFILE_H_8B2E4F61__
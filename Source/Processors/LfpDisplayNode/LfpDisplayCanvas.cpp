@@ -27,9 +27,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 LfpDisplayCanvas::LfpDisplayCanvas(LfpDisplayNode* processor_) :
      timebase(1.0f), displayGain(1.0f),   timeOffset(0.0f),
-    processor(processor_), selectedChannelType(HEADSTAGE_CHANNEL)
+    processor(processor_), selectedChannelType(HEADSTAGE_CHANNEL),
+    imageTop(0), screenWidth(0), pixelWidth(1), isAnimating(false),
+    needsFullRender(true), dirtyStart(0), dirtyEnd(0)
 {
 
+    renderThread = new LfpRenderThread(this);
+
     nChans = processor->getNumInputs();
     std::cout << "Setting num inputs on LfpDisplayCanvas to " << nChans << std::endl;
 
@@ -260,11 +264,18 @@ LfpDisplayCanvas::LfpDisplayCanvas(LfpDisplayNode* processor_) :
     }
 
     TopLevelWindow::getTopLevelWindow(0)->addKeyListener(this);
+
+    renderThread->startThread();
 }
 
 LfpDisplayCanvas::~LfpDisplayCanvas()
 {
 
+    renderThread->signalThreadShouldExit();
+    renderThread->notify();
+    renderThread->stopThread(1000);
+    cancelPendingUpdate();
+
     deleteAndZero(screenBuffer);
     deleteAndZero(screenBufferMin);
     deleteAndZero(screenBufferMean);
@@ -313,11 +324,17 @@ void LfpDisplayCanvas::beginAnimation()
 {
     std::cout << "Beginning animation." << std::endl;
 
-    displayBufferSize = displayBuffer->getNumSamples();
-
-    for (int i = 0; i < screenBufferIndex.size(); i++)
     {
-        screenBufferIndex.set(i,0);
+        const ScopedLock sl(renderLock);
+
+        displayBufferSize = displayBuffer->getNumSamples();
+
+        for (int i = 0; i < screenBufferIndex.size(); i++)
+        {
+            screenBufferIndex.set(i,0);
+        }
+
+        isAnimating = true;
     }
 
     startCallbacks();
@@ -328,10 +345,15 @@ void LfpDisplayCanvas::endAnimation()
     std::cout << "Ending animation." << std::endl;
 
     stopCallbacks();
+
+    const ScopedLock sl(renderLock);
+    isAnimating = false;
 }
 
 void LfpDisplayCanvas::update()
 {
+    const ScopedLock sl(renderLock);
+
     nChans = jmax(processor->getNumInputs(),1);
 
     sampleRate.clear();
@@ -615,6 +637,8 @@ void LfpDisplayCanvas::refreshState()
 {
     // called when the component's tab becomes visible again
 
+    const ScopedLock sl(renderLock);
+
     for (int i = 0; i <= displayBufferIndex.size(); i++) // include event channel
     {
 
@@ -627,6 +651,8 @@ void LfpDisplayCanvas::refreshState()
 void LfpDisplayCanvas::refreshScreenBuffer()
 {
 
+    const ScopedLock sl(renderLock);
+
     for (int i = 0; i < screenBufferIndex.size(); i++)
         screenBufferIndex.set(i,0);
 
@@ -656,7 +682,7 @@ void LfpDisplayCanvas::updateScreenBuffer()
 {
 
     // copy new samples from the displayBuffer into the screenBuffer
-    int maxSamples = lfpDisplay->getWidth() - leftmargin;
+    int maxSamples = jmin(screenWidth, int(MAX_N_SAMP));
 
     for (int channel = 0; channel <= nChans; channel++) // pull one extra channel for event display
     {
@@ -683,7 +709,7 @@ void LfpDisplayCanvas::updateScreenBuffer()
         //     std::cout << channel << " " << sbi << " " << dbi << " " << nSamples << std::endl;
 
 
-        float ratio = sampleRate[channel] * timebase / float(getWidth() - leftmargin - scrollBarThickness); // samples / pixel
+        float ratio = sampleRate[channel] * timebase / float(pixelWidth); // samples / pixel
         // this number is crucial: converting from samples to values (in px) for the screen buffer
         int valuesNeeded = (int) float(nSamples) / ratio; // N pixels needed for this update
 
@@ -883,14 +909,228 @@ void LfpDisplayCanvas::paint(Graphics& g)
 void LfpDisplayCanvas::refresh()
 {
 
-    updateScreenBuffer();
+    lfpDisplay->refresh(); // takes a new layout snapshot if a full redraw was requested
 
-    lfpDisplay->refresh(); // redraws only the new part of the screen buffer
+    renderThread->notify(); // the render thread pulls in the new samples
 
     //getPeer()->performAnyPendingRepaintsNow();
 
 }
 
+void LfpDisplayCanvas::updateRenderLayout()
+{
+    if (viewport == nullptr || lfpDisplay == nullptr)
+        return;
+
+    const ScopedLock sl(renderLock);
+
+    const int w = jmax(1, lfpDisplay->getWidth() - leftmargin);
+    const int h = jmax(1, viewport->getViewHeight());
+
+    screenWidth = w;
+    pixelWidth = jmax(1, getWidth() - leftmargin - scrollBarThickness);
+    imageTop = viewport->getViewPositionY();
+
+    // software image, so that the render thread can write to it directly
+    if (!traceImage.isValid() || traceImage.getWidth() != w || traceImage.getHeight() != h)
+        traceImage = Image(Image::ARGB, w, h, true, SoftwareImageType());
+
+    channelLayout.clearQuick();
+
+    for (int i = 0; i < lfpDisplay->channels.size(); i++)
+    {
+        LfpChannelDisplay* disp = lfpDisplay->channels[i];
+
+        LfpChannelLayout layout;
+        layout.channel = i;
+        layout.top = disp->getY() - imageTop;
+        layout.bottom = layout.top + disp->getHeight();
+
+        // ensure that only visible channels are rendered
+        if (layout.bottom <= 0 || layout.top >= h)
+            continue;
+
+        layout.centre = layout.top + disp->getHeight()/2;
+        layout.halfHeight = disp->getChannelHeight()/2;
+        layout.scale = disp->getScale();
+        layout.colour = disp->getColour().getPixelARGB();
+        layout.isEnabled = disp->getEnabledState();
+        layout.drawLines = disp->getDrawMethod();
+
+        channelLayout.add(layout);
+    }
+
+    needsFullRender = true;
+    renderThread->notify();
+}
+
+void LfpDisplayCanvas::renderFrame()
+{
+    {
+        const ScopedLock sl(renderLock);
+
+        if (!traceImage.isValid() || screenBufferIndex.size() <= nChans)
+            return;
+
+        if (isAnimating && displayBufferSize > 0)
+            updateScreenBuffer();
+
+        const int w = jmin(traceImage.getWidth(), int(MAX_N_SAMP) - 1);
+
+        int from = w;
+        int to = 0;
+
+        if (needsFullRender)
+        {
+            from = 0;
+            to = w;
+            needsFullRender = false;
+        }
+        else
+        {
+            for (int i = 0; i <= nChans; i++)
+            {
+                from = jmin(from, lastScreenBufferIndex[i]);
+                to = jmax(to, screenBufferIndex[i] + 1); // includes the cursor column
+            }
+
+            from = jmax(0, from);
+            to = jmin(w, to);
+        }
+
+        if (from >= to)
+            return;
+
+        Image::BitmapData data(traceImage, Image::BitmapData::readWrite);
+        renderColumns(data, from, to);
+
+        if (dirtyStart >= dirtyEnd)
+        {
+            dirtyStart = from;
+            dirtyEnd = to;
+        }
+        else
+        {
+            dirtyStart = jmin(dirtyStart, from);
+            dirtyEnd = jmax(dirtyEnd, to);
+        }
+    }
+
+    triggerAsyncUpdate();
+}
+
+void LfpDisplayCanvas::renderColumns(Image::BitmapData& data, int from, int to)
+{
+    const int h = data.height;
+
+    const PixelARGB cursorColour = Colours::yellow.getPixelARGB();
+    const PixelARGB centreColour = Colour(40,40,40).getPixelARGB();
+
+    PixelARGB eventColours[8];
+
+    for (int ev_ch = 0; ev_ch < 8; ev_ch++)
+        eventColours[ev_ch] = lfpDisplay->channelColours[ev_ch*2].withAlpha(0.35f).getPixelARGB();
+
+    const float* events = screenBuffer->getReadPointer(nChans); // last channel+1 in buffer (represents events)
+
+    for (int i = from; i < to; i++)
+    {
+        uint8* column = data.getPixelPointer(i, 0);
+
+        for (int y = 0; y < h; y++)
+            ((PixelARGB*) (column + y*data.lineStride))->setARGB(0, 0, 0, 0);
+
+        int rawEventState = int(events[i]);
+
+        for (int n = 0; n < channelLayout.size(); n++)
+        {
+            const LfpChannelLayout& layout = channelLayout.getReference(n);
+
+            const int top = jmax(0, layout.top);
+            const int bottom = jmin(h, layout.bottom);
+            const int bandTop = jmax(top, layout.centre - layout.halfHeight);
+            const int bandBottom = jmin(bottom, layout.centre + layout.halfHeight);
+
+            if (i == screenBufferIndex[layout.channel]) // most recent drawn sample position
+            {
+                for (int y = bandTop; y < bandBottom; y++)
+                    ((PixelARGB*) (column + y*data.lineStride))->set(cursorColour);
+
+                continue;
+            }
+
+            if (!layout.isEnabled)
+                continue;
+
+            if (layout.centre >= 0 && layout.centre < h)
+                ((PixelARGB*) (column + layout.centre*data.lineStride))->blend(centreColour);
+
+            for (int ev_ch = 0; ev_ch < 8 ; ev_ch++) // for all event channels
+            {
+                // events are represented by a bit code, so we have to extract the individual bits with a mask
+                if ((rawEventState & (1 << ev_ch)) && lfpDisplay->getEventDisplayState(ev_ch))
+                {
+                    for (int y = bandTop; y < bandBottom; y++)
+                        ((PixelARGB*) (column + y*data.lineStride))->blend(eventColours[ev_ch]);
+                }
+            }
+
+            float a, b;
+
+            if (layout.drawLines) // connect this sample to the next one
+            {
+                a = screenBuffer->getSample(layout.channel, i);
+                b = (i + 1 < data.width && i + 1 != screenBufferIndex[layout.channel]) ?
+                    screenBuffer->getSample(layout.channel, i + 1) : a;
+            }
+            else // min/max of all samples in the pixel
+            {
+                a = screenBufferMax->getSample(layout.channel, i);
+                b = screenBufferMin->getSample(layout.channel, i);
+            }
+
+            int y1 = int(a*layout.scale) + layout.centre;
+            int y2 = int(b*layout.scale) + layout.centre;
+
+            if (y1 > y2)
+                std::swap(y1, y2);
+
+            // if there is too much vertical range in one pixel, don't draw the full line for speed reasons
+            const int step = (y2 - y1) < 200 ? 1 : ((y2 - y1) < 400 ? 2 : jmax(1, y2 - y1));
+
+            for (int y = jmax(y1, top); y <= y2 && y < bottom; y += step)
+                ((PixelARGB*) (column + y*data.lineStride))->set(layout.colour);
+        }
+    }
+}
+
+void LfpDisplayCanvas::drawTraces(Graphics& g)
+{
+    const ScopedLock sl(renderLock);
+
+    if (traceImage.isValid())
+        g.drawImageAt(traceImage, leftmargin, imageTop);
+}
+
+void LfpDisplayCanvas::handleAsyncUpdate()
+{
+    int from, to, top, height;
+
+    {
+        const ScopedLock sl(renderLock);
+
+        from = dirtyStart;
+        to = dirtyEnd;
+        top = imageTop;
+        height = traceImage.getHeight();
+
+        dirtyStart = dirtyEnd = 0;
+    }
+
+    if (from < to)
+        lfpDisplay->repaint(leftmargin + from, top, to - from, height);
+}
+
 bool LfpDisplayCanvas::keyPressed(const KeyPress& key)
 {
     if (key.getKeyCode() == key.spaceKey)
@@ -1066,6 +1306,31 @@ int LfpDisplayCanvas::getRangeStep(ChannelType type)
 
 // -------------------------------------------------------------
 
+LfpRenderThread::LfpRenderThread(LfpDisplayCanvas* c) : Thread("LFP renderer"), canvas(c)
+{
+
+}
+
+LfpRenderThread::~LfpRenderThread()
+{
+
+}
+
+void LfpRenderThread::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(-1); // woken up by the canvas's refresh timer or a layout change
+
+        if (threadShouldExit())
+            break;
+
+        canvas->renderFrame();
+    }
+}
+
+// -------------------------------------------------------------
+
 LfpTimescale::LfpTimescale(LfpDisplayCanvas* c) : canvas(c)
 {
 
@@ -1248,6 +1513,8 @@ void LfpDisplay::setColors()
         channelInfo[i]->setColour(channelColours[(int(i/colorGrouping)+1)  % channelColours.size()]);
     }
 
+    canvas->fullredraw = true;
+
 }
 
 
@@ -1294,12 +1561,18 @@ void LfpDisplay::resized()
 
 void LfpDisplay::paint(Graphics& g)
 {
-
+    canvas->drawTraces(g);
 }
 
 void LfpDisplay::refresh()
 {
 
+    // the traces themselves are rendered into the canvas's trace image by the
+    // LfpRenderThread, which repaints the updated columns once they are done
+    if (!canvas->fullredraw)
+        return;
+
+    canvas->updateRenderLayout();
 
     int topBorder = viewport->getViewPositionY();
     int bottomBorder = viewport->getViewHeight() + topBorder;
@@ -1313,19 +1586,8 @@ void LfpDisplay::refresh()
 
         if ((topBorder <= componentBottom && bottomBorder >= componentTop))
         {
-            if (canvas->fullredraw)
-            {
-                channels[i]->fullredraw = true;
-                channels[i]->repaint();
-                channelInfo[i]->repaint();
-
-            }
-            else
-            {
-                channels[i]->repaint(canvas->lastScreenBufferIndex[i]-2, 0, (canvas->screenBufferIndex[i]-canvas->lastScreenBufferIndex[i])+3, getChildComponent(i)->getHeight());  //repaint only the updated portion
-                // we redraw from -2 to +1 relative to the real redraw window, the -2 makes sure that the lines join nicely, and the +1 draws the vertical update line
-            }
-            //std::cout << i << std::endl;
+            channels[i]->repaint();
+            channelInfo[i]->repaint();
         }
 
     }
@@ -1596,6 +1858,7 @@ void LfpDisplay::setEnabledState(bool state, int chan)
     {
         channels[chan]->setEnabledState(state);
         canvas->isChannelEnabled.set(chan, state);
+        canvas->fullredraw = true;
     }
 }
 
@@ -1659,11 +1922,8 @@ void LfpChannelDisplay::setEnabledState(bool state)
 void LfpChannelDisplay::paint(Graphics& g)
 {
 
-    //g.fillAll(Colours::grey);
-
-    g.setColour(Colours::yellow);   // draw most recent drawn sample position
-    g.drawLine(canvas->screenBufferIndex[chan]+1, 0, canvas->screenBufferIndex[chan]+1, getHeight());
-
+    // the trace, the centre line and the sample position marker are rendered
+    // into the canvas's trace image; only the selection and scale are drawn here
 
     //g.setColour(Colours::red); // draw oldest drawn sample position
     //g.drawLine(canvas->lastScreenBufferIndex, 0, canvas->lastScreenBufferIndex, getHeight()-channelOverlap);
@@ -1723,114 +1983,6 @@ void LfpChannelDisplay::paint(Graphics& g)
 
         }
 
-
-        g.setColour(Colour(40,40,40));
-        g.drawLine(0, getHeight()/2, getWidth(), getHeight()/2);
-
-        int stepSize = 1;
-        int from = 0; // for vertical line drawing in the LFP data
-        int to = 0;
-
-        //for (int i = 0; i < getWidth()-stepSize; i += stepSize) // redraw entire display
-        int ifrom = canvas->lastScreenBufferIndex[chan] - 3; // need to start drawing a bit before the actual redraw windowfor the interpolated line to join correctly
-
-        if (ifrom < 0)
-            ifrom = 0;
-
-        int ito = canvas->screenBufferIndex[chan] - 1;
-
-        if (fullredraw)
-        {
-            ifrom = 0; //canvas->leftmargin;
-            ito = getWidth()-stepSize;
-            fullredraw = false;
-        }
-
-        for (int i = ifrom; i < ito ; i += stepSize) // redraw only changed portion
-        {
-
-            // draw event markers
-            int rawEventState = canvas->getYCoord(canvas->getNumChannels(), i);// get last channel+1 in buffer (represents events)
-            
-            //if (i == ifrom)
-            //    std::cout << rawEventState << std::endl;
-
-            for (int ev_ch = 0; ev_ch < 8 ; ev_ch++) // for all event channels
-            {
-                if (display->getEventDisplayState(ev_ch))  // check if plotting for this channel is enabled
-                {
-                    if (rawEventState & (1 << ev_ch))    // events are  representet by a bit code, so we have to extract the individual bits with a mask
-                    {
-                        //std::cout << "Drawing event." << std::endl;
-                        g.setColour(display->channelColours[ev_ch*2]); // get color from lfp color scheme
-                        g.setOpacity(0.35f);
-                        g.drawLine(i, center-channelHeight/2 , i, center+channelHeight/2);
-                    }
-                }
-            }
-
-            //std::cout << "e " << canvas->getYCoord(canvas->getNumChannels()-1, i) << std::endl;
-            g.setColour(lineColour);
-
-            if (drawMethod) // switched between to line drawing and pixel wise drawing
-            {
-
-                // drawLine makes for ok anti-aliased plots, but is pretty slow
-                g.drawLine(i,
-                           (canvas->getYCoord(chan, i)/range*channelHeightFloat)+getHeight()/2,
-                           i+stepSize,
-                           (canvas->getYCoord(chan, i+stepSize)/range*channelHeightFloat)+getHeight()/2);
-
-
-            }
-            else
-            {
-
-                // // pixel wise line plot has no anti-aliasing, but runs much faster
-                double a = (canvas->getYCoordMax(chan, i)/range*channelHeightFloat)+getHeight()/2;
-                double b = (canvas->getYCoordMin(chan, i)/range*channelHeightFloat)+getHeight()/2;
-                double m = (canvas->getYCoordMean(chan, i)/range*channelHeightFloat)+getHeight()/2;
-                if (a<b)
-                {
-                    from = (a);
-                    to = (b);
-                }
-                else
-                {
-                    from = (b);
-                    to = (a);
-                }
-
-                //g.setColour(lineColour.withMultipliedBrightness( 1+(((((float)(to-from)*range)/getHeight())-0.01)*2)  )); // make spikes etc slightly brighter
-
-
-                if ((to-from) < 200)  // if there is too much vertical range in one pixel, don't draw the full line for speed reasons
-                {
-                    for (int j = from; j <= to; j += 1)
-                    {
-                        g.setPixel(i,j);
-                    }
-                }
-                else if ((to-from) < 400)
-                {
-                    for (int j = from; j <= to; j += 2)
-                    {
-                        g.setPixel(i,j);
-                    }
-                }
-                else
-                {
-                    g.setPixel(i,to);
-                    g.setPixel(i,from);
-                }
-
-                //draw mean
-                //g.setColour(Colours::black);
-                //g.setPixel(i,m);
-
-            }
-
-        }
     }
 
     // g.setColour(lineColour.withAlpha(0.7f)); // alpha on seems to decrease draw speed
@@ -1948,6 +2100,21 @@ void LfpChannelDisplay::setDrawMethod(bool isDrawMethod)
 
 }
 
+bool LfpChannelDisplay::getDrawMethod()
+{
+    return drawMethod;
+}
+
+Colour LfpChannelDisplay::getColour()
+{
+    return lineColour;
+}
+
+float LfpChannelDisplay::getScale()
+{
+    return channelHeightFloat / range;
+}
+
 
 void LfpChannelDisplay::setName(String name_)
 {
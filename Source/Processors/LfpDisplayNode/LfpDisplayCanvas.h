@@ -36,6 +36,21 @@ class LfpChannelDisplay;
 class LfpChannelDisplayInfo;
 class EventDisplayInterface;
 class LfpViewport;
+class LfpRenderThread;
+
+/** Position and scaling of one channel's trace in the trace image. */
+struct LfpChannelLayout
+{
+    int channel;
+    int top;        // first image row the trace may use
+    int bottom;     // one past the last image row
+    int centre;
+    int halfHeight;
+    float scale;    // pixels per unit, negative unless the input is inverted
+    PixelARGB colour;
+    bool isEnabled;
+    bool drawLines;
+};
 
 /**
 
@@ -48,7 +63,8 @@ class LfpViewport;
 class LfpDisplayCanvas : public Visualizer,
     public ComboBox::Listener,
     public Button::Listener,
-    public KeyListener
+    public KeyListener,
+    public AsyncUpdater
 
 {
 public:
@@ -73,6 +89,20 @@ public:
 
     void resized();
 
+    /** Pulls new samples into the screen buffers and rasterizes the changed
+        columns into the trace image. Called by the LfpRenderThread. */
+    void renderFrame();
+
+    /** Takes a new snapshot of the channel positions, ranges and colours and
+        schedules a full render. Called on the message thread. */
+    void updateRenderLayout();
+
+    /** Blits the trace image into the LfpDisplay. */
+    void drawTraces(Graphics& g);
+
+    /** Repaints the columns rendered since the last call. */
+    void handleAsyncUpdate();
+
     int getChannelHeight();
 
     int getNumChannels();
@@ -176,15 +206,55 @@ private:
     void refreshScreenBuffer();
     void updateScreenBuffer();
 
+    void renderColumns(Image::BitmapData& data, int from, int to);
+
     Array<int> displayBufferIndex;
     int displayBufferSize;
 
     int scrollBarThickness;
 
+    // guards the screen buffers, the trace image and the layout,
+    // which are shared with the render thread
+    CriticalSection renderLock;
+    ScopedPointer<LfpRenderThread> renderThread;
+
+    Image traceImage; // visible part of the LfpDisplay, one column per screen buffer sample
+    Array<LfpChannelLayout> channelLayout;
+    int imageTop; // LfpDisplay y coordinate of the first image row
+    int screenWidth; // number of screen buffer samples across the display
+    int pixelWidth; // width used to convert samples to pixels
+
+    bool isAnimating;
+    bool needsFullRender;
+    int dirtyStart;
+    int dirtyEnd;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LfpDisplayCanvas);
 
 };
 
+/**
+
+  Rasterizes new LFP samples into the canvas's trace image, so that the
+  message thread only has to blit the image.
+
+  @see LfpDisplayCanvas
+
+*/
+
+class LfpRenderThread : public Thread
+{
+public:
+    LfpRenderThread(LfpDisplayCanvas* canvas);
+    ~LfpRenderThread();
+
+    void run();
+
+private:
+    LfpDisplayCanvas* canvas;
+
+};
+
 class LfpTimescale : public Component
 {
 public:
@@ -310,6 +380,12 @@ public:
     void setCanBeInverted(bool);
 
     void setDrawMethod(bool);
+    bool getDrawMethod();
+
+    Colour getColour();
+
+    /** Pixels per unit of signal (negative unless the input is inverted). */
+    float getScale();
 
     PopupMenu getOptions();
     void changeParameter(const int id);
@@ -323,8 +399,6 @@ public:
     ChannelType getType();
     void updateType();
 
-    bool fullredraw; // used to indicate that a full redraw is required. is set false after each full redraw
-
 protected:
 
     LfpDisplayCanvas* canvas;
@@ -89,6 +89,9 @@ void LfpDisplayNode::updateSettings()
     displayBufferIndex.clear();
     displayBufferIndex.insertMultiple(0, 0, getNumInputs() + numEventChannels);
 
+    repeatPhase.clear();
+    repeatPhase.insertMultiple(0, 0.0f, getNumInputs());
+
 }
 
 bool LfpDisplayNode::resizeBuffer()
@@ -299,6 +302,12 @@ void LfpDisplayNode::process(AudioSampleBuffer& buffer, MidiBuffer& events)
 
     for (int chan = 0; chan < buffer.getNumChannels(); chan++)
     {
+        if (chan < getNumInputs() && channels[chan]->decimation > 1.0f)
+        {
+            copyRepeated(buffer, chan, channels[chan]->decimation);
+            continue;
+        }
+
          int samplesLeft = displayBuffer->getNumSamples() - displayBufferIndex[chan];
          int nSamples = getNumSamples(chan);
 
@@ -339,3 +348,35 @@ void LfpDisplayNode::process(AudioSampleBuffer& buffer, MidiBuffer& events)
 
 }
 
+
+void LfpDisplayNode::copyRepeated(AudioSampleBuffer& buffer, int chan, float decimation)
+{
+    // each sample is held for as many display samples as it spans at the
+    // full rate, so decimated channels keep time with the others
+    const float* source = buffer.getReadPointer(chan);
+    float* dest = displayBuffer->getWritePointer(chan);
+
+    const int bufferSize = displayBuffer->getNumSamples();
+    const int nSamples = getNumSamples(chan);
+
+    int index = displayBufferIndex[chan];
+    float phase = repeatPhase[chan];
+
+    for (int i = 0; i < nSamples; i++)
+    {
+        phase += decimation;
+
+        while (phase >= 1.0f)
+        {
+            dest[index] = source[i];
+
+            if (++index == bufferSize)
+                index = 0;
+
+            phase -= 1.0f;
+        }
+    }
+
+    displayBufferIndex.set(chan, index);
+    repeatPhase.set(chan, phase);
+}
@@ -82,6 +82,7 @@ private:
     ScopedPointer<AudioSampleBuffer> displayBuffer;
 
     Array<int> displayBufferIndex;
+    Array<float> repeatPhase; // display samples owed to each decimated channel
     Array<int> eventSourceNodes;
     std::map<int, int> channelForEventSource;
 
@@ -99,6 +100,9 @@ private:
 
     bool resizeBuffer();
 
+    /** Copies a decimated channel at the display's rate by repeating samples. */
+    void copyRepeated(AudioSampleBuffer& buffer, int chan, float decimation);
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LfpDisplayNode);
 
 };
@@ -141,9 +141,76 @@ StringTS::~StringTS() {
 	delete str;
 }
 
+/*********************************************/
+NetworkEventQueue::NetworkEventQueue() : dequeuePosition(0)
+{
+	slots.calloc(NETWORK_EVENTS_QUEUE_SIZE);
+
+	for (int k = 0; k < NETWORK_EVENTS_QUEUE_SIZE; k++)
+		slots[k].sequence.set((uint32) k);
+
+	enqueuePosition.set(0);
+}
+
+bool NetworkEventQueue::push(const uint8* data, int length, int64 timestamp)
+{
+	// each slot's sequence number says whose turn it is: a producer may fill
+	// it when it equals the position, the consumer when it is one past it
+	uint32 position = enqueuePosition.get();
+	Slot* slot;
+
+	for (;;)
+	{
+		slot = &slots[position & (NETWORK_EVENTS_QUEUE_SIZE - 1)];
+		const int32 difference = (int32) (slot->sequence.get() - position);
+
+		if (difference == 0)
+		{
+			if (enqueuePosition.compareAndSetBool(position + 1, position))
+				break;
+
+			position = enqueuePosition.get();
+		}
+		else if (difference < 0)
+		{
+			return false; // full
+		}
+		else
+		{
+			position = enqueuePosition.get();
+		}
+	}
+
+	slot->length = jmin(length, NETWORK_EVENTS_MAX_LENGTH);
+	slot->timestamp = timestamp;
+	memcpy(slot->data, data, slot->length);
+
+	slot->sequence.set(position + 1);
+
+	return true;
+}
+
+bool NetworkEventQueue::pop(uint8* dest, int& length, int64& timestamp)
+{
+	Slot* slot = &slots[dequeuePosition & (NETWORK_EVENTS_QUEUE_SIZE - 1)];
+
+	if ((int32) (slot->sequence.get() - (dequeuePosition + 1)) < 0)
+		return false; // empty, or the producer hasn't finished writing
+
+	length = slot->length;
+	timestamp = slot->timestamp;
+	memcpy(dest, slot->data, length);
+
+	slot->sequence.set(dequeuePosition + NETWORK_EVENTS_QUEUE_SIZE);
+	dequeuePosition++;
+
+	return true;
+}
+
 /*********************************************/
 NetworkEvents::NetworkEvents(void *zmq_context)
-	: GenericProcessor("Network Events"), Thread("NetworkThread"), threshold(200.0), bufferZone(5.0f), state(false)
+	: GenericProcessor("Network Events"), Thread("NetworkThread"), threshold(200.0), bufferZone(5.0f), state(false),
+	  socketType(REP_SOCKET), numReported(0), lastMessageLength(0)
 
 {
 	zmqcontext = zmq_context;
@@ -156,27 +223,46 @@ NetworkEvents::NetworkEvents(void *zmq_context)
 	sendSampleCount = false; // disable updating the continuous buffer sample counts,
 							 // since this processor only sends events
 	shutdown = false;
+
+	startTimer(NETWORK_EVENTS_UI_INTERVAL);
 }
 
 void NetworkEvents::setNewListeningPort(int port)
 {
 	// first, close existing thread.
 	closesocket();
-	// allow some time for thread to quit
-#ifdef WIN32
-	Sleep(300);
-#else
-	usleep(300 * 1000);
-#endif
 
-	
 	urlport = port;
 	opensocket();
 }
 
+void NetworkEvents::setSocketType(SocketType type)
+{
+	closesocket();
+
+	socketType = type;
+	opensocket();
+}
+
+NetworkEvents::SocketType NetworkEvents::getSocketType()
+{
+	return socketType;
+}
+
+int NetworkEvents::getNumReceived()
+{
+	return numReceived.get();
+}
+
+int NetworkEvents::getNumDropped()
+{
+	return numDropped.get();
+}
+
 NetworkEvents::~NetworkEvents()
 {
 	shutdown = true;
+	stopTimer();
 	closesocket();
 }
 
@@ -185,16 +271,10 @@ bool NetworkEvents::closesocket()
 
 std::cout << "Disabling network node" << std::endl;
 
-#ifdef ZEROMQ 
-	if (threadRunning)
-	{
-		zmq_close(responder);
-		zmq_ctx_destroy(zmqcontext); // this will cause the thread to exit
+	// the thread polls with a timeout, then closes its own socket
+	signalThreadShouldExit();
+	stopThread(1000);
 
-		if (!shutdown)
-			zmqcontext = getProcessorGraph()->createZmqContext();// and this will take care that processor graph doesn't attempt to delete the context again
-	}
-#endif
 	return true;
 }
 
@@ -277,19 +357,18 @@ void NetworkEvents::handleEvent(int eventType, juce::MidiMessage& event, int sam
 
 void NetworkEvents::postTimestamppedStringToMidiBuffer(StringTS s, MidiBuffer& events)
 {
-	uint8* msg_with_ts = new uint8[s.len+8]; // for the two timestamps
-	memcpy(msg_with_ts, s.str, s.len);	
-	memcpy(msg_with_ts+s.len, &s.timestamp, 8);
+	const int len = jmin(s.len, NETWORK_EVENTS_MAX_LENGTH);
+
+	memcpy(eventData, s.str, len);
+	memcpy(eventData+len, &s.timestamp, 8);
 	
 	addEvent(events, 
 			 (uint8) NETWORK,
 			 0,
 			 0,
 			 0,
-			 (uint8) s.len+8,
-			 msg_with_ts);
-
-	delete msg_with_ts;
+			 (uint8) (len+8),
+			 eventData);
 }
 
 void NetworkEvents::simulateStopRecord()
@@ -406,18 +485,75 @@ void NetworkEvents::process(AudioSampleBuffer& buffer,
 	//simulateDesignAndTrials(events);
 
 	//std::cout << *buffer.getSampleData(0, 0) << std::endl;
-	lock.enter();
-	 while (!networkMessagesQueue.empty()) {
-			 StringTS msg = networkMessagesQueue.front();
-			 postTimestamppedStringToMidiBuffer(msg, events);
-			 sendActionMessage("Network event received: " + msg.getString());
-//			 getUIComponent()->getLogWindow()->addLineToLog(msg);
-		     networkMessagesQueue.pop();
-	 }
-	 lock.exit();
+
+	// no locks or allocation here; the message center is updated from timerCallback()
+	int len;
+	int64 timestamp;
+
+	for (int n = 0; n < NETWORK_EVENTS_MAX_PER_BLOCK
+		 && networkMessagesQueue.pop(eventData, len, timestamp); n++)
+	{
+		memcpy(eventData+len, &timestamp, 8);
+
+		addEvent(events,
+				 (uint8) NETWORK,
+				 0,
+				 0,
+				 0,
+				 (uint8) (len+8),
+				 eventData);
+	}
 
 }
 
+String NetworkEvents::receivedMessage(const uint8* data, int length, int64 timestamp)
+{
+	if (length == 0)
+		return "Recieved Zero Message?!?!?";
+
+	if (length > NETWORK_EVENTS_MAX_LENGTH)
+		std::cout << "Network event longer than " << NETWORK_EVENTS_MAX_LENGTH << " bytes; truncating." << std::endl;
+
+	if (!networkMessagesQueue.push(data, length, timestamp))
+	{
+		++numDropped;
+		return "Dropped";
+	}
+
+	{
+		const SpinLock::ScopedLockType sl(lastMessageLock);
+		lastMessageLength = jmin(length, NETWORK_EVENTS_MAX_LENGTH);
+		memcpy(lastMessage, data, lastMessageLength);
+	}
+
+	++numReceived;
+
+	// handle special messages
+	return handleSpecialMessages(StringTS((unsigned char*) data, jmin(length, NETWORK_EVENTS_MAX_LENGTH), timestamp));
+}
+
+void NetworkEvents::timerCallback()
+{
+	const int received = numReceived.get();
+
+	if (received == numReported)
+		return;
+
+	String text;
+
+	{
+		const SpinLock::ScopedLockType sl(lastMessageLock);
+		text = String((const char*) lastMessage, lastMessageLength);
+	}
+
+	if (received - numReported > 1)
+		text += " (+" + String(received - numReported - 1) + " more)";
+
+	numReported = received;
+
+	sendActionMessage("Network event received: " + text);
+}
+
 
 void NetworkEvents::opensocket()
 {
@@ -427,54 +563,107 @@ void NetworkEvents::opensocket()
 void NetworkEvents::run() {
 
 #ifdef ZEROMQ 
- responder = zmq_socket (zmqcontext, ZMQ_REP);
-  String url= String("tcp://*:")+String(urlport);
-  int rc = zmq_bind (responder, url.toRawUTF8());
+	const int type = (socketType == ROUTER_SOCKET) ? ZMQ_ROUTER :
+					 (socketType == PULL_SOCKET) ? ZMQ_PULL : ZMQ_REP;
+
+	responder = zmq_socket (zmqcontext, type);
+
+	int linger = 0;
+	zmq_setsockopt(responder, ZMQ_LINGER, &linger, sizeof(linger));
+
+	String url= String("tcp://*:")+String(urlport);
+	int rc = zmq_bind (responder, url.toRawUTF8());
   
-  if (rc != 0) {
-	  // failed to open socket?
-  	  std::cout << "Failed to open socket." << std::endl;
-	  return;
-  }
-
-  threadRunning = true;
-	 unsigned char *buffer = new unsigned char[MAX_MESSAGE_LENGTH];
-	 int result=-1;
- 
-	while (threadRunning) {
-		
-         result = zmq_recv (responder, buffer, MAX_MESSAGE_LENGTH-1, 0); // blocking
-		
-         juce::int64 timestamp_software = timer.getHighResolutionTicks();
-		
-		 if (result < 0) // will only happen when responder dies.
+	if (rc != 0) {
+		// failed to open socket?
+		std::cout << "Failed to open socket." << std::endl;
+		zmq_close(responder);
+		responder = nullptr;
+		return;
+	}
+
+	threadRunning = true;
+
+	// ROUTER replies go back through the sender's identity (and the empty
+	// delimiter frame that REQ senders add)
+	uint8 identity[256];
+	int identityLength = 0;
+	bool hasDelimiter = false;
+
+	while (!threadShouldExit()) {
+
+		zmq_pollitem_t item;
+		item.socket = responder;
+		item.fd = 0;
+		item.events = ZMQ_POLLIN;
+		item.revents = 0;
+
+		rc = zmq_poll(&item, 1, 100);
+
+		if (rc < 0) // will only happen when the context goes away
 			break;
 
-		StringTS Msg(buffer, result, timestamp_software);
-		if (result > 0) {
-			lock.enter();
-			networkMessagesQueue.push(Msg);
-		    lock.exit();
+		// take everything that has arrived
+		while (rc > 0 && !threadShouldExit()) {
 
-		    //std::cout << "Received message!" << std::endl;
-			// handle special messages
-			String response = handleSpecialMessages(Msg);
-	
-			zmq_send (responder, response.getCharPointer(), response.length(), 0);
-		} else 
-		{
-			String zeroMessageError = "Recieved Zero Message?!?!?";
-			//std::cout << "Received Zero Message!" << std::endl;
+			zmq_msg_t part;
+			zmq_msg_init(&part);
+
+			if (zmq_msg_recv(&part, responder, ZMQ_DONTWAIT) < 0)
+			{
+				zmq_msg_close(&part);
+				break;
+			}
+
+			juce::int64 timestamp_software = timer.getHighResolutionTicks();
+
+			identityLength = 0;
+			hasDelimiter = false;
+
+			for (int k = 0; zmq_msg_more(&part); k++)
+			{
+				const int size = (int) zmq_msg_size(&part);
+
+				if (k == 0 && socketType == ROUTER_SOCKET)
+				{
+					identityLength = jmin(size, 256);
+					memcpy(identity, zmq_msg_data(&part), identityLength);
+				}
+				else if (size == 0)
+				{
+					hasDelimiter = true;
+				}
+
+				zmq_msg_close(&part);
+				zmq_msg_init(&part);
+				zmq_msg_recv(&part, responder, 0); // the rest of a multipart message is already here
+			}
+
+			String response = receivedMessage((const uint8*) zmq_msg_data(&part),
+											  (int) zmq_msg_size(&part),
+											  timestamp_software);
+			zmq_msg_close(&part);
+
+			if (socketType == REP_SOCKET)
+			{
+				zmq_send (responder, response.toRawUTF8(), response.getNumBytesAsUTF8(), 0);
+			}
+			else if (socketType == ROUTER_SOCKET)
+			{
+				zmq_send (responder, identity, identityLength, ZMQ_SNDMORE);
+
+				if (hasDelimiter)
+					zmq_send (responder, "", 0, ZMQ_SNDMORE);
 
-			zmq_send (responder, zeroMessageError.getCharPointer(), zeroMessageError.length(), 0);
+				zmq_send (responder, response.toRawUTF8(), response.getNumBytesAsUTF8(), ZMQ_DONTWAIT);
+			}
 		}
-    }
-	
+	}
 
 	zmq_close(responder);
-	delete buffer;
+	responder = nullptr;
 	threadRunning = false;
-    return;
+	return;
 #endif
 }
 
@@ -522,6 +711,7 @@ void NetworkEvents::saveCustomParametersToXml(XmlElement* parentElement)
 {
     XmlElement* mainNode = parentElement->createNewChildElement("NETWORKEVENTS");
     mainNode->setAttribute("port", urlport);
+    mainNode->setAttribute("socket", (int) socketType);
 }
 
 
@@ -534,7 +724,15 @@ void NetworkEvents::loadCustomParametersFromXml()
 		{
 			if (mainNode->hasTagName("NETWORKEVENTS"))
 			{
-				setNewListeningPort(mainNode->getIntAttribute("port"));
+				closesocket();
+				urlport = mainNode->getIntAttribute("port");
+				socketType = (SocketType) mainNode->getIntAttribute("socket", REP_SOCKET);
+				opensocket();
+
+				NetworkEventsEditor* ed = (NetworkEventsEditor*) getEditor();
+
+				if (ed != nullptr)
+					ed->updateSettings();
 			}
 		}
 	}
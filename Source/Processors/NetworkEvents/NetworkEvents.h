@@ -44,6 +44,11 @@
 #include <list>
 #include <queue>
 
+#define NETWORK_EVENTS_QUEUE_SIZE 1024   // must be a power of two
+#define NETWORK_EVENTS_MAX_LENGTH 247    // bytes; an event holds at most 255, including the timestamp
+#define NETWORK_EVENTS_MAX_PER_BLOCK 256 // events posted per block; the rest wait for the next one
+#define NETWORK_EVENTS_UI_INTERVAL 250   // ms between message center updates
+
 /**
 
  Sends incoming TCP/IP messages from 0MQ to the events buffer
@@ -71,7 +76,60 @@ public:
 	juce::int64 timestamp;
 };
 
-class NetworkEvents : public GenericProcessor,  public Thread
+/**
+
+  Lock-free queue of fixed-size message slots, with any number of
+  producers and a single consumer.
+
+  push() and pop() never allocate or block; push() returns false if the
+  queue is full.
+
+*/
+
+class NetworkEventQueue
+{
+public:
+	NetworkEventQueue();
+
+	/** Copies a message into the next free slot (truncating it to
+	    NETWORK_EVENTS_MAX_LENGTH bytes). */
+	bool push(const uint8* data, int length, int64 timestamp);
+
+	/** Copies the oldest message into dest, which must hold
+	    NETWORK_EVENTS_MAX_LENGTH bytes. Only call from one thread. */
+	bool pop(uint8* dest, int& length, int64& timestamp);
+
+private:
+	struct Slot
+	{
+		Atomic<uint32> sequence;
+		int length;
+		int64 timestamp;
+		uint8 data[NETWORK_EVENTS_MAX_LENGTH];
+	};
+
+	HeapBlock<Slot> slots;
+	Atomic<uint32> enqueuePosition;
+	uint32 dequeuePosition;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NetworkEventQueue);
+};
+
+/**
+
+  Receives messages over ZeroMQ and posts them as NETWORK events.
+
+  The socket can be a REP socket (each sender waits for a reply before
+  sending the next message), a ROUTER socket (REQ or DEALER senders;
+  DEALERs can send many messages without waiting for replies) or a PULL
+  socket (PUSH senders; no replies).
+
+  The receiving thread hands messages to process() through a
+  NetworkEventQueue; the message center is updated from a timer.
+
+*/
+
+class NetworkEvents : public GenericProcessor,  public Thread, public Timer
 {
 public:
     NetworkEvents(void *zmq_context);
@@ -107,6 +165,20 @@ public:
 	void postTimestamppedStringToMidiBuffer(StringTS s, MidiBuffer& events);
 	void setNewListeningPort(int port);
 
+	enum SocketType
+	{
+		REP_SOCKET = 1,
+		ROUTER_SOCKET,
+		PULL_SOCKET
+	};
+
+	/** Reopens the socket with the given type. */
+	void setSocketType(SocketType type);
+	SocketType getSocketType();
+
+	int getNumReceived();
+	int getNumDropped();
+
 	void saveCustomParametersToXml(XmlElement* parentElement);
 	void loadCustomParametersFromXml();
 
@@ -117,6 +189,12 @@ private:
 	   void handleEvent(int eventType, MidiMessage& event, int samplePos);
 
 	   StringTS createStringTS(String S, int64 t);
+
+	/** Queues a received message; returns the reply for REP and ROUTER senders. */
+	String receivedMessage(const uint8* data, int length, int64 timestamp);
+
+	/** Sends the latest message to the message center. */
+	void timerCallback();
 	  
 	void *zmqcontext;
 	void *responder;
@@ -125,9 +203,19 @@ private:
     bool state;
     bool shutdown;
 	Time timer;
- 	std::queue<StringTS> networkMessagesQueue;
-	
-	CriticalSection lock;
+
+	SocketType socketType;
+	NetworkEventQueue networkMessagesQueue;
+	uint8 eventData[NETWORK_EVENTS_MAX_LENGTH + 8];
+
+	Atomic<int> numReceived;
+	Atomic<int> numDropped;
+	int numReported;
+
+	// the latest message, for the message center
+	uint8 lastMessage[NETWORK_EVENTS_MAX_LENGTH];
+	int lastMessageLength;
+	SpinLock lastMessageLock;
 	std::queue<StringTS> simulation;
 	int64 simulationStartTime;
 	bool firstTime ;
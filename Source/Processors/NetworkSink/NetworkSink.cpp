@@ -0,0 +1,556 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifdef ZEROMQ
+
+#ifdef WIN32
+    #include "../../Resources/windows-libs/ZeroMQ/include/zmq.h"
+#else
+    #include <zmq.h>
+#endif
+
+#endif
+
+#include "NetworkSink.h"
+#include "NetworkSinkEditor.h"
+#include "../Visualization/SpikeObject.h"
+
+#include <stdio.h>
+
+NetworkSink::NetworkSink()
+    : GenericProcessor("Network Sink"), Thread("Network Sink"),
+      slotSize(0), writeIndex(0), readIndex(0),
+      port(NETWORK_SINK_DEFAULT_PORT), decimation(1),
+      sendFloat(false), sendSpikes(true), sendEvents(true),
+      activeDecimation(1), activeSendFloat(false), activeSendSpikes(true), activeSendEvents(true),
+      decimationPhase(0), publishedRate(0), blockTimestamp(0), sequenceNumber(0),
+      context(nullptr), status("Stopped")
+{
+
+    for (int i = 0; i < NETWORK_SINK_NUM_SLOTS; i++)
+    {
+        Slot* slot = new Slot();
+        slot->numBytes = 0;
+        slots.add(slot);
+    }
+
+#ifdef ZEROMQ
+    // a context of its own, so that closing other sockets can't affect this one
+    context = zmq_ctx_new();
+#endif
+
+}
+
+NetworkSink::~NetworkSink()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread(2000);
+
+#ifdef ZEROMQ
+    // returns once ZeroMQ has released every slot
+    if (context != nullptr)
+        zmq_ctx_term(context);
+#endif
+
+}
+
+AudioProcessorEditor* NetworkSink::createEditor()
+{
+    editor = new NetworkSinkEditor(this, true);
+    return editor;
+}
+
+void NetworkSink::setParameter(int parameterIndex, float newValue)
+{
+    editor->updateParameterButtons(parameterIndex);
+}
+
+void NetworkSink::setPort(int port_)
+{
+    port = port_;
+}
+
+int NetworkSink::getPort()
+{
+    return port;
+}
+
+void NetworkSink::setDecimation(int factor)
+{
+    decimation = jmax(1, factor);
+}
+
+int NetworkSink::getDecimation()
+{
+    return decimation;
+}
+
+void NetworkSink::setSendFloat(bool shouldSendFloat)
+{
+    sendFloat = shouldSendFloat;
+}
+
+bool NetworkSink::getSendFloat()
+{
+    return sendFloat;
+}
+
+void NetworkSink::setSendSpikes(bool shouldSendSpikes)
+{
+    sendSpikes = shouldSendSpikes;
+}
+
+bool NetworkSink::getSendSpikes()
+{
+    return sendSpikes;
+}
+
+void NetworkSink::setSendEvents(bool shouldSendEvents)
+{
+    sendEvents = shouldSendEvents;
+}
+
+bool NetworkSink::getSendEvents()
+{
+    return sendEvents;
+}
+
+int NetworkSink::getNumSent()
+{
+    return numSent.get();
+}
+
+int NetworkSink::getNumDropped()
+{
+    return numDropped.get();
+}
+
+String NetworkSink::getStatus()
+{
+    const ScopedLock sl(statusLock);
+    return status;
+}
+
+bool NetworkSink::waitForSlots(int timeoutMs)
+{
+    const uint32 start = Time::getMillisecondCounter();
+
+    for (int i = 0; i < slots.size(); i++)
+    {
+        while (slots[i]->state.get() == SLOT_SENDING)
+        {
+            if (Time::getMillisecondCounter() - start > (uint32) timeoutMs)
+                return false;
+
+            Thread::sleep(1);
+        }
+    }
+
+    return true;
+}
+
+bool NetworkSink::enable()
+{
+
+    // ZeroMQ may still be holding on to slots from the last run
+    if (!waitForSlots(1000))
+    {
+        std::cout << "Network sink: messages from the last run are still being sent." << std::endl;
+        return false;
+    }
+
+    activeDecimation = decimation;
+    activeSendFloat = sendFloat;
+    activeSendSpikes = sendSpikes;
+    activeSendEvents = sendEvents;
+
+    activeChannels.clear();
+
+    if (getEditor() != nullptr)
+        activeChannels = getEditor()->getActiveChannels();
+
+    bitVolts.malloc(jmax(1, activeChannels.size()));
+    accumulators.calloc(jmax(1, activeChannels.size()));
+
+    for (int i = 0; i < activeChannels.size(); i++)
+        bitVolts[i] = channels[activeChannels[i]]->bitVolts;
+
+    publishedRate = (activeChannels.size() > 0 ? channels[activeChannels[0]]->sampleRate : getSampleRate())
+                    / float(activeDecimation);
+
+    decimationPhase = 0;
+    sequenceNumber = 0;
+    numSent.set(0);
+    numDropped.set(0);
+
+    // room for a full continuous message (and at least a large spike)
+    const int newSlotSize = jmax(int(NETWORK_SINK_MIN_SLOT_SIZE),
+                                 NETWORK_SINK_HEADER_SIZE + activeChannels.size() * 2
+                                 + activeChannels.size() * NETWORK_SINK_MAX_SAMPLES * 4);
+
+    for (int i = 0; i < slots.size(); i++)
+    {
+        if (newSlotSize != slotSize)
+            slots[i]->data.malloc(newSlotSize);
+
+        slots[i]->state.set(SLOT_FREE);
+    }
+
+    slotSize = newSlotSize;
+    writeIndex = 0;
+    readIndex = 0;
+
+    startThread();
+
+    return true;
+}
+
+bool NetworkSink::disable()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread(2000);
+
+    return true;
+}
+
+void NetworkSink::run()
+{
+
+    void* publisher = nullptr;
+
+#ifdef ZEROMQ
+
+    if (context != nullptr)
+    {
+        publisher = zmq_socket(context, ZMQ_PUB);
+
+        // never block: a subscriber that falls behind loses messages instead
+        int highWaterMark = NETWORK_SINK_HIGH_WATER_MARK;
+        zmq_setsockopt(publisher, ZMQ_SNDHWM, &highWaterMark, sizeof(highWaterMark));
+
+        int linger = 0;
+        zmq_setsockopt(publisher, ZMQ_LINGER, &linger, sizeof(linger));
+
+        String url = "tcp://*:" + String(port);
+
+        if (zmq_bind(publisher, url.toRawUTF8()) != 0)
+        {
+            std::cout << "Network sink could not bind to " << url << ": "
+                      << zmq_strerror(zmq_errno()) << std::endl;
+
+            zmq_close(publisher);
+            publisher = nullptr;
+        }
+    }
+
+#endif
+
+    {
+        const ScopedLock sl(statusLock);
+        status = (publisher != nullptr) ? "Publishing on port " + String(port) : "Not connected";
+    }
+
+    while (!threadShouldExit())
+    {
+        wait(100);
+
+        while (slots[readIndex]->state.get() == SLOT_READY)
+        {
+            Slot* slot = slots[readIndex];
+            slot->state.set(SLOT_SENDING);
+
+            bool sent = false;
+
+#ifdef ZEROMQ
+            if (publisher != nullptr)
+            {
+                // ZeroMQ sends straight from the slot and calls releaseSlot() when it's done
+                zmq_msg_t message;
+                zmq_msg_init_data(&message, slot->data, slot->numBytes, releaseSlot, slot);
+
+                if (zmq_msg_send(&message, publisher, ZMQ_DONTWAIT) >= 0)
+                    sent = true;
+                else
+                    zmq_msg_close(&message); // releases the slot
+            }
+            else
+#endif
+            {
+                slot->state.set(SLOT_FREE);
+            }
+
+            if (sent)
+                ++numSent;
+            else
+                ++numDropped;
+
+            readIndex = (readIndex + 1) % slots.size();
+        }
+    }
+
+#ifdef ZEROMQ
+    if (publisher != nullptr)
+        zmq_close(publisher);
+#endif
+
+    const ScopedLock sl(statusLock);
+    status = "Stopped";
+
+}
+
+void NetworkSink::releaseSlot(void* data, void* hint)
+{
+    ((Slot*) hint)->state.set(SLOT_FREE);
+}
+
+NetworkSink::Slot* NetworkSink::claimSlot()
+{
+    Slot* slot = slots[writeIndex];
+
+    if (slot->state.get() != SLOT_FREE)
+    {
+        // leave a gap in the sequence numbers so that subscribers notice
+        sequenceNumber++;
+        ++numDropped;
+        return nullptr;
+    }
+
+    return slot;
+}
+
+void NetworkSink::publishSlot(Slot* slot, int numBytes)
+{
+    slot->numBytes = numBytes;
+    slot->state.set(SLOT_READY);
+
+    writeIndex = (writeIndex + 1) % slots.size();
+    sequenceNumber++;
+
+    notify();
+}
+
+void NetworkSink::writeHeader(uint8* dest, uint8 type, uint8 format, int numChannels,
+                              int numSamples, float rate, int64 timestamp)
+{
+    NetworkMessageHeader header;
+    header.type = type;
+    header.format = format;
+    header.numChannels = (uint16) numChannels;
+    header.numSamples = (uint32) numSamples;
+    header.sequenceNumber = sequenceNumber;
+    header.sampleRate = rate;
+    header.timestamp = timestamp;
+
+    header.write(dest);
+}
+
+void NetworkSink::process(AudioSampleBuffer& buffer, MidiBuffer& events)
+{
+    blockTimestamp = activeChannels.size() > 0 ? getTimestamp(activeChannels[0]) : getTimestamp(0);
+
+    if (activeSendSpikes || activeSendEvents)
+        checkForEvents(events);
+
+    if (activeChannels.size() > 0)
+        sendContinuous(buffer, getNumSamples(activeChannels[0]));
+}
+
+void NetworkSink::sendContinuous(AudioSampleBuffer& buffer, int numSamples)
+{
+    const int numChannels = activeChannels.size();
+    const int bytesPerSample = activeSendFloat ? 4 : 2;
+
+    int start = 0;
+
+    while (start < numSamples)
+    {
+        // at most NETWORK_SINK_MAX_SAMPLES published samples per message
+        const int chunk = jmin(numSamples - start,
+                               NETWORK_SINK_MAX_SAMPLES * activeDecimation - decimationPhase);
+        const int numOut = (decimationPhase + chunk) / activeDecimation;
+
+        // the averages still have to be kept up to date if the message is dropped
+        Slot* slot = (numOut > 0) ? claimSlot() : nullptr;
+        uint8* samples = nullptr;
+
+        if (slot != nullptr)
+        {
+            uint8* indices = slot->data + NETWORK_SINK_HEADER_SIZE;
+
+            for (int c = 0; c < numChannels; c++)
+            {
+                const uint16 index = (uint16) activeChannels[c];
+                memcpy(indices + c * 2, &index, 2);
+            }
+
+            samples = indices + numChannels * 2;
+        }
+
+        int phase = decimationPhase;
+
+        for (int c = 0; c < numChannels; c++)
+        {
+            const float* src = buffer.getReadPointer(activeChannels[c], start);
+            uint8* dest = (samples != nullptr) ? samples + c * numOut * bytesPerSample : nullptr;
+
+            float sum = accumulators[c];
+            phase = decimationPhase;
+
+            for (int i = 0; i < chunk; i++)
+            {
+                sum += src[i];
+
+                if (++phase == activeDecimation)
+                {
+                    const float value = sum / float(activeDecimation);
+
+                    if (dest != nullptr)
+                    {
+                        if (activeSendFloat)
+                        {
+                            memcpy(dest, &value, 4);
+                        }
+                        else
+                        {
+                            const int16 v = (int16) jlimit(-32768, 32767, roundFloatToInt(value / bitVolts[c]));
+                            memcpy(dest, &v, 2);
+                        }
+
+                        dest += bytesPerSample;
+                    }
+
+                    sum = 0;
+                    phase = 0;
+                }
+            }
+
+            accumulators[c] = sum;
+        }
+
+        if (slot != nullptr)
+        {
+            writeHeader(slot->data, CONTINUOUS_MESSAGE, activeSendFloat ? 1 : 0,
+                        numChannels, numOut, publishedRate,
+                        blockTimestamp + start - decimationPhase);
+
+            publishSlot(slot, NETWORK_SINK_HEADER_SIZE + numChannels * 2
+                        + numChannels * numOut * bytesPerSample);
+        }
+
+        decimationPhase = phase;
+        start += chunk;
+    }
+}
+
+void NetworkSink::handleEvent(int eventType, MidiMessage& event, int samplePosition)
+{
+    const uint8* dataptr = event.getRawData();
+    const int numBytes = event.getRawDataSize();
+
+    if (eventType == SPIKE && activeSendSpikes)
+    {
+        // the ticket at the end of the event only means something in this GUI
+        const int packedBytes = numBytes - SPIKE_TICKET_SIZE;
+
+        if (packedBytes < SPIKE_METADATA_SIZE ||
+            NETWORK_SINK_HEADER_SIZE + packedBytes > slotSize)
+        {
+            sequenceNumber++;
+            ++numDropped;
+            return;
+        }
+
+        Slot* slot = claimSlot();
+
+        if (slot == nullptr)
+            return;
+
+        // the event already holds the packed spike
+        uint16 nChannels, nSamples;
+        int64 timestamp;
+        memcpy(&timestamp, dataptr + 1, 8);
+        memcpy(&nChannels, dataptr + 19, 2);
+        memcpy(&nSamples, dataptr + 21, 2);
+
+        memcpy(slot->data + NETWORK_SINK_HEADER_SIZE, dataptr, packedBytes);
+
+        writeHeader(slot->data, SPIKE_MESSAGE, 0, nChannels, nSamples,
+                    publishedRate * activeDecimation, timestamp);
+
+        publishSlot(slot, NETWORK_SINK_HEADER_SIZE + packedBytes);
+    }
+    else if (eventType == TTL && activeSendEvents)
+    {
+        Slot* slot = claimSlot();
+
+        if (slot == nullptr)
+            return;
+
+        uint8* payload = slot->data + NETWORK_SINK_HEADER_SIZE;
+        payload[0] = dataptr[2]; // event ID
+        payload[1] = dataptr[3]; // event channel
+        payload[2] = dataptr[1]; // source node ID
+        payload[3] = 0;
+
+        writeHeader(slot->data, EVENT_MESSAGE, 0, 0, 0,
+                    publishedRate * activeDecimation, blockTimestamp + samplePosition);
+
+        publishSlot(slot, NETWORK_SINK_HEADER_SIZE + 4);
+    }
+}
+
+void NetworkSink::saveCustomParametersToXml(XmlElement* parentElement)
+{
+    XmlElement* mainNode = parentElement->createNewChildElement("NETWORKSINK");
+    mainNode->setAttribute("port", port);
+    mainNode->setAttribute("decimation", decimation);
+    mainNode->setAttribute("float", sendFloat);
+    mainNode->setAttribute("spikes", sendSpikes);
+    mainNode->setAttribute("events", sendEvents);
+}
+
+void NetworkSink::loadCustomParametersFromXml()
+{
+
+    if (parametersAsXml != nullptr)
+    {
+        forEachXmlChildElement(*parametersAsXml, mainNode)
+        {
+            if (mainNode->hasTagName("NETWORKSINK"))
+            {
+                setPort(mainNode->getIntAttribute("port", NETWORK_SINK_DEFAULT_PORT));
+                setDecimation(mainNode->getIntAttribute("decimation", 1));
+                setSendFloat(mainNode->getBoolAttribute("float", false));
+                setSendSpikes(mainNode->getBoolAttribute("spikes", true));
+                setSendEvents(mainNode->getBoolAttribute("events", true));
+            }
+        }
+    }
+
+    NetworkSinkEditor* ed = (NetworkSinkEditor*) getEditor();
+
+    if (ed != nullptr)
+        ed->updateSettings();
+}
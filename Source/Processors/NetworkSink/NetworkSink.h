@@ -0,0 +1,254 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __NETWORKSINK_H_3A9C51E7__
+#define __NETWORKSINK_H_3A9C51E7__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../GenericProcessor/GenericProcessor.h"
+
+#define NETWORK_SINK_DEFAULT_PORT 5557
+#define NETWORK_SINK_NUM_SLOTS 64         // messages that can wait for the send thread
+#define NETWORK_SINK_MAX_SAMPLES 1024     // samples per channel in one continuous message
+#define NETWORK_SINK_MIN_SLOT_SIZE 16384  // bytes; also bounds the size of a spike message
+#define NETWORK_SINK_HIGH_WATER_MARK 256  // messages queued per subscriber before new ones are dropped
+#define NETWORK_SINK_HEADER_SIZE 24
+
+/**
+
+  The header at the start of every message published by a NetworkSink
+  (see below for the layout). Also used by NetworkStreamThread to read
+  the messages back.
+
+*/
+
+struct NetworkMessageHeader
+{
+    uint8 type;
+    uint8 format;
+    uint16 numChannels;
+    uint32 numSamples;
+    uint32 sequenceNumber;
+    float sampleRate;
+    int64 timestamp;
+
+    void write(uint8* dest) const
+    {
+        dest[0] = type;
+        dest[1] = format;
+        memcpy(dest + 2, &numChannels, 2);
+        memcpy(dest + 4, &numSamples, 4);
+        memcpy(dest + 8, &sequenceNumber, 4);
+        memcpy(dest + 12, &sampleRate, 4);
+        memcpy(dest + 16, &timestamp, 8);
+    }
+
+    /** Returns false if the message is too short to hold a header. */
+    bool read(const uint8* src, int numBytes)
+    {
+        if (numBytes < NETWORK_SINK_HEADER_SIZE)
+            return false;
+
+        type = src[0];
+        format = src[1];
+        memcpy(&numChannels, src + 2, 2);
+        memcpy(&numSamples, src + 4, 4);
+        memcpy(&sequenceNumber, src + 8, 4);
+        memcpy(&sampleRate, src + 12, 4);
+        memcpy(&timestamp, src + 16, 8);
+
+        return true;
+    }
+};
+
+/**
+
+  Publishes continuous data, spikes and TTL events over a ZeroMQ PUB socket.
+
+  Every message starts with a 24-byte little-endian header:
+
+      0  uint8   message type (0 = continuous, 1 = spike, 2 = TTL event)
+      1  uint8   sample format (0 = int16 in bit-volt units, 1 = float32 in microvolts)
+      2  uint16  number of channels
+      4  uint32  number of samples per channel
+      8  uint32  sequence number (gaps mean dropped messages)
+     12  float   sample rate after decimation
+     16  int64   timestamp of the first sample
+
+  followed by the payload:
+
+  - continuous: the channel indices (uint16 each), then the samples
+    channel after channel.
+  - spike: the spike, packed as by packSpike().
+  - TTL event: event ID, event channel, source node ID and one unused byte.
+
+  Since the message type is the first byte, subscribers can filter on it
+  (e.g. subscribe to "\x01" for spikes only).
+
+  The audio thread writes each message into a preallocated slot and hands
+  it to a send thread; ZeroMQ sends straight from the slot and returns it
+  when it's done. If all slots are in use, or a subscriber has
+  NETWORK_SINK_HIGH_WATER_MARK messages queued, new messages are dropped
+  instead of blocking acquisition.
+
+  Settings changed during acquisition take effect the next time
+  acquisition starts.
+
+  @see GenericProcessor, NetworkSinkEditor
+
+*/
+
+class NetworkSink : public GenericProcessor,
+                    public Thread
+{
+public:
+
+    NetworkSink();
+    ~NetworkSink();
+
+    AudioProcessorEditor* createEditor();
+
+    bool isSink()
+    {
+        return true;
+    }
+
+    void process(AudioSampleBuffer& buffer, MidiBuffer& events);
+
+    void handleEvent(int eventType, MidiMessage& event, int samplePosition);
+
+    void setParameter(int parameterIndex, float newValue);
+
+    /** Opens the socket and starts the send thread. */
+    bool enable();
+
+    /** Stops the send thread and closes the socket. */
+    bool disable();
+
+    /** Sends the messages written by the audio thread. */
+    void run();
+
+    void setPort(int port);
+    int getPort();
+
+    /** Averages this many samples into each published sample. */
+    void setDecimation(int factor);
+    int getDecimation();
+
+    void setSendFloat(bool shouldSendFloat);
+    bool getSendFloat();
+
+    void setSendSpikes(bool shouldSendSpikes);
+    bool getSendSpikes();
+
+    void setSendEvents(bool shouldSendEvents);
+    bool getSendEvents();
+
+    int getNumSent();
+    int getNumDropped();
+
+    /** Describes the socket state for the editor. */
+    String getStatus();
+
+    void saveCustomParametersToXml(XmlElement* parentElement);
+    void loadCustomParametersFromXml();
+
+    enum MessageType
+    {
+        CONTINUOUS_MESSAGE = 0,
+        SPIKE_MESSAGE = 1,
+        EVENT_MESSAGE = 2
+    };
+
+private:
+
+    enum SlotState
+    {
+        SLOT_FREE = 0,
+        SLOT_READY,
+        SLOT_SENDING
+    };
+
+    struct Slot
+    {
+        HeapBlock<uint8> data;
+        int numBytes;
+        Atomic<int> state;
+    };
+
+    /** Returns the next slot if it is free, or nullptr (and counts a drop). */
+    Slot* claimSlot();
+
+    /** Passes the claimed slot to the send thread. */
+    void publishSlot(Slot* slot, int numBytes);
+
+    void writeHeader(uint8* dest, uint8 type, uint8 format, int numChannels,
+                     int numSamples, float rate, int64 timestamp);
+
+    void sendContinuous(AudioSampleBuffer& buffer, int numSamples);
+
+    /** Called by ZeroMQ once it no longer needs a slot. */
+    static void releaseSlot(void* data, void* hint);
+
+    /** Waits for ZeroMQ to give back every slot. */
+    bool waitForSlots(int timeoutMs);
+
+    OwnedArray<Slot> slots;
+    int slotSize;
+    int writeIndex;
+    int readIndex;
+
+    // settings, and the copies used while acquiring
+    int port;
+    int decimation;
+    bool sendFloat;
+    bool sendSpikes;
+    bool sendEvents;
+
+    int activeDecimation;
+    bool activeSendFloat;
+    bool activeSendSpikes;
+    bool activeSendEvents;
+
+    Array<int> activeChannels;
+    HeapBlock<float> bitVolts;
+    HeapBlock<float> accumulators;
+    int decimationPhase;
+    float publishedRate;
+
+    int64 blockTimestamp;
+    uint32 sequenceNumber;
+
+    Atomic<int> numSent;
+    Atomic<int> numDropped;
+
+    void* context;
+    String status;
+    CriticalSection statusLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NetworkSink);
+
+};
+
+
+#endif  // __NETWORKSINK_H_3A9C51E7__
@@ -0,0 +1,179 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "NetworkSinkEditor.h"
+#include "NetworkSink.h"
+
+#include <stdio.h>
+
+NetworkSinkEditor::NetworkSinkEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors=true)
+    : GenericEditor(parentNode, useDefaultParameterEditors), statusTimer(this)
+
+{
+    desiredWidth = 180;
+
+    sink = (NetworkSink*) parentNode;
+
+    portLabel = new Label("Port", "Port:");
+    portLabel->setFont(Font("Small Text", 13, Font::plain));
+    portLabel->setBounds(10,28,45,20);
+    portLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(portLabel);
+
+    portValue = new Label("Port value", String(sink->getPort()));
+    portValue->setFont(Font("Default", 15, Font::plain));
+    portValue->setBounds(55,28,70,20);
+    portValue->setColour(Label::textColourId, Colours::white);
+    portValue->setColour(Label::backgroundColourId, Colours::grey);
+    portValue->setEditable(true);
+    portValue->addListener(this);
+    addAndMakeVisible(portValue);
+
+    decimationSelector = new ComboBox("Decimation");
+    decimationSelector->setBounds(10,55,75,20);
+    decimationSelector->addListener(this);
+
+    for (int i = 0; i < 6; i++)
+        decimationSelector->addItem("1:" + String(1 << i), (1 << i)); // id = decimation factor
+
+    decimationSelector->setTooltip("Number of samples averaged into each published sample");
+    addAndMakeVisible(decimationSelector);
+
+    formatSelector = new ComboBox("Format");
+    formatSelector->setBounds(95,55,75,20);
+    formatSelector->addListener(this);
+    formatSelector->addItem("int16", 1);
+    formatSelector->addItem("float", 2);
+    formatSelector->setTooltip("Publish samples as int16 bit-volt units or float microvolts");
+    addAndMakeVisible(formatSelector);
+
+    spikeButton = new UtilityButton("Spikes", Font("Small Text", 13, Font::plain));
+    spikeButton->setRadius(3.0f);
+    spikeButton->setBounds(10,82,75,18);
+    spikeButton->addListener(this);
+    spikeButton->setClickingTogglesState(true);
+    spikeButton->setTooltip("Publish incoming spikes");
+    addAndMakeVisible(spikeButton);
+
+    eventButton = new UtilityButton("Events", Font("Small Text", 13, Font::plain));
+    eventButton->setRadius(3.0f);
+    eventButton->setBounds(95,82,75,18);
+    eventButton->addListener(this);
+    eventButton->setClickingTogglesState(true);
+    eventButton->setTooltip("Publish incoming TTL events");
+    addAndMakeVisible(eventButton);
+
+    statusLabel = new Label("Status", "Stopped");
+    statusLabel->setFont(Font("Small Text", 11, Font::plain));
+    statusLabel->setBounds(10,105,165,18);
+    statusLabel->setColour(Label::textColourId, Colours::darkgrey);
+    addAndMakeVisible(statusLabel);
+
+    updateSettings();
+
+}
+
+NetworkSinkEditor::~NetworkSinkEditor()
+{
+
+}
+
+void NetworkSinkEditor::updateSettings()
+{
+    portValue->setText(String(sink->getPort()), dontSendNotification);
+    decimationSelector->setSelectedId(sink->getDecimation(), dontSendNotification);
+    formatSelector->setSelectedId(sink->getSendFloat() ? 2 : 1, dontSendNotification);
+    spikeButton->setToggleState(sink->getSendSpikes(), dontSendNotification);
+    eventButton->setToggleState(sink->getSendEvents(), dontSendNotification);
+}
+
+void NetworkSinkEditor::buttonEvent(Button* button)
+{
+    if (button == spikeButton)
+    {
+        sink->setSendSpikes(spikeButton->getToggleState());
+    }
+    else if (button == eventButton)
+    {
+        sink->setSendEvents(eventButton->getToggleState());
+    }
+}
+
+void NetworkSinkEditor::comboBoxChanged(ComboBox* comboBox)
+{
+    if (comboBox == decimationSelector)
+    {
+        sink->setDecimation(decimationSelector->getSelectedId());
+    }
+    else if (comboBox == formatSelector)
+    {
+        sink->setSendFloat(formatSelector->getSelectedId() == 2);
+    }
+}
+
+void NetworkSinkEditor::labelTextChanged(Label* label)
+{
+    if (label == portValue)
+    {
+        int port = label->getText().getIntValue();
+
+        if (port > 0 && port < 65536)
+            sink->setPort(port);
+        else
+            label->setText(String(sink->getPort()), dontSendNotification);
+    }
+}
+
+void NetworkSinkEditor::startAcquisition()
+{
+    GenericEditor::startAcquisition();
+
+    portValue->setEditable(false);
+    decimationSelector->setEnabled(false);
+    formatSelector->setEnabled(false);
+
+    statusTimer.startTimer(500);
+}
+
+void NetworkSinkEditor::stopAcquisition()
+{
+    GenericEditor::stopAcquisition();
+
+    statusTimer.stopTimer();
+    updateStatus();
+
+    portValue->setEditable(true);
+    decimationSelector->setEnabled(true);
+    formatSelector->setEnabled(true);
+}
+
+void NetworkSinkEditor::updateStatus()
+{
+    String text = sink->getStatus();
+
+    if (sink->getNumSent() > 0 || sink->getNumDropped() > 0)
+        text += " (" + String(sink->getNumSent()) + " sent, " + String(sink->getNumDropped()) + " dropped)";
+
+    statusLabel->setText(text, dontSendNotification);
+    statusLabel->setTooltip(text);
+}
@@ -0,0 +1,93 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __NETWORKSINKEDITOR_H_C47E0B92__
+#define __NETWORKSINKEDITOR_H_C47E0B92__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../Editors/GenericEditor.h"
+
+class NetworkSink;
+
+/**
+
+  User interface for the NetworkSink processor.
+
+  The channels to publish are chosen in the channel selector drawer.
+
+  @see NetworkSink
+
+*/
+
+class NetworkSinkEditor : public GenericEditor,
+                          public ComboBox::Listener,
+                          public Label::Listener
+{
+public:
+    NetworkSinkEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors);
+    virtual ~NetworkSinkEditor();
+
+    void buttonEvent(Button* button);
+    void comboBoxChanged(ComboBox* comboBox);
+    void labelTextChanged(Label* label);
+
+    /** Shows the processor's current settings. */
+    void updateSettings();
+
+    void startAcquisition();
+    void stopAcquisition();
+
+private:
+
+    void updateStatus();
+
+    /** Refreshes the status line during acquisition (GenericEditor's own timer is used for fading). */
+    class StatusTimer : public Timer
+    {
+    public:
+        StatusTimer(NetworkSinkEditor* e) : editor(e) {}
+        void timerCallback()
+        {
+            editor->updateStatus();
+        }
+    private:
+        NetworkSinkEditor* editor;
+    };
+
+    NetworkSink* sink;
+    StatusTimer statusTimer;
+
+    ScopedPointer<Label> portLabel;
+    ScopedPointer<Label> portValue;
+    ScopedPointer<ComboBox> decimationSelector;
+    ScopedPointer<ComboBox> formatSelector;
+    ScopedPointer<UtilityButton> spikeButton;
+    ScopedPointer<UtilityButton> eventButton;
+    ScopedPointer<Label> statusLabel;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NetworkSinkEditor);
+
+};
+
+
+#endif  // __NETWORKSINKEDITOR_H_C47E0B92__
@@ -263,12 +263,12 @@ void PeriStimulusTimeHistogramNode::dumpSpikeEventToDisk(SpikeObject *s, bool du
 	fwrite(&s->nChannels, 2,1, eventFile);
 
 	// 7. gains
-	fwrite(&s->gain, 4,s->nChannels, eventFile);
+	fwrite(s->gain, 4,s->nChannels, eventFile);
 
 	// 8. num data points per channel
 	fwrite(&s->nSamples, 2,1, eventFile);
 	if (dumpWave)
-		fwrite(&s->data, 2,s->nSamples*s->nChannels, eventFile);
+		fwrite(s->data, 2,s->nSamples*s->nChannels, eventFile);
 
 	
 }
@@ -489,20 +489,22 @@ void PeriStimulusTimeHistogramNode::handleEvent(int eventType, MidiMessage& even
         int bufferSize = event.getRawDataSize();
         if (bufferSize > 0)
         {
-            SpikeObject newSpike;
-            unpackSpike(&newSpike, dataptr, bufferSize);
+            SpikeHandle newSpike = unpackSpikeEvent(dataptr, bufferSize);
 
-			if (newSpike.sortedId > 0) { // drop unsorted spikes
-				trialCircularBuffer->addSpikeToSpikeBuffer(newSpike);
+            if (newSpike.isNull())
+                return;
+
+			if (newSpike->sortedId > 0) { // drop unsorted spikes
+				trialCircularBuffer->addSpikeToSpikeBuffer(*newSpike);
 			}
 			if (isRecording)
 			{
-				if  (spikeSavingMode == 1 && newSpike.sortedId > 0)
-					dumpSpikeEventToDisk(&newSpike, false);
-				else if (spikeSavingMode == 2 && newSpike.sortedId > 0)
-					dumpSpikeEventToDisk(&newSpike, true);
+				if  (spikeSavingMode == 1 && newSpike->sortedId > 0)
+					dumpSpikeEventToDisk(newSpike.get(), false);
+				else if (spikeSavingMode == 2 && newSpike->sortedId > 0)
+					dumpSpikeEventToDisk(newSpike.get(), true);
 				else if (spikeSavingMode == 3)
-					dumpSpikeEventToDisk(&newSpike, true);
+					dumpSpikeEventToDisk(newSpike.get(), true);
 			}
         }
     }
@@ -98,7 +98,95 @@ void setDefaultColors(uint8 &R, uint8 &G, uint8 &B, int ID)
 
 
 /******************************/
-PSTH::PSTH(int ID, TrialCircularBufferParams params_, bool vis) : conditionID(ID),params(params_),numTrials(0),visible(vis)
+PSTHSmoother::PSTHSmoother() : sigma(0), recursive(false), B(1), b1(0), b2(0), b3(0)
+{
+	kernel.push_back(1.0f);
+}
+
+void PSTHSmoother::setStandardDeviation(float sigmaBins)
+{
+	if (sigmaBins == sigma)
+		return;
+
+	sigma = sigmaBins;
+	recursive = sigma >= PSTH_RECURSIVE_SMOOTHING_MIN_SIGMA;
+	if (recursive)
+	{
+		// Young & van Vliet, "Recursive implementation of the Gaussian filter", 1995
+		double q = 0.98711 * sigma - 0.96330;
+		double q2 = q * q, q3 = q2 * q;
+		double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+		b1 = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+		b2 = -(1.4281 * q2 + 1.26661 * q3) / b0;
+		b3 = 0.422205 * q3 / b0;
+		B = 1.0 - (b1 + b2 + b3);
+	} else
+	{
+		int zeroIndex = (int)(sigma * 3.5); // +- 3.5 standard deviations.
+		kernel.resize(2 * zeroIndex + 1);
+		float sumZ = 0;
+		for (int k = 0; k < kernel.size(); k++)
+		{
+			float z = float(k - zeroIndex);
+			kernel[k] = (sigma > 0) ? exp(-(z * z) / (2 * sigma * sigma)) : 1.0f;
+			sumZ += kernel[k];
+		}
+		// normalize kernel
+		for (int k = 0; k < kernel.size(); k++)
+		{
+			kernel[k] /= sumZ;
+		}
+	}
+}
+
+void PSTHSmoother::smooth(const float *y, int numPoints, float *out)
+{
+	if (!recursive)
+	{
+		int zeroIndex = (kernel.size() - 1) / 2;
+		for (int k = 0; k < numPoints; k++)
+		{
+			int jmin = (k - zeroIndex < 0) ? -k : -zeroIndex;
+			int jmax = (k + zeroIndex >= numPoints) ? numPoints - 1 - k : zeroIndex;
+			float response = 0;
+			for (int j = jmin; j <= jmax; j++)
+				response += y[k + j] * kernel[j + zeroIndex];
+			out[k] = response;
+		}
+		return;
+	}
+
+	// the causal pass runs past the end of the curve, so that the anti-causal
+	// pass starts from (practically) zero state.
+	int numPadded = numPoints + (int)ceil(4 * sigma);
+	forwardPass.resize(numPadded);
+
+	double w1 = 0, w2 = 0, w3 = 0;
+	for (int k = 0; k < numPadded; k++)
+	{
+		double x = (k < numPoints) ? y[k] : 0.0;
+		double w = B * x + b1 * w1 + b2 * w2 + b3 * w3;
+		forwardPass[k] = w;
+		w3 = w2;
+		w2 = w1;
+		w1 = w;
+	}
+
+	double v1 = 0, v2 = 0, v3 = 0;
+	for (int k = numPadded - 1; k >= 0; k--)
+	{
+		double v = B * forwardPass[k] + b1 * v1 + b2 * v2 + b3 * v3;
+		if (k < numPoints)
+			out[k] = v;
+		v3 = v2;
+		v2 = v1;
+		v1 = v;
+	}
+}
+
+/******************************/
+PSTH::PSTH(int ID, TrialCircularBufferParams params_, bool vis) : conditionID(ID),params(params_),numTrials(0),visible(vis),
+	prevTrialsHead(0), numPrevTrials(0), averageDirty(false), smoothedDirty(true), smoothedSigmaMS(0)
 {
 	// if approximate is on, we won't sample exactly xmin and xmax
 	if (params.approximate)
@@ -152,6 +240,13 @@ PSTH::PSTH(int ID, TrialCircularBufferParams params_, bool vis) : conditionID(ID
 		}
 		dx = binTime[1]-binTime[0];
 	}
+	binSums.resize(numBins);
+	coverageCounts.resize(numBins+1);
+	for (int k = 0; k < numBins; k++)
+		binSums[k] = 0;
+	for (int k = 0; k <= numBins; k++)
+		coverageCounts[k] = 0;
+
 	xmin = -mod_pre_sec;
 	xmax = mod_post_sec;
 	ymax = -1e10;
@@ -176,7 +271,16 @@ PSTH::PSTH(const PSTH& c)
 	numBins = c.numBins;
 	avgResponse=c.avgResponse;
 	prevTrials = c.prevTrials;
+	prevTrialsHead = c.prevTrialsHead;
+	numPrevTrials = c.numPrevTrials;
 	numDataPoints=c.numDataPoints;
+	binSums = c.binSums;
+	coverageCounts = c.coverageCounts;
+	averageDirty = c.averageDirty;
+	smoothedDirty = c.smoothedDirty;
+	smoothedSigmaMS = c.smoothedSigmaMS;
+	smoothedResponse = c.smoothedResponse;
+	smoother = c.smoother;
 	timeSpanSecs = c.timeSpanSecs;
 	binTime = c.binTime;
 	xmin = c.xmin;
@@ -207,131 +311,191 @@ void PSTH::clear()
 	{
 		numDataPoints[k] = 0;
 		avgResponse[k] = 0;
+		binSums[k] = 0;
 	}
-	
+	for (int k = 0; k <= numBins; k++)
+		coverageCounts[k] = 0;
+
+	averageDirty = false;
+	smoothedDirty = true;
 }
 
-void PSTH::updatePSTH(SmartSpikeCircularBuffer *spikeBuffer, Trial *trial)
+void PSTH::refreshAverage()
 {
+	if (!averageDirty)
+		return;
 
-	tictoc.Tic(16);
-	Time t;
-	float ticksPerSec =t.getHighResolutionTicksPerSecond();
-
-	tictoc.Tic(30);
-	std::vector<int64> alignedSpikes = spikeBuffer->getAlignedSpikes(trial, mod_pre_sec, mod_post_sec);
-	tictoc.Toc(31);
-
-	tictoc.Tic(32);
-	std::vector<float> instantaneousSpikesRate;
-	instantaneousSpikesRate.resize(numBins);
-	for (int k = 0; k < numBins; k++)
-	{
-		instantaneousSpikesRate[k] = 0;
-	}
-
-	for (int k=0;k<alignedSpikes.size();k++)
+	// a bin is covered by all trials that covered at least one bin after it
+	ymax = -1e10;
+	ymin = 1e10;
+	int covered = 0;
+	for (int k = numBins-1; k >= 0; k--)
 	{
-		// spike times are aligned relative to trial alignment (i.e.) , onset is at "0"
-		// convert ticks back to seconds, then to bins.
-		float spikeTimeSec = float(alignedSpikes[k]) / ticksPerSec;
-
-		int binIndex = (spikeTimeSec +mod_pre_sec) / timeSpanSecs * numBins;
-		if (binIndex >= 0 && binIndex < numBins)
+		covered += coverageCounts[k+1];
+		numDataPoints[k] = covered;
+		if (covered > 0)
+		{
+			avgResponse[k] = binSums[k] / covered;
+			ymax = MAX(ymax,avgResponse[k]);
+			ymin = MIN(ymin,avgResponse[k]);
+		} else
 		{
-			instantaneousSpikesRate[binIndex] += 1.0;
+			avgResponse[k] = 0;
 		}
 	}
+	averageDirty = false;
+}
+
+double PSTH::getPreSec() const
+{
+	return mod_pre_sec;
+}
+
+double PSTH::getPostSec() const
+{
+	return mod_post_sec;
+}
+
+float* PSTH::storeTrial()
+{
+	// returns the slot for the newest trial, overwriting the oldest one once
+	// maxTrialsInMemory trials were stored.
+	int maxTrials = params.maxTrialsInMemory > 0 ? params.maxTrialsInMemory : 1;
+	if (numPrevTrials > 0)
+		prevTrialsHead = (prevTrialsHead + 1) % maxTrials;
+
+	if ((prevTrialsHead + 1) * numBins > prevTrials.size())
+		prevTrials.resize((prevTrialsHead + 1) * numBins);
+
+	if (numPrevTrials < maxTrials)
+		numPrevTrials++;
+
+	return &prevTrials[prevTrialsHead * numBins];
+}
+
+void PSTH::updatePSTH(const std::vector<int64> &alignedSpikes, Trial *trial)
+{
+
+	tictoc.Tic(16);
+	double ticksPerSec = Time::getHighResolutionTicksPerSecond();
+
+	tictoc.Tic(32);
+	// the instantaneous rate is written straight into the trial history
+	float *instantaneousSpikesRate = storeTrial();
+	std::fill(instantaneousSpikesRate, instantaneousSpikesRate + numBins, 0.0f);
 
 	float lastUpdateTS = float(trial->endTS-trial->alignTS) / ticksPerSec + mod_post_sec;
 	int lastBinIndex = (int)( (lastUpdateTS + mod_pre_sec) / timeSpanSecs * numBins);
-
+	if (lastBinIndex < 0)
+		lastBinIndex = 0;
+	if (lastBinIndex > numBins)
+		lastBinIndex = numBins;
 
 	xmax = MAX(xmax,lastUpdateTS);
 
+	// spike times are aligned relative to trial alignment (i.e.) , onset is at "0"
+	// convert ticks straight to bins.
+	float scale = 1000.0;
+	double preTicks = mod_pre_sec * ticksPerSec;
+	double binsPerTick = numBins / (timeSpanSecs * ticksPerSec);
+	for (int k=0;k<alignedSpikes.size();k++)
+	{
+		double ticksFromStart = alignedSpikes[k] + preTicks;
+		if (ticksFromStart < 0)
+			continue;
 
-	numTrials++;
-	// Update average firing rate, up to when the trial ended. 
-	ymax = -1e10;
-	ymin = 1e10;
+		int binIndex = (int)(ticksFromStart * binsPerTick);
+		if (binIndex >= numBins)
+			break; // spikes are sorted
 
-	 float scale = 1000.0;
-	for (int k = 0; k < lastBinIndex; k++)
-	{
-		numDataPoints[k]++;
-		avgResponse[k] = ((numDataPoints[k] - 1) * avgResponse[k] + scale*instantaneousSpikesRate[k]) / numDataPoints[k];
-		ymax = MAX(ymax,avgResponse[k]);
-		ymin = MIN(ymin,avgResponse[k]);
+		instantaneousSpikesRate[binIndex] += 1.0;
+		// the average firing rate is only updated up to when the trial ended.
+		if (binIndex < lastBinIndex)
+			binSums[binIndex] += scale;
 	}
-	tictoc.Toc(32);
 
-	// keep existing trial
-	if (prevTrials.size()+1 > params.maxTrialsInMemory)
-	{
-		prevTrials.pop_back();
-	}
-	prevTrials.push_front(instantaneousSpikesRate);
+	numTrials++;
+	coverageCounts[lastBinIndex]++;
+	averageDirty = smoothedDirty = true;
+	tictoc.Toc(32);
 	tictoc.Toc(16);
 
 }
 
 void PSTH::getRange(float &xMin, float &xMax, float &yMin, float &yMax)
 {
+	refreshAverage();
 	xMin = xmin;
 	yMax = ymax;
 	xMax = xmax;
 	yMin = ymin;
 }
 
-void PSTH::updatePSTH(std::vector<float> alignedLFP,std::vector<bool> valid)
+void PSTH::updatePSTH(const std::vector<float> &alignedLFP, const std::vector<bool> &valid)
 {
 	
 	numTrials++;
 
-	ymax = -1e10;
-	ymin = 1e10;
 	xmin = -mod_pre_sec;
 	xmax = 0;
 
-	// Update average firing rate, up to when the trial ended. 
-	for (int k = 0; k < valid.size(); k++)
+	// Update average lfp, up to when the trial ended. 
+	int numValid = 0;
+	for (int k = 0; k < valid.size() && k < numBins; k++)
 	{
 		if (!valid[k]) {
 			xmax = MAX(xmax, binTime[k]);
 			break;
 		}
-		numDataPoints[k]++;
-		avgResponse[k] = ((numDataPoints[k] - 1) * avgResponse[k] + alignedLFP[k]) / numDataPoints[k];
-		ymax = MAX(ymax, avgResponse[k]);
-		ymin = MIN(ymin, avgResponse[k]);
+		binSums[k] += alignedLFP[k];
+		numValid++;
 	}			
+	coverageCounts[numValid]++;
+	averageDirty = smoothedDirty = true;
 	
 	// keep existing trial
-	if (prevTrials.size()+1 > params.maxTrialsInMemory)
-	{
-		prevTrials.pop_back();
-	}
-	prevTrials.push_front(alignedLFP);
+	float *lastTrial = storeTrial();
+	int numToCopy = MIN((int)alignedLFP.size(), numBins);
+	for (int k = 0; k < numToCopy; k++)
+		lastTrial[k] = alignedLFP[k];
+	for (int k = numToCopy; k < numBins; k++)
+		lastTrial[k] = 0;
 	
 }
 
-std::vector<float> PSTH::getAverageTrialResponse()
+const std::vector<float>& PSTH::getAverageTrialResponse()
 {
-	std::vector<float> tmp;
-	
-	tmp = avgResponse;
+	refreshAverage();
+	return avgResponse;
+}
 
-	return tmp;
+const std::vector<float>& PSTH::getSmoothedTrialResponse(float guassianStandardDeviationMS)
+{
+	refreshAverage();
+	if (guassianStandardDeviationMS <= 0 || numBins == 0)
+		return avgResponse;
+
+	if (smoothedDirty || guassianStandardDeviationMS != smoothedSigmaMS)
+	{
+		smoother.setStandardDeviation(guassianStandardDeviationMS / (dx * 1000.0));
+		smoothedResponse.resize(numBins);
+		smoother.smooth(&avgResponse[0], numBins, &smoothedResponse[0]);
+		smoothedSigmaMS = guassianStandardDeviationMS;
+		smoothedDirty = false;
+	}
+	return smoothedResponse;
 }
 
-std::vector<float> PSTH::getLastTrial()
+void PSTH::getLastTrial(std::vector<float> &y) const
 {
-	std::vector<float> tmp;
-	if (prevTrials.size() > 0)
+	if (numPrevTrials > 0)
 	{
-		tmp = prevTrials.front();
+		const float *lastTrial = &prevTrials[prevTrialsHead * numBins];
+		y.assign(lastTrial, lastTrial + numBins);
+	} else
+	{
+		y.clear();
 	}
-	return tmp;
 }
 
 /***********************/
@@ -478,7 +642,7 @@ ChannelPSTHs::ChannelPSTHs(int ID, TrialCircularBufferParams params_) : channelI
 	numTrials = 0;
 }
 
-void ChannelPSTHs::updateConditionsWithLFP(std::vector<int> conditionsNeedUpdating, std::vector<float> alignedLFP, std::vector<bool> valid, Trial *trial)
+void ChannelPSTHs::updateConditionsWithLFP(const std::vector<int> &conditionsNeedUpdating, const std::vector<float> &alignedLFP, const std::vector<bool> &valid, Trial *trial)
 {
 	numTrials++;
 	if (conditionsNeedUpdating.size() == 0)
@@ -642,7 +806,7 @@ void UnitPSTHs::getRange(float &xmin, float &xmax, float &ymin, float &ymax)
 }
 
 
-void UnitPSTHs::updateConditionsWithSpikes(std::vector<int> conditionsNeedUpdating, Trial* trial)
+void UnitPSTHs::updateConditionsWithSpikes(const std::vector<int> &conditionsNeedUpdating, Trial* trial)
 {
 	redrawNeeded = true;
 	numTrials++;
@@ -651,23 +815,10 @@ void UnitPSTHs::updateConditionsWithSpikes(std::vector<int> conditionsNeedUpdati
 
 	tictoc.Tic(14);
 
-	for (int k=0;k<conditionPSTHs.size();k++) {
-		for (int j=0;j<conditionsNeedUpdating.size();j++) 
-		{
-			if (conditionPSTHs[k].conditionID == conditionsNeedUpdating[j]) 
-			{
-				// this condition needs to be updated.
-				conditionPSTHs[k].updatePSTH(&spikeBuffer, trial);
-			}
-		}
-	}
-
-	
+	int modifiedTrialType = -1;
 	if (params.buildTrialsPSTH)
 	{
-		tictoc.Tic(15);
-		// update individual trial PSTH
-		int modifiedTrialType;
+		// first, make sure we have enough memory allocated to hold all these trials...
 		if (trial->type >= TTL_TRIAL_OFFSET)
 		{
 			modifiedTrialType = trial->type-TTL_TRIAL_OFFSET;
@@ -685,8 +836,39 @@ void UnitPSTHs::updateConditionsWithSpikes(std::vector<int> conditionsNeedUpdati
 				trialPSTHs.push_back(PSTH(k,params,true));
 			}
 		}
-		// now update
-		trialPSTHs[modifiedTrialType].updatePSTH(&spikeBuffer, trial);
+	}
+
+	// all PSTHs of a unit share the same params, and therefore the same
+	// pre/post window. align the spikes once and reuse them for all of them.
+	const PSTH *windowPSTH = conditionPSTHs.size() > 0 ? &conditionPSTHs[0] : 
+		(modifiedTrialType >= 0 ? &trialPSTHs[modifiedTrialType] : nullptr);
+	if (windowPSTH == nullptr)
+	{
+		tictoc.Toc(14);
+		return;
+	}
+
+	tictoc.Tic(30);
+	spikeBuffer.getAlignedSpikes(trial, windowPSTH->getPreSec(), windowPSTH->getPostSec(), alignedSpikes);
+	tictoc.Toc(30);
+
+	for (int k=0;k<conditionPSTHs.size();k++) {
+		for (int j=0;j<conditionsNeedUpdating.size();j++) 
+		{
+			if (conditionPSTHs[k].conditionID == conditionsNeedUpdating[j]) 
+			{
+				// this condition needs to be updated.
+				conditionPSTHs[k].updatePSTH(alignedSpikes, trial);
+			}
+		}
+	}
+
+	
+	if (params.buildTrialsPSTH)
+	{
+		tictoc.Tic(15);
+		// update individual trial PSTH
+		trialPSTHs[modifiedTrialType].updatePSTH(alignedSpikes, trial);
 		tictoc.Toc(15);
 	}
 	tictoc.Toc(14);
@@ -754,19 +936,17 @@ void ElectrodePSTH::UpdateChannelConditionWithLFP(int ch, std::vector<int> *cond
 }
 
 
-void ElectrodePSTH::updateChannelsConditionsWithLFP(std::vector<int> conditionsNeedUpdate, Trial *trial, SmartContinuousCircularBuffer *lfpBuffer)
+void ElectrodePSTH::updateChannelsConditionsWithLFP(const std::vector<int> &conditionsNeedUpdate, Trial *trial, SmartContinuousCircularBuffer *lfpBuffer)
 {
 	// compute trial aligned lfp for all channels 
-	
-	std::vector<bool> valid;
-	std::vector<std::vector<float> > alignedLFP;
+	// (alignedLFP and alignedValid keep their capacity between trials)
 
 	tictoc.Tic(6);
 	// resample all electrode channels 
 
 	tictoc.Tic(18);
 	bool success = lfpBuffer->getAlignedData(channels,trial,&channelsPSTHs[0].conditionPSTHs[0].binTime,
-		channelsPSTHs[0].params, alignedLFP,valid);
+		channelsPSTHs[0].params, alignedLFP,alignedValid);
 
 	tictoc.Toc(18);
 	// now we can average data
@@ -775,7 +955,7 @@ void ElectrodePSTH::updateChannelsConditionsWithLFP(std::vector<int> conditionsN
 	{
 		for (int ch=0;ch<channelsPSTHs.size();ch++)
 			{
-				channelsPSTHs[ch].updateConditionsWithLFP(conditionsNeedUpdate, alignedLFP[ch], valid, trial);
+				channelsPSTHs[ch].updateConditionsWithLFP(conditionsNeedUpdate, alignedLFP[ch], alignedValid, trial);
 			}
 	//			ElectrodePSTHlfpJob *job = new ElectrodePSTHlfpJob(this,ch,&conditionsNeedUpdate,trial, &(alignedLFP[ch]), &valid);
 	}
@@ -791,6 +971,7 @@ void ElectrodePSTH::updateChannelsConditionsWithLFP(std::vector<int> conditionsN
 
 void SmartContinuousCircularBuffer::addTrialStartToSmartBuffer(int trialID)
 {
+	const ScopedLock myScopedLock (mut);
 	smartPointerIndex[trialptr] = ptr;
 	smartPointerTrialID[trialptr] = trialID;
 	trialptr++;
@@ -812,11 +993,14 @@ SmartContinuousCircularBuffer::SmartContinuousCircularBuffer(int NumCh, float Sa
 	}
 }
 
-bool SmartContinuousCircularBuffer::getAlignedData(std::vector<int> channels, Trial *trial, std::vector<float> *timeBins,
-												   TrialCircularBufferParams params,
+bool SmartContinuousCircularBuffer::getAlignedData(const std::vector<int> &channels, Trial *trial, const std::vector<float> *timeBins,
+												   const TrialCircularBufferParams &params,
 									std::vector<std::vector<float> > &output,
 									std::vector<bool> &valid)
 {
+	// the audio thread keeps writing to the buffer while trials are aligned on the analysis thread
+	const ScopedLock myScopedLock (mut);
+
 	if (!params.approximate) 
 	{
 		// use this for buffers with gaps
@@ -829,19 +1013,15 @@ bool SmartContinuousCircularBuffer::getAlignedData(std::vector<int> channels, Tr
 
 	int numTimeBins = timeBins->size();
 
+	// output and valid are owned by the caller and only grow the first time around
 	output.resize(channels.size());
 	valid.resize(numTimeBins);
 	for (int ch=0;ch<channels.size();ch++)
 	{
 		output[ch].resize(numTimeBins);
-
-		for (int j=0;j<numTimeBins;j++)
-			output[ch][j] = 0;
-	}
-	for (int i=0;i<numTimeBins;i++)
-	{
-		valid[i] = false;
+		std::fill(output[ch].begin(), output[ch].end(), 0.0f);
 	}
+	std::fill(valid.begin(), valid.end(), false);
 
 
 
@@ -958,7 +1138,7 @@ bool SmartContinuousCircularBuffer::getAlignedData(std::vector<int> channels, Tr
 
 			for (int ch=0;ch<channels.size();ch++)
 			{
-				float value = Buf[channels[ch]][actual_index];
+				float value = getChannel(channels[ch])[actual_index];
 				output[ch][index] =  value;
 			}
 		}
@@ -994,7 +1174,8 @@ bool SmartContinuousCircularBuffer::getAlignedData(std::vector<int> channels, Tr
 
 			for (int ch=0;ch<channels.size();ch++)
 			{
-				output[ch][i] =  Buf[channels[ch]][index1] * (1-frac) +  Buf[channels[ch]][index2] * (frac);
+				const float *chanBuf = getChannel(channels[ch]);
+				output[ch][i] =  chanBuf[index1] * (1-frac) +  chanBuf[index2] * (frac);
 			}
 
 		}
@@ -1003,7 +1184,7 @@ bool SmartContinuousCircularBuffer::getAlignedData(std::vector<int> channels, Tr
 }
 
 
-bool SmartContinuousCircularBuffer::getAlignedDataInterp(std::vector<int> channels, Trial *trial, std::vector<float> *timeBins,
+bool SmartContinuousCircularBuffer::getAlignedDataInterp(const std::vector<int> &channels, Trial *trial, const std::vector<float> *timeBins,
 												   float preSec, float postSec,
 									std::vector<std::vector<float> > &output,
 									std::vector<bool> &valid)
@@ -1011,6 +1192,7 @@ bool SmartContinuousCircularBuffer::getAlignedDataInterp(std::vector<int> channe
 	// to update a condition's continuous data psth, we will first find 
 	// data samples in the vicinity of the trial, and then interpolate at the
 	// needed time bins.
+	const ScopedLock myScopedLock (mut);
 	if (numSamplesInBuf <= 1 )
 		return false;
 
@@ -1043,19 +1225,15 @@ bool SmartContinuousCircularBuffer::getAlignedDataInterp(std::vector<int> channe
 
 	int numTimeBins = timeBins->size();
 
+	// output and valid are owned by the caller and only grow the first time around
 	output.resize(channels.size());
 	valid.resize(numTimeBins);
 	for (int ch=0;ch<channels.size();ch++)
 	{
 		output[ch].resize(numTimeBins);
-
-		for (int j=0;j<numTimeBins;j++)
-			output[ch][j] = 0;
-	}
-	for (int i=0;i<numTimeBins;i++)
-	{
-		valid[i] = false;
+		std::fill(output[ch].begin(), output[ch].end(), 0.0f);
 	}
+	std::fill(valid.begin(), valid.end(), false);
 
 	// 1. instead of searching the entire buffer, query when did the trial started....
 	int k = 0;
@@ -1155,7 +1333,8 @@ bool SmartContinuousCircularBuffer::getAlignedDataInterp(std::vector<int> channe
 		valid[i] = true;
 		for (int ch=0;ch<channels.size();ch++)
 		{
-			output[ch][i] =  Buf[channels[ch]][index] * (1-fracA) +  Buf[channels[ch]][index_next] * (fracA);
+			const float *chanBuf = getChannel(channels[ch]);
+			output[ch][i] =  chanBuf[index] * (1-fracA) +  chanBuf[index_next] * (fracA);
 		}
 		// now advance pointers if needed
 		if (i < numTimeBins-1) 
@@ -1276,14 +1455,13 @@ int SmartSpikeCircularBuffer::queryTrialStart(int ID)
 
 
 
-std::vector<int64> SmartSpikeCircularBuffer::getAlignedSpikes(Trial *trial, float preSecs, float postSecs)
+void SmartSpikeCircularBuffer::getAlignedSpikes(Trial *trial, float preSecs, float postSecs, std::vector<int64> &alignedSpikes)
 {
 	// we need to update the average firing rate with the spikes that were stored in the spike buffer.
 	// first, query spike buffer where does the trial start....
 	jassert(spikeTimesSoftware.size() > 0);
-	std::vector<int64> alignedSpikes;
-	Time t;
-	int64 ticksPerSec = t.getHighResolutionTicksPerSecond();
+	alignedSpikes.clear();
+	int64 ticksPerSec = Time::getHighResolutionTicksPerSecond();
 	int64 numTicksPreTrial =preSecs * ticksPerSec;
 	int64 numTicksPostTrial =postSecs * ticksPerSec;
 
@@ -1292,7 +1470,7 @@ std::vector<int64> SmartSpikeCircularBuffer::getAlignedSpikes(Trial *trial, floa
 
 	int saved_ptr = queryTrialStart(trial->trialID);
 	if (saved_ptr < 0)
-		return alignedSpikes; // trial is not in memory??!?
+		return; // trial is not in memory??!?
 
 
 	// return all spikes within a given interval aligned to AlignTS
@@ -1344,14 +1522,18 @@ std::vector<int64> SmartSpikeCircularBuffer::getAlignedSpikes(Trial *trial, floa
 		}
 	
 
-	std::sort(alignedSpikes.begin(),alignedSpikes.begin()+alignedSpikes.size());
-	return alignedSpikes;
+	std::sort(alignedSpikes.begin(),alignedSpikes.end());
 }
 
 /**********************/
 
 TrialCircularBuffer::~TrialCircularBuffer()
 {
+	if (analysisThread != nullptr)
+	{
+		analysisThread->stopThread(2000);
+		analysisThread = nullptr;
+	}
 	//delete lfpBuffer;
 	//lfpBuffer = nullptr;
 	//delete ttlBuffer;
@@ -1368,6 +1550,7 @@ TrialCircularBuffer::TrialCircularBuffer()
 	hardwareTriggerAlignmentChannel = -1;
 	lastSimulatedTrialTS = 0;
 	lastTrialID = 0;
+	droppedAnalysisItems = 0;
 	uniqueIntervalID = 0;
 	useThreads = true;
 }
@@ -1382,6 +1565,7 @@ TrialCircularBuffer::TrialCircularBuffer(TrialCircularBufferParams params_) : pa
 	trialCounter = 0;
 	lastSimulatedTrialTS = 0;
 	lastTrialID = 0;
+	droppedAnalysisItems = 0;
 	hardwareTriggerAlignmentChannel = -1;
 	uniqueIntervalID = 0;
 	// sampling them should be at least 600 Hz (Nyquist!)
@@ -1402,6 +1586,11 @@ TrialCircularBuffer::TrialCircularBuffer(TrialCircularBufferParams params_) : pa
 		threadpool = new ThreadPool(numCpus);
 
 	clearDesign();
+
+	pendingItems.reserve(PSTH_ANALYSIS_QUEUE_SIZE);
+	processingItems.reserve(PSTH_ANALYSIS_QUEUE_SIZE);
+	analysisThread = new TrialAnalysisThread(this);
+	analysisThread->startThread();
 }
 
 void TrialCircularBuffer::getLastTrial(int electrodeIndex, int channelIndex, int conditionIndex, float &x0, float &dx, std::vector<float> &y)
@@ -1410,7 +1599,7 @@ void TrialCircularBuffer::getLastTrial(int electrodeIndex, int channelIndex, int
 	//lockPSTH();
 	x0 = electrodesPSTH[electrodeIndex].channelsPSTHs[channelIndex].conditionPSTHs[conditionIndex].binTime[0];
 	dx = electrodesPSTH[electrodeIndex].channelsPSTHs[channelIndex].conditionPSTHs[conditionIndex].getDx();
-	y = electrodesPSTH[electrodeIndex].channelsPSTHs[channelIndex].conditionPSTHs[conditionIndex].getLastTrial();
+	electrodesPSTH[electrodeIndex].channelsPSTHs[channelIndex].conditionPSTHs[conditionIndex].getLastTrial(y);
 	//unlockPSTH();
 }
 
@@ -1916,17 +2105,11 @@ bool TrialCircularBuffer::parseMessage(StringTS msg)
 		  currentTrial.type = -1;
 		  lfpBuffer->addTrialStartToSmartBuffer(currentTrial.trialID);
 		  ttlBuffer->addTrialStartToSmartBuffer(currentTrial.trialID);
-		  const ScopedLock myScopedLock (psthMutex);
 
-		  //lockPSTH();
-		  for (int i = 0; i < electrodesPSTH.size(); i++) 
-			{
-				for (int u=0;u<electrodesPSTH[i].unitsPSTHs.size();u++)
-				{
-					electrodesPSTH[i].unitsPSTHs[u].addTrialStartToSmartBuffer(&currentTrial);
-				}
-		  }
-		  //unlockPSTH();
+		  PSTHanalysisItem item;
+		  item.type = PSTHanalysisItem::TRIAL_START;
+		  item.trial = currentTrial;
+		  queueAnalysisItem(item);
 		  if (input.size() > 1) {
 			  currentTrial.type = input[1].getIntValue();
 		  }
@@ -2029,33 +2212,107 @@ bool TrialCircularBuffer::parseMessage(StringTS msg)
 	  return   redrawNeeded ;
 }
 
-void TrialCircularBuffer::addSpikeToSpikeBuffer(SpikeObject newSpike)
+void TrialCircularBuffer::addSpikeToSpikeBuffer(const SpikeObject& newSpike)
 {
-	//lockPSTH();
+	PSTHanalysisItem item;
+	item.type = PSTHanalysisItem::SPIKE;
+	item.electrodeID = newSpike.electrodeID;
+	item.unitID = newSpike.sortedId;
+	item.softwareTS = newSpike.timestamp_software;
+	item.hardwareTS = newSpike.timestamp;
+	queueAnalysisItem(item);
+}
+
+void TrialCircularBuffer::queueAnalysisItem(const PSTHanalysisItem &item)
+{
+	if (analysisThread == nullptr)
+	{
+		const ScopedLock myScopedLock (psthMutex);
+		PSTHanalysisItem copy(item);
+		applyAnalysisItem(copy);
+		return;
+	}
+
+	{
+		const ScopedLock myScopedLock (pendingMutex);
+		// never grow past the reserved capacity here; if the analysis thread
+		// fell behind by PSTH_ANALYSIS_QUEUE_SIZE items the item is dropped
+		if (pendingItems.size() >= pendingItems.capacity())
+		{
+			++droppedAnalysisItems;
+			return;
+		}
+		pendingItems.push_back(item);
+	}
+
+	// spikes are picked up by the periodic wake up of the analysis thread
+	if (item.type != PSTHanalysisItem::SPIKE)
+		analysisThread->notify();
+}
+
+void TrialCircularBuffer::processPendingAnalysisItems()
+{
+	{
+		const ScopedLock myScopedLock (pendingMutex);
+		processingItems.swap(pendingItems);
+	}
+
+	const int dropped = droppedAnalysisItems.exchange(0);
+	if (dropped > 0)
+		std::cout << "PSTH: analysis queue full, dropped " << dropped << " items" << std::endl;
+
+	if (processingItems.size() == 0)
+		return;
+
 	const ScopedLock myScopedLock (psthMutex);
+	for (int k = 0; k < processingItems.size(); k++)
+	{
+		applyAnalysisItem(processingItems[k]);
+	}
+	processingItems.clear();
+}
 
-	for (int e = 0; e < electrodesPSTH.size(); e++)
+void TrialCircularBuffer::applyAnalysisItem(PSTHanalysisItem &item)
+{
+	if (item.type == PSTHanalysisItem::SPIKE)
 	{
-		if (electrodesPSTH[e].electrodeID == newSpike.electrodeID)
+		for (int e = 0; e < electrodesPSTH.size(); e++)
 		{
-			for (int u = 0; u < electrodesPSTH[e].unitsPSTHs.size(); u++)
+			if (electrodesPSTH[e].electrodeID == item.electrodeID)
 			{
-				if (electrodesPSTH[e].unitsPSTHs[u].unitID == newSpike.sortedId)
+				for (int u = 0; u < electrodesPSTH[e].unitsPSTHs.size(); u++)
 				{
-					electrodesPSTH[e].unitsPSTHs[u].addSpikeToBuffer(newSpike.timestamp_software,newSpike.timestamp);
-					//unlockPSTH();
-					return;
+					if (electrodesPSTH[e].unitsPSTHs[u].unitID == item.unitID)
+					{
+						electrodesPSTH[e].unitsPSTHs[u].addSpikeToBuffer(item.softwareTS, item.hardwareTS);
+						return;
+					}
 				}
 			}
-			
 		}
+		// get got a sorted spike event before we got the information about the new unit?!?!?!
+	}
+	else if (item.type == PSTHanalysisItem::TRIAL_START)
+	{
+		for (int i = 0; i < electrodesPSTH.size(); i++)
+		{
+			for (int u = 0; u < electrodesPSTH[i].unitsPSTHs.size(); u++)
+			{
+				electrodesPSTH[i].unitsPSTHs[u].addTrialStartToSmartBuffer(&item.trial);
+			}
+		}
+	}
+	else if (item.type == PSTHanalysisItem::TRIAL_END)
+	{
+		tictoc.Tic(4);
+		updatePSTHwithTrial(&item.trial);
+		tictoc.Toc(4);
+		lastTrialID = item.trial.trialID;
 	}
-	// get got a sorted spike event before we got the information about the new unit?!?!?!
-//	unlockPSTH();
 }
 
 
-bool TrialCircularBuffer::contains(std::vector<int> v, int x)
+bool TrialCircularBuffer::contains(const std::vector<int> &v, int x)
 {
 	for (int k = 0; k < v.size(); k++)
 		if (v[k] == x)
@@ -2086,7 +2343,7 @@ void TrialCircularBuffer::updatePSTHwithTrial(Trial *trial)
 //	printf("Calling updatePSTHwithTrial::lock conditions finished \n");
 	
 	// find out which conditions need to be updated
-	std::vector<int> conditionsNeedUpdating;
+	conditionsNeedUpdating.clear();
 	for (int c=0;c<conditions.size();c++)
 	{
 		if (contains(conditions[c].trialTypes, trial->type) &&
@@ -2104,7 +2361,7 @@ void TrialCircularBuffer::updatePSTHwithTrial(Trial *trial)
 		return;
 	}
 
-	if (!useThreads)
+	if (!useThreads || threadpool == nullptr)
 	{
 		// these two parts can be fully distributed along several threads because they are completely independent.
 		//printf("Calling updatePSTHwithTrial::update without threads\n");
@@ -2174,8 +2431,6 @@ void TrialCircularBuffer::simulateHardwareTrial(int64 ttl_timestamp_software,int
 	float secElapsed = float(tickdiff) / numTicksPerSecond;
 	if (secElapsed > params.ttlSupressionTimeSec)
 	{
-		const ScopedLock myScopedLock (psthMutex);
-		//lockPSTH();
 		Trial ttlTrial;
 		ttlTrial.trialID = ++trialCounter;
 		ttlTrial.startTS = ttl_timestamp_software;
@@ -2188,16 +2443,14 @@ void TrialCircularBuffer::simulateHardwareTrial(int64 ttl_timestamp_software,int
 		ttlTrial.hardwareAlignment = true;
 		lfpBuffer->addTrialStartToSmartBuffer(ttlTrial.trialID);
 		ttlBuffer->addTrialStartToSmartBuffer(ttlTrial.trialID);
-		for (int i=0;i<electrodesPSTH.size();i++) 
-		{
-			for (int u=0;u<electrodesPSTH[i].unitsPSTHs.size();u++)
-			{
-				electrodesPSTH[i].unitsPSTHs[u].addTrialStartToSmartBuffer(&ttlTrial);
-			}
-		}
+
+		PSTHanalysisItem item;
+		item.type = PSTHanalysisItem::TRIAL_START;
+		item.trial = ttlTrial;
+		queueAnalysisItem(item);
+
 		aliveTrials.push(ttlTrial);
 		lastSimulatedTrialTS = ttl_timestamp_software;
-		//unlockPSTH();
 	}
 }
 
@@ -2247,14 +2500,17 @@ void TrialCircularBuffer::addTTLevent(int channel,int64 ttl_timestamp_software,
 	  
 }
 	
-std::vector<std::vector<bool>> TrialCircularBuffer::reconstructTTLchannels(int64 hardware_timestamp,int nSamples)
+void TrialCircularBuffer::reconstructTTLchannels(int64 hardware_timestamp,int nSamples)
 {
-	std::vector<std::vector<bool>> contdata;
-	contdata.resize(params.numTTLchannels);
+	// reconstructedTTLs only grows when a larger block than before arrives.
+	std::vector<std::vector<bool> > &contdata = reconstructedTTLs;
+	if (contdata.size() != params.numTTLchannels)
+		contdata.resize(params.numTTLchannels);
 	
 	for (int k=0;k<params.numTTLchannels;k++)
 	{
-		contdata[k].resize(nSamples);
+		if (contdata[k].size() < nSamples)
+			contdata[k].resize(nSamples);
 	}
 
 	int64 currTS = hardware_timestamp;
@@ -2280,7 +2536,6 @@ std::vector<std::vector<bool>> TrialCircularBuffer::reconstructTTLchannels(int64
 		}
 		
 	}
-	return contdata;
 }
 
 
@@ -2294,7 +2549,7 @@ int TrialCircularBuffer::getLastTrialID()
 	return lastTrialID;
 }
 
-std::vector<XYline> TrialCircularBuffer::getElectrodeConditionCurves(int electrodeID, int channelID)
+std::vector<XYline> TrialCircularBuffer::getElectrodeConditionCurves(int electrodeID, int channelID, float guassianStandardDeviationMS)
 {
 	std::vector<XYline> lines;
 
@@ -2323,8 +2578,7 @@ std::vector<XYline> TrialCircularBuffer::getElectrodeConditionCurves(int electro
 									 electrodesPSTH[electrodeIndex].channelsPSTHs[entryindex].conditionPSTHs[cond].colorRGB[2]);
 						double x0 = electrodesPSTH[electrodeIndex].channelsPSTHs[entryindex].conditionPSTHs[cond].binTime[0];
 						double dx = electrodesPSTH[electrodeIndex].channelsPSTHs[entryindex].conditionPSTHs[cond].getDx();
-						std::vector<float> y = electrodesPSTH[electrodeIndex].channelsPSTHs[entryindex].conditionPSTHs[cond].getAverageTrialResponse();
-						XYline l(x0,dx,y, 1.0, lineColor);
+						XYline l(x0,dx,electrodesPSTH[electrodeIndex].channelsPSTHs[entryindex].conditionPSTHs[cond].getSmoothedTrialResponse(guassianStandardDeviationMS), 1.0, lineColor);
 						lines.push_back(l);
 					}
 
@@ -2419,7 +2673,7 @@ juce::Colour TrialCircularBuffer::getUnitColor(int electrodeID, int unitID)
 	return juce::Colours::black;
 }
 
-std::vector<XYline> TrialCircularBuffer::getUnitConditionCurves(int electrodeID, int unitID)
+std::vector<XYline> TrialCircularBuffer::getUnitConditionCurves(int electrodeID, int unitID, float guassianStandardDeviationMS)
 {
 	std::vector<XYline> lines;
 	//lockPSTH();
@@ -2446,8 +2700,7 @@ std::vector<XYline> TrialCircularBuffer::getUnitConditionCurves(int electrodeID,
 									 electrodesPSTH[electrodeIndex].unitsPSTHs[entryindex].conditionPSTHs[cond].colorRGB[2]);
 						double x0 = electrodesPSTH[electrodeIndex].unitsPSTHs[entryindex].conditionPSTHs[cond].binTime[0];
 						double dx = electrodesPSTH[electrodeIndex].unitsPSTHs[entryindex].conditionPSTHs[cond].getDx();
-						std::vector<float> y = electrodesPSTH[electrodeIndex].unitsPSTHs[entryindex].conditionPSTHs[cond].getAverageTrialResponse();
-						XYline l(x0,dx,y, 1.0, lineColor);
+						XYline l(x0,dx,electrodesPSTH[electrodeIndex].unitsPSTHs[entryindex].conditionPSTHs[cond].getSmoothedTrialResponse(guassianStandardDeviationMS), 1.0, lineColor);
 						lines.push_back(l);
 					}
 
@@ -2616,49 +2869,6 @@ void TrialCircularBuffer::updateElectrodeName(int electrodeID, String newName)
 	//unlockPSTH();
 }
 
- std::vector<float> TrialCircularBuffer::buildSmoothKernel(float guassianStandardDeviationMS, float binSizeInMS)
-{
-	 std::vector<float> smoothKernel;
-	// assume each bin correponds to one millisecond.
-	// build the gaussian kernel
-	int numKernelBins = 2*(int)(guassianStandardDeviationMS*3.5/binSizeInMS)+1; // +- 3.5 standard deviations.
-	int zeroIndex = (numKernelBins-1)/2;
-	smoothKernel.resize(numKernelBins); 
-	float sumZ = 0;
-	for (int k=0;k<numKernelBins;k++) 
-	{
-		float z = float(k*binSizeInMS-zeroIndex);
-		smoothKernel[k] = exp(- (z*z)/(2*guassianStandardDeviationMS*guassianStandardDeviationMS));
-		sumZ+=smoothKernel[k];
-	}
-	// normalize kernel
-	for (int k=0;k<numKernelBins;k++) 
-	{
-		smoothKernel[k] /= sumZ;
-	}
-	return smoothKernel;
-}
-
-std::vector<float> TrialCircularBuffer::smooth(std::vector<float> y, std::vector<float> smoothKernel, int xmin, int xmax)
-{
-	std::vector<float> smoothy;
-	smoothy.resize(xmax-xmin+1);
-
-	int numKernelBins = smoothKernel.size();
-	int zeroIndex = (numKernelBins-1)/2;
-	int numXbins = y.size();
-	for (int k=xmin;k<=xmax;k++)
-	{
-		float response = 0;
-		for (int j=-zeroIndex;j<zeroIndex;j++)
-		{
-			if (k+j >=0 && k+j < numXbins)
-				response+=y[k+j] * smoothKernel[j+zeroIndex];
-		}
-		smoothy[k-xmin] = response;
-	}
-	return  smoothy;
-}
 // Builds average raster matrix.
 // each line corresponds to a trial type, and contains the average response for that trial type.
 // each column corresponds to a specific time point, returned by x_time
@@ -2674,10 +2884,6 @@ std::vector<std::vector<float>> TrialCircularBuffer::getTrialsAverageUnitRespons
 	numTrialRepeats.clear();
 	numTrialTypes = 0;
 
-	std::vector<float> smoothKernel;
-	if (smoothMS > 0)
-		smoothKernel = buildSmoothKernel(smoothMS, 1.0);
-
 	//lockPSTH();
 	//lockConditions();
 	const ScopedLock myScopedLock (psthMutex);
@@ -2736,10 +2942,9 @@ std::vector<std::vector<float>> TrialCircularBuffer::getTrialsAverageUnitRespons
 						} else
 						{
 
-						if (smoothMS > 0)
-							avgResponseMatrix[trialIter] = smooth(electrodesPSTH[electrodeIndex].unitsPSTHs[entryindex].trialPSTHs[trialIter].getAverageTrialResponse(), smoothKernel,xminIndex,xmaxIndex);
-						else
-							avgResponseMatrix[trialIter] = electrodesPSTH[electrodeIndex].unitsPSTHs[entryindex].trialPSTHs[trialIter].getAverageTrialResponse();
+						// smoothed curves are cached by the PSTH, and only recomputed for trial types that got new trials
+						const std::vector<float> &response = electrodesPSTH[electrodeIndex].unitsPSTHs[entryindex].trialPSTHs[trialIter].getSmoothedTrialResponse(smoothMS);
+						avgResponseMatrix[trialIter].assign(response.begin()+xminIndex, response.begin()+xmaxIndex+1);
 						}
 						
 					}
@@ -2775,10 +2980,6 @@ std::vector<std::vector<float>> TrialCircularBuffer::getTrialsAverageChannelResp
 	numTrialRepeats.clear();
 	numTrialTypes = 0;
 
-	std::vector<float> smoothKernel;
-	if (smoothMS > 0)
-		smoothKernel = buildSmoothKernel(smoothMS, 1.0);
-
 	const ScopedLock myScopedLock (psthMutex);
 	//const ScopedLock myScopedLock (conditionMutex);
 
@@ -2837,10 +3038,9 @@ std::vector<std::vector<float>> TrialCircularBuffer::getTrialsAverageChannelResp
 						} else
 						{
 
-						if (smoothMS > 0)
-							avgResponseMatrix[trialIter] = smooth(electrodesPSTH[electrodeIndex].channelsPSTHs[entryindex].trialPSTHs[trialIter].getAverageTrialResponse(), smoothKernel,xminIndex,xmaxIndex);
-						else
-							avgResponseMatrix[trialIter] = electrodesPSTH[electrodeIndex].channelsPSTHs[entryindex].trialPSTHs[trialIter].getAverageTrialResponse();
+						// smoothed curves are cached by the PSTH, and only recomputed for trial types that got new trials
+						const std::vector<float> &response = electrodesPSTH[electrodeIndex].channelsPSTHs[entryindex].trialPSTHs[trialIter].getSmoothedTrialResponse(smoothMS);
+						avgResponseMatrix[trialIter].assign(response.begin()+xminIndex, response.begin()+xmaxIndex+1);
 						}
 						
 					}
@@ -3060,7 +3260,7 @@ int TrialCircularBuffer::getNumTrialsInUnit(int electrodeID, int unitID)
 	return 0;
 }
 
-juce::Image TrialCircularBuffer::getTrialsAverageResponseAsJuceImage(int  ymin, int ymax,	std::vector<float> x_time,	int numTrialTypes,	std::vector<int> numTrialRepeats,	std::vector<std::vector<float>> trialResponseMatrix, float &maxValue)
+juce::Image TrialCircularBuffer::getTrialsAverageResponseAsJuceImage(int  ymin, int ymax, const std::vector<float> &x_time, int numTrialTypes, const std::vector<int> &numTrialRepeats, const std::vector<std::vector<float> > &trialResponseMatrix, float &maxValue)
 {
 	if (trialResponseMatrix.size() == 0)
 	{
@@ -3162,7 +3362,7 @@ void TrialCircularBuffer::process(AudioSampleBuffer& buffer,int nSamples,int64 h
 
 	// for oscilloscope purposes, it is easier to reconstruct TTL changes to "continuous" form.
 	if (params.reconstructTTL) {
-		std::vector<std::vector<bool>> reconstructedTTLs = reconstructTTLchannels(hardware_timestamp,nSamples);
+		reconstructTTLchannels(hardware_timestamp,nSamples);
 		ttlBuffer->update(reconstructedTTLs,hardware_timestamp,software_timestamp,nSamples);
 	}
 	tictoc.Toc(2);
@@ -3170,19 +3370,15 @@ void TrialCircularBuffer::process(AudioSampleBuffer& buffer,int nSamples,int64 h
 	//printf("Exiting reconstructedTTLs\n");
 
 	// now, check if a trial finished, and enough time has elapsed so we also
-	// have post trial information
+	// have post trial information. Completed trials are only queued here;
+	// the PSTHs are updated by the analysis thread.
 	tictoc.Tic(3);
-	Time t;
-	long startTime = t.getHighResolutionTicks();
-	double MaxPSTHprocessingTime = 50/1000; // 50 ms
-	if (electrodesPSTH.size() > 0 && aliveTrials.size() > 0)
+	if (electrodesPSTH.size() > 0)
 	{
 		//printf("Entering alive loop\n");
-		for (int k=0;k<aliveTrials.size();k++)
+		while (aliveTrials.size() > 0)
 		{
-			Trial topTrial = aliveTrials.front();
-			int64 ticksElapsed = software_timestamp - topTrial.endTS;
-			float timeElapsedSec = float(ticksElapsed)/ numTicksPerSecond;
+			const Trial& topTrial = aliveTrials.front();
 
 			bool trialEndedAndEnoughDataInBuffer;
 
@@ -3196,23 +3392,14 @@ void TrialCircularBuffer::process(AudioSampleBuffer& buffer,int nSamples,int64 h
 				trialEndedAndEnoughDataInBuffer = hardware_timestamp+nSamples > topTrial.alignTS_hardware+ (params.postSec + 0.1)*params.sampleRate;
 			}
 
-			if (trialEndedAndEnoughDataInBuffer)
-			{
-				aliveTrials.pop();
-				lastTrialID = topTrial.trialID;
-				//printf("Entering updatePSTHwithTrial\n");
-				tictoc.Tic(4);
-				updatePSTHwithTrial(&topTrial);
-				tictoc.Toc(4);
-				//printf("Exitting updatePSTHwithTrial\n");
-			}
-
-			long endTime = t.getHighResolutionTicks();
-			
-		//	if  ((endTime-startTime) > MaxPSTHprocessingTime*t.getHighResolutionTicksPerSecond())
-				//break;
-			
+			if (!trialEndedAndEnoughDataInBuffer)
+				break;
 
+			PSTHanalysisItem item;
+			item.type = PSTHanalysisItem::TRIAL_END;
+			item.trial = topTrial;
+			aliveTrials.pop();
+			queueAnalysisItem(item);
 		}
 		//printf("Exitting alive loop\n");
 	}
@@ -3229,6 +3416,20 @@ TrialCircularBufferThread::TrialCircularBufferThread(TrialCircularBuffer *tcb_,
 
 }
 
+TrialAnalysisThread::TrialAnalysisThread(TrialCircularBuffer *tcb_) : Thread("PSTH analysis"), tcb(tcb_)
+{
+}
+
+void TrialAnalysisThread::run()
+{
+	while (!threadShouldExit())
+	{
+		// woken up early when a trial starts or ends
+		wait(20);
+		tcb->processPendingAnalysisItems();
+	}
+}
+
 juce::ThreadPoolJob::JobStatus TrialCircularBufferThread::runJob()
 {
 	if (jobType == 0)
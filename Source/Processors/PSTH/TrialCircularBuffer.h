@@ -37,6 +37,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 class Electrode;
 
 #define TTL_TRIAL_OFFSET 30000
+#define PSTH_ANALYSIS_QUEUE_SIZE 10000
+#define PSTH_RECURSIVE_SMOOTHING_MIN_SIGMA 3.0f // in bins. wider gaussians use the recursive filter
 
 #ifndef MAX
 #define MAX(a,b)((a)<(b)?(b):(a))
@@ -108,7 +110,8 @@ public:
 	// contains spike times, but also pointers for trial onsets so we don't need to search
 	// the entire array 
 	void addSpikeToBuffer(int64 spikeTimeSoftware,int64 spikeTimeHardware);
-	std::vector<int64> getAlignedSpikes(Trial *trial, float preSecs, float postSecs);
+	// fills alignedSpikes (cleared first, capacity is kept between calls)
+	void getAlignedSpikes(Trial *trial, float preSecs, float postSecs, std::vector<int64> &alignedSpikes);
 	void addTrialStartToBuffer(Trial *t);
 
 	int queryTrialStart(int trialID);
@@ -133,12 +136,12 @@ class SmartContinuousCircularBuffer : public ContinuousCircularBuffer
 {
 public:
 	SmartContinuousCircularBuffer(int NumCh, float SamplingRate, int SubSampling, float NumSecInBuffer);
-	bool getAlignedData(std::vector<int> channels, Trial *trial, std::vector<float> *timeBins,
-									TrialCircularBufferParams params,
+	bool getAlignedData(const std::vector<int> &channels, Trial *trial, const std::vector<float> *timeBins,
+									const TrialCircularBufferParams &params,
 									std::vector<std::vector<float> > &output,
 									std::vector<bool> &valid);
 
-	bool getAlignedDataInterp(std::vector<int> channels, Trial *trial, std::vector<float> *timeBins,
+	bool getAlignedDataInterp(const std::vector<int> &channels, Trial *trial, const std::vector<float> *timeBins,
 												   float preSec, float postSec,
 									std::vector<std::vector<float> > &output,
 									std::vector<bool> &valid);
@@ -152,6 +155,24 @@ public:
 };
 
 
+/** Gaussian smoothing of PSTH curves. Narrow kernels are applied as a direct
+	convolution, wide ones with the recursive approximation of Young & van Vliet,
+	whose cost does not depend on the kernel width. Values outside the curve are zero. */
+class PSTHSmoother
+{
+public:
+	PSTHSmoother();
+	void setStandardDeviation(float sigmaBins);
+	void smooth(const float *y, int numPoints, float *out);
+
+private:
+	float sigma;
+	bool recursive;
+	std::vector<float> kernel;
+	double B, b1, b2, b3; // recursive coefficients, normalized by b0
+	std::vector<double> forwardPass;
+};
+
 class PSTH
 {
 public:
@@ -160,11 +181,15 @@ public:
 	PSTH(const PSTH& c);
 	double getDx();
 	void clear();
-	void updatePSTH(SmartSpikeCircularBuffer *spikeBuffer, Trial *trial);
-	void updatePSTH(std::vector<float> alignedLFP,std::vector<bool> valid);
+	void updatePSTH(const std::vector<int64> &alignedSpikes, Trial *trial);
+	void updatePSTH(const std::vector<float> &alignedLFP, const std::vector<bool> &valid);
 
-	std::vector<float> getAverageTrialResponse();
-	std::vector<float> getLastTrial();
+	const std::vector<float>& getAverageTrialResponse();
+	// cached. only recomputed after a new trial or when the kernel width changes
+	const std::vector<float>& getSmoothedTrialResponse(float guassianStandardDeviationMS);
+	void getLastTrial(std::vector<float> &y) const;
+	double getPreSec() const;
+	double getPostSec() const;
 
 	void getRange(float &xMin, float &xMax, float &yMin, float &yMax);
 
@@ -181,19 +206,31 @@ public:
 
 private:
 	double dx,mod_pre_sec, mod_post_sec;
-	std::list<std::vector<float>> prevTrials; 
+	float* storeTrial();
+	void refreshAverage();
+
+	// running per bin sums over all trials. the average (and numDataPoints) is only
+	// recomputed from them when somebody asks for it.
+	std::vector<double> binSums;
+	std::vector<int> coverageCounts; // coverageCounts[n]: number of trials that covered bins [0,n)
+	bool averageDirty, smoothedDirty;
+	float smoothedSigmaMS;
+	std::vector<float> smoothedResponse;
+	PSTHSmoother smoother;
+
+	// last maxTrialsInMemory trials, numBins values each, kept in a flat ring.
+	// grows up to its final size during the first trials and is reused afterwards.
+	std::vector<float> prevTrials;
+	int prevTrialsHead, numPrevTrials;
 	std::vector<float> avgResponse; // either firing rate or lfp
 
-
-	std::vector<int64> getAlignSpikes(SmartSpikeCircularBuffer *spikeBuffer, Trial *t);
-
 };
 
 class UnitPSTHs 
 {
 public:
 	UnitPSTHs(int ID,TrialCircularBufferParams params,uint8 R, uint8 G, uint8 B);
-	void updateConditionsWithSpikes(std::vector<int> conditionsNeedUpdating, Trial *trial);
+	void updateConditionsWithSpikes(const std::vector<int> &conditionsNeedUpdating, Trial *trial);
 	void addSpikeToBuffer(int64 spikeTimestampSoftware,int64 spikeTimestampHardware);
 	void addTrialStartToSmartBuffer(Trial *t);
 	void clearStatistics();
@@ -215,13 +252,15 @@ public:
 	int numTrials;
 	TrialCircularBufferParams params;
 
+private:
+	std::vector<int64> alignedSpikes; // scratch, reused for every trial
 };
 
 class ChannelPSTHs 
 {
 public:
 	ChannelPSTHs(int channelID, TrialCircularBufferParams params);
-	void updateConditionsWithLFP(std::vector<int> conditionsNeedUpdating, std::vector<float> lfpData, std::vector<bool> valid, Trial *trial);
+	void updateConditionsWithLFP(const std::vector<int> &conditionsNeedUpdating, const std::vector<float> &lfpData, const std::vector<bool> &valid, Trial *trial);
 	void clearStatistics();
 	void getRange(float &xmin, float &xmax, float &ymin, float &ymax);
 	bool isNewDataAvailable();
@@ -238,7 +277,7 @@ class TTL_PSTHs
 {
 public:
 	TTL_PSTHs(int ttlChannelID, TrialCircularBufferParams params);
-	void updateConditionsWithLFP(std::vector<int> conditionsNeedUpdating, std::vector<float> lfpData, std::vector<float> valid, Trial *trial);
+	void updateConditionsWithLFP(const std::vector<int> &conditionsNeedUpdating, const std::vector<float> &lfpData, const std::vector<float> &valid, Trial *trial);
 	void clearStatistics();
 	void getRange(float &xmin, float &xmax, float &ymin, float &ymax);
 	int ttlChannelID;
@@ -254,7 +293,7 @@ public:
 	ElectrodePSTH();
 	ElectrodePSTH(int ID, String name);
 	~ElectrodePSTH();
-	void updateChannelsConditionsWithLFP(std::vector<int> conditionsNeedUpdate, Trial *trial, SmartContinuousCircularBuffer *lfpBuffer);
+	void updateChannelsConditionsWithLFP(const std::vector<int> &conditionsNeedUpdate, Trial *trial, SmartContinuousCircularBuffer *lfpBuffer);
 	void UpdateChannelConditionWithLFP(int ch, std::vector<int> *conditionsNeedUpdate, Trial *trial, std::vector<float>* alignedLFP,std::vector<bool> *valid);
 	int electrodeID;
 	String electrodeName;
@@ -264,6 +303,10 @@ public:
 	std::vector<TTL_PSTHs> ttlPSTHs;
 	
 	ThreadPool *threadpool; // used for multi-channel electrodes only
+private:
+	// scratch buffers for trial aligned lfp, reused for every trial
+	std::vector<std::vector<float> > alignedLFP;
+	std::vector<bool> alignedValid;
 };
 
 class ElectrodePSTHlfpJob : public ThreadPoolJob
@@ -287,6 +330,39 @@ struct ttlStatus
 	bool value;
 	int64 ts;
 };
+
+/** Work item handed from the audio thread to the PSTH analysis thread.
+	Items are applied in the order they were queued, so a completed trial is
+	always analyzed after the spikes and trial starts that preceded it. */
+struct PSTHanalysisItem
+{
+	enum ItemType
+	{
+		SPIKE,
+		TRIAL_START,
+		TRIAL_END
+	};
+
+	ItemType type;
+	Trial trial;
+	int electrodeID;
+	int unitID;
+	int64 softwareTS, hardwareTS;
+};
+
+class TrialCircularBuffer;
+
+/** Applies queued spikes and completed trials to the PSTHs, so that the
+	(potentially heavy) trial aggregation never runs on the audio thread. */
+class TrialAnalysisThread : public Thread
+{
+public:
+	TrialAnalysisThread(TrialCircularBuffer *tcb_);
+	void run();
+
+private:
+	TrialCircularBuffer *tcb;
+};
 	
 class TrialCircularBuffer 
 {
@@ -295,12 +371,12 @@ public:
 	TrialCircularBuffer(TrialCircularBufferParams param_);
 	~TrialCircularBuffer();
     void updatePSTHwithTrial(Trial *trial);
-	bool contains(std::vector<int> v, int x);
+	bool contains(const std::vector<int> &v, int x);
 	void toggleConditionVisibility(int cond);
 	void modifyConditionVisibility(int cond, bool newstate);
 	void modifyConditionVisibilityusingConditionID(int condID, bool newstate);
 	bool parseMessage(StringTS s);
-	void addSpikeToSpikeBuffer(SpikeObject newSpike);
+	void addSpikeToSpikeBuffer(const SpikeObject& newSpike);
 	void process(AudioSampleBuffer& buffer,int nSamples,int64 hardware_timestamp,int64 software_timestamp);
 	void simulateHardwareTrial(int64 ttl_timestamp_software,int64 ttl_timestamp_hardware, int trialType, float lengthSec);
 	//void simulateTrial(int64 ttl_timestamp_software, int trialType, float lengthSec);
@@ -316,7 +392,7 @@ public:
 	void simulateTTLtrial(int channel, int64 ttl_timestamp_software);
 	void clearDesign();
 	void clearAll();
-	std::vector<std::vector<bool>>  reconstructTTLchannels(int64 hardware_timestamp,int nSamples);
+	void reconstructTTLchannels(int64 hardware_timestamp,int nSamples);
 	void channelChange(int electrodeID, int channelindex, int newchannel);
 	void syncInternalDataStructuresWithSpikeSorter(Array<Electrode *> electrodes);
 	void addNewElectrode(Electrode *electrode);
@@ -344,8 +420,8 @@ public:
 	int getNumConditions();
 	void getLastTrial(int electrodeIndex, int channelIndex, int conditionIndex, float &x0, float &dx, std::vector<float> &y);
 	Condition getCondition(int conditionIndex);
-	std::vector<XYline> getElectrodeConditionCurves(int electrodeID, int channelID);
-	std::vector<XYline> getUnitConditionCurves(int electrodeID, int unitID);
+	std::vector<XYline> getElectrodeConditionCurves(int electrodeID, int channelID, float guassianStandardDeviationMS = 0);
+	std::vector<XYline> getUnitConditionCurves(int electrodeID, int unitID, float guassianStandardDeviationMS = 0);
 	
 	std::vector<std::vector<float>> getTrialsAverageUnitResponse(int electrodeID, int unitID, 
 																 std::vector<float> &x_time, int &numTrialTypes, 
@@ -362,12 +438,14 @@ public:
 	int getNumTrialTypesInChannel(int electrodeID, int channelID);
 	void clearUnitStatistics(int electrodeID, int unitID);
 	void clearChanneltatistics(int electrodeID, int channelID);
-	 std::vector<float> buildSmoothKernel(float guassianStandardDeviationMS, float binSizeInMS);
 	 void updateElectrodeName(int electrodeID, String newName);
 	juce::Colour getUnitColor(int electrodeID, int unitID);
 	int getLastTrialID();
 	int getNumberAliveTrials();
 
+	/** called by the analysis thread. Applies everything queued so far. */
+	void processPendingAnalysisItems();
+
 	// thread job functions
 	void updateLFPwithTrial(int electrodeIndex, std::vector<int> *conditionsNeedUpdate, Trial *trial);
 	void updateSpikeswithTrial(int electrodeIndex, int unitIndex, std::vector<int> *conditionsNeedUpdate, Trial *trial);
@@ -377,10 +455,12 @@ private:
 	bool useThreads;
    std::vector<int> dropOutcomes;
 
-	juce::Image getTrialsAverageResponseAsJuceImage(int  ymin, int ymax,	std::vector<float> x_time,	int numTrialTypes,	
-													std::vector<int> numTrialRepeats,	std::vector<std::vector<float>> trialResponseMatrix, float &maxValue);
+	void queueAnalysisItem(const PSTHanalysisItem &item);
+	void applyAnalysisItem(PSTHanalysisItem &item);
+
+	juce::Image getTrialsAverageResponseAsJuceImage(int  ymin, int ymax, const std::vector<float> &x_time, int numTrialTypes,	
+													const std::vector<int> &numTrialRepeats, const std::vector<std::vector<float> > &trialResponseMatrix, float &maxValue);
 
-	std::vector<float> smooth(std::vector<float> y, std::vector<float> smoothKernel, int xmin, int xmax);
 
 	bool firstTime;
 	int lastTrialID;
@@ -401,8 +481,17 @@ private:
 	ScopedPointer<SmartContinuousCircularBuffer> lfpBuffer;
 	ScopedPointer<SmartContinuousCircularBuffer> ttlBuffer;
 	std::queue<ttlStatus> ttlQueue;
+	std::vector<std::vector<bool> > reconstructedTTLs; // numTTLchannels x largest block seen so far
+	std::vector<int> conditionsNeedUpdating; // scratch for updatePSTHwithTrial
 	TrialCircularBufferParams params;
 	ScopedPointer<ThreadPool> threadpool;
+
+	// both vectors are preallocated and swapped, so queueing from the
+	// audio thread does not allocate in steady state.
+	CriticalSection pendingMutex;
+	std::vector<PSTHanalysisItem> pendingItems, processingItems;
+	Atomic<int> droppedAnalysisItems;
+	ScopedPointer<TrialAnalysisThread> analysisThread;
 };
 
 class TrialCircularBufferThread : public ThreadPoolJob
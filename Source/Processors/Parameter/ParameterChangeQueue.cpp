@@ -0,0 +1,69 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "ParameterChangeQueue.h"
+
+ParameterChangeQueue::ParameterChangeQueue()
+{
+    changes.calloc(PARAMETER_QUEUE_SIZE);
+}
+
+ParameterChangeQueue::~ParameterChangeQueue()
+{
+
+}
+
+bool ParameterChangeQueue::push(const ParameterChange& change)
+{
+    const int write = writeIndex.get();
+
+    if (write - readIndex.get() >= PARAMETER_QUEUE_SIZE)
+        return false;
+
+    changes[write & (PARAMETER_QUEUE_SIZE - 1)] = change;
+
+    // publishes the entry to the consumer
+    writeIndex.set(write + 1);
+
+    return true;
+}
+
+bool ParameterChangeQueue::pop(ParameterChange& change)
+{
+    const int read = readIndex.get();
+
+    if (read == writeIndex.get())
+        return false;
+
+    change = changes[read & (PARAMETER_QUEUE_SIZE - 1)];
+
+    // hands the slot back to the producer
+    readIndex.set(read + 1);
+
+    return true;
+}
+
+bool ParameterChangeQueue::isEmpty() const
+{
+    return readIndex.get() == writeIndex.get();
+}
@@ -0,0 +1,77 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PARAMETERCHANGEQUEUE_H_A41E7C35__
+#define __PARAMETERCHANGEQUEUE_H_A41E7C35__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+#define PARAMETER_QUEUE_SIZE 2048 // must be a power of two
+
+/** One parameter change, as passed to GenericProcessor::applyParameterChange(). */
+struct ParameterChange
+{
+    int parameterIndex;
+    int channel;    // the processor's current channel when the change was made
+    int subChannel; // for processors that address channels within a group (e.g. electrodes), otherwise -1
+    float value;
+};
+
+/**
+
+  Carries parameter changes from the message thread to the processing
+  thread.
+
+  A single-producer, single-consumer ring buffer: push() is only called
+  from the message thread and pop() only from the thread that runs the
+  processor, so neither side ever locks or allocates.
+
+  @see GenericProcessor
+
+*/
+
+class ParameterChangeQueue
+{
+public:
+    ParameterChangeQueue();
+    ~ParameterChangeQueue();
+
+    /** Adds a change; returns false if the queue is full. */
+    bool push(const ParameterChange& change);
+
+    /** Takes the oldest change; returns false if the queue is empty. */
+    bool pop(ParameterChange& change);
+
+    bool isEmpty() const;
+
+private:
+    HeapBlock<ParameterChange> changes;
+
+    Atomic<int> readIndex;
+    Atomic<int> writeIndex;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParameterChangeQueue);
+
+};
+
+#endif  // __PARAMETERCHANGEQUEUE_H_A41E7C35__
@@ -0,0 +1,121 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include "ParameterSnapshot.h"
+#include "../GenericProcessor/GenericProcessor.h"
+
+ParameterSnapshot::ParameterSnapshot()
+{
+
+}
+
+ParameterSnapshot::~ParameterSnapshot()
+{
+
+}
+
+File ParameterSnapshot::getFileFor(const File& xmlFile)
+{
+    return xmlFile.withFileExtension("snapshot");
+}
+
+int64 ParameterSnapshot::getHash(const File& xmlFile)
+{
+    return xmlFile.loadFileAsString().hashCode64();
+}
+
+bool ParameterSnapshot::write(const File& xmlFile, const Array<GenericProcessor*>& processors)
+{
+    MemoryOutputStream stream;
+
+    stream.writeInt(PARAMETER_SNAPSHOT_MAGIC);
+    stream.writeInt(PARAMETER_SNAPSHOT_VERSION);
+    stream.writeInt64(getHash(xmlFile));
+    stream.writeInt(processors.size());
+
+    for (int i = 0; i < processors.size(); i++)
+    {
+        MemoryOutputStream block;
+        processors[i]->saveToSnapshot(block);
+
+        stream.writeInt(processors[i]->getNodeId());
+        stream.writeInt((int) block.getDataSize());
+        stream.write(block.getData(), block.getDataSize());
+    }
+
+    File snapshotFile = getFileFor(xmlFile);
+
+    return snapshotFile.replaceWithData(stream.getData(), stream.getDataSize());
+}
+
+bool ParameterSnapshot::read(const File& xmlFile)
+{
+    blocks.clear();
+
+    File snapshotFile = getFileFor(xmlFile);
+
+    if (!snapshotFile.existsAsFile())
+        return false;
+
+    MemoryBlock data;
+
+    if (!snapshotFile.loadFileAsData(data))
+        return false;
+
+    MemoryInputStream stream(data, false);
+
+    if (stream.readInt() != PARAMETER_SNAPSHOT_MAGIC ||
+        stream.readInt() != PARAMETER_SNAPSHOT_VERSION)
+        return false;
+
+    if (stream.readInt64() != getHash(xmlFile))
+    {
+        std::cout << "The parameter snapshot is older than " << xmlFile.getFileName()
+                  << "; loading from XML only." << std::endl;
+        return false;
+    }
+
+    const int numProcessors = stream.readInt();
+
+    for (int i = 0; i < numProcessors && !stream.isExhausted(); i++)
+    {
+        const int nodeId = stream.readInt();
+        const int size = stream.readInt();
+
+        if (size < 0 || size > stream.getNumBytesRemaining())
+        {
+            blocks.clear();
+            return false;
+        }
+
+        MemoryBlock block;
+        stream.readIntoMemoryBlock(block, size);
+        blocks.set(nodeId, block);
+    }
+
+    return true;
+}
+
+MemoryBlock ParameterSnapshot::getBlock(int nodeId) const
+{
+    return blocks[nodeId];
+}
@@ -0,0 +1,80 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef __PARAMETERSNAPSHOT_H_5D83C2E7__
+#define __PARAMETERSNAPSHOT_H_5D83C2E7__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+#define PARAMETER_SNAPSHOT_MAGIC 0x534e454f // "OENS"
+#define PARAMETER_SNAPSHOT_VERSION 1
+
+class GenericProcessor;
+
+/**
+
+  A binary copy of the per-channel parameters of a signal chain, written
+  next to a configuration the user saves ("config.xml" gets "config.snapshot").
+  The settings.xml files in recording directories don't get one.
+
+  Each processor's block holds its channel selection states and, for
+  processors that support it, their custom per-channel arrays (see
+  GenericProcessor::saveCustomChannelParametersToSnapshot()). Loading those
+  from the snapshot skips the CHANNEL elements of the XML, which are most
+  of the work for large channel counts.
+
+  The snapshot records a hash of the XML file it was written with, and is
+  ignored if the XML has changed since; the XML is always enough on its own.
+
+  @see EditorViewport, GenericProcessor
+
+*/
+
+class ParameterSnapshot
+{
+public:
+    ParameterSnapshot();
+    ~ParameterSnapshot();
+
+    /** The snapshot file that belongs to a settings file. */
+    static File getFileFor(const File& xmlFile);
+
+    /** Writes the snapshot for processors, after xmlFile has been written. */
+    static bool write(const File& xmlFile, const Array<GenericProcessor*>& processors);
+
+    /** Reads the snapshot of xmlFile; returns false if there is none, or if it's stale. */
+    bool read(const File& xmlFile);
+
+    /** The block saved for a processor, or an empty block. */
+    MemoryBlock getBlock(int nodeId) const;
+
+private:
+
+    static int64 getHash(const File& xmlFile);
+
+    HashMap<int, MemoryBlock> blocks; // by node ID
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParameterSnapshot);
+
+};
+
+#endif  // __PARAMETERSNAPSHOT_H_5D83C2E7__
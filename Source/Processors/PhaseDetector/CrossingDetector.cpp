@@ -0,0 +1,279 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include "CrossingDetector.h"
+
+#if JUCE_INTEL
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+
+// each of these tests CROSSING_SCAN_WIDTH samples from data on
+
+inline bool anyBelow(const float* data, float level)
+{
+#if JUCE_INTEL
+    const __m128 l = _mm_set1_ps(level);
+    __m128 found = _mm_setzero_ps();
+
+    for (int j = 0; j < CROSSING_SCAN_WIDTH; j += 4)
+        found = _mm_or_ps(found, _mm_cmplt_ps(_mm_loadu_ps(data + j), l));
+
+    return _mm_movemask_ps(found) != 0;
+#else
+    int found = 0;
+
+    for (int j = 0; j < CROSSING_SCAN_WIDTH; j++)
+        found += (data[j] < level) ? 1 : 0;
+
+    return found != 0;
+#endif
+}
+
+inline bool anyAbove(const float* data, float level)
+{
+#if JUCE_INTEL
+    const __m128 l = _mm_set1_ps(level);
+    __m128 found = _mm_setzero_ps();
+
+    for (int j = 0; j < CROSSING_SCAN_WIDTH; j += 4)
+        found = _mm_or_ps(found, _mm_cmpgt_ps(_mm_loadu_ps(data + j), l));
+
+    return _mm_movemask_ps(found) != 0;
+#else
+    int found = 0;
+
+    for (int j = 0; j < CROSSING_SCAN_WIDTH; j++)
+        found += (data[j] > level) ? 1 : 0;
+
+    return found != 0;
+#endif
+}
+
+}
+
+CrossingDetector::CrossingDetector()
+{
+
+}
+
+CrossingDetector::~CrossingDetector()
+{
+
+}
+
+void CrossingDetector::setNumChannels(int numChannels)
+{
+    ChannelState initial;
+    initial.triggered = false;
+    initial.lastSample = 0.0f;
+    initial.phase = NO_PHASE;
+
+    while (states.size() < numChannels)
+        states.add(initial);
+
+    states.removeRange(numChannels, states.size() - numChannels);
+}
+
+int CrossingDetector::getNumChannels() const
+{
+    return states.size();
+}
+
+void CrossingDetector::reset()
+{
+    for (int i = 0; i < states.size(); i++)
+    {
+        ChannelState& state = states.getReference(i);
+        state.triggered = false;
+        state.lastSample = 0.0f;
+        state.phase = NO_PHASE;
+    }
+}
+
+bool CrossingDetector::isTriggered(int chan) const
+{
+    return states[chan].triggered;
+}
+
+int CrossingDetector::findLevelCrossings(int chan, const float* data, int numSamples,
+                                         float level, float rearmLevel, int* offsets)
+{
+    ChannelState& state = states.getReference(chan);
+
+    int numCrossings = 0;
+    int i = 0;
+
+    while (i < numSamples)
+    {
+        i = state.triggered ? findFirstAbove(data, i, numSamples, rearmLevel)
+                            : findFirstBelow(data, i, numSamples, level);
+
+        if (i == numSamples)
+            break;
+
+        offsets[numCrossings++] = i;
+        state.triggered = !state.triggered;
+        i++;
+    }
+
+    return numCrossings;
+}
+
+int CrossingDetector::findPhase(int chan, const float* data, int numSamples,
+                                PhaseType targetPhase, int* offsets)
+{
+    ChannelState& state = states.getReference(chan);
+
+    if (numSamples <= 0)
+        return 0;
+
+    int numCrossings = 0;
+
+    // the first sample steps from the end of the last block
+    int phase = getPhase(data[0], state.lastSample);
+    int i = 0;
+
+    if (phase == NO_PHASE || phase == state.phase)
+    {
+        phase = state.phase;
+        i = findPhaseChange(data, 1, numSamples, phase);
+    }
+
+    while (i < numSamples)
+    {
+        phase = getPhase(data[i], i > 0 ? data[i - 1] : state.lastSample);
+
+        if (phase == targetPhase)
+            offsets[numCrossings++] = i;
+
+        i = findPhaseChange(data, i + 1, numSamples, phase);
+    }
+
+    state.phase = phase;
+    state.lastSample = data[numSamples - 1];
+
+    return numCrossings;
+}
+
+int CrossingDetector::findFirstBelow(const float* data, int start, int end, float level)
+{
+    int i = start;
+
+    for (; i + CROSSING_SCAN_WIDTH <= end; i += CROSSING_SCAN_WIDTH)
+    {
+        if (anyBelow(data + i, level))
+            break;
+    }
+
+    for (; i < end; i++)
+    {
+        if (data[i] < level)
+            return i;
+    }
+
+    return end;
+}
+
+int CrossingDetector::findFirstAbove(const float* data, int start, int end, float level)
+{
+    int i = start;
+
+    for (; i + CROSSING_SCAN_WIDTH <= end; i += CROSSING_SCAN_WIDTH)
+    {
+        if (anyAbove(data + i, level))
+            break;
+    }
+
+    for (; i < end; i++)
+    {
+        if (data[i] > level)
+            return i;
+    }
+
+    return end;
+}
+
+int CrossingDetector::findPhaseChange(const float* data, int start, int end, int phase)
+{
+    int i = start;
+
+#if JUCE_INTEL
+    // the four phases can't overlap, so a change is any of the other three
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 allOnes = _mm_cmpeq_ps(zero, zero);
+    const __m128 keepFallingPos = (phase == FALLING_POS) ? zero : allOnes;
+    const __m128 keepFallingNeg = (phase == FALLING_NEG) ? zero : allOnes;
+    const __m128 keepRisingNeg = (phase == RISING_NEG) ? zero : allOnes;
+    const __m128 keepRisingPos = (phase == RISING_POS) ? zero : allOnes;
+#endif
+
+    for (; i + CROSSING_SCAN_WIDTH <= end; i += CROSSING_SCAN_WIDTH)
+    {
+#if JUCE_INTEL
+        __m128 found = zero;
+
+        for (int j = 0; j < CROSSING_SCAN_WIDTH; j += 4)
+        {
+            const __m128 sample = _mm_loadu_ps(data + i + j);
+            const __m128 previous = _mm_loadu_ps(data + i + j - 1);
+
+            // the same comparisons as getPhase()
+            const __m128 fallingPos = _mm_and_ps(_mm_cmplt_ps(sample, previous), _mm_cmpgt_ps(sample, zero));
+            const __m128 fallingNeg = _mm_and_ps(_mm_cmplt_ps(sample, zero), _mm_cmpge_ps(previous, zero));
+            const __m128 risingNeg = _mm_and_ps(_mm_cmpgt_ps(sample, previous), _mm_cmplt_ps(sample, zero));
+            const __m128 risingPos = _mm_and_ps(_mm_cmpgt_ps(sample, zero), _mm_cmple_ps(previous, zero));
+
+            found = _mm_or_ps(found, _mm_or_ps(_mm_or_ps(_mm_and_ps(fallingPos, keepFallingPos),
+                                                         _mm_and_ps(fallingNeg, keepFallingNeg)),
+                                               _mm_or_ps(_mm_and_ps(risingNeg, keepRisingNeg),
+                                                         _mm_and_ps(risingPos, keepRisingPos))));
+        }
+
+        if (_mm_movemask_ps(found) != 0)
+            break;
+#else
+        int found = 0;
+
+        for (int j = 0; j < CROSSING_SCAN_WIDTH; j++)
+        {
+            const int p = getPhase(data[i + j], data[i + j - 1]);
+            found += ((p != NO_PHASE) & (p != phase)) ? 1 : 0;
+        }
+
+        if (found)
+            break;
+#endif
+    }
+
+    for (; i < end; i++)
+    {
+        const int p = getPhase(data[i], data[i - 1]);
+
+        if (p != NO_PHASE && p != phase)
+            return i;
+    }
+
+    return end;
+}
@@ -0,0 +1,119 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef __CROSSINGDETECTOR_H_2A7E41C9__
+#define __CROSSINGDETECTOR_H_2A7E41C9__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+#define CROSSING_SCAN_WIDTH 16   // samples tested at once while nothing happens
+#define CROSSING_CHUNK_SIZE 4096 // samples per call; offset arrays must hold this many
+
+/**
+
+  Finds threshold crossings and phase changes in continuous data, for the
+  EventDetector and the PhaseDetector.
+
+  Each channel keeps its state between blocks (the hysteresis of level
+  crossings, the last sample and the current phase), so an event is found
+  at the same sample whatever the block size. Blocks are scanned
+  CROSSING_SCAN_WIDTH samples at a time with SSE comparisons (branch-free
+  scalar ones on other processors); only the group in which something
+  happens is looked at sample by sample.
+
+  Results are returned as arrays of sample offsets within the block, so the
+  caller can add all of a block's events at once.
+
+  @see EventDetector, PhaseDetector
+
+*/
+
+class CrossingDetector
+{
+public:
+
+    /** Where a signal is in its cycle; the order matches the PhaseDetector's. */
+    enum PhaseType
+    {
+        NO_PHASE, RISING_POS, FALLING_POS, FALLING_NEG, RISING_NEG
+    };
+
+    CrossingDetector();
+    ~CrossingDetector();
+
+    /** Keeps the state of existing channels; new ones start reset. */
+    void setNumChannels(int numChannels);
+    int getNumChannels() const;
+
+    void reset();
+
+    /** Finds where a channel goes below level (it triggers) and then back
+        above rearmLevel (it re-arms). Returns the number of offsets; the
+        state toggles at each one, starting from isTriggered(). At most
+        CROSSING_CHUNK_SIZE samples. */
+    int findLevelCrossings(int chan, const float* data, int numSamples,
+                           float level, float rearmLevel, int* offsets);
+
+    bool isTriggered(int chan) const;
+
+    /** Finds where a channel enters targetPhase: the positive peak
+        (FALLING_POS), the falling zero crossing (FALLING_NEG), the trough
+        (RISING_NEG) or the rising zero crossing (RISING_POS). Returns the
+        number of offsets. At most CROSSING_CHUNK_SIZE samples. */
+    int findPhase(int chan, const float* data, int numSamples,
+                  PhaseType targetPhase, int* offsets);
+
+    /** The first sample from start on that is below level, or end. */
+    static int findFirstBelow(const float* data, int start, int end, float level);
+
+    /** The first sample from start on that is above level, or end. */
+    static int findFirstAbove(const float* data, int start, int end, float level);
+
+private:
+
+    struct ChannelState
+    {
+        bool triggered;
+        float lastSample;
+        int phase;
+    };
+
+    /** The phase that a step from previous to sample starts, or NO_PHASE. The
+        four cases can't overlap, so at most one term is non-zero. */
+    static inline int getPhase(float sample, float previous)
+    {
+        return ((sample < previous) & (sample > 0.0f)) * FALLING_POS
+               | ((sample < 0.0f) & (previous >= 0.0f)) * FALLING_NEG
+               | ((sample > previous) & (sample < 0.0f)) * RISING_NEG
+               | ((sample > 0.0f) & (previous <= 0.0f)) * RISING_POS;
+    }
+
+    /** The first sample from start on (start > 0) whose phase isn't NO_PHASE or phase. */
+    static int findPhaseChange(const float* data, int start, int end, int phase);
+
+    Array<ChannelState> states;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CrossingDetector);
+
+};
+
+#endif  // __CROSSINGDETECTOR_H_2A7E41C9__
@@ -31,6 +31,8 @@ PhaseDetector::PhaseDetector()
 
 {
 
+    crossings.malloc(CROSSING_CHUNK_SIZE);
+
 }
 
 PhaseDetector::~PhaseDetector()
@@ -54,13 +56,13 @@ void PhaseDetector::addModule()
     m.outputChan = -1;
     m.gateChan = -1;
     m.isActive = true;
-    m.lastSample = 0.0f;
     m.type = NONE;
     m.samplesSinceTrigger = 5000;
     m.wasTriggered = false;
-    m.phase = NO_PHASE;
 
     modules.add(m);
+
+    detector.setNumChannels(modules.size());
 }
 
 void PhaseDetector::setActiveModule(int i)
@@ -73,7 +75,21 @@ void PhaseDetector::setActiveModule(int i)
 void PhaseDetector::setParameter(int parameterIndex, float newValue)
 {
 
-    DetectorModule& module = modules.getReference(activeModule);
+    if (activeModule >= 0 && activeModule < modules.size())
+        queueParameterChange(parameterIndex, newValue, activeModule);
+
+}
+
+void PhaseDetector::applyParameterChange(const ParameterChange& change)
+{
+
+    if (change.channel < 0 || change.channel >= modules.size())
+        return;
+
+    DetectorModule& module = modules.getReference(change.channel);
+
+    const int parameterIndex = change.parameterIndex;
+    const float newValue = change.value;
 
     if (parameterIndex == 1) // module type
     {
@@ -131,9 +147,28 @@ void PhaseDetector::updateSettings()
 
 bool PhaseDetector::enable()
 {
+    detector.reset();
+
     return true;
 }
 
+CrossingDetector::PhaseType PhaseDetector::getTargetPhase(ModuleType type)
+{
+    switch (type)
+    {
+        case PEAK:
+            return CrossingDetector::FALLING_POS;
+        case FALLING_ZERO:
+            return CrossingDetector::FALLING_NEG;
+        case TROUGH:
+            return CrossingDetector::RISING_NEG;
+        case RISING_ZERO:
+            return CrossingDetector::RISING_POS;
+        default:
+            return CrossingDetector::NO_PHASE;
+    }
+}
+
 void PhaseDetector::handleEvent(int eventType, MidiMessage& event, int sampleNum)
 {
     // MOVED GATING TO PULSE PAL OUTPUT!
@@ -173,89 +208,52 @@ void PhaseDetector::process(AudioSampleBuffer& buffer,
     checkForEvents(events);
 
     // loop through the modules
-    for (int i = 0; i < modules.size(); i++)
+    for (int m = 0; m < modules.size(); m++)
     {
-        DetectorModule& module = modules.getReference(i);
+        DetectorModule& module = modules.getReference(m);
 
         // check to see if it's active and has a channel
         if (module.isActive && module.outputChan >= 0 &&
             module.inputChan >= 0 &&
             module.inputChan < buffer.getNumChannels())
         {
-            for (int i = 0; i < getNumSamples(module.inputChan); i++)
-            {
-                const float sample = *buffer.getReadPointer(module.inputChan, i);
-
-                if (sample < module.lastSample && sample > 0 && module.phase != FALLING_POS)
-                {
+            const float* data = buffer.getReadPointer(module.inputChan);
+            const int nSamples = jmin(getNumSamples(module.inputChan), buffer.getNumSamples());
 
-                    if (module.type == PEAK)
-                    {
-                        addEvent(events, TTL, i, 1, module.outputChan);
-                        module.samplesSinceTrigger = 0;
-                        module.wasTriggered = true;
-                    }
+            const CrossingDetector::PhaseType target = getTargetPhase(module.type);
 
-                    module.phase = FALLING_POS;
+            // where the pulse of the last trigger ends, relative to this block
+            int pulseEnd = module.wasTriggered ? PHASE_DETECTOR_PULSE_LENGTH - module.samplesSinceTrigger : -1;
 
-                }
-                else if (sample < 0 && module.lastSample >= 0 && module.phase != FALLING_NEG)
-                {
-
-                    if (module.type == FALLING_ZERO)
-                    {
-                        addEvent(events, TTL, i, 1, module.outputChan);
-                        module.samplesSinceTrigger = 0;
-                        module.wasTriggered = true;
-                    }
-
-                    module.phase = FALLING_NEG;
-
-                }
-                else if (sample > module.lastSample && sample < 0 && module.phase != RISING_NEG)
-                {
-
-                    if (module.type == TROUGH)
-                    {
-                        addEvent(events, TTL, i, 1, module.outputChan);
-                        module.samplesSinceTrigger = 0;
-                        module.wasTriggered = true;
-                    }
-
-                    module.phase = RISING_NEG;
+            for (int start = 0; start < nSamples; start += CROSSING_CHUNK_SIZE)
+            {
+                const int numCrossings = detector.findPhase(m, data + start,
+                                                            jmin(CROSSING_CHUNK_SIZE, nSamples - start),
+                                                            target, crossings);
 
-                }
-                else if (sample > 0 && module.lastSample <= 0 && module.phase != RISING_POS)
+                for (int i = 0; i < numCrossings; i++)
                 {
+                    const int sampleNum = start + crossings[i];
 
-                    if (module.type == RISING_ZERO)
-                    {
-                        addEvent(events, TTL, i, 1, module.outputChan);
-                        module.samplesSinceTrigger = 0;
-                        module.wasTriggered = true;
-                    }
-
-                    module.phase = RISING_POS;
+                    // a trigger before the end of the pulse extends it
+                    if (pulseEnd >= 0 && pulseEnd < sampleNum)
+                        addEvent(events, TTL, pulseEnd, 0, module.outputChan);
 
+                    addEvent(events, TTL, sampleNum, 1, module.outputChan);
+                    pulseEnd = sampleNum + PHASE_DETECTOR_PULSE_LENGTH;
                 }
-
-                module.lastSample = sample;
-
-                if (module.wasTriggered)
-                {
-                    if (module.samplesSinceTrigger > 1000)
-                    {
-                        addEvent(events, TTL, i, 0, module.outputChan);
-                        module.wasTriggered = false;
-                    }
-                    else
-                    {
-                        module.samplesSinceTrigger++;
-                    }
-                }
-
             }
 
+            if (pulseEnd >= 0 && pulseEnd < nSamples)
+            {
+                addEvent(events, TTL, pulseEnd, 0, module.outputChan);
+                module.wasTriggered = false;
+            }
+            else if (pulseEnd >= 0)
+            {
+                module.wasTriggered = true;
+                module.samplesSinceTrigger = PHASE_DETECTOR_PULSE_LENGTH - (pulseEnd - nSamples);
+            }
 
         }
 
@@ -27,14 +27,22 @@
 
 #include "../../../JuceLibraryCode/JuceHeader.h"
 #include "../GenericProcessor/GenericProcessor.h"
+#include "CrossingDetector.h"
 
 #define NUM_INTERVALS 5
+#define PHASE_DETECTOR_PULSE_LENGTH 1001 // samples from a trigger to its "off" event
 
 /**
 
   Uses peaks to estimate the phase of a continuous signal.
 
-  @see GenericProcessor, PhaseDetectorEditor
+  Each module watches one input channel and sends a TTL pulse on its output
+  channel whenever the input reaches the selected phase (a peak, trough or
+  zero crossing). The phases are found by a CrossingDetector, which keeps
+  each module's state between blocks, so many modules can run within one
+  callback.
+
+  @see GenericProcessor, PhaseDetectorEditor, CrossingDetector
 
 */
 
@@ -63,6 +71,8 @@ public:
     void addModule();
     void setActiveModule(int);
 
+    void applyParameterChange(const ParameterChange& change);
+
 private:
 
     enum ModuleType
@@ -70,11 +80,6 @@ private:
         NONE, PEAK, FALLING_ZERO, TROUGH, RISING_ZERO
     };
 
-    enum PhaseType
-    {
-        NO_PHASE, RISING_POS, FALLING_POS, FALLING_NEG, RISING_NEG
-    };
-
     struct DetectorModule
     {
 
@@ -82,15 +87,19 @@ private:
         int gateChan;
         int outputChan;
         bool isActive;
-        float lastSample;
         int samplesSinceTrigger;
         bool wasTriggered;
         ModuleType type;
-        PhaseType phase;
     };
 
+    /** The phase at which a module of the given type triggers. */
+    static CrossingDetector::PhaseType getTargetPhase(ModuleType type);
+
     Array<DetectorModule> modules;
 
+    CrossingDetector detector; // one channel per module
+    HeapBlock<int> crossings;
+
     int activeModule;
 
     void handleEvent(int eventType, MidiMessage& event, int sampleNum);
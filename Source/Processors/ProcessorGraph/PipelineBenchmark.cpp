@@ -0,0 +1,522 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PipelineBenchmark.h"
+#include "ProcessorGraph.h"
+#include "../GenericProcessor/GenericProcessor.h"
+#include "../SourceNode/SourceNode.h"
+#include "../DataThreads/NeuralSimulatorThread.h"
+#include "../SpikeDetector/SpikeDetectorEditor.h"
+#include "../SpikeSorter/SpikeSorter.h"
+#include "../SpikeSorter/SpikeSorterEditor.h"
+#include "../AudioNode/AudioNode.h"
+#include "../RecordNode/RecordNode.h"
+#include "../RecordNode/RecordEngine.h"
+#include "../../UI/EditorViewport.h"
+#include "../../Audio/AudioComponent.h"
+
+PipelineBenchmark::PipelineBenchmark(const StringArray& parameters)
+{
+    channelCounts = getIntList(getOption(parameters, "--channels", "64,384"));
+    blockSizes = getIntList(getOption(parameters, "--block-sizes", "512,2048"));
+
+    numBlocks = jlimit(1, PROFILE_WINDOW_SIZE, getOption(parameters, "--blocks", "500").getIntValue());
+    tolerance = jmax(0.0, getOption(parameters, "--tolerance", "0.1").getDoubleValue());
+
+    const File cwd = File::getCurrentWorkingDirectory();
+
+    outputFile = cwd.getChildFile(getOption(parameters, "--output", "benchmark.json"));
+
+    const String baseline = getOption(parameters, "--baseline", String::empty);
+
+    if (baseline.isNotEmpty())
+        baselineFile = cwd.getChildFile(baseline);
+
+    const String recordDir = getOption(parameters, "--record-dir", String::empty);
+
+    if (recordDir.isNotEmpty())
+        recordingDirectory = cwd.getChildFile(recordDir);
+    else
+        recordingDirectory = File::getSpecialLocation(File::tempDirectory).getChildFile("open-ephys-benchmark");
+}
+
+PipelineBenchmark::~PipelineBenchmark()
+{
+
+}
+
+bool PipelineBenchmark::isRequested(const StringArray& parameters)
+{
+    return parameters.contains("--benchmark", true);
+}
+
+String PipelineBenchmark::getOption(const StringArray& parameters, const String& name, const String& defaultValue)
+{
+    for (int i = 0; i < parameters.size(); i++)
+    {
+        if (parameters[i].startsWithIgnoreCase(name + "="))
+            return parameters[i].fromFirstOccurrenceOf("=", false, false).unquoted();
+    }
+
+    return defaultValue;
+}
+
+Array<int> PipelineBenchmark::getIntList(const String& text)
+{
+    StringArray tokens;
+    tokens.addTokens(text, ",", String::empty);
+
+    Array<int> values;
+
+    for (int i = 0; i < tokens.size(); i++)
+    {
+        const int value = tokens[i].trim().getIntValue();
+
+        if (value > 0)
+            values.addIfNotAlreadyThere(value);
+    }
+
+    return values;
+}
+
+void PipelineBenchmark::timerCallback()
+{
+    stopTimer();
+
+    const int exitCode = run();
+
+    JUCEApplication::getInstance()->setApplicationReturnValue(exitCode);
+    JUCEApplication::quit();
+}
+
+int PipelineBenchmark::run()
+{
+    if (getAudioComponent()->callbacksAreActive())
+    {
+        std::cout << "Benchmark: stop acquisition first." << std::endl;
+        return 2;
+    }
+
+    // keep the user's signal chain, so that quitting doesn't save the benchmark chain over it
+    const File tempDirectory = File::getSpecialLocation(File::tempDirectory);
+    const File savedChain = tempDirectory.getNonexistentChildFile("benchmark-saved-chain", ".xml");
+
+    getEditorViewport()->saveState(savedChain);
+
+    recordingDirectory.createDirectory();
+
+    Array<var> runs;
+    bool failed = false;
+
+    for (int e = 0; e < RecordEngineManager::getNumOfBuiltInEngines() && !failed; e++)
+    {
+        ScopedPointer<RecordEngineManager> manager = RecordEngineManager::createBuiltInEngineManager(e);
+        const String engineId = manager->getID();
+
+        for (int c = 0; c < channelCounts.size() && !failed; c++)
+        {
+            const int numChannels = jmin(channelCounts[c], NEURAL_SIMULATOR_MAX_CHANNELS);
+
+            if (!loadChain(numChannels, e))
+            {
+                failed = true;
+                break;
+            }
+
+            for (int b = 0; b < blockSizes.size(); b++)
+            {
+                const int blockSize = jmin(blockSizes[b], BENCHMARK_MAX_BLOCK_SIZE);
+
+                std::cout << "Benchmark: " << engineId << ", " << numChannels << " channels, "
+                          << blockSize << " samples per block" << std::endl;
+
+                var result = measure(blockSize);
+
+                if (!result.isObject())
+                {
+                    failed = true;
+                    break;
+                }
+
+                result.getDynamicObject()->setProperty("engine", engineId);
+                runs.add(result);
+            }
+        }
+    }
+
+    getEditorViewport()->loadState(savedChain);
+    savedChain.deleteFile();
+
+    if (failed)
+    {
+        std::cout << "Benchmark: could not run the signal chain." << std::endl;
+        return 2;
+    }
+
+    DynamicObject* results = new DynamicObject();
+    var resultsVar(results);
+
+    results->setProperty("version", JUCEApplication::getInstance()->getApplicationVersion());
+    results->setProperty("date", Time::getCurrentTime().toString(true, true, true, true));
+    results->setProperty("os", SystemStats::getOperatingSystemName());
+    results->setProperty("cpu", SystemStats::getCpuVendor());
+    results->setProperty("numCpus", SystemStats::getNumCpus());
+    results->setProperty("cpuSpeedMHz", SystemStats::getCpuSpeedInMegaherz());
+    results->setProperty("blocksPerRun", numBlocks);
+    results->setProperty("runs", runs);
+
+    int exitCode = 0;
+
+    if (baselineFile != File::nonexistent)
+    {
+        const var baseline = JSON::parse(baselineFile);
+
+        if (!baseline.isObject())
+        {
+            std::cout << "Benchmark: " << baselineFile.getFullPathName() << " is not a benchmark result." << std::endl;
+            exitCode = 2;
+        }
+        else
+        {
+            Array<var> regressions = compareWithBaseline(runs, baseline);
+
+            results->setProperty("baseline", baselineFile.getFullPathName());
+            results->setProperty("baselineVersion", baseline["version"]);
+            results->setProperty("regressions", regressions);
+
+            for (int i = 0; i < regressions.size(); i++)
+                std::cout << "Benchmark regression: " << regressions[i].toString() << std::endl;
+
+            if (regressions.size() > 0)
+                exitCode = 1;
+        }
+    }
+
+    if (outputFile.replaceWithText(JSON::toString(resultsVar)))
+        std::cout << "Benchmark results written to " << outputFile.getFullPathName() << std::endl;
+    else
+    {
+        std::cout << "Benchmark: could not write " << outputFile.getFullPathName() << std::endl;
+        exitCode = 2;
+    }
+
+    return exitCode;
+}
+
+bool PipelineBenchmark::loadChain(int numChannels, int engineIndex)
+{
+    const char* chain[] = {"Sources/Neural Simulator",
+                           "Filters/Bandpass Filter",
+                           "Filters/Common Avg Ref",
+                           "Filters/Spike Detector",
+                           "Filters/Spike Sorter"
+                          };
+
+    XmlElement xml("SETTINGS");
+
+    XmlElement* version = xml.createNewChildElement("INFO")->createNewChildElement("VERSION");
+    version->addTextElement(JUCEApplication::getInstance()->getApplicationVersion());
+
+    XmlElement* signalChain = xml.createNewChildElement("SIGNALCHAIN");
+
+    for (int i = 0; i < 5; i++)
+    {
+        XmlElement* processor = signalChain->createNewChildElement("PROCESSOR");
+        processor->setAttribute("name", chain[i]);
+        processor->setAttribute("insertionPoint", 1);
+        processor->setAttribute("NodeId", 100 + i);
+
+        if (i == 0)
+        {
+            // a fixed seed and unit density, so every run sees the same data
+            XmlElement* editor = processor->createNewChildElement("EDITOR");
+            editor->setAttribute("NumChannels", numChannels);
+            editor->setAttribute("SampleRate", BENCHMARK_SAMPLE_RATE);
+            editor->setAttribute("NumUnits", jmax(8, numChannels / 4));
+            editor->setAttribute("Seed", 1);
+        }
+    }
+
+    XmlElement* controlPanel = xml.createNewChildElement("CONTROLPANEL");
+    controlPanel->setAttribute("isOpen", false);
+    controlPanel->setAttribute("recordEngine", engineIndex + 1);
+
+    const File chainFile = File::getSpecialLocation(File::tempDirectory).getNonexistentChildFile("benchmark-chain", ".xml");
+
+    if (!xml.writeToFile(chainFile, String::empty))
+        return false;
+
+    getEditorViewport()->loadState(chainFile);
+    chainFile.deleteFile();
+
+    if (getSimulator() == nullptr || getChain().size() < 7)
+        return false;
+
+    getSimulator()->setRealTime(false);
+
+    addTetrodes(numChannels);
+
+    return true;
+}
+
+void PipelineBenchmark::addTetrodes(int numChannels)
+{
+    GenericProcessor* detector = findProcessor("Spike Detector");
+    SpikeSorter* sorter = (SpikeSorter*) findProcessor("Spike Sorter");
+
+    if (detector != nullptr)
+    {
+        SpikeDetectorEditor* editor = (SpikeDetectorEditor*) detector->getEditor();
+
+        for (int i = 0; i + 4 <= numChannels; i += 4)
+            editor->addElectrode(4);
+    }
+
+    if (sorter != nullptr)
+    {
+        for (int i = 0; i + 4 <= numChannels; i += 4)
+            sorter->addElectrode(4, "Tetrode " + String(i / 4 + 1), 0);
+
+        ((SpikeSorterEditor*) sorter->getEditor())->refreshElectrodeList();
+    }
+
+    if (detector != nullptr)
+        getEditorViewport()->makeEditorVisible(detector->getEditor(), false, true);
+}
+
+var PipelineBenchmark::measure(int blockSize)
+{
+    ProcessorGraph* graph = getProcessorGraph();
+    NeuralSimulatorThread* simulator = getSimulator();
+
+    graph->getRecordNode()->setDataDirectory(recordingDirectory);
+
+    if (!graph->enableProcessors())
+        return var::null;
+
+    graph->prepareToPlay(BENCHMARK_OUTPUT_RATE, blockSize);
+
+    Array<GenericProcessor*> processors = getChain();
+
+    AudioSampleBuffer output(2, blockSize);
+    MidiBuffer events;
+
+    for (int n = 0; n < BENCHMARK_WARMUP_BLOCKS; n++)
+    {
+        simulator->fillBuffer(blockSize);
+        events.clear();
+        graph->processBlock(output, events);
+    }
+
+    graph->setRecordState(true);
+
+    for (int i = 0; i < processors.size(); i++)
+        processors[i]->getProfile().reset();
+
+    int64 chainTicks = 0;
+
+    for (int n = 0; n < numBlocks; n++)
+    {
+        simulator->fillBuffer(blockSize);
+        events.clear();
+
+        const int64 start = Time::getHighResolutionTicks();
+        graph->processBlock(output, events);
+        chainTicks += Time::getHighResolutionTicks() - start;
+    }
+
+    // read the profiles before the block that closes the files
+    const double samplesPerRun = double(blockSize) * numBlocks;
+    double recordMs = 0;
+
+    Array<var> nodes;
+
+    for (int i = 0; i < processors.size(); i++)
+    {
+        const ProcessingStats stats = processors[i]->getProfile().getStats();
+
+        DynamicObject* node = new DynamicObject();
+        node->setProperty("name", processors[i]->getName());
+        node->setProperty("nsPerSample", stats.meanMs * 1.0e6 / blockSize);
+        node->setProperty("p99Ms", stats.p99Ms);
+        node->setProperty("maxMs", stats.maxMs);
+
+        if (AllocationCounter::isEnabled())
+            node->setProperty("allocationsPerBlock", stats.meanAllocations);
+
+        nodes.add(var(node));
+
+        if (processors[i] == graph->getRecordNode())
+            recordMs = stats.meanMs * stats.numBlocks;
+    }
+
+    graph->setRecordState(false);
+
+    simulator->fillBuffer(blockSize);
+    events.clear();
+    graph->processBlock(output, events); // lets the RecordNode close its files
+
+    graph->disableProcessors();
+
+    const File recording = graph->getRecordNode()->getDataDirectory();
+    int64 bytesWritten = 0;
+
+    if (recording.isDirectory() && recording.isAChildOf(recordingDirectory))
+    {
+        Array<File> files;
+        recording.findChildFiles(files, File::findFiles, true);
+
+        for (int i = 0; i < files.size(); i++)
+            bytesWritten += files[i].getSize();
+
+        recording.deleteRecursively();
+    }
+
+    const double chainSeconds = Time::highResolutionTicksToSeconds(chainTicks);
+    const double dataSeconds = samplesPerRun / BENCHMARK_SAMPLE_RATE;
+
+    DynamicObject* result = new DynamicObject();
+    var resultVar(result);
+
+    result->setProperty("channels", simulator->getNumChannels());
+    result->setProperty("blockSize", blockSize);
+    result->setProperty("sampleRate", BENCHMARK_SAMPLE_RATE);
+    result->setProperty("chainNsPerSample", chainSeconds * 1.0e9 / samplesPerRun);
+    result->setProperty("realTimeLoad", chainSeconds / dataSeconds);
+    result->setProperty("bytesWritten", bytesWritten);
+    result->setProperty("diskMBps", recordMs > 0 ? (bytesWritten / 1.0e6) / (recordMs / 1000.0) : 0.0);
+    result->setProperty("nodes", nodes);
+
+    return resultVar;
+}
+
+Array<var> PipelineBenchmark::compareWithBaseline(const Array<var>& runs, const var& baseline)
+{
+    Array<var> regressions;
+
+    const Array<var>* baselineRuns = baseline["runs"].getArray();
+
+    if (baselineRuns == nullptr)
+        return regressions;
+
+    for (int r = 0; r < runs.size(); r++)
+    {
+        const var& current = runs.getReference(r);
+        const String label = current["engine"].toString() + ", " + current["channels"].toString()
+                             + " ch, " + current["blockSize"].toString() + " samples: ";
+
+        for (int b = 0; b < baselineRuns->size(); b++)
+        {
+            const var& previous = baselineRuns->getReference(b);
+
+            if (previous["engine"] != current["engine"] ||
+                (int) previous["channels"] != (int) current["channels"] ||
+                (int) previous["blockSize"] != (int) current["blockSize"])
+                continue;
+
+            const Array<var>* currentNodes = current["nodes"].getArray();
+            const Array<var>* previousNodes = previous["nodes"].getArray();
+
+            for (int i = 0; currentNodes != nullptr && previousNodes != nullptr && i < currentNodes->size(); i++)
+            {
+                const var& node = currentNodes->getReference(i);
+
+                for (int j = 0; j < previousNodes->size(); j++)
+                {
+                    const var& previousNode = previousNodes->getReference(j);
+
+                    if (previousNode["name"] != node["name"])
+                        continue;
+
+                    const double ns = node["nsPerSample"];
+                    const double previousNs = previousNode["nsPerSample"];
+                    const var allocations = node["allocationsPerBlock"];
+                    const var previousAllocations = previousNode["allocationsPerBlock"];
+
+                    if (ns > previousNs * (1.0 + tolerance))
+                        regressions.add(label + node["name"].toString() + " takes " + String(ns, 1)
+                                        + " ns/sample (was " + String(previousNs, 1) + ")");
+
+                    // only builds with OPEN_EPHYS_COUNT_ALLOCATIONS report allocations
+                    if (!allocations.isVoid() && !previousAllocations.isVoid()
+                        && double(allocations) > double(previousAllocations) + 0.5)
+                        regressions.add(label + node["name"].toString() + " allocates " + String(double(allocations), 1)
+                                        + " times per block (was " + String(double(previousAllocations), 1) + ")");
+
+                    break;
+                }
+            }
+
+            const double disk = current["diskMBps"];
+            const double previousDisk = previous["diskMBps"];
+
+            if (disk < previousDisk * (1.0 - tolerance))
+                regressions.add(label + "writes " + String(disk, 1) + " MB/s (was " + String(previousDisk, 1) + ")");
+
+            break;
+        }
+    }
+
+    return regressions;
+}
+
+GenericProcessor* PipelineBenchmark::findProcessor(const String& name)
+{
+    Array<GenericProcessor*> processors = getProcessorGraph()->getListOfProcessors();
+
+    for (int i = 0; i < processors.size(); i++)
+    {
+        if (processors[i]->getName().equalsIgnoreCase(name))
+            return processors[i];
+    }
+
+    return nullptr;
+}
+
+NeuralSimulatorThread* PipelineBenchmark::getSimulator()
+{
+    SourceNode* source = (SourceNode*) findProcessor("Neural Simulator");
+
+    if (source == nullptr)
+        return nullptr;
+
+    return (NeuralSimulatorThread*) source->getThread();
+}
+
+Array<GenericProcessor*> PipelineBenchmark::getChain()
+{
+    Array<GenericProcessor*> chain;
+
+    for (GenericProcessor* p = findProcessor("Neural Simulator"); p != nullptr; p = p->getDestNode())
+    {
+        if (chain.contains(p))
+            break;
+
+        chain.add(p);
+    }
+
+    chain.add(getProcessorGraph()->getRecordNode());
+    chain.add(getProcessorGraph()->getAudioNode());
+
+    return chain;
+}
@@ -0,0 +1,127 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PIPELINEBENCHMARK_H_3F6C1A9D__
+#define __PIPELINEBENCHMARK_H_3F6C1A9D__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../../AccessClass.h"
+
+#define BENCHMARK_WARMUP_BLOCKS 50
+#define BENCHMARK_MAX_BLOCK_SIZE 8192 // leaves room in the simulator's buffer
+#define BENCHMARK_SAMPLE_RATE 30000
+#define BENCHMARK_OUTPUT_RATE 44100.0 // monitor output, as if from the audio device
+
+class GenericProcessor;
+class NeuralSimulatorThread;
+
+/**
+
+  Measures the signal chain without an audio device, so that releases can
+  be compared before they are deployed.
+
+  Started with "--benchmark" on the command line. For every channel count,
+  record engine and block size, the benchmark:
+
+  - loads a Neural Simulator -> Bandpass Filter -> Common Avg Ref ->
+    Spike Detector -> Spike Sorter chain (one tetrode per four channels).
+  - enables the processors as acquisition would, and calls the
+    ProcessorGraph's processBlock() itself, generating each block of
+    simulated data on demand so the source never waits.
+  - records while it measures, into a temporary directory.
+
+  Each processor's ns per sample, p99 block time and (in builds with
+  OPEN_EPHYS_COUNT_ALLOCATIONS) allocations per block come from its
+  ProcessingProfile; the RecordNode's time and the
+  size of the files it wrote give the disk throughput. The results are
+  written as JSON. If a baseline file from an earlier run is given, runs
+  that got slower by more than the tolerance are listed, and the
+  application exits with a non-zero code.
+
+  Options:
+  --channels=64,384      channel counts
+  --block-sizes=512,2048 samples per block
+  --blocks=500           measured blocks per run (at most PROFILE_WINDOW_SIZE)
+  --output=file.json     where to write the results
+  --baseline=file.json   results to compare against
+  --tolerance=0.1        allowed slowdown before a run counts as a regression
+  --record-dir=path      where the test recordings are written (and deleted)
+
+  The signal chain that was open before the benchmark is restored afterwards.
+
+  @see ProcessorGraph, ProcessingProfile, NeuralSimulatorThread
+
+*/
+
+class PipelineBenchmark : public Timer,
+    public AccessClass
+{
+public:
+    PipelineBenchmark(const StringArray& parameters);
+    ~PipelineBenchmark();
+
+    /** True if the command line asks for a benchmark run. */
+    static bool isRequested(const StringArray& parameters);
+
+    /** Runs the whole benchmark once the main window is up, then quits. */
+    void timerCallback();
+
+private:
+
+    /** Runs every configuration; returns the application's exit code. */
+    int run();
+
+    /** Replaces the signal chain with the benchmark chain. */
+    bool loadChain(int numChannels, int engineIndex);
+
+    /** Adds tetrodes covering every channel to the spike detector and sorter. */
+    void addTetrodes(int numChannels);
+
+    /** Measures one block size on the loaded chain. */
+    var measure(int blockSize);
+
+    /** Lists the runs that are slower than the baseline (as text). */
+    Array<var> compareWithBaseline(const Array<var>& runs, const var& baseline);
+
+    GenericProcessor* findProcessor(const String& name);
+    NeuralSimulatorThread* getSimulator();
+
+    /** The processors of the chain, in order, then the RecordNode and AudioNode. */
+    Array<GenericProcessor*> getChain();
+
+    static String getOption(const StringArray& parameters, const String& name, const String& defaultValue);
+    static Array<int> getIntList(const String& text);
+
+    Array<int> channelCounts;
+    Array<int> blockSizes;
+    int numBlocks;
+    double tolerance;
+    File outputFile;
+    File baselineFile;
+    File recordingDirectory;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PipelineBenchmark);
+
+};
+
+#endif  // __PIPELINEBENCHMARK_H_3F6C1A9D__
@@ -53,6 +53,7 @@
 #include "../NetworkEvents/NetworkEvents.h"
 #include "../PSTH/PeriStimulusTimeHistogramNode.h"
 #include "../CAR/CAR.h"
+#include "../NetworkSink/NetworkSink.h"
 
 
 #ifdef ZEROMQ 
@@ -70,6 +71,8 @@
 ProcessorGraph::ProcessorGraph() : currentNodeId(100)
 {
 
+    executor = new SignalChainExecutor();
+
 	createZmqContext();
     // The ProcessorGraph will always have 0 inputs (all content is generated within graph)
     // but it will have N outputs, where N is the number of channels for the audio monitor
@@ -117,6 +120,8 @@ void ProcessorGraph::createDefaultNodes()
     addNode(an, AUDIO_NODE_ID);
     addNode(msgCenter, MESSAGE_CENTER_ID);
 
+    executor->setSinkNodes(recn, an, msgCenter);
+
 }
 
 void ProcessorGraph::updatePointers()
@@ -290,22 +295,16 @@ void ProcessorGraph::clearConnections()
         }
     }
 
-    // connect audio subnetwork
-    for (int n = 0; n < 2; n++)
-    {
-
-        addConnection(AUDIO_NODE_ID, n,
-                      OUTPUT_NODE_ID, n);
-
-    }
-
-    addConnection(MESSAGE_CENTER_ID, midiChannelIndex,
-                  RECORD_NODE_ID, midiChannelIndex);
+    // the executor feeds the audio output and the message center events
+    // to the record node itself, so no graph connections are needed
+    executor->clear();
 }
 
 
 void ProcessorGraph::updateConnections(Array<SignalChainTabButton*, CriticalSection> tabs)
 {
+    const ScopedLock sl(getCallbackLock()); // the executor's plan is rebuilt below
+
     clearConnections(); // clear processor graph
 
     std::cout << "Updating connections:" << std::endl;
@@ -330,6 +329,9 @@ void ProcessorGraph::updateConnections(Array<SignalChainTabButton*, CriticalSect
 
             if (source->enabledState())
             {
+                if (!(source->isSplitter() || source->isMerger()))
+                    executor->addProcessor(source);
+
                 // add the connections to audio and record nodes if necessary
                 if (!(source->isSink()     ||
                       source->isSplitter() ||
@@ -427,8 +429,73 @@ void ProcessorGraph::updateConnections(Array<SignalChainTabButton*, CriticalSect
         } // end while source != 0
     } // end "tabs" for loop
 
+    executor->build();
+    executor->prepare(getBlockSize());
+
 } // end method
 
+void ProcessorGraph::prepareToPlay(double sampleRate, int estimatedSamplesPerBlock)
+{
+    AudioProcessorGraph::prepareToPlay(sampleRate, estimatedSamplesPerBlock);
+
+    const ScopedLock sl(getCallbackLock());
+    executor->prepare(estimatedSamplesPerBlock);
+}
+
+void ProcessorGraph::processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
+{
+    callbackMonitor.callbackStarted();
+
+    executor->process(buffer, midiMessages);
+
+    callbackMonitor.callbackFinished(buffer.getNumSamples(), getSampleRate());
+}
+
+const CallbackMonitor& ProcessorGraph::getCallbackMonitor()
+{
+    return callbackMonitor;
+}
+
+String ProcessorGraph::getTimingReport()
+{
+    return executor->getBranchTimingReport() + "\n" + callbackMonitor.getSummary();
+}
+
+String ProcessorGraph::exportProfilingTrace(const File& file)
+{
+    String events;
+    Array<Thread::ThreadID> threads;
+
+    callbackMonitor.getProfile().appendTraceEvents(events, "Audio callback", threads);
+
+    for (int i = 0; i < getNumNodes(); i++)
+    {
+        Node* node = getNode(i);
+
+        if (node->nodeId != OUTPUT_NODE_ID)
+        {
+            GenericProcessor* p = (GenericProcessor*) node->getProcessor();
+            p->getProfile().appendTraceEvents(events, p->getName() + " (" + String(p->getNodeId()) + ")", threads);
+        }
+    }
+
+    for (int i = 0; i < threads.size(); i++)
+    {
+        if (events.isNotEmpty())
+            events << ",\n";
+
+        events << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << String(i)
+               << ",\"args\":{\"name\":\"" << (i == 0 && callbackMonitor.getProfile().getNumBlocks() > 0 ? "Audio thread" : "Worker " + String(i)) << "\"}}";
+    }
+
+    String json = "{\"traceEvents\":[\n" + events + "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    if (!file.replaceWithText(json))
+        return "Could not write " + file.getFileName() + ".";
+
+    return "Saved profiling trace to " + file.getFileName() + ".";
+}
+
 void ProcessorGraph::connectProcessors(GenericProcessor* source, GenericProcessor* dest)
 {
 
@@ -438,26 +505,16 @@ void ProcessorGraph::connectProcessors(GenericProcessor* source, GenericProcesso
     std::cout << "     Connecting " << source->getName() << " " << source->getNodeId(); //" channel ";
     std::cout << " to " << dest->getName() << " " << dest->getNodeId() << std::endl;
 
-    // 1. connect continuous channels
+    // 1. claim the dest's input channels
     for (int chan = 0; chan < source->getNumOutputs(); chan++)
     {
         //std::cout << chan << " ";
 
-        addConnection(source->getNodeId(),         // sourceNodeID
-                      chan,                        // sourceNodeChannelIndex
-                      dest->getNodeId(),           // destNodeID
-                      dest->getNextChannel(true)); // destNodeChannelIndex
+        dest->getNextChannel(true);
     }
 
-    // std::cout << "     Connecting " << source->getName() <<
-    //           " event channel to " <<
-    //           dest->getName() << std::endl;
-
-    // 2. connect event channel
-    addConnection(source->getNodeId(),    // sourceNodeID
-                  midiChannelIndex,       // sourceNodeChannelIndex
-                  dest->getNodeId(),      // destNodeID
-                  midiChannelIndex);      // destNodeChannelIndex
+    // 2. let the executor route the continuous and event channels
+    executor->addConnection(source, dest);
 
 }
 
@@ -477,33 +534,16 @@ void ProcessorGraph::connectProcessorToAudioAndRecordNodes(GenericProcessor* sou
         // THIS IS A HACK TO MAKE SURE AUDIO NODE KNOWS WHAT THE SAMPLE RATE SHOULD BE
         // IT CAN CAUSE PROBLEMS IF THE SAMPLE RATE VARIES ACROSS PROCESSORS
         getAudioNode()->settings.sampleRate = source->getSampleRate();
-
-        addConnection(source->getNodeId(),                   // sourceNodeID
-                      chan,                                  // sourceNodeChannelIndex
-                      AUDIO_NODE_ID,                         // destNodeID
-                      getAudioNode()->getNextChannel(true)); // destNodeChannelIndex
+        getAudioNode()->getNextChannel(true);
 
         getRecordNode()->addInputChannel(source, chan);
-
-        addConnection(source->getNodeId(),                    // sourceNodeID
-                      chan,                                   // sourceNodeChannelIndex
-                      RECORD_NODE_ID,                         // destNodeID
-                      getRecordNode()->getNextChannel(true)); // destNodeChannelIndex
+        getRecordNode()->getNextChannel(true);
 
     }
 
-    // connect event channel
-    addConnection(source->getNodeId(),    // sourceNodeID
-                  midiChannelIndex,       // sourceNodeChannelIndex
-                  RECORD_NODE_ID,         // destNodeID
-                  midiChannelIndex);      // destNodeChannelIndex
-
-    // connect event channel
-    addConnection(source->getNodeId(),    // sourceNodeID
-                  midiChannelIndex,       // sourceNodeChannelIndex
-                  AUDIO_NODE_ID,          // destNodeID
-                  midiChannelIndex);      // destNodeChannelIndex
-
+    // the record and audio nodes read this processor's output (and events)
+    // straight from its buffer, in the order the channels were added above
+    executor->addTap(source);
 
     getRecordNode()->addInputChannel(source, midiChannelIndex);
 
@@ -526,6 +566,8 @@ GenericProcessor* ProcessorGraph::createProcessorFromDescription(String& descrip
             // subProcessorType.equalsIgnoreCase("File Reader") ||
             subProcessorType.equalsIgnoreCase("Custom FPGA") ||
             subProcessorType.equalsIgnoreCase("eCube") || // Added by Michael Borisov
+            subProcessorType.equalsIgnoreCase("Network Stream") ||
+            subProcessorType.equalsIgnoreCase("Neural Simulator") ||
             subProcessorType.equalsIgnoreCase("Rhythm FPGA"))
         {
 
@@ -677,6 +719,11 @@ GenericProcessor* ProcessorGraph::createProcessorFromDescription(String& descrip
 			std::cout << "Creating a PSTH output node." << std::endl;
 			processor = new PeriStimulusTimeHistogramNode();
 		}
+        else if (subProcessorType.equalsIgnoreCase("Network Sink"))
+        {
+            std::cout << "Creating a Network Sink." << std::endl;
+            processor = new NetworkSink();
+        }
 
         sendActionMessage("New sink created.");
     }
@@ -770,6 +817,8 @@ bool ProcessorGraph::enableProcessors()
         }
     }
 
+    callbackMonitor.reset();
+
     for (int i = 0; i < getNumNodes(); i++)
     {
 
@@ -778,8 +827,10 @@ bool ProcessorGraph::enableProcessors()
         if (node->nodeId != OUTPUT_NODE_ID)
         {
             GenericProcessor* p = (GenericProcessor*) node->getProcessor();
+            p->getProfile().reset();
             p->enableEditor();
             p->enable();
+            p->setParameterQueueActive(true);
         }
     }
 
@@ -804,6 +855,7 @@ bool ProcessorGraph::disableProcessors()
         {
             GenericProcessor* p = (GenericProcessor*) node->getProcessor();
             std::cout << "Disabling " << p->getName() << std::endl;
+            p->setParameterQueueActive(false);
 			if (node->nodeId != MESSAGE_CENTER_ID)
 				p->disableEditor();
             allClear = p->disable();
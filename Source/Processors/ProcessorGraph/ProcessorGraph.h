@@ -27,6 +27,8 @@
 #include "../../../JuceLibraryCode/JuceHeader.h"
 
 #include "../../AccessClass.h"
+#include "SignalChainExecutor.h"
+#include "../GenericProcessor/ProcessingProfile.h"
 
 class GenericProcessor;
 class RecordNode;
@@ -45,8 +47,12 @@ class SignalChainTabButton;
 
   The user is able to modify the ProcessGraph through the EditorViewport
 
+  Data is not routed through AudioProcessorGraph connections; instead, the
+  connections found by updateConnections() are handed to a SignalChainExecutor,
+  which runs the processors on shared buffers.
+
   @see EditorViewport, GenericProcessor, GenericEditor, RecordNode,
-       AudioNode, Configuration, MessageCenter
+       AudioNode, Configuration, MessageCenter, SignalChainExecutor
 
 */
 
@@ -74,6 +80,22 @@ public:
 
     void updateConnections(Array<SignalChainTabButton*, CriticalSection>);
 
+    /** Allocates the signal chain buffers before the audio device starts. */
+    void prepareToPlay(double sampleRate, int estimatedSamplesPerBlock);
+
+    /** Runs the signal chain through the SignalChainExecutor. */
+    void processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages);
+
+    /** Callback time, slack and xruns of the current acquisition. */
+    const CallbackMonitor& getCallbackMonitor();
+
+    /** Writes the recent blocks of every processor as a Chrome trace (JSON) file.
+        Returns a message for the MessageCenter. */
+    String exportProfilingTrace(const File& file);
+
+    /** Returns the time spent in each branch of the signal chain and in the audio callback. */
+    String getTimingReport();
+
     bool processorWithSameNameExists(const String& name);
 
     void changeListenerCallback(ChangeBroadcaster* source);
@@ -93,6 +115,9 @@ private:
 void* zmqcontext;
     int currentNodeId;
 
+    ScopedPointer<SignalChainExecutor> executor;
+    CallbackMonitor callbackMonitor;
+
     enum nodeIds
     {
         RECORD_NODE_ID = 900,
@@ -0,0 +1,809 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "SignalChainExecutor.h"
+#include "../GenericProcessor/GenericProcessor.h"
+
+// bytes reserved up front for each event buffer, so that typical blocks
+// never have to grow them on the audio thread
+#define EXECUTOR_EVENT_BUFFER_BYTES 8192
+
+// yields before the audio thread goes to sleep waiting for a worker; most
+// branches finish within that time, and waking up costs more than the wait
+#define EXECUTOR_SPINS_BEFORE_WAIT 32
+
+SignalChainWorker::SignalChainWorker(SignalChainExecutor* executor_) :
+    Thread("Signal Chain Worker"), executor(executor_)
+{
+
+}
+
+void SignalChainWorker::startBlock()
+{
+    blockReady.signal();
+}
+
+void SignalChainWorker::run()
+{
+    while (!threadShouldExit())
+    {
+        if (blockReady.wait(100) && !threadShouldExit())
+        {
+            executor->runReadyBranches(false);
+            ++executor->workersFinished;
+            executor->workerProgress.signal();
+        }
+    }
+}
+
+SignalChainExecutor::SignalChainExecutor() :
+    recordNode(nullptr), audioNode(nullptr), messageCenter(nullptr),
+    monitorBuffer(2, 1024), maxBlockSize(0), blockSize(0), currentNumSamples(0), isBuilt(false),
+    branchReady(true), chainLastMs(0), chainMeanMs(0), chainMaxMs(0), numTimedBlocks(0)
+{
+
+}
+
+SignalChainExecutor::~SignalChainExecutor()
+{
+    stopWorkers();
+}
+
+void SignalChainExecutor::clear()
+{
+    isBuilt = false;
+
+    stopWorkers();
+
+    branches.clear();
+    steps.clear();
+    buffers.clear();
+    order.clear();
+    taps.clear();
+}
+
+void SignalChainExecutor::setSinkNodes(GenericProcessor* recordNode_,
+                                       GenericProcessor* audioNode_,
+                                       GenericProcessor* messageCenter_)
+{
+    recordNode = recordNode_;
+    audioNode = audioNode_;
+    messageCenter = messageCenter_;
+}
+
+int SignalChainExecutor::indexOf(GenericProcessor* processor)
+{
+    for (int i = 0; i < steps.size(); i++)
+    {
+        if (steps[i]->processor == processor)
+            return i;
+    }
+
+    return -1;
+}
+
+void SignalChainExecutor::addProcessor(GenericProcessor* processor)
+{
+    if (processor == nullptr || indexOf(processor) >= 0)
+        return;
+
+    Step* step = new Step();
+    step->processor = processor;
+    step->numInputChannels = 0;
+    step->numViewChannels = 0;
+    step->numOutputs = 0;
+    step->buffer = -1;
+    step->copyFrom = -1;
+    step->isTapped = false;
+    step->copyTap = false;
+
+    steps.add(step);
+}
+
+void SignalChainExecutor::addConnection(GenericProcessor* source, GenericProcessor* dest)
+{
+    if (source == nullptr || dest == nullptr)
+        return;
+
+    addProcessor(source);
+    addProcessor(dest);
+
+    Step* destStep = steps[indexOf(dest)];
+
+    // channels are appended in connection order, like GenericProcessor::getNextChannel()
+    Input input;
+    input.step = indexOf(source);
+    input.offset = destStep->numInputChannels;
+    input.numChannels = source->getNumOutputs();
+
+    destStep->inputs.add(input);
+    destStep->numInputChannels += input.numChannels;
+}
+
+void SignalChainExecutor::addTap(GenericProcessor* source)
+{
+    if (source == nullptr)
+        return;
+
+    addProcessor(source);
+
+    int index = indexOf(source);
+
+    if (!taps.contains(index))
+    {
+        taps.add(index);
+        steps[index]->isTapped = true;
+    }
+}
+
+void SignalChainExecutor::build()
+{
+    order.clear();
+    buffers.clear();
+
+    for (int i = 0; i < steps.size(); i++)
+    {
+        Step* step = steps[i];
+
+        step->consumers.clear();
+        step->copyTargets.clear();
+        step->buffer = -1;
+        step->copyFrom = -1;
+        step->copyTap = false;
+        step->numOutputs = step->processor->getNumOutputs();
+        step->numViewChannels = jmax(step->processor->getNumInputChannels(),
+                                     step->processor->getNumOutputChannels());
+    }
+
+    // 1. put every processor after its sources; otherwise keep the order
+    //    in which updateConnections() visited them
+    Array<bool> placed;
+    placed.insertMultiple(0, false, steps.size());
+
+    while (order.size() < steps.size())
+    {
+        int next = -1;
+
+        for (int i = 0; i < steps.size() && next < 0; i++)
+        {
+            if (placed[i])
+                continue;
+
+            bool isReady = true;
+
+            for (int j = 0; j < steps[i]->inputs.size(); j++)
+            {
+                if (!placed[steps[i]->inputs[j].step])
+                    isReady = false;
+            }
+
+            if (isReady)
+                next = i;
+        }
+
+        if (next < 0)
+        {
+            jassertfalse; // the chain contains a loop
+
+            for (int i = 0; i < steps.size(); i++)
+            {
+                if (!placed[i])
+                {
+                    steps[i]->inputs.clear();
+                    steps[i]->numInputChannels = 0;
+                    order.add(i);
+                }
+            }
+
+            break;
+        }
+
+        placed.set(next, true);
+        order.add(next);
+    }
+
+    for (int n = 0; n < order.size(); n++)
+    {
+        Step* step = steps[order[n]];
+
+        for (int j = 0; j < step->inputs.size(); j++)
+            steps[step->inputs[j].step]->consumers.add(order[n]);
+    }
+
+    // 2. hand each source's buffer on to its last consumer; earlier
+    //    consumers (other splitter branches) get a copy as soon as the source
+    //    has run, so the branches no longer depend on each other. A source
+    //    that also feeds a merged input keeps its buffer, since the merge
+    //    reads it later on.
+    for (int n = 0; n < order.size(); n++)
+    {
+        Step* step = steps[order[n]];
+
+        bool adopts = false;
+
+        if (step->inputs.size() == 1)
+        {
+            Step* source = steps[step->inputs[0].step];
+            adopts = source->consumers.getLast() == order[n];
+
+            for (int j = 0; j < source->consumers.size(); j++)
+            {
+                if (steps[source->consumers[j]]->inputs.size() > 1)
+                    adopts = false;
+            }
+        }
+
+        if (adopts)
+        {
+            step->buffer = steps[step->inputs[0].step]->buffer;
+        }
+        else
+        {
+            if (step->inputs.size() == 1)
+            {
+                step->copyFrom = step->inputs[0].step;
+                steps[step->copyFrom]->copyTargets.add(order[n]);
+            }
+
+            SharedBuffer* buffer = new SharedBuffer();
+            buffer->numChannels = 0;
+            step->buffer = buffers.size();
+            buffers.add(buffer);
+        }
+
+        SharedBuffer* buffer = buffers[step->buffer];
+        buffer->numChannels = jmax(buffer->numChannels,
+                                   jmax(step->numInputChannels, step->numViewChannels, step->numOutputs));
+    }
+
+    // 3. taps whose buffer is overwritten in place later on need a copy
+    Array<int> lastStep;
+    lastStep.insertMultiple(0, -1, buffers.size());
+
+    for (int n = 0; n < order.size(); n++)
+        lastStep.set(steps[order[n]]->buffer, order[n]);
+
+    for (int n = 0; n < order.size(); n++)
+    {
+        Step* step = steps[order[n]];
+        step->copyTap = step->isTapped && lastStep[step->buffer] != order[n];
+    }
+
+    buildBranches();
+
+    std::cout << "Signal chain executor: " << order.size() << " processors sharing "
+              << buffers.size() << " buffers, " << branches.size() << " branches on "
+              << workers.size() + 1 << " threads." << std::endl;
+
+    isBuilt = true;
+}
+
+void SignalChainExecutor::buildBranches()
+{
+    stopWorkers();
+    branches.clear();
+
+    // a branch is a run of processors that each feed only the next one;
+    // it starts wherever the chain splits, merges or begins
+    Array<int> branchOfStep;
+    branchOfStep.insertMultiple(0, -1, steps.size());
+
+    for (int n = 0; n < order.size(); n++)
+    {
+        Step* step = steps[order[n]];
+        int b = -1;
+
+        if (step->inputs.size() == 1 &&
+            steps[step->inputs[0].step]->consumers.size() == 1)
+        {
+            b = branchOfStep[step->inputs[0].step];
+        }
+
+        if (b >= 0)
+        {
+            branches[b]->steps.add(order[n]);
+            branches[b]->name << " > " << step->processor->getName();
+        }
+        else
+        {
+            b = branches.size();
+
+            Branch* branch = new Branch();
+            branch->steps.add(order[n]);
+            branch->name = step->processor->getName();
+            branch->numDependencies = 0;
+
+            for (int j = 0; j < step->inputs.size(); j++)
+            {
+                Branch* dependency = branches[branchOfStep[step->inputs[j].step]];
+
+                if (!dependency->children.contains(b))
+                {
+                    dependency->children.add(b);
+                    branch->numDependencies++;
+                }
+            }
+
+            branches.add(branch);
+        }
+
+        branchOfStep.set(order[n], b);
+    }
+
+    resetTimings();
+
+    // one thread per branch that can run alongside another, up to the number of cores
+    int numLeaves = 0;
+
+    for (int i = 0; i < branches.size(); i++)
+    {
+        if (branches[i]->children.size() == 0)
+            numLeaves++;
+    }
+
+    int numWorkers = jmin(numLeaves - 1, SystemStats::getNumCpus() - 1);
+
+    for (int i = 0; i < numWorkers; i++)
+    {
+        SignalChainWorker* worker = new SignalChainWorker(this);
+        worker->startThread(9);
+        workers.add(worker);
+    }
+}
+
+void SignalChainExecutor::stopWorkers()
+{
+    for (int i = 0; i < workers.size(); i++)
+        workers[i]->signalThreadShouldExit();
+
+    for (int i = 0; i < workers.size(); i++)
+    {
+        workers[i]->startBlock();
+        workers[i]->stopThread(1000);
+    }
+
+    workers.clear();
+}
+
+void SignalChainExecutor::resetTimings()
+{
+    for (int i = 0; i < branches.size(); i++)
+    {
+        branches[i]->lastMs.set(0);
+        branches[i]->meanMs.set(0);
+        branches[i]->maxMs.set(0);
+    }
+
+    chainLastMs.set(0);
+    chainMeanMs.set(0);
+    chainMaxMs.set(0);
+    numTimedBlocks.set(0);
+}
+
+String SignalChainExecutor::getBranchTimingReport()
+{
+    String report;
+
+    report << "Signal chain timing over " << String(numTimedBlocks.get()) << " blocks ("
+           << String(workers.size() + 1) << " threads):\n";
+
+    double sumOfMeans = 0;
+
+    for (int i = 0; i < branches.size(); i++)
+    {
+        Branch* branch = branches[i];
+
+        const double meanMs = branch->meanMs.get();
+
+        report << "  " << branch->name << ": mean " << String(meanMs, 3)
+               << " ms, max " << String(branch->maxMs.get(), 3) << " ms\n";
+
+        sumOfMeans += meanMs;
+    }
+
+    report << "  Whole chain: mean " << String(chainMeanMs.get(), 3) << " ms, max "
+           << String(chainMaxMs.get(), 3) << " ms (branches add up to "
+           << String(sumOfMeans, 3) << " ms)";
+
+    return report;
+}
+
+float* SignalChainExecutor::getOutputChannel(int step, int chan)
+{
+    Step* s = steps[step];
+
+    if (s->copyTap)
+        return s->tapBuffer->getWritePointer(chan);
+    else
+        return buffers[s->buffer]->channels[chan];
+}
+
+AudioSampleBuffer* SignalChainExecutor::createView(Array<float*>& channels, int numSamples)
+{
+    if (channels.size() == 0)
+        return new AudioSampleBuffer(0, numSamples);
+
+    return new AudioSampleBuffer(channels.getRawDataPointer(), channels.size(), numSamples);
+}
+
+void SignalChainExecutor::copyEvents(MidiBuffer& dest, const MidiBuffer& source)
+{
+    // unlike operator=, this reuses the storage that dest already has
+    dest.clear();
+    dest.addEvents(source, 0, -1, 0);
+}
+
+void SignalChainExecutor::runProcessor(AudioProcessor* processor, AudioSampleBuffer& buffer, MidiBuffer& events)
+{
+    // GenericProcessor hides processBlock(); the graph called it through AudioProcessor as well
+    processor->processBlock(buffer, events);
+}
+
+void SignalChainExecutor::prepare(int maxBlockSize_)
+{
+    maxBlockSize = jmax(maxBlockSize, maxBlockSize_);
+    blockSize = maxBlockSize;
+
+    Array<float*> channels;
+
+    for (int i = 0; i < buffers.size(); i++)
+    {
+        SharedBuffer* buffer = buffers[i];
+
+        buffer->data.setSize(jmax(1, buffer->numChannels), blockSize);
+        buffer->data.clear();
+        buffer->channels.clear();
+
+        for (int chan = 0; chan < buffer->numChannels; chan++)
+            buffer->channels.add(buffer->data.getWritePointer(chan));
+
+        buffer->events.ensureSize(EXECUTOR_EVENT_BUFFER_BYTES);
+    }
+
+    for (int n = 0; n < order.size(); n++)
+    {
+        Step* step = steps[order[n]];
+
+        channels.clear();
+
+        for (int chan = 0; chan < step->numViewChannels; chan++)
+            channels.add(buffers[step->buffer]->channels[chan]);
+
+        step->view = createView(channels, blockSize);
+
+        if (step->copyTap)
+        {
+            step->tapBuffer = new AudioSampleBuffer(jmax(1, step->numOutputs), blockSize);
+            step->tapBuffer->clear();
+            step->tapEvents.ensureSize(EXECUTOR_EVENT_BUFFER_BYTES);
+        }
+        else
+        {
+            step->tapBuffer = nullptr;
+        }
+    }
+
+    // the RecordNode sees the tapped channels in the order they were registered,
+    // the AudioNode sees the same channels after its two output channels
+    monitorBuffer.setSize(2, blockSize);
+    monitorBuffer.clear();
+
+    recordChannels.clear();
+
+    for (int i = 0; i < taps.size(); i++)
+    {
+        for (int chan = 0; chan < steps[taps[i]]->numOutputs; chan++)
+            recordChannels.add(getOutputChannel(taps[i], chan));
+    }
+
+    recordView = createView(recordChannels, blockSize);
+
+    audioChannels = recordChannels;
+    audioChannels.insert(0, monitorBuffer.getWritePointer(1));
+    audioChannels.insert(0, monitorBuffer.getWritePointer(0));
+
+    audioView = createView(audioChannels, blockSize);
+
+    channels.clear();
+    messageCenterView = createView(channels, blockSize);
+
+    recordEvents.ensureSize(EXECUTOR_EVENT_BUFFER_BYTES);
+    audioEvents.ensureSize(EXECUTOR_EVENT_BUFFER_BYTES);
+    messageCenterEvents.ensureSize(EXECUTOR_EVENT_BUFFER_BYTES);
+}
+
+void SignalChainExecutor::setViewSize(int numSamples)
+{
+    // the 0-channel views still need a valid pointer list
+    float** const noChannels = audioChannels.getRawDataPointer();
+
+    for (int n = 0; n < order.size(); n++)
+    {
+        Step* step = steps[order[n]];
+        SharedBuffer* buffer = buffers[step->buffer];
+
+        step->view->setDataToReferTo(step->numViewChannels > 0 ? buffer->channels.getRawDataPointer() : noChannels,
+                                     step->numViewChannels, numSamples);
+    }
+
+    recordView->setDataToReferTo(recordChannels.size() > 0 ? recordChannels.getRawDataPointer() : noChannels,
+                                 recordChannels.size(), numSamples);
+    audioView->setDataToReferTo(noChannels, audioChannels.size(), numSamples);
+    messageCenterView->setDataToReferTo(noChannels, 0, numSamples);
+
+    blockSize = numSamples;
+}
+
+void SignalChainExecutor::process(AudioSampleBuffer& output, MidiBuffer& midiMessages)
+{
+    const int numSamples = output.getNumSamples();
+
+    if (maxBlockSize == 0)
+        output.clear();
+
+    // blocks longer than prepare() allowed for are run in pieces, so nothing
+    // is reallocated here
+    for (int start = 0; maxBlockSize > 0 && start < numSamples; start += maxBlockSize)
+        processBlock(output, start, jmin(maxBlockSize, numSamples - start));
+
+    midiMessages.clear();
+}
+
+void SignalChainExecutor::processBlock(AudioSampleBuffer& output, int startSample, int numSamples)
+{
+    if (numSamples != blockSize)
+        setViewSize(numSamples); // variable-block devices get here often
+
+    recordEvents.clear();
+    audioEvents.clear();
+
+    if (messageCenter != nullptr)
+    {
+        messageCenterEvents.clear();
+        runProcessor(messageCenter, *messageCenterView, messageCenterEvents);
+        recordEvents.addEvents(messageCenterEvents, 0, -1, 0);
+    }
+
+    const int64 chainStart = Time::getHighResolutionTicks();
+
+    currentNumSamples = numSamples;
+
+    if (isBuilt && workers.size() > 0)
+    {
+        for (int i = 0; i < branches.size(); i++)
+        {
+            branches[i]->remainingDependencies.set(branches[i]->numDependencies);
+            branches[i]->claimed.set(0);
+        }
+
+        branchesClaimed.set(0);
+        workersFinished.set(0);
+        workerProgress.reset();
+
+        for (int i = 0; i < workers.size(); i++)
+            workers[i]->startBlock();
+
+        runReadyBranches(true);
+
+        // join: the record and audio nodes need every branch
+        int numSpins = 0;
+
+        while (workersFinished.get() < workers.size())
+            waitForWorkers(numSpins);
+    }
+    else if (isBuilt)
+    {
+        for (int i = 0; i < branches.size(); i++)
+            runBranch(branches.getUnchecked(i));
+    }
+
+    updateTiming(chainLastMs, chainMeanMs, chainMaxMs, chainStart);
+    ++numTimedBlocks;
+
+    for (int i = 0; i < taps.size(); i++)
+    {
+        const MidiBuffer& events = getTapEvents(taps.getUnchecked(i));
+
+        recordEvents.addEvents(events, 0, -1, 0);
+        audioEvents.addEvents(events, 0, -1, 0);
+    }
+
+    FloatVectorOperations::clear(monitorBuffer.getWritePointer(0), numSamples);
+    FloatVectorOperations::clear(monitorBuffer.getWritePointer(1), numSamples);
+
+    if (audioNode != nullptr)
+    {
+        audioView->getArrayOfWritePointers();
+        runProcessor(audioNode, *audioView, audioEvents);
+    }
+
+    if (recordNode != nullptr)
+    {
+        recordView->getArrayOfWritePointers();
+        runProcessor(recordNode, *recordView, recordEvents);
+    }
+
+    for (int chan = 0; chan < output.getNumChannels(); chan++)
+    {
+        if (chan < 2)
+            output.copyFrom(chan, startSample, monitorBuffer.getReadPointer(chan), numSamples);
+        else
+            output.clear(chan, startSample, numSamples);
+    }
+}
+
+void SignalChainExecutor::waitForWorkers(int& numSpins)
+{
+    if (++numSpins < EXECUTOR_SPINS_BEFORE_WAIT)
+        Thread::yield();
+    else
+        workerProgress.wait(1); // the timeout only guards against a lost signal
+}
+
+void SignalChainExecutor::runReadyBranches(bool isAudioThread)
+{
+    int numSpins = 0;
+
+    // whoever claimed the other branches finishes them; the audio thread
+    // waits for that at the join
+    while (branchesClaimed.get() < branches.size())
+    {
+        // a branch that becomes ready after this is seen by the scan below,
+        // or signals again
+        if (!isAudioThread)
+            branchReady.reset();
+
+        bool ranBranch = false;
+
+        for (int i = 0; i < branches.size(); i++)
+        {
+            Branch* branch = branches.getUnchecked(i);
+
+            if (branch->remainingDependencies.get() == 0 &&
+                branch->claimed.compareAndSetBool(1, 0))
+            {
+                // wakes the sleeping workers so they can leave
+                if (++branchesClaimed == branches.size())
+                    branchReady.signal();
+
+                runBranch(branch);
+
+                for (int j = 0; j < branch->children.size(); j++)
+                {
+                    if (--(branches.getUnchecked(branch->children.getUnchecked(j))->remainingDependencies) == 0)
+                        branchReady.signal();
+                }
+
+                ranBranch = true;
+
+                if (!isAudioThread)
+                    workerProgress.signal();
+            }
+        }
+
+        if (!ranBranch && branchesClaimed.get() < branches.size())
+        {
+            if (isAudioThread)
+                waitForWorkers(numSpins);
+            else
+                branchReady.wait(1); // the timeout only guards against a lost signal
+        }
+    }
+}
+
+void SignalChainExecutor::runBranch(Branch* branch)
+{
+    const int64 start = Time::getHighResolutionTicks();
+
+    for (int i = 0; i < branch->steps.size(); i++)
+        runStep(steps.getUnchecked(branch->steps.getUnchecked(i)));
+
+    updateTiming(branch->lastMs, branch->meanMs, branch->maxMs, start);
+}
+
+void SignalChainExecutor::updateTiming(Atomic<double>& lastMs, Atomic<double>& meanMs, Atomic<double>& maxMs, int64 startTicks)
+{
+    // only one thread times a branch in any block, so plain loads and stores will do
+    const double ms = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks) * 1000.0;
+    const double mean = meanMs.get();
+
+    lastMs.set(ms);
+    meanMs.set(mean + (ms - mean) / double(numTimedBlocks.get() + 1));
+    maxMs.set(jmax(maxMs.get(), ms));
+}
+
+const MidiBuffer& SignalChainExecutor::getTapEvents(int step)
+{
+    Step* s = steps.getUnchecked(step);
+
+    if (s->copyTap)
+        return s->tapEvents;
+    else
+        return buffers.getUnchecked(s->buffer)->events;
+}
+
+void SignalChainExecutor::runStep(Step* step)
+{
+    const int numSamples = currentNumSamples;
+    SharedBuffer* buffer = buffers.getUnchecked(step->buffer);
+
+    // 1. gather the inputs (in-place steps already have them, and copies
+    //    were made when their source ran)
+    if (step->inputs.size() > 1)
+    {
+        buffer->events.clear();
+
+        for (int i = 0; i < step->inputs.size(); i++)
+        {
+            const Input& input = step->inputs.getReference(i);
+            SharedBuffer* source = buffers.getUnchecked(steps.getUnchecked(input.step)->buffer);
+
+            for (int chan = 0; chan < input.numChannels; chan++)
+                FloatVectorOperations::copy(buffer->channels.getUnchecked(input.offset + chan),
+                                            source->channels.getUnchecked(chan),
+                                            numSamples);
+
+            buffer->events.addEvents(source->events, 0, -1, 0);
+        }
+    }
+    else if (step->inputs.size() == 0)
+    {
+        buffer->events.clear();
+    }
+
+    // unconnected channels start out silent
+    for (int chan = step->numInputChannels; chan < step->numViewChannels; chan++)
+        FloatVectorOperations::clear(buffer->channels.getUnchecked(chan), numSamples);
+
+    // the view may still think it was cleared during the previous block
+    step->view->getArrayOfWritePointers();
+
+    // 2. run the processor
+    runProcessor(step->processor, *step->view, buffer->events);
+
+    // 3. give the other splitter branches their copy before this buffer
+    //    is overwritten in place
+    for (int i = 0; i < step->copyTargets.size(); i++)
+    {
+        Step* target = steps.getUnchecked(step->copyTargets.getUnchecked(i));
+        SharedBuffer* dest = buffers.getUnchecked(target->buffer);
+
+        for (int chan = 0; chan < target->numInputChannels; chan++)
+            FloatVectorOperations::copy(dest->channels.getUnchecked(chan),
+                                        buffer->channels.getUnchecked(chan),
+                                        numSamples);
+
+        copyEvents(dest->events, buffer->events);
+    }
+
+    // 4. keep the output for the RecordNode and AudioNode
+    if (step->copyTap)
+    {
+        for (int chan = 0; chan < step->numOutputs; chan++)
+            FloatVectorOperations::copy(step->tapBuffer->getWritePointer(chan),
+                                        buffer->channels.getUnchecked(chan),
+                                        numSamples);
+
+        copyEvents(step->tapEvents, buffer->events);
+    }
+}
@@ -0,0 +1,252 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SIGNALCHAINEXECUTOR_H_5E1D2A7C__
+#define __SIGNALCHAINEXECUTOR_H_5E1D2A7C__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+
+class GenericProcessor;
+class SignalChainExecutor;
+
+/**
+
+  Runs branches of the signal chain alongside the audio thread.
+
+  @see SignalChainExecutor
+
+*/
+
+class SignalChainWorker : public Thread
+{
+public:
+    SignalChainWorker(SignalChainExecutor* executor);
+
+    /** Wakes the worker up to help with the current block. */
+    void startBlock();
+
+    void run();
+
+private:
+    SignalChainExecutor* executor;
+    WaitableEvent blockReady;
+
+};
+
+/**
+
+  Runs the signal chain assembled by the ProcessorGraph.
+
+  Rather than routing every channel through a separate AudioProcessorGraph
+  connection, the executor calls the processors in dependency order and lets
+  them share buffers:
+
+  - a processor fed by a single source works in place on that source's buffer,
+    as long as it is the last consumer of that source to run.
+  - the other branches of a splitter get a copy of the source's buffer just
+    before they run (copy-on-write).
+  - a processor fed through a merger gets its inputs copied side by side.
+
+  The RecordNode and AudioNode read every tapped processor's output through
+  channel pointers. Data is only copied when a later processor would
+  overwrite the tapped buffer in place.
+
+  The chain is cut into branches wherever it splits or merges. Branches that
+  don't depend on each other (e.g. the two paths after a splitter) run at the
+  same time on SignalChainWorker threads; the RecordNode and AudioNode run
+  once every branch has finished. The time spent in each branch is kept, so
+  the work can be balanced across paths.
+
+  All buffers are allocated by prepare() for the largest block seen so far,
+  so process() never reallocates them. A smaller block only repoints the
+  views, and a larger one is run in pieces.
+
+  @see ProcessorGraph
+
+*/
+
+class SignalChainExecutor
+{
+public:
+    SignalChainExecutor();
+    ~SignalChainExecutor();
+
+    /** Removes all processors, connections and taps from the execution plan. */
+    void clear();
+
+    /** Sets the nodes that receive the taps and the message center events. */
+    void setSinkNodes(GenericProcessor* recordNode,
+                      GenericProcessor* audioNode,
+                      GenericProcessor* messageCenter);
+
+    /** Adds a processor to the plan (ignored if it's already there). */
+    void addProcessor(GenericProcessor* processor);
+
+    /** Feeds all outputs of source into the next free inputs of dest. */
+    void addConnection(GenericProcessor* source, GenericProcessor* dest);
+
+    /** Sends all outputs of source to the RecordNode and AudioNode. */
+    void addTap(GenericProcessor* source);
+
+    /** Orders the processors and decides which ones share buffers. */
+    void build();
+
+    /** Allocates buffers for blocks of up to maxBlockSize samples; they only
+        ever grow. Not real-time safe. */
+    void prepare(int maxBlockSize);
+
+    /** Runs one block through the signal chain and writes the monitor output. */
+    void process(AudioSampleBuffer& output, MidiBuffer& midiMessages);
+
+    /** Returns the mean and maximum time spent in each branch since the chain was built. */
+    String getBranchTimingReport();
+
+private:
+
+    friend class SignalChainWorker;
+
+    struct Input
+    {
+        int step;
+        int offset;
+        int numChannels;
+    };
+
+    struct Step
+    {
+        GenericProcessor* processor;
+
+        Array<Input> inputs;
+        Array<int> consumers; // in execution order
+        Array<int> copyTargets; // consumers that get a copy of the output
+
+        int numInputChannels;
+        int numViewChannels;
+        int numOutputs;
+
+        int buffer;
+        int copyFrom;
+        bool isTapped;
+        bool copyTap;
+
+        ScopedPointer<AudioSampleBuffer> view;
+        ScopedPointer<AudioSampleBuffer> tapBuffer;
+        MidiBuffer tapEvents;
+    };
+
+    struct Branch
+    {
+        Array<int> steps;
+        Array<int> children;
+        int numDependencies;
+        String name;
+
+        Atomic<int> remainingDependencies;
+        Atomic<int> claimed;
+
+        // written by the thread that ran the branch, read by the timing report
+        Atomic<double> lastMs;
+        Atomic<double> meanMs;
+        Atomic<double> maxMs;
+    };
+
+    struct SharedBuffer
+    {
+        int numChannels;
+        AudioSampleBuffer data;
+        Array<float*> channels;
+        MidiBuffer events;
+    };
+
+    int indexOf(GenericProcessor* processor);
+    float* getOutputChannel(int step, int chan);
+    const MidiBuffer& getTapEvents(int step);
+
+    void buildBranches();
+    void stopWorkers();
+    void resetTimings();
+    void updateTiming(Atomic<double>& lastMs, Atomic<double>& meanMs, Atomic<double>& maxMs, int64 startTicks);
+
+    /** Runs branches as their dependencies finish, until every branch has been
+        claimed; called by the audio thread and the workers. */
+    void runReadyBranches(bool isAudioThread);
+
+    /** Lets the audio thread wait for a worker: a few yields, then a sleep on workerProgress. */
+    void waitForWorkers(int& numSpins);
+    void runBranch(Branch* branch);
+    void runStep(Step* step);
+
+    /** Runs numSamples (at most maxBlockSize) through the chain and writes them to output. */
+    void processBlock(AudioSampleBuffer& output, int startSample, int numSamples);
+
+    /** Points every view at its buffers with a new length; the buffers stay as they are. */
+    void setViewSize(int numSamples);
+
+    static AudioSampleBuffer* createView(Array<float*>& channels, int numSamples);
+    static void runProcessor(AudioProcessor* processor, AudioSampleBuffer& buffer, MidiBuffer& events);
+    static void copyEvents(MidiBuffer& dest, const MidiBuffer& source);
+
+    OwnedArray<Step> steps;
+    OwnedArray<SharedBuffer> buffers;
+    OwnedArray<Branch> branches;
+    OwnedArray<SignalChainWorker> workers;
+    Array<int> order;
+    Array<int> taps;
+
+    GenericProcessor* recordNode;
+    GenericProcessor* audioNode;
+    GenericProcessor* messageCenter;
+
+    ScopedPointer<AudioSampleBuffer> recordView;
+    ScopedPointer<AudioSampleBuffer> audioView;
+    ScopedPointer<AudioSampleBuffer> messageCenterView;
+    AudioSampleBuffer monitorBuffer;
+
+    Array<float*> recordChannels;
+    Array<float*> audioChannels;
+
+    MidiBuffer recordEvents;
+    MidiBuffer audioEvents;
+    MidiBuffer messageCenterEvents;
+
+    int maxBlockSize;
+    int blockSize;
+    int currentNumSamples;
+    bool isBuilt;
+
+    Atomic<int> branchesClaimed;
+    Atomic<int> workersFinished;
+    WaitableEvent workerProgress; // signalled when a worker finishes a branch or the block
+    WaitableEvent branchReady; // manual reset; signalled when a branch can run or the last one is claimed
+
+    Atomic<double> chainLastMs;
+    Atomic<double> chainMeanMs;
+    Atomic<double> chainMaxMs;
+    Atomic<int64> numTimedBlocks;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SignalChainExecutor);
+
+};
+
+
+#endif  // __SIGNALCHAINEXECUTOR_H_5E1D2A7C__
@@ -93,7 +93,7 @@ void HDF5Recording::openFiles(File rootFolder, int experimentNumber, int recordi
     infoArray[0]->name = String("Open Ephys Recording #") + String(recordingNumber);
     
     if (hasAcquired)
-	   infoArray[0]->start_time = (*timestamps)[getChannel(0)->sourceNodeId]; //(*timestamps).begin()->first;
+	   infoArray[0]->start_time = (*timestamps)[getChannel(0)->getStreamId()]; //(*timestamps).begin()->first;
     else
         infoArray[0]->start_time = 0;
 
@@ -111,7 +111,7 @@ void HDF5Recording::openFiles(File rootFolder, int experimentNumber, int recordi
                 fileArray[index]->initFile(getChannel(i)->nodeId,basepath);
                 fileArray[index]->open();
                 if (hasAcquired)
-				    infoArray[index]->start_time = (*timestamps)[getChannel(i)->sourceNodeId]; //the timestamps of the first channel
+				    infoArray[index]->start_time = (*timestamps)[getChannel(i)->getStreamId()]; //the timestamps of the first channel
                 else
                     infoArray[index]->start_time = 0;
             }
@@ -169,8 +169,8 @@ void HDF5Recording::writeData(AudioSampleBuffer& buffer)
         if (getChannel(i)->getRecordState())
         {
 
-            int sourceNodeId = getChannel(i)->sourceNodeId;
-            int nSamples = (*numSamples)[sourceNodeId];
+            int streamId = getChannel(i)->getStreamId();
+            int nSamples = (*numSamples)[streamId];
 
             double multFactor = 1/(float(0x7fff) * getChannel(i)->bitVolts);
             int index = processorMap[getChannel(i)->recordIndex];
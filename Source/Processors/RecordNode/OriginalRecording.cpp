@@ -28,6 +28,9 @@ OriginalRecording::OriginalRecording() : separateFiles(false),
     recordingNumber(0), experimentNumber(0),  zeroBuffer(1, 50000),
     eventFile(nullptr), messageFile(nullptr), lastProcId(0)
 {
+    spikeBufferSize = MAX_SPIKE_BUFFER_LEN;
+    spikeBuffer.malloc(spikeBufferSize);
+
     continuousDataIntegerBuffer = new int16[10000];
     continuousDataFloatBuffer = new float[10000];
 
@@ -310,8 +313,8 @@ String OriginalRecording::generateHeader(Channel* ch)
     }
 
     header += "header.sampleRate = ";
-    // all channels need to have the same sample rate under the current scheme
-    header += String(getChannel(0)->sampleRate);
+    // each continuous file has its channel's rate (resampled channels differ)
+    header += String((ch != nullptr) ? ch->sampleRate : getChannel(0)->sampleRate);
     header += ";\n";
     header += "header.blockLength = ";
     header += BLOCK_LENGTH;
@@ -444,11 +447,11 @@ void OriginalRecording::writeData(AudioSampleBuffer& buffer)
         {
             int samplesWritten = 0;
 
-            int sourceNodeId = getChannel(i)->sourceNodeId;
+            int streamId = getChannel(i)->getStreamId();
 
             samplesSinceLastTimestamp.set(i,0);
 
-            int nSamples = (*numSamples)[sourceNodeId];
+            int nSamples = (*numSamples)[streamId];
 
             while (samplesWritten < nSamples) // there are still unwritten samples in this buffer
             {
@@ -536,9 +539,9 @@ void OriginalRecording::writeTimestampAndSampleCount(FILE* file, int channel)
 
     uint16 samps = BLOCK_LENGTH;
 
-    int sourceNodeId = getChannel(channel)->sourceNodeId;
+    int streamId = getChannel(channel)->getStreamId();
 
-    int64 ts = (*timestamps)[sourceNodeId] + samplesSinceLastTimestamp[channel];
+    int64 ts = (*timestamps)[streamId] + samplesSinceLastTimestamp[channel];
 
     fwrite(&ts,                       // ptr
            8,                               // size of each element
@@ -626,20 +629,20 @@ void OriginalRecording::closeFiles()
 
 void OriginalRecording::writeSpike(const SpikeObject& spike, int electrodeIndex)
 {
-    uint8_t spikeBuffer[MAX_SPIKE_BUFFER_LEN];
-
     if (spikeFileArray[electrodeIndex] == nullptr)
         return;
 
-    packSpike(&spike, spikeBuffer, MAX_SPIKE_BUFFER_LEN);
+    int totalBytes = getPackedSpikeSize(&spike); // metadata, samples, gains and thresholds
 
-    int totalBytes = spike.nSamples * spike.nChannels * 2 + // account for samples
-                     spike.nChannels * 4 +            // acount for gain
-                     spike.nChannels * 2 +            // account for thresholds
-                     SPIKE_METADATA_SIZE;             // 42, from SpikeObject.h
+    diskWriteLock.enter();
 
+    if (totalBytes > spikeBufferSize)
+    {
+        spikeBufferSize = totalBytes;
+        spikeBuffer.realloc(spikeBufferSize);
+    }
 
-    diskWriteLock.enter();
+    packSpike(&spike, spikeBuffer, spikeBufferSize);
 
     fwrite(spikeBuffer, 1, totalBytes, spikeFileArray[electrodeIndex]);
 
@@ -104,6 +104,10 @@ private:
 
     CriticalSection diskWriteLock;
 
+    /** Holds packed spikes; grows when a larger spike arrives. */
+    HeapBlock<uint8_t> spikeBuffer;
+    int spikeBufferSize;
+
     struct ChannelInfo
     {
         String name;
@@ -0,0 +1,526 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PreTriggerBuffer.h"
+#include "../Channel/Channel.h"
+
+PreTriggerBuffer::PreTriggerBuffer()
+    : numChannels(0), capacity(0), fastestRate(0.0f),
+      maxBlocks(0), firstBlock(0), numBlocks(0), writePosition(0),
+      firstEvent(0), numEvents(0), numPendingEvents(0),
+      firstSpike(0), numSpikes(0), numPendingSpikes(0),
+      keepHistory(false), lostBlocks(false), started(false), numUnread(0),
+      skipFirstSamples(false), numStartStreams(0), numEndStreams(0),
+      readEvent(0), readEventsLeft(0), readSpike(0), readSpikesLeft(0)
+{
+    events.calloc(PRE_TRIGGER_MAX_EVENTS);
+
+    Spike noSpike;
+    noSpike.electrodeIndex = 0;
+    noSpike.streamId = -1;
+    spikes.insertMultiple(0, noSpike, PRE_TRIGGER_MAX_SPIKES);
+
+    // replayed events are copied into these, so none is allocated while recording
+    uint8 empty[PRE_TRIGGER_EVENT_SIZE] = { 0 };
+
+    for (int size = 1; size <= PRE_TRIGGER_EVENT_SIZE; size++)
+        messages.add(new MidiMessage(empty, size));
+}
+
+PreTriggerBuffer::~PreTriggerBuffer()
+{
+
+}
+
+void PreTriggerBuffer::prepare(const Array<Channel*>& channels, float preTriggerSeconds, float extraSeconds)
+{
+    numChannels = channels.size();
+
+    channelStreams.clear();
+    streamIds.clear();
+    streamRates.clear();
+    fastestRate = 0.0f;
+
+    for (int i = 0; i < numChannels; i++)
+    {
+        const int streamId = channels[i]->getStreamId();
+
+        channelStreams.add(streamId);
+
+        if (!streamIds.contains(streamId))
+        {
+            streamIds.add(streamId);
+            streamRates.add(channels[i]->sampleRate);
+        }
+
+        fastestRate = jmax(fastestRate, channels[i]->sampleRate);
+    }
+
+    keepHistory = (preTriggerSeconds > 0.0f);
+
+    // two of the longest blocks on top, so a new block always fits once older ones are dropped
+    capacity = int(ceil((preTriggerSeconds + extraSeconds) * fastestRate)) + 2 * PRE_TRIGGER_MAX_BLOCK_LENGTH;
+
+    samples.malloc(size_t(numChannels) * capacity);
+
+    // enough entries that the samples fill up first, unless blocks are very short
+    maxBlocks = capacity / PRE_TRIGGER_MIN_BLOCK_LENGTH + 2;
+    blocks.calloc(maxBlocks);
+
+    readPointers.clear();
+    readPointers.insertMultiple(0, nullptr, numChannels);
+
+    std::cout << "Pre-trigger buffer holds " << capacity << " samples of "
+              << numChannels << " channels, in up to " << maxBlocks << " blocks." << std::endl;
+
+    clear();
+}
+
+void PreTriggerBuffer::clear()
+{
+    firstBlock = 0;
+    numBlocks = 0;
+    writePosition = 0;
+
+    firstEvent = 0;
+    numEvents = 0;
+    numPendingEvents = 0;
+
+    releaseSpikes(firstSpike, numSpikes);
+    firstSpike = 0;
+    numSpikes = 0;
+    numPendingSpikes = 0;
+
+    lostBlocks = false;
+    started = false;
+    numUnread = 0;
+    skipFirstSamples = false;
+
+    numStartStreams = 0;
+    numEndStreams = 0;
+
+    readEventsLeft = 0;
+    readSpikesLeft = 0;
+}
+
+PreTriggerBuffer::Block& PreTriggerBuffer::getBlock(int index)
+{
+    return blocks[(firstBlock + index) % maxBlocks];
+}
+
+void PreTriggerBuffer::addEvent(const MidiMessage& event, int samplePosition)
+{
+    if (!keepHistory && !started)
+        return;
+
+    while (numEvents == PRE_TRIGGER_MAX_EVENTS)
+    {
+        if (numBlocks == 0)
+            return; // every slot is taken by the block being added
+
+        if (!dropOldest())
+            lostBlocks = true;
+    }
+
+    Event& e = events[(firstEvent + numEvents) % PRE_TRIGGER_MAX_EVENTS];
+
+    e.samplePosition = samplePosition;
+    e.size = jmin(event.getRawDataSize(), PRE_TRIGGER_EVENT_SIZE);
+    memcpy(e.data, event.getRawData(), e.size);
+
+    numEvents++;
+    numPendingEvents++;
+}
+
+void PreTriggerBuffer::addSpike(const SpikeHandle& spike, int electrodeIndex, int streamId)
+{
+    if (!keepHistory && !started)
+        return;
+
+    while (numSpikes == PRE_TRIGGER_MAX_SPIKES)
+    {
+        if (numBlocks == 0)
+            return; // every slot is taken by the block being added
+
+        if (!dropOldest())
+            lostBlocks = true;
+    }
+
+    Spike& s = spikes.getReference((firstSpike + numSpikes) % PRE_TRIGGER_MAX_SPIKES);
+
+    s.spike = spike;
+    s.electrodeIndex = electrodeIndex;
+    s.streamId = streamId;
+
+    numSpikes++;
+    numPendingSpikes++;
+}
+
+void PreTriggerBuffer::releaseSpikes(int first, int count)
+{
+    for (int i = 0; i < count; i++)
+        spikes.getReference((first + i) % PRE_TRIGGER_MAX_SPIKES).spike.reset();
+}
+
+void PreTriggerBuffer::dropPending()
+{
+    numEvents -= numPendingEvents;
+    numPendingEvents = 0;
+
+    releaseSpikes(firstSpike + numSpikes - numPendingSpikes, numPendingSpikes);
+    numSpikes -= numPendingSpikes;
+    numPendingSpikes = 0;
+}
+
+int PreTriggerBuffer::getBlockLength(const std::map<int, int>& numSamples)
+{
+    if (numChannels == 0)
+        return 0;
+
+    int length = 0;
+
+    for (std::map<int, int>::const_iterator it = numSamples.begin(); it != numSamples.end(); ++it)
+        length = jmax(length, it->second);
+
+    return length;
+}
+
+int64 PreTriggerBuffer::findSpace(int length)
+{
+    int64 start = writePosition;
+
+    // blocks never wrap around the end of the buffer
+    if (start % capacity + length > capacity)
+        start += capacity - start % capacity;
+
+    const int64 oldest = (numBlocks > 0) ? getBlock(0).start : start;
+
+    return (start + length - oldest <= capacity) ? start : -1;
+}
+
+bool PreTriggerBuffer::hasRoomFor(const std::map<int, int>& numSamples)
+{
+    return numBlocks < maxBlocks && findSpace(getBlockLength(numSamples)) >= 0;
+}
+
+bool PreTriggerBuffer::dropOldest()
+{
+    const Block& block = getBlock(0);
+
+    firstEvent = (firstEvent + block.numEvents) % PRE_TRIGGER_MAX_EVENTS;
+    numEvents -= block.numEvents;
+
+    releaseSpikes(firstSpike, block.numSpikes);
+    firstSpike = (firstSpike + block.numSpikes) % PRE_TRIGGER_MAX_SPIKES;
+    numSpikes -= block.numSpikes;
+
+    firstBlock = (firstBlock + 1) % maxBlocks;
+    numBlocks--;
+
+    if (numUnread > 0)
+    {
+        numUnread--;
+        skipFirstSamples = false;
+        return false;
+    }
+
+    return true;
+}
+
+void PreTriggerBuffer::noteEnds(const std::map<int, int>& numSamples, const std::map<int, int64>& timestamps)
+{
+    numEndStreams = 0;
+
+    for (std::map<int, int64>::const_iterator it = timestamps.begin();
+         it != timestamps.end() && numEndStreams < PRE_TRIGGER_MAX_STREAMS; ++it)
+    {
+        std::map<int, int>::const_iterator count = numSamples.find(it->first);
+
+        endStreamIds[numEndStreams] = it->first;
+        endTimestamps[numEndStreams] = it->second + ((count != numSamples.end()) ? count->second : 0);
+        numEndStreams++;
+    }
+}
+
+bool PreTriggerBuffer::addBlock(const AudioSampleBuffer& buffer,
+                                const std::map<int, int>& numSamples,
+                                const std::map<int, int64>& timestamps)
+{
+    noteEnds(numSamples, timestamps);
+
+    bool keptAll = !lostBlocks;
+    lostBlocks = false;
+
+    if (!keepHistory && !started)
+    {
+        dropPending();
+        return keptAll;
+    }
+
+    const int length = jmin(getBlockLength(numSamples), buffer.getNumSamples());
+
+    int64 start = findSpace(length);
+
+    while (start < 0 || numBlocks == maxBlocks)
+    {
+        if (numBlocks == 0)
+        {
+            // longer than the whole buffer
+            dropPending();
+            return false;
+        }
+
+        if (!dropOldest())
+            keptAll = false;
+
+        start = findSpace(length);
+    }
+
+    Block& block = getBlock(numBlocks);
+
+    block.start = start;
+    block.length = length;
+    block.firstEvent = (firstEvent + numEvents - numPendingEvents) % PRE_TRIGGER_MAX_EVENTS;
+    block.numEvents = numPendingEvents;
+    block.firstSpike = (firstSpike + numSpikes - numPendingSpikes) % PRE_TRIGGER_MAX_SPIKES;
+    block.numSpikes = numPendingSpikes;
+    block.numStreams = 0;
+
+    for (std::map<int, int64>::const_iterator it = timestamps.begin();
+         it != timestamps.end() && block.numStreams < PRE_TRIGGER_MAX_STREAMS; ++it)
+    {
+        std::map<int, int>::const_iterator count = numSamples.find(it->first);
+
+        block.streamIds[block.numStreams] = it->first;
+        block.timestamps[block.numStreams] = it->second;
+        block.numSamples[block.numStreams] = (count != numSamples.end()) ? count->second : 0;
+        block.numStreams++;
+    }
+
+    const int offset = int(start % capacity);
+    const int numToCopy = jmin(numChannels, buffer.getNumChannels());
+
+    for (int i = 0; i < numToCopy; i++)
+        FloatVectorOperations::copy(samples + size_t(i) * capacity + offset, buffer.getReadPointer(i), length);
+
+    numBlocks++;
+    writePosition = start + length;
+    numPendingEvents = 0;
+    numPendingSpikes = 0;
+
+    if (started)
+        numUnread++;
+
+    return keptAll;
+}
+
+float PreTriggerBuffer::getRate(int streamId)
+{
+    const int index = streamIds.indexOf(streamId);
+
+    return (index > -1) ? streamRates[index] : fastestRate;
+}
+
+bool PreTriggerBuffer::endsBeforeStart(const Block& block)
+{
+    for (int s = 0; s < block.numStreams; s++)
+    {
+        int n = 0;
+
+        while (n < numStartStreams && startStreamIds[n] != block.streamIds[s])
+            n++;
+
+        if (n == numStartStreams || block.timestamps[s] + block.numSamples[s] > startTimestamps[n])
+            return false;
+    }
+
+    return true;
+}
+
+void PreTriggerBuffer::markStart(float seconds)
+{
+    started = true;
+
+    numStartStreams = numEndStreams;
+
+    for (int s = 0; s < numEndStreams; s++)
+    {
+        startStreamIds[s] = endStreamIds[s];
+        startTimestamps[s] = endTimestamps[s] - int64(seconds * getRate(endStreamIds[s]) + 0.5f);
+    }
+
+    while (numBlocks > 0 && endsBeforeStart(getBlock(0)))
+        dropOldest();
+
+    // can't start before the oldest sample that was kept
+    if (numBlocks > 0)
+    {
+        const Block& block = getBlock(0);
+
+        for (int s = 0; s < block.numStreams; s++)
+        {
+            for (int n = 0; n < numStartStreams; n++)
+            {
+                if (startStreamIds[n] == block.streamIds[s])
+                    startTimestamps[n] = jmax(startTimestamps[n], block.timestamps[s]);
+            }
+        }
+    }
+
+    numUnread = numBlocks;
+    skipFirstSamples = true;
+}
+
+void PreTriggerBuffer::markStop()
+{
+    started = false;
+}
+
+bool PreTriggerBuffer::isStarted()
+{
+    return started;
+}
+
+int PreTriggerBuffer::getNumUnread()
+{
+    return numUnread;
+}
+
+void PreTriggerBuffer::getStartTimestamps(std::map<int, int64>& timestamps)
+{
+    for (int n = 0; n < numStartStreams; n++)
+        timestamps[startStreamIds[n]] = startTimestamps[n];
+}
+
+int PreTriggerBuffer::getSkip(int streamId)
+{
+    if (!skipFirstSamples || numBlocks == 0)
+        return 0;
+
+    const Block& block = getBlock(0);
+
+    for (int s = 0; s < block.numStreams; s++)
+    {
+        if (block.streamIds[s] != streamId)
+            continue;
+
+        for (int n = 0; n < numStartStreams; n++)
+        {
+            if (startStreamIds[n] == streamId)
+                return int(jlimit(int64(0), int64(block.numSamples[s]), startTimestamps[n] - block.timestamps[s]));
+        }
+    }
+
+    return 0;
+}
+
+void PreTriggerBuffer::readBlock(AudioSampleBuffer& data,
+                                 std::map<int, int>& numSamples,
+                                 std::map<int, int64>& timestamps)
+{
+    const Block& block = getBlock(0);
+
+    if (numChannels > 0)
+    {
+        const int offset = int(block.start % capacity);
+
+        for (int i = 0; i < numChannels; i++)
+            readPointers.set(i, samples + size_t(i) * capacity + offset + getSkip(channelStreams[i]));
+
+        data.setDataToReferTo(readPointers.getRawDataPointer(), numChannels, block.length);
+    }
+
+    for (int s = 0; s < block.numStreams; s++)
+    {
+        const int skip = getSkip(block.streamIds[s]);
+
+        numSamples[block.streamIds[s]] = block.numSamples[s] - skip;
+        timestamps[block.streamIds[s]] = block.timestamps[s] + skip;
+    }
+
+    readEvent = block.firstEvent;
+    readEventsLeft = block.numEvents;
+    readSpike = block.firstSpike;
+    readSpikesLeft = block.numSpikes;
+}
+
+MidiMessage* PreTriggerBuffer::getNextEvent(int& samplePosition)
+{
+    while (readEventsLeft > 0)
+    {
+        const Event& e = events[readEvent];
+
+        readEvent = (readEvent + 1) % PRE_TRIGGER_MAX_EVENTS;
+        readEventsLeft--;
+
+        // events are timed in the stream of the node that sent them
+        const int skip = getSkip((e.size > 1) ? e.data[1] : -1);
+
+        if (e.samplePosition >= skip && e.size > 0)
+        {
+            MidiMessage* event = messages[e.size - 1];
+
+            // the message owns its data; only its bytes change
+            memcpy(const_cast<uint8*>(event->getRawData()), e.data, e.size);
+
+            samplePosition = e.samplePosition - skip;
+            return event;
+        }
+    }
+
+    return nullptr;
+}
+
+SpikeObject* PreTriggerBuffer::getNextSpike(int& electrodeIndex)
+{
+    while (readSpikesLeft > 0)
+    {
+        const Spike& s = spikes.getReference(readSpike);
+
+        readSpike = (readSpike + 1) % PRE_TRIGGER_MAX_SPIKES;
+        readSpikesLeft--;
+
+        int n = 0;
+
+        while (n < numStartStreams && startStreamIds[n] != s.streamId)
+            n++;
+
+        // spikes of an unknown stream go with the block they arrived in
+        if (!s.spike.isNull() && (n == numStartStreams || s.spike->timestamp >= startTimestamps[n]))
+        {
+            electrodeIndex = s.electrodeIndex;
+            return s.spike.get();
+        }
+    }
+
+    return nullptr;
+}
+
+void PreTriggerBuffer::finishBlock()
+{
+    if (numBlocks > 0)
+        dropOldest();
+
+    readEventsLeft = 0;
+    readSpikesLeft = 0;
+}
@@ -0,0 +1,235 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PRETRIGGERBUFFER_H_5D0E8B27__
+#define __PRETRIGGERBUFFER_H_5D0E8B27__
+
+#include "../../../JuceLibraryCode/JuceHeader.h"
+#include "../Visualization/SpikeObject.h"
+#include <map>
+
+#define PRE_TRIGGER_MIN_BLOCK_LENGTH 64 // samples; shorter blocks can fill the block table before the samples run out
+#define PRE_TRIGGER_MAX_STREAMS 32
+#define PRE_TRIGGER_MAX_EVENTS 4096   // events kept at once; more than this drops the oldest blocks
+#define PRE_TRIGGER_EVENT_SIZE 256         // bytes kept of each event; longer messages are cut
+#define PRE_TRIGGER_MAX_SPIKES 4096   // spikes kept at once; more than this drops the oldest blocks
+#define PRE_TRIGGER_MAX_BLOCK_LENGTH 10000 // samples, as in OriginalRecording's conversion buffers
+
+class Channel;
+
+/**
+
+  Keeps the most recent blocks that reached the RecordNode, so that a
+  recording can start before the record button was pressed, and so that
+  nothing is lost while the files are being opened.
+
+  Each block is stored with its sample counts and timestamps (by stream),
+  its events and its spikes, so it can be handed to the record engines
+  later exactly as if it had just arrived. Spikes are kept as handles to
+  the SpikeObjects the detectors made. When there's no room for a new block, the
+  oldest ones are dropped.
+
+  markStart() turns the blocks from a given time onwards into the
+  recording; they are then read back, oldest first, until the buffer has
+  caught up. Dropping one of those blocks loses data, which addBlock()
+  reports.
+
+  Only the processing thread may use the buffer once acquisition has
+  started; prepare() and clear() are called before and after.
+
+  @see RecordNode
+
+*/
+
+class PreTriggerBuffer
+{
+public:
+    PreTriggerBuffer();
+    ~PreTriggerBuffer();
+
+    /** Makes room for the pre-trigger time plus some extra time of every
+        channel, at the fastest of their sample rates, in blocks of at least
+        PRE_TRIGGER_MIN_BLOCK_LENGTH samples. With no pre-trigger time,
+        blocks are only kept once the recording has started. Not real-time
+        safe. */
+    void prepare(const Array<Channel*>& channels, float preTriggerSeconds, float extraSeconds);
+
+    /** Drops every block. */
+    void clear();
+
+    /** Keeps an event for the block that is added next. */
+    void addEvent(const MidiMessage& event, int samplePosition);
+
+    /** Keeps a spike for the block that is added next. streamId is the
+        stream whose samples the spike's timestamp counts, or -1. */
+    void addSpike(const SpikeHandle& spike, int electrodeIndex, int streamId);
+
+    /** True if a block with these sample counts fits without dropping any. */
+    bool hasRoomFor(const std::map<int, int>& numSamples);
+
+    /** Copies a block, along with the events added since the last one.
+        Returns false if a block of the recording had to be dropped. */
+    bool addBlock(const AudioSampleBuffer& buffer,
+                  const std::map<int, int>& numSamples,
+                  const std::map<int, int64>& timestamps);
+
+    /** Starts the recording the given time before the end of the newest
+        block, in every stream. Older blocks are dropped, and so are the
+        first samples and events of the oldest block kept. */
+    void markStart(float seconds);
+
+    /** Ends the recording; blocks added from now on are not part of it. */
+    void markStop();
+
+    bool isStarted();
+
+    /** Blocks of the recording that haven't been read yet. */
+    int getNumUnread();
+
+    /** Timestamps of the first recorded sample of each stream. */
+    void getStartTimestamps(std::map<int, int64>& timestamps);
+
+    /** Points data at the oldest unread block, and sets its sample counts
+        and timestamps. The events and spikes are then read with
+        getNextEvent() and getNextSpike(), and finishBlock() drops the block. */
+    void readBlock(AudioSampleBuffer& data,
+                   std::map<int, int>& numSamples,
+                   std::map<int, int64>& timestamps);
+
+    /** The next event of the block being read, or nullptr. The message
+        belongs to the buffer and is reused by later calls. */
+    MidiMessage* getNextEvent(int& samplePosition);
+
+    /** The next spike of the block being read, or nullptr. Spikes from
+        before the start of the recording are skipped. */
+    SpikeObject* getNextSpike(int& electrodeIndex);
+
+    void finishBlock();
+
+private:
+
+    struct Block
+    {
+        int64 start; // first sample, counted from when the buffer was cleared
+        int length; // samples kept of every channel
+        int firstEvent;
+        int numEvents;
+        int firstSpike;
+        int numSpikes;
+
+        int numStreams;
+        int streamIds[PRE_TRIGGER_MAX_STREAMS];
+        int numSamples[PRE_TRIGGER_MAX_STREAMS];
+        int64 timestamps[PRE_TRIGGER_MAX_STREAMS];
+    };
+
+    struct Event
+    {
+        int samplePosition;
+        int size;
+        uint8 data[PRE_TRIGGER_EVENT_SIZE];
+    };
+
+    struct Spike
+    {
+        SpikeHandle spike;
+        int electrodeIndex;
+        int streamId;
+    };
+
+    /** Where a block of this length can go without dropping any, or -1. */
+    int64 findSpace(int length);
+
+    /** Drops the oldest block; returns false if it was part of the recording. */
+    bool dropOldest();
+
+    /** Lets go of count spikes from first on, which go back to the pool. */
+    void releaseSpikes(int first, int count);
+
+    /** Drops the events and spikes added since the last block. */
+    void dropPending();
+
+    int getBlockLength(const std::map<int, int>& numSamples);
+
+    /** Samples of the given stream that come before the start, in the oldest block. */
+    int getSkip(int streamId);
+
+    bool endsBeforeStart(const Block& block);
+
+    void noteEnds(const std::map<int, int>& numSamples, const std::map<int, int64>& timestamps);
+
+    float getRate(int streamId);
+
+    Block& getBlock(int index);
+
+    int numChannels;
+    int capacity; // samples per channel
+    HeapBlock<float> samples; // channel-major
+    Array<int> channelStreams;
+
+    Array<int> streamIds; // known sample rates, by stream
+    Array<float> streamRates;
+    float fastestRate;
+
+    HeapBlock<Block> blocks;
+    int maxBlocks;
+    int firstBlock;
+    int numBlocks;
+    int64 writePosition;
+
+    HeapBlock<Event> events;
+    OwnedArray<MidiMessage> messages; // one of each size, handed out by getNextEvent()
+    int firstEvent;
+    int numEvents;
+    int numPendingEvents; // added since the last block
+
+    Array<Spike> spikes; // PRE_TRIGGER_MAX_SPIKES of them, used as a ring
+    int firstSpike;
+    int numSpikes;
+    int numPendingSpikes; // added since the last block
+
+    bool keepHistory;
+    bool lostBlocks; // since the last call to addBlock()
+    bool started;
+    int numUnread; // blocks at the start of the buffer that belong to the recording
+    bool skipFirstSamples;
+
+    int numStartStreams;
+    int startStreamIds[PRE_TRIGGER_MAX_STREAMS];
+    int64 startTimestamps[PRE_TRIGGER_MAX_STREAMS];
+
+    int numEndStreams; // where the newest block ended, even if it wasn't kept
+    int endStreamIds[PRE_TRIGGER_MAX_STREAMS];
+    int64 endTimestamps[PRE_TRIGGER_MAX_STREAMS];
+
+    Array<float*> readPointers;
+    int readEvent;
+    int readEventsLeft;
+    int readSpike;
+    int readSpikesLeft;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PreTriggerBuffer);
+
+};
+
+#endif  // __PRETRIGGERBUFFER_H_5D0E8B27__
@@ -57,12 +57,12 @@ SpikeRecordInfo* RecordEngine::getSpikeElectrode(int index)
     return getProcessorGraph()->getRecordNode()->getSpikeElectrode(index);
 }
 
-void RecordEngine::updateTimestamps(std::map<uint8, int64>* ts)
+void RecordEngine::updateTimestamps(std::map<int, int64>* ts)
 {
     timestamps = ts;
 }
 
-void RecordEngine::updateNumSamples(std::map<uint8, int>* ns)
+void RecordEngine::updateNumSamples(std::map<int, int>* ns)
 {
     numSamples = ns;
 }
@@ -46,6 +46,7 @@ struct SpikeRecordInfo
     String name;
     int numChannels;
     int sampleRate;
+    int streamId; // whose samples the spike timestamps count, or -1
 
     int recordIndex;
 };
@@ -67,13 +68,13 @@ public:
     	2-registerProcessor, addChannel, registerSpikeSource, addspikeelectrode
     	3-configureEngine (which calls setParameter)
     	3-startAcquisition
-    During acquisition:
-    	updateTimeStamps
     When recording starts (in the specified order):
     	1-directoryChanged (if needed)
-    	2-openFiles
+    	2-updateTimestamps, with the timestamps of the first recorded samples
+    	3-openFiles, on a separate thread
     During recording:
-    	writeData, writeEvent, writeSpike
+    	updateTimestamps and updateNumSamples, then writeData, writeEvent, writeSpike
+    	(the first blocks may have been buffered, and are written late)
     When recording stops:
     	closeFiles
     */
@@ -130,10 +131,10 @@ public:
 
     /** Called every time a new timestamp event is received
     */
-    void updateTimestamps(std::map<uint8, int64>* timestamps);
+    void updateTimestamps(std::map<int, int64>* timestamps);
 
     /** Called every time a new numSamples event is received */
-    void updateNumSamples(std::map<uint8, int>* numSamples);
+    void updateNumSamples(std::map<int, int>* numSamples);
 
     /** Called after all channels and spike groups have been registered,
     	just before acquisition starts
@@ -164,8 +165,8 @@ protected:
     */
     String generateDateString();
 
-    std::map<uint8, int>* numSamples;
-    std::map<uint8, int64>* timestamps;
+    std::map<int, int>* numSamples;   // by stream; see Channel::getStreamId()
+    std::map<int, int64>* timestamps;
 
 private:
     RecordEngineManager* manager;
@@ -35,7 +35,8 @@
 
 RecordNode::RecordNode()
     : GenericProcessor("Record Node"),
-      newDirectoryNeeded(true),  timestamp(0)
+      newDirectoryNeeded(true),  timestamp(0), preTriggerTime(0.0f),
+      writingDirectly(false), bufferedData(1, 1)
 {
 
     isProcessing = false;
@@ -53,6 +54,9 @@ RecordNode::RecordNode()
 
     spikeElectrodeIndex = 0;
 
+    queuedSpikes.ensureStorageAllocated(RECORD_SPIKE_QUEUE_SIZE);
+    writtenSpikes.ensureStorageAllocated(RECORD_SPIKE_QUEUE_SIZE);
+
     experimentNumber = 0;
     hasRecorded = false;
 
@@ -64,6 +68,12 @@ RecordNode::RecordNode()
 
 RecordNode::~RecordNode()
 {
+    if (fileOpener != nullptr)
+    {
+        startMarked.signal();
+        fileOpener->waitForThreadToExit(-1);
+    }
+
     delete eventChannel; // Memory leak fixed by Michael Borisov
 }
 
@@ -115,6 +125,12 @@ void RecordNode::filenameComponentChanged(FilenameComponent* fnc)
 
 }
 
+void RecordNode::setDataDirectory(const File& directory)
+{
+    dataDirectory = directory;
+    newDirectoryNeeded = true;
+}
+
 void RecordNode::updateChannelName(int channelIndex, String newname)
 {
     /*  if (channelPointers[channelIndex] != nullptr && channelIndex < channelPointers.size())
@@ -184,6 +200,16 @@ void RecordNode::addInputChannel(GenericProcessor* sourceNode, int chan)
 
 }
 
+void RecordNode::setPreTriggerTime(float seconds)
+{
+    preTriggerTime = jmax(0.0f, seconds);
+}
+
+float RecordNode::getPreTriggerTime()
+{
+    return preTriggerTime;
+}
+
 void RecordNode::updateTrialNumber()
 {
     trialNum++;
@@ -288,10 +314,16 @@ void RecordNode::setParameter(int parameterIndex, float newValue)
     if (parameterIndex == 1)
     {
 
-        isRecording = true;
         hasRecorded = true;
         // std::cout << "START RECORDING." << std::endl;
 
+        // the previous recording's files are opened by now
+        if (fileOpener != nullptr)
+        {
+            startMarked.signal();
+            fileOpener->waitForThreadToExit(-1);
+        }
+
         if (newDirectoryNeeded)
         {
             createNewDirectory();
@@ -311,9 +343,14 @@ void RecordNode::setParameter(int parameterIndex, float newValue)
             getEditorViewport()->saveState(File(settingsFileName));
         }
 
-        EVERY_ENGINE->openFiles(rootFolder, experimentNumber, recordingNumber);
+        // the processing thread marks the start in the pre-trigger buffer,
+        // and keeps the data there until the files are open
+        startMarked.reset();
+        isRecording = true;
+        startRequested.set(1);
 
-        allFilesOpened = true;
+        fileOpener = new FileOpener(this);
+        fileOpener->startThread();
 
     }
     else if (parameterIndex == 0)
@@ -369,7 +406,93 @@ void RecordNode::closeAllFiles()
     {
         EVERY_ENGINE->closeFiles();
         allFilesOpened = false;
+        filesOpened.set(0);
+    }
+}
+
+RecordNode::FileOpener::FileOpener(RecordNode* n)
+    : Thread("Record File Opener"), node(n)
+{
+}
+
+void RecordNode::FileOpener::run()
+{
+    node->openAllFiles();
+}
+
+void RecordNode::openAllFiles()
+{
+    // engines that store the start time read it when their files are opened
+    startMarked.wait(-1);
+
+    startTimestamps.clear();
+    preTrigger.getStartTimestamps(startTimestamps);
+
+    EVERY_ENGINE->updateTimestamps(&startTimestamps);
+
+    int64 start = Time::getHighResolutionTicks();
+
+    EVERY_ENGINE->openFiles(rootFolder, experimentNumber, recordingNumber);
+
+    std::cout << "Opened recording files in "
+              << Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start) * 1000.0
+              << " ms." << std::endl;
+
+    filesOpened.set(1);
+}
+
+void RecordNode::writeBufferedBlock()
+{
+    preTrigger.readBlock(bufferedData, bufferedNumSamples, bufferedTimestamps);
+
+    EVERY_ENGINE->updateTimestamps(&bufferedTimestamps);
+    EVERY_ENGINE->updateNumSamples(&bufferedNumSamples);
+
+    MidiMessage* event;
+    int samplePosition;
+
+    while ((event = preTrigger.getNextEvent(samplePosition)) != nullptr)
+        EVERY_ENGINE->writeEvent(*event->getRawData(), *event, samplePosition);
+
+    SpikeObject* spike;
+    int electrodeIndex;
+
+    while ((spike = preTrigger.getNextSpike(electrodeIndex)) != nullptr)
+        EVERY_ENGINE->writeSpike(*spike, electrodeIndex);
+
+    if (channelPointers.size() > 0)
+        EVERY_ENGINE->writeData(bufferedData);
+
+    preTrigger.finishBlock();
+}
+
+void RecordNode::writeQueuedSpikes()
+{
+    {
+        const SpinLock::ScopedLockType lock(spikeQueueLock);
+        writtenSpikes.swapWith(queuedSpikes);
+    }
+
+    for (int i = 0; i < writtenSpikes.size(); i++)
+    {
+        const QueuedSpike& queued = writtenSpikes.getReference(i);
+
+        if (writingDirectly)
+        {
+            EVERY_ENGINE->writeSpike(*queued.spike, queued.electrodeIndex);
+        }
+        else
+        {
+            // kept with the block that is added next, like the events
+            SpikeRecordInfo* electrode = spikeElectrodePointers[queued.electrodeIndex];
+            const int streamId = (electrode != nullptr) ? electrode->streamId : -1;
+
+            preTrigger.addSpike(queued.spike, queued.electrodeIndex, streamId);
+        }
     }
+
+    // clearQuick keeps the storage; the handles return the spikes to the pool
+    writtenSpikes.clearQuick();
 }
 
 bool RecordNode::enable()
@@ -384,6 +507,13 @@ bool RecordNode::enable()
     recordingNumber = -1;
     EVERY_ENGINE->configureEngine();
     EVERY_ENGINE->startAcquisition();
+
+    preTrigger.prepare(channelPointers, preTriggerTime, RECORD_OPEN_TIME);
+    startRequested.set(0);
+    lostBlocks.set(0);
+    droppedSpikes.set(0);
+    writingDirectly = false;
+
     isProcessing = true;
     return true;
 }
@@ -394,8 +524,39 @@ bool RecordNode::disable()
     // close files if necessary
     setParameter(0, 10.0f);
 
+    if (fileOpener != nullptr)
+    {
+        // in case no block arrived after recording started
+        startMarked.signal();
+        fileOpener->waitForThreadToExit(-1);
+        fileOpener = nullptr;
+    }
+
+    if (filesOpened.get() != 0)
+        allFilesOpened = true;
+
     if (isProcessing)
+    {
+        if (allFilesOpened)
+        {
+            while (preTrigger.getNumUnread() > 0)
+                writeBufferedBlock();
+        }
+
+        writeQueuedSpikes();
         closeAllFiles();
+    }
+
+    signalFilesShouldClose = false;
+    preTrigger.clear();
+
+    if (lostBlocks.exchange(0) != 0)
+        std::cout << "Record Node: the pre-trigger buffer was full; data was lost before the files were opened." << std::endl;
+
+    const int dropped = droppedSpikes.exchange(0);
+
+    if (dropped > 0)
+        std::cout << "Record Node: the spike queue was full; dropped " << dropped << " spikes." << std::endl;
 
     isProcessing = false;
 
@@ -410,14 +571,14 @@ float RecordNode::getFreeSpace()
 
 void RecordNode::handleEvent(int eventType, MidiMessage& event, int samplePosition)
 {
-    if (isRecording && allFilesOpened)
+    if ((eventType == TTL) || (eventType == MESSAGE) || (eventType == NETWORK))
     {
-        if ((eventType == TTL) || (eventType == MESSAGE) || (eventType == NETWORK))
+        if (event.getRawData()+4 > 0) // saving flag > 0 (i.e., event has not already been processed)
         {
-            if (event.getRawData()+4 > 0) // saving flag > 0 (i.e., event has not already been processed)
-            {
+            if (writingDirectly)
                 EVERY_ENGINE->writeEvent(eventType, event, samplePosition);
-            }
+            else
+                preTrigger.addEvent(event, samplePosition);
         }
     }
 }
@@ -425,14 +586,50 @@ void RecordNode::handleEvent(int eventType, MidiMessage& event, int samplePositi
 void RecordNode::process(AudioSampleBuffer& buffer,
                          MidiBuffer& events)
 {
+    if (!allFilesOpened && filesOpened.get() != 0)
+        allFilesOpened = true;
+
+    if (startRequested.compareAndSetBool(0, 1))
+    {
+        preTrigger.markStart(preTriggerTime);
+        startMarked.signal();
+    }
+
+    // read once, so that the data and events of a block go the same way
+    const bool recording = isRecording;
+
+    if (!recording && preTrigger.isStarted())
+    {
+        preTrigger.markStop();
+        writingDirectly = false;
+    }
+
+    // this is intended to prevent parameter changes from closing files
+    // before recording stops
+    if (signalFilesShouldClose && !recording && allFilesOpened)
+    {
+        // what was recorded before the stop is still waiting in the buffer
+        while (preTrigger.getNumUnread() > 0)
+            writeBufferedBlock();
+
+        closeAllFiles();
+        signalFilesShouldClose = false;
+    }
+
+    // the spike sources of this block have all run by now; their spikes
+    // go with this block, straight to the engines or into the buffer
+    writeQueuedSpikes();
+
+    if (writingDirectly)
+    {
+        EVERY_ENGINE->updateTimestamps(&timestamps);
+        EVERY_ENGINE->updateNumSamples(&numSamples);
+    }
+
     // FIRST: cycle through events -- extract the TTLs and the timestamps
     checkForEvents(events);
 
-    //update timstamp data even if we're not recording yet
-    EVERY_ENGINE->updateTimestamps(&timestamps);
-    EVERY_ENGINE->updateNumSamples(&numSamples);
-
-    if (isRecording && allFilesOpened)
+    if (writingDirectly)
     {
         // SECOND: write channel data
         if (channelPointers.size() > 0)
@@ -446,12 +643,23 @@ void RecordNode::process(AudioSampleBuffer& buffer,
 
     }
 
-    // this is intended to prevent parameter changes from closing files
-    // before recording stops
-    if (signalFilesShouldClose)
+    const bool canWrite = recording && allFilesOpened;
+
+    // write the oldest blocks rather than drop them
+    while (canWrite && preTrigger.getNumUnread() > 0 && !preTrigger.hasRoomFor(numSamples))
+        writeBufferedBlock();
+
+    // reported by disable(), off the processing thread
+    if (!preTrigger.addBlock(buffer, numSamples, timestamps))
+        lostBlocks.set(1);
+
+    if (canWrite)
     {
-        closeAllFiles();
-        signalFilesShouldClose = false;
+        for (int n = 0; n < RECORD_CATCH_UP_BLOCKS && preTrigger.getNumUnread() > 0; n++)
+            writeBufferedBlock();
+
+        if (preTrigger.getNumUnread() == 0)
+            writingDirectly = true;
     }
 
 }
@@ -484,9 +692,22 @@ int RecordNode::addSpikeElectrode(SpikeRecordInfo* elec)
     return spikeElectrodeIndex++;
 }
 
-void RecordNode::writeSpike(SpikeObject& spike, int electrodeIndex)
+void RecordNode::writeSpike(const SpikeHandle& spike, int electrodeIndex)
 {
-    EVERY_ENGINE->writeSpike(spike,electrodeIndex);
+    const SpinLock::ScopedLockType lock(spikeQueueLock);
+
+    // the queue never grows, so writing a spike never allocates
+    if (queuedSpikes.size() < RECORD_SPIKE_QUEUE_SIZE)
+    {
+        QueuedSpike queued;
+        queued.spike = spike;
+        queued.electrodeIndex = electrodeIndex;
+        queuedSpikes.add(queued);
+    }
+    else
+    {
+        ++droppedSpikes;
+    }
 }
 
 SpikeRecordInfo* RecordNode::getSpikeElectrode(int index)
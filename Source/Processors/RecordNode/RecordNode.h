@@ -30,13 +30,18 @@
 
 #include "../GenericProcessor/GenericProcessor.h"
 #include "../Channel/Channel.h"
+#include "PreTriggerBuffer.h"
+#include "../Visualization/SpikeObject.h"
 
 
 #define HEADER_SIZE 1024
 #define BLOCK_LENGTH 1024
 
+#define RECORD_OPEN_TIME 1.0f        // seconds buffered on top of the pre-trigger time while files are opened
+#define RECORD_CATCH_UP_BLOCKS 4     // buffered blocks written per callback until the buffer has caught up
+#define RECORD_SPIKE_QUEUE_SIZE 4096 // spikes held between callbacks; more are dropped
+
 struct SpikeRecordInfo;
-struct SpikeObject;
 class RecordEngine;
 
 /**
@@ -46,7 +51,13 @@ class RecordEngine;
 
   Receives a signal from the ControlPanel to begin recording.
 
-  @see GenericProcessor, ControlPanel
+  Files are opened on a separate thread when recording starts. Until
+  they are, incoming blocks wait in a PreTriggerBuffer with their events
+  and spikes. The buffer also keeps the last few seconds before the
+  record button was pressed when a pre-trigger time is set. The buffered blocks are written a few at a
+  time, then the node goes back to writing each block as it arrives.
+
+  @see GenericProcessor, ControlPanel, PreTriggerBuffer
 
 */
 
@@ -117,6 +128,11 @@ public:
     */
     void filenameComponentChanged(FilenameComponent*);
 
+    /** Sets the folder that recording directories are created in, without the
+        folder selector; the next recording starts a new directory.
+    */
+    void setDataDirectory(const File& directory);
+
     /** Creates a new data directory in the location specified by the fileNameComponent.
     */
     void createNewDirectory();
@@ -127,6 +143,13 @@ public:
         return rootFolder;
     }
 
+    /** Sets how much data from before the start of each recording is
+        kept; takes effect when acquisition next starts.
+    */
+    void setPreTriggerTime(float seconds);
+
+    float getPreTriggerTime();
+
     void appendTrialNumber(bool);
 
     void updateTrialNumber();
@@ -149,9 +172,11 @@ public:
     */
     int addSpikeElectrode(SpikeRecordInfo* elec);
 
-    /** Called by a spike recording source to write a spike to file
+    /** Called by a spike recording source to write a spike to file.
+    The spike is queued and written by the RecordNode's own process(), since
+    sources on different branches of the signal chain may run at the same time.
     */
-    void writeSpike(SpikeObject& spike, int electrodeIndex);
+    void writeSpike(const SpikeHandle& spike, int electrodeIndex);
 
     SpikeRecordInfo* getSpikeElectrode(int index);
 
@@ -195,6 +220,67 @@ private:
     */
     void closeAllFiles();
 
+    /** Opens the files of a new recording, on the FileOpener's thread.
+    */
+    void openAllFiles();
+
+    /** Writes the oldest buffered block of the recording, with its events.
+    */
+    void writeBufferedBlock();
+
+    /** Writes the spikes queued by writeSpike since the last block, or keeps them
+    in the pre-trigger buffer with the block that is added next.
+    */
+    void writeQueuedSpikes();
+
+    class FileOpener : public Thread
+    {
+    public:
+        FileOpener(RecordNode* node);
+        void run();
+
+    private:
+        RecordNode* node;
+    };
+
+    ScopedPointer<FileOpener> fileOpener;
+
+    /** Set by the FileOpener; allFilesOpened follows it on the processing thread. */
+    Atomic<int> filesOpened;
+
+    /** Set when recording starts, until the processing thread has marked the start. */
+    Atomic<int> startRequested;
+    WaitableEvent startMarked;
+
+    PreTriggerBuffer preTrigger;
+    float preTriggerTime;
+
+    /** True while blocks go straight to the engines rather than through the buffer. */
+    bool writingDirectly;
+
+    /** Set when the buffer dropped part of a recording; reported when acquisition stops. */
+    Atomic<int> lostBlocks;
+
+    /** Spikes that didn't fit in the queue; reported when acquisition stops. */
+    Atomic<int> droppedSpikes;
+
+    struct QueuedSpike
+    {
+        SpikeHandle spike;
+        int electrodeIndex;
+    };
+
+    /** Filled by writeSpike under spikeQueueLock, and swapped with writtenSpikes
+    by the processing thread; both keep their storage. */
+    Array<QueuedSpike> queuedSpikes;
+    Array<QueuedSpike> writtenSpikes;
+    SpinLock spikeQueueLock;
+
+    AudioSampleBuffer bufferedData;
+    std::map<int, int> bufferedNumSamples;
+    std::map<int, int64> bufferedTimestamps;
+    std::map<int, int64> startTimestamps;
+
     /** Pointers to all continuous channels */
     Array<Channel*> channelPointers;
 
@@ -23,26 +23,22 @@
 
 #include "ResamplingNode.h"
 #include "ResamplingNodeEditor.h"
+#include "../../UI/EditorViewport.h"
 
 #include <stdio.h>
 
 ResamplingNode::ResamplingNode()
     : GenericProcessor("Resampler"),
-      targetSampleRate(5000.0f), ratio(1.0)
+      targetSampleRate(5000.0f)
 {
 
-    filter = new Dsp::SmoothedFilterDesign
-    <Dsp::RBJ::Design::LowPass, 1> (1024);
-
     parameters.add(Parameter("Hz",500.0f, 10000.0f, targetSampleRate, 0, true));
 
-    tempBuffer = new AudioSampleBuffer(16, TEMP_BUFFER_WIDTH);
-
 }
 
 ResamplingNode::~ResamplingNode()
 {
-    filter = 0;
+
 }
 
 AudioProcessorEditor* ResamplingNode::createEditor()
@@ -65,171 +61,284 @@ void ResamplingNode::setParameter(int parameterIndex, float newValue)
 
         targetSampleRate = newValue;
 
-        settings.sampleRate = targetSampleRate;
+        //std::cout << "Got parameter update." << std::endl;
+    }
+    else if (parameterIndex == 1 && currentChannel >= 0)
+    {
+        setResampleState(currentChannel, newValue != 0);
+    }
 
-        ratio = sourceBufferSampleRate / targetSampleRate;
+    // neither can change during acquisition, so the chain can be updated;
+    // downstream processors pick up the new rates
+    getEditorViewport()->makeEditorVisible(getEditor(), false, true);
 
-        for (int i = 0; i < channels.size(); i++)
-        {
-            channels[i]->sampleRate = targetSampleRate;
-        }
+    //std::cout << float(p[0]) << std::endl;
 
-        updateFilter();
+}
 
-        //std::cout << "Got parameter update." << std::endl;
+void ResamplingNode::setResampleStates(const Array<int>& chans, bool resample)
+{
+    editor->updateParameterButtons(1);
+
+    for (int n = 0; n < chans.size(); n++)
+    {
+        if (chans[n] >= 0)
+            setResampleState(chans[n], resample);
     }
 
-    //std::cout << float(p[0]) << std::endl;
+    getEditorViewport()->makeEditorVisible(getEditor(), false, true);
+}
 
+void ResamplingNode::setResampleState(int chan, bool resample)
+{
+    while (shouldResample.size() <= chan)
+        shouldResample.add(true);
+
+    shouldResample.set(chan, resample);
 }
 
 bool ResamplingNode::enable()
 {
 
+    for (int i = 0; i < resamplers.size(); i++)
+    {
+        if (resamplers[i] != nullptr)
+            resamplers[i]->reset();
+    }
 
-    tempBuffer->clear();
-
-    updateFilter();
+    for (int s = 0; s < streams.size(); s++)
+        streams.getReference(s).hasTimestamp = false;
 
     return true;
 
 }
 
+bool ResamplingNode::getResampleStateForChannel(int chan)
+{
+    return shouldResample[chan];
+}
+
 void ResamplingNode::updateSettings()
 {
 
-    sourceBufferSampleRate = settings.sampleRate;
-    settings.sampleRate = targetSampleRate;
+    filterBanks.clear();
+    resamplers.clear();
+    streams.clear();
+    channelStream.clear();
 
-    if (getNumInputs() > 0)
-        tempBuffer->setSize(getNumInputs(), TEMP_BUFFER_WIDTH);
+    while (shouldResample.size() < channels.size())
+        shouldResample.add(true);
 
-    ratio = sourceBufferSampleRate / targetSampleRate;
+    bool allResampled = true;
 
     for (int i = 0; i < channels.size(); i++)
     {
-        channels[i]->sampleRate = targetSampleRate;
-    }
+        Channel* chan = channels[i];
+        const double sourceRate = chan->sampleRate;
 
-    updateFilter();
+        channelStream.add(-1);
 
-}
+        if (!shouldResample[i] || std::abs(sourceRate - targetSampleRate) < 1e-6)
+        {
+            resamplers.add(nullptr);
+            allResampled = allResampled && shouldResample[i];
+            continue;
+        }
 
+        const int inputStreamId = chan->getStreamId();
+        int s = findStream(inputStreamId);
 
-void ResamplingNode::updateFilter()
-{
+        if (s < 0)
+        {
+            // the new stream is keyed by this node and the source
+            for (int k = 0; k < streams.size(); k++)
+            {
+                if (streams[k].sourceNodeId == chan->sourceNodeId)
+                {
+                    std::cout << getName() << ": channel " << i + 1 << " arrives at a different rate "
+                              << "from the rest of its source; it won't be resampled." << std::endl;
+                    s = -2;
+                }
+            }
+
+            if (s == -2)
+            {
+                resamplers.add(nullptr);
+                allResampled = false;
+                continue;
+            }
+
+            ResampledStream stream;
+            stream.inputStreamId = inputStreamId;
+            stream.sourceNodeId = chan->sourceNodeId;
+            stream.ratio = sourceRate / targetSampleRate;
+            stream.numProduced = 0;
+            stream.nextTimestamp = 0;
+            stream.hasTimestamp = false;
+
+            s = streams.size();
+            streams.add(stream);
+        }
+
+        channelStream.set(i, s);
+
+        PolyphaseFilterBank* bank = nullptr;
+
+        for (int b = 0; b < filterBanks.size(); b++)
+        {
+            if (filterBanks[b]->getSourceRate() == sourceRate)
+                bank = filterBanks[b];
+        }
 
-    double cutoffFreq = (ratio > 1.0) ? 2 * targetSampleRate  // downsample
-                        : targetSampleRate / 2; // upsample
+        if (bank == nullptr)
+        {
+            bank = new PolyphaseFilterBank(sourceRate, targetSampleRate);
+            filterBanks.add(bank);
+        }
 
-    double sampleFreq = (ratio > 1.0) ? sourceBufferSampleRate // downsample
-                        : targetSampleRate;  // upsample
+        PolyphaseResampler* resampler = new PolyphaseResampler(RESAMPLING_MAX_BLOCK_SIZE);
+        resampler->setFilterBank(bank, 1);
+        resamplers.add(resampler);
 
-    Dsp::Params params;
-    params[0] = sampleFreq; // sample rate
-    params[1] = cutoffFreq; // cutoff frequency
-    params[2] = 1.25; //Q //
+        chan->sampleRate = targetSampleRate;
+        chan->decimation *= (float) streams[s].ratio;
+        chan->streamId = Channel::getStreamId(nodeId, chan->sourceNodeId);
+    }
 
-    filter->setParams(params);
+    // the processor's rate is the rate of the channels it leaves alone, if any
+    if (allResampled)
+        settings.sampleRate = targetSampleRate;
 
 }
 
-// void ResamplingNode::releaseResources()
-// {
-// 	//fclose(file);
-// }
+int ResamplingNode::findStream(int inputStreamId)
+{
+    for (int s = 0; s < streams.size(); s++)
+    {
+        if (streams[s].inputStreamId == inputStreamId)
+            return s;
+    }
+
+    return -1;
+}
 
 void ResamplingNode::process(AudioSampleBuffer& buffer,
                              MidiBuffer& midiMessages)
 {
 
-    //std::cout << "Resampling node sample count: " << nSamples << std::endl; ///buffer.getNumSamples() << std::endl;
+    const int nChannels = jmin(buffer.getNumChannels(), resamplers.size());
 
-    // save data at the beginning of each round of processing
-    //writeContinuousBuffer(buffer.getSampleData(0), nSamples, 0);
-
-    int nSamples = 100; // SOME NUMBER
-
-    int nSamps = float(nSamples);
-    int valuesNeeded = int(nSamps / ratio);
-
-    if (ratio > 1.0001)
+    for (int i = 0; i < nChannels; i++)
     {
-        // pre-apply filter before downsampling
-        filter->process(nSamples, buffer.getArrayOfWritePointers());
-    }
+        if (resamplers[i] == nullptr)
+            continue;
 
-    // initialize variables
-    tempBuffer->clear();
-    int sourceBufferPos = 0;
-    int sourceBufferSize = buffer.getNumSamples();
-    float subSampleOffset = 0.0;
-    int nextPos = (sourceBufferPos + 1) % sourceBufferSize;
+        ResampledStream& stream = streams.getReference(channelStream[i]);
 
-    int tempBufferPos;
+        // getNumSamples() would look up the channel's new stream
+        std::map<int, int>::const_iterator count = numSamples.find(stream.inputStreamId);
+        const int nSamples = (count != numSamples.end()) ? jmin(count->second, buffer.getNumSamples()) : 0;
 
-    // code modified from "juce_ResamplingAudioSource.cpp":
+        const float* source = buffer.getReadPointer(i);
+        float* dest = buffer.getWritePointer(i);
+        int produced = 0;
 
-    for (tempBufferPos = 0; tempBufferPos < valuesNeeded; tempBufferPos++)
-    {
-        float gain = 1.0;
-        float alpha = (float) subSampleOffset;
-        float invAlpha = 1.0f - alpha;
+        // the FIFO holds RESAMPLING_MAX_BLOCK_SIZE samples, so longer blocks go
+        // through it in pieces. The input is copied into the FIFO before the
+        // output can overwrite it.
+        int start = 0;
 
-        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        do
         {
+            const int length = jmin(RESAMPLING_MAX_BLOCK_SIZE, nSamples - start);
 
-            tempBuffer->addFrom(channel, 		// destChannel
-                                tempBufferPos,  // destSampleOffset
-                                buffer,			// source
-                                channel,		// sourceChannel
-                                sourceBufferPos,// sourceSampleOffset
-                                1,				// number of samples
-                                invAlpha*gain);      // gain to apply to source
-
-            tempBuffer->addFrom(channel, 		// destChannel
-                                tempBufferPos,   // destSampleOffset
-                                buffer,			// source
-                                channel,			// sourceChannel
-                                nextPos,		 	// sourceSampleOffset
-                                1,				// number of samples
-                                alpha*gain);     	 // gain to apply to source
+            resamplers[i]->write(source + start, length);
+            start += length;
 
+            // once all of the input is in, the output can fill the buffer
+            const int limit = (start < nSamples) ? start : buffer.getNumSamples();
+
+            produced += resamplers[i]->readAvailable(dest + produced, limit - produced);
         }
+        while (start < nSamples);
 
-        subSampleOffset += ratio;
+        // every channel of a stream gets the same count, since they share the filter bank
+        stream.numProduced = produced;
+    }
 
-        while (subSampleOffset >= 1.0)
+    for (int s = 0; s < streams.size(); s++)
+    {
+        ResampledStream& stream = streams.getReference(s);
+
+        if (!stream.hasTimestamp)
         {
-            if (++sourceBufferPos >= sourceBufferSize)
-                sourceBufferPos = 0;
+            std::map<int, int64>::const_iterator ts = timestamps.find(stream.inputStreamId);
 
-            nextPos = (sourceBufferPos + 1) % sourceBufferSize;
-            subSampleOffset -= 1.0;
+            stream.nextTimestamp = (ts != timestamps.end()) ? (int64) (ts->second / stream.ratio) : 0;
+            stream.hasTimestamp = true;
         }
+
+        setTimestamp(midiMessages, stream.nextTimestamp, stream.sourceNodeId);
+        setNumSamples(midiMessages, stream.numProduced, stream.sourceNodeId);
+
+        stream.nextTimestamp += stream.numProduced;
     }
 
-    // std::cout << sourceBufferPos << " " << tempBufferPos << std::endl;
+}
 
+void ResamplingNode::saveCustomChannelParametersToXml(XmlElement* channelInfo, int channelNumber, bool isEventChannel)
+{
 
-    if (ratio < 0.9999)
+    if (!isEventChannel && channelNumber > -1 && channelNumber < shouldResample.size())
     {
-
-        filter->process(tempBufferPos, tempBuffer->getArrayOfWritePointers());
-        // apply the filter after upsampling
-        ///////filter->process (totalSamples, buffer.getArrayOfChannels());
+        XmlElement* channelParams = channelInfo->createNewChildElement("PARAMETERS");
+        channelParams->setAttribute("resample", shouldResample[channelNumber]);
     }
-    else if (ratio <= 1.0001)
-    {
 
-        // no resampling is being applied, no need to filter, BUT...
-        // keep the filter stoked with samples to avoid discontinuities
+}
+
+void ResamplingNode::loadCustomChannelParametersFromXml(XmlElement* channelInfo, bool isEventChannel)
+{
+
+    int channelNum = channelInfo->getIntAttribute("number");
+
+    if (!isEventChannel && channelNum > -1)
+    {
+        forEachXmlChildElement(*channelInfo, subNode)
+        {
+            if (subNode->hasTagName("PARAMETERS"))
+            {
+                while (shouldResample.size() <= channelNum)
+                    shouldResample.add(true);
 
+                shouldResample.set(channelNum, subNode->getBoolAttribute("resample", true));
+            }
+        }
     }
 
-    // copy the tempBuffer back into the original buffer
-    buffer = AudioSampleBuffer(tempBuffer->getArrayOfWritePointers(), 2, tempBufferPos);//buffer.getNumSamples());
+}
+
+bool ResamplingNode::saveCustomChannelParametersToSnapshot(OutputStream& stream)
+{
+    stream.writeInt(shouldResample.size());
+
+    for (int i = 0; i < shouldResample.size(); i++)
+        stream.writeBool(shouldResample[i]);
+
+    return true;
+}
 
-    nSamples = valuesNeeded;
+bool ResamplingNode::loadCustomChannelParametersFromSnapshot(InputStream& stream)
+{
+    const int numChannels = stream.readInt();
+
+    if (numChannels < 0)
+        return false;
+
+    shouldResample.clearQuick();
 
+    for (int i = 0; i < numChannels; i++)
+        shouldResample.add(stream.readBool());
+
+    return true;
 }
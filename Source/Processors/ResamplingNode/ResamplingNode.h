@@ -26,18 +26,34 @@
 
 
 #include "../../../JuceLibraryCode/JuceHeader.h"
-#include "../Dsp/Dsp.h"
 #include "../GenericProcessor/GenericProcessor.h"
+#include "../AudioNode/PolyphaseResampler.h"
 
-#define TEMP_BUFFER_WIDTH 5000
+#define RESAMPLING_MAX_BLOCK_SIZE 10000 // input samples per channel that each FIFO holds; larger blocks are split
 
 /**
 
-  Changes the sample rate of continuous data.
+  Changes the sample rate of continuous data, e.g. to decimate 30 kHz wideband
+  data to 1-2.5 kHz for LFP analysis early in the chain.
 
-  Code is based on Juce's ResamplingAudioSource class.
+  Every resampled channel runs through a PolyphaseResampler (the windowed-sinc
+  filter bank also used by the AudioNode), one filter bank per input sample
+  rate. Each block takes the channel's real sample count from the event buffer
+  and emits as many output samples as that input allows. The filter phase and
+  history carry over between blocks, so the output is continuous.
 
-  @see GenericProcessor
+  Channels can be left at their own rate (the "+CH" button), so full-rate
+  spike channels and decimated LFP channels can share one buffer. Resampled
+  channels get a stream of their own (see Channel::getStreamId()): this node
+  sends a sample count and a timestamp (in output samples) for it with every
+  block, and records the decimation in each Channel. Events keep the source's
+  timebase. The filter delays the data by half its length; this is not taken
+  out of the timestamps.
+
+  Blocks can't grow, so upsampling is limited to the size of the buffer; any
+  input left over waits for the next block.
+
+  @see GenericProcessor, PolyphaseResampler
 
 */
 
@@ -51,14 +67,28 @@ public:
     ~ResamplingNode();
 
     void process(AudioSampleBuffer& buffer, MidiBuffer& midiMessages);
+
+    /** Parameter 0 is the target rate; parameter 1 turns resampling of the
+        current channel on or off. Both change the signal chain, so neither
+        can be used during acquisition. */
     void setParameter(int parameterIndex, float newValue);
 
-    void updateSettings();
+    /** Turns resampling of several channels on or off, and updates the signal
+        chain once for all of them. */
+    void setResampleStates(const Array<int>& chans, bool resample);
 
-    void updateFilter();
+    void updateSettings();
 
     bool enable();
 
+    bool getResampleStateForChannel(int chan);
+
+    void saveCustomChannelParametersToXml(XmlElement* channelInfo, int channelNumber, bool isEventChannel);
+    void loadCustomChannelParametersFromXml(XmlElement* channelInfo, bool isEventChannel);
+
+    bool saveCustomChannelParametersToSnapshot(OutputStream& stream);
+    bool loadCustomChannelParametersFromSnapshot(InputStream& stream);
+
     AudioProcessorEditor* createEditor();
     bool hasEditor() const
     {
@@ -67,24 +97,30 @@ public:
 
 private:
 
-    // sample rate, timebase, and ratio info:
+    /** The resampled channels of one input stream. */
+    struct ResampledStream
+    {
+        int inputStreamId;
+        int sourceNodeId;
+        double ratio;         // input samples per output sample
+        int numProduced;      // output samples in the current block
+        int64 nextTimestamp;  // in output samples
+        bool hasTimestamp;
+    };
+
+    int findStream(int inputStreamId);
+
+    void setResampleState(int chan, bool resample);
+
     double targetSampleRate;
-    double sourceBufferSampleRate; //, destBufferSampleRate;
-    double ratio; //, lastRatio;
-    //double destBufferTimebaseSecs;
-    //int destBufferWidth;
-
-    // major objects:
-    Dsp::Filter* filter;
-    //ScopedPointer<AudioSampleBuffer> destBuffer;
-    ScopedPointer<AudioSampleBuffer> tempBuffer;
-
-    // is the destBuffer a temp buffer or not?
-    //bool destBufferIsTempBuffer;
-    //bool isTransmitting;
-
-    // indexing objects that persist between rounds:
-    //int destBufferPos;
+
+    Array<bool> shouldResample; // by channel
+
+    OwnedArray<PolyphaseFilterBank> filterBanks; // one per input sample rate
+    OwnedArray<PolyphaseResampler> resamplers;   // one per channel, or nullptr if it isn't resampled
+
+    Array<ResampledStream> streams;
+    Array<int> channelStream; // index into streams for each resampled channel
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ResamplingNode);
 
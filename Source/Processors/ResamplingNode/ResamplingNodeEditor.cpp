@@ -23,6 +23,7 @@
 
 
 #include "ResamplingNodeEditor.h"
+#include "ResamplingNode.h"
 #include <stdio.h>
 
 
@@ -32,9 +33,53 @@ ResamplingNodeEditor::ResamplingNodeEditor(GenericProcessor* parentNode, bool us
 {
     desiredWidth = 180;
 
+    // channels that are toggled off keep their own rate
+    resampleChannelButton = new UtilityButton("+CH", Font("Default", 10, Font::plain));
+    resampleChannelButton->addListener(this);
+    resampleChannelButton->setBounds(130, 95, 30, 18);
+    resampleChannelButton->setClickingTogglesState(true);
+    resampleChannelButton->setToggleState(true, dontSendNotification);
+    resampleChannelButton->setTooltip("When this button is off, selected channels are not resampled");
+    addAndMakeVisible(resampleChannelButton);
+
 }
 
 ResamplingNodeEditor::~ResamplingNodeEditor()
 {
     deleteAllChildren();
-}
\ No newline at end of file
+}
+
+void ResamplingNodeEditor::buttonEvent(Button* button)
+{
+
+    if (button == resampleChannelButton)
+    {
+        ResamplingNode* rn = (ResamplingNode*) getProcessor();
+
+        // one update of the signal chain for all the selected channels
+        rn->setResampleStates(getActiveChannels(), button->getToggleState());
+    }
+
+}
+
+void ResamplingNodeEditor::channelChanged(int chan)
+{
+    ResamplingNode* rn = (ResamplingNode*) getProcessor();
+
+    resampleChannelButton->setToggleState(rn->getResampleStateForChannel(chan), dontSendNotification);
+}
+
+void ResamplingNodeEditor::startAcquisition()
+{
+    GenericEditor::startAcquisition();
+
+    // changing which channels are resampled changes the signal chain
+    resampleChannelButton->setEnabled(false);
+}
+
+void ResamplingNodeEditor::stopAcquisition()
+{
+    GenericEditor::stopAcquisition();
+
+    resampleChannelButton->setEnabled(true);
+}
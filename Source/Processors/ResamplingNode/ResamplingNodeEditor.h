@@ -42,11 +42,18 @@ public:
     ResamplingNodeEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors);
     virtual ~ResamplingNodeEditor();
 
-    // void startAcquisition();
-    //void stopAcquisition();
+    void buttonEvent(Button* button);
+
+    /** Shows whether the selected channel is resampled. */
+    void channelChanged(int chan);
+
+    void startAcquisition();
+    void stopAcquisition();
 
 private:
 
+    UtilityButton* resampleChannelButton;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ResamplingNodeEditor);
 
 };
@@ -25,9 +25,13 @@
 #include "../DataThreads/DataBuffer.h"
 #include "../DataThreads/RHD2000Thread.h"
 #include "../DataThreads/EcubeThread.h" // Added by Michael Borisov
+#include "../DataThreads/NetworkStreamThread.h"
+#include "../DataThreads/NeuralSimulatorThread.h"
 #include "../SourceNode/SourceNodeEditor.h"
 #include "../DataThreads/RHD2000Editor.h"
 #include "../DataThreads/EcubeEditor.h" // Added by Michael Borisov
+#include "../DataThreads/NetworkStreamEditor.h"
+#include "../DataThreads/NeuralSimulatorEditor.h"
 #include "../Channel/Channel.h"
 #include <stdio.h>
 
@@ -51,6 +55,14 @@ SourceNode::SourceNode(const String& name_)
     {
         dataThread = new RHD2000Thread(this);
     }
+    else if (getName().equalsIgnoreCase("Network Stream"))
+    {
+        dataThread = new NetworkStreamThread(this);
+    }
+    else if (getName().equalsIgnoreCase("Neural Simulator"))
+    {
+        dataThread = new NeuralSimulatorThread(this);
+    }
 #if ECUBE_COMPILE
     else if (getName().equalsIgnoreCase("eCube"))
     {
@@ -311,6 +323,14 @@ AudioProcessorEditor* SourceNode::createEditor()
         //  RHD2000Editor* r2e = (RHD2000Editor*) editor.get();
         //  r2e->scanPorts();
     }
+    else if (getName().equalsIgnoreCase("Network Stream"))
+    {
+        editor = new NetworkStreamEditor(this, (NetworkStreamThread*) dataThread.get(), true);
+    }
+    else if (getName().equalsIgnoreCase("Neural Simulator"))
+    {
+        editor = new NeuralSimulatorEditor(this, (NeuralSimulatorThread*) dataThread.get(), true);
+    }
 #ifdef ECUBE_COMPILE
     else if (getName().equalsIgnoreCase("ECube"))
     {
@@ -63,7 +63,8 @@ SpikeDetector::SpikeDetector()
         electrodeCounter.add(0);
     }
 
-    spikeBuffer = new uint8_t[MAX_SPIKE_BUFFER_LEN]; // MAX_SPIKE_BUFFER_LEN defined in SpikeObject.h
+    spikeBufferSize = MAX_SPIKE_BUFFER_LEN; // MAX_SPIKE_BUFFER_LEN defined in SpikeObject.h
+    spikeBuffer.malloc(spikeBufferSize);
 
 }
 
@@ -103,6 +104,12 @@ void SpikeDetector::updateSettings()
                 break;
         }
 
+        // spike timestamps count the samples of the electrode's channels
+        const int firstChannel = *electrodes[i]->channels;
+
+        if (firstChannel >= 0 && firstChannel < channels.size())
+            ch->streamId = channels[firstChannel]->getStreamId();
+
         eventChannels.add(ch);
     }
 
@@ -299,16 +306,30 @@ void SpikeDetector::setParameter(int parameterIndex, float newValue)
 {
     //editor->updateParameterButtons(parameterIndex);
 
-    if (parameterIndex == 99 && currentElectrode > -1)
+    if ((parameterIndex == 99 || parameterIndex == 98) && currentElectrode > -1)
+        queueParameterChange(parameterIndex, newValue, currentElectrode, currentChannelIndex);
+}
+
+void SpikeDetector::applyParameterChange(const ParameterChange& change)
+{
+    if (change.channel < 0 || change.channel >= electrodes.size())
+        return;
+
+    SimpleElectrode* electrode = electrodes[change.channel];
+
+    if (change.subChannel < 0 || change.subChannel >= electrode->numChannels)
+        return;
+
+    if (change.parameterIndex == 99)
     {
-        *(electrodes[currentElectrode]->thresholds+currentChannelIndex) = newValue;
+        *(electrode->thresholds+change.subChannel) = change.value;
     }
-    else if (parameterIndex == 98 && currentElectrode > -1)
+    else if (change.parameterIndex == 98)
     {
-        if (newValue == 0.0f)
-            *(electrodes[currentElectrode]->isActive+currentChannelIndex) = false;
+        if (change.value == 0.0f)
+            *(electrode->isActive+change.subChannel) = false;
         else
-            *(electrodes[currentElectrode]->isActive+currentChannelIndex) = true;
+            *(electrode->isActive+change.subChannel) = true;
     }
 }
 
@@ -338,16 +359,23 @@ bool SpikeDetector::disable()
     return true;
 }
 
-void SpikeDetector::addSpikeEvent(SpikeObject* s, MidiBuffer& eventBuffer, int peakIndex)
+void SpikeDetector::addSpikeEvent(const SpikeHandle& s, MidiBuffer& eventBuffer, int peakIndex)
 {
 
     // std::cout << "Adding spike event for index " << peakIndex << std::endl;
 
     s->eventType = SPIKE_EVENT_CODE;
 
-    int numBytes = packSpike(s,                        // SpikeObject
+    // only happens the first time a larger electrode fires
+    if (getSpikeEventSize(s.get()) > spikeBufferSize)
+    {
+        spikeBufferSize = getSpikeEventSize(s.get());
+        spikeBuffer.realloc(spikeBufferSize);
+    }
+
+    int numBytes = packSpikeEvent(s,                   // SpikeHandle
                              spikeBuffer,              // uint8_t*
-                             MAX_SPIKE_BUFFER_LEN);    // int
+                             spikeBufferSize);         // int
 
     if (numBytes > 0)
         eventBuffer.addEvent(spikeBuffer, numBytes, peakIndex);
@@ -375,9 +403,9 @@ void SpikeDetector::addWaveformToSpikeObject(SpikeObject* s,
 //    uint8_t     color[3];
 //    float       pcProj[2];
 //    uint16_t    samplingFrequencyHz;
-//    uint16_t    data[MAX_NUMBER_OF_SPIKE_CHANNELS* MAX_NUMBER_OF_SPIKE_CHANNEL_SAMPLES];
-//    float       gain[MAX_NUMBER_OF_SPIKE_CHANNELS];
-//    uint16_t    threshold[MAX_NUMBER_OF_SPIKE_CHANNELS];
+//    uint16_t*   data; // nChannels * nSamples values
+//    float*      gain; // nChannels values
+//    uint16_t*   threshold; // nChannels values
     
     s->timestamp = getTimestamp(currentChannel) + peakIndex;
 
@@ -506,19 +534,20 @@ void SpikeDetector::process(AudioSampleBuffer& buffer,
 //                        uint8_t     color[3];
 //                        float       pcProj[2];
 //                        uint16_t    samplingFrequencyHz;
-//                        uint16_t    data[MAX_NUMBER_OF_SPIKE_CHANNELS* MAX_NUMBER_OF_SPIKE_CHANNEL_SAMPLES];
-//                        float       gain[MAX_NUMBER_OF_SPIKE_CHANNELS];
-//                        uint16_t    threshold[MAX_NUMBER_OF_SPIKE_CHANNELS];
-
-                        SpikeObject newSpike;
-                        newSpike.timestamp = 0; //getTimestamp(currentChannel) + peakIndex;
-                        newSpike.timestamp_software = -1;
-                        newSpike.source = i;
-                        newSpike.nChannels = electrode->numChannels;
-                        newSpike.sortedId = 0;
-                        newSpike.electrodeID = 0;
-                        newSpike.channel = 0;
-                        newSpike.samplingFrequencyHz = sampleRateForElectrode;
+//                        uint16_t*   data; // nChannels * nSamples values
+//                        float*      gain; // nChannels values
+//                        uint16_t*   threshold; // nChannels values
+
+                        SpikeHandle newSpike = SpikePool::getInstance().allocate(electrode->numChannels,
+                                                                                  electrode->prePeakSamples +
+                                                                                  electrode->postPeakSamples);
+                        newSpike->timestamp = 0; //getTimestamp(currentChannel) + peakIndex;
+                        newSpike->timestamp_software = -1;
+                        newSpike->source = i;
+                        newSpike->sortedId = 0;
+                        newSpike->electrodeID = 0;
+                        newSpike->channel = 0;
+                        newSpike->samplingFrequencyHz = sampleRateForElectrode;
 
                         currentIndex = 0;
 
@@ -526,7 +555,7 @@ void SpikeDetector::process(AudioSampleBuffer& buffer,
                         for (int channel = 0; channel < electrode->numChannels; channel++)
                         {
 
-                            addWaveformToSpikeObject(&newSpike,
+                            addWaveformToSpikeObject(newSpike.get(),
                                                      peakIndex,
                                                      i,
                                                      channel);
@@ -545,7 +574,7 @@ void SpikeDetector::process(AudioSampleBuffer& buffer,
                         }
 
                         //for (int xxx = 0; xxx < 1000; xxx++) // overload with spikes for testing purposes
-                        addSpikeEvent(&newSpike, events, peakIndex);
+                        addSpikeEvent(newSpike, events, peakIndex);
 
                         // advance the sample index
                         sampleIndex = peakIndex + electrode->postPeakSamples;
@@ -754,3 +783,51 @@ void SpikeDetector::loadCustomParametersFromXml()
 
 }
 
+bool SpikeDetector::saveCustomChannelParametersToSnapshot(OutputStream& stream)
+{
+    stream.writeInt(electrodes.size());
+
+    for (int i = 0; i < electrodes.size(); i++)
+    {
+        SimpleElectrode* electrode = electrodes[i];
+
+        stream.writeInt(electrode->numChannels);
+
+        for (int j = 0; j < electrode->numChannels; j++)
+        {
+            stream.writeDouble(*(electrode->thresholds+j));
+            stream.writeBool(*(electrode->isActive+j));
+        }
+    }
+
+    return true;
+}
+
+bool SpikeDetector::loadCustomChannelParametersFromSnapshot(InputStream& stream)
+{
+    // the electrodes themselves come from the XML, which loads first
+    const int numElectrodes = stream.readInt();
+
+    if (numElectrodes != electrodes.size())
+        return false;
+
+    for (int i = 0; i < numElectrodes; i++)
+    {
+        const int numChannels = stream.readInt();
+
+        if (numChannels != electrodes[i]->numChannels)
+            return false;
+
+        for (int j = 0; j < numChannels; j++)
+        {
+            const double threshold = stream.readDouble();
+            const bool isActive = stream.readBool();
+
+            queueParameterChange(99, (float) threshold, i, j);
+            queueParameterChange(98, isActive ? 1.0f : 0.0f, i, j);
+        }
+    }
+
+    return true;
+}
+
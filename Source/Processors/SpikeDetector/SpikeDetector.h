@@ -81,6 +81,9 @@ public:
     /** Used to alter parameters of data acquisition. */
     void setParameter(int parameterIndex, float newValue);
 
+    /** Writes a queued threshold or channel state into the electrode. */
+    void applyParameterChange(const ParameterChange& change);
+
     /** Called whenever the signal chain is altered. */
     void updateSettings();
 
@@ -155,6 +158,10 @@ public:
     void saveCustomParametersToXml(XmlElement* parentElement);
     void loadCustomParametersFromXml();
 
+    /** The thresholds and active states of every electrode's channels. */
+    bool saveCustomChannelParametersToSnapshot(OutputStream& stream);
+    bool loadCustomChannelParametersFromSnapshot(InputStream& stream);
+
 private:
     /** Pointer to a continuous buffer. */
     AudioSampleBuffer* dataBuffer;
@@ -177,7 +184,8 @@ private:
     int currentChannelIndex;
     int currentIndex;
 
-    uint8_t* spikeBuffer;///[256];
+    HeapBlock<uint8_t> spikeBuffer;
+    int spikeBufferSize;
     int64 timestamp;
 
     Array<SimpleElectrode*> electrodes;
@@ -189,7 +197,7 @@ private:
 
     void handleEvent(int eventType, MidiMessage& event, int sampleNum);
 
-    void addSpikeEvent(SpikeObject* s, MidiBuffer& eventBuffer, int peakIndex);
+    void addSpikeEvent(const SpikeHandle& s, MidiBuffer& eventBuffer, int peakIndex);
     void addWaveformToSpikeObject(SpikeObject* s,
                                   int& peakIndex,
                                   int& electrodeNumber,
@@ -56,6 +56,13 @@ SpikeDisplayCanvas::SpikeDisplayCanvas(SpikeDisplayNode* n) :
     invertSpikesButton->setToggleState(false, sendNotification);
     addAndMakeVisible(invertSpikesButton);
 
+    densityButton = new UtilityButton("Density", Font("Small Text", 13, Font::plain));
+    densityButton->setRadius(3.0f);
+    densityButton->addListener(this);
+    densityButton->setClickingTogglesState(true);
+    densityButton->setToggleState(false, sendNotification);
+    addAndMakeVisible(densityButton);
+
     addAndMakeVisible(viewport);
 
     setWantsKeyboardFocus(true);
@@ -133,6 +140,8 @@ void SpikeDisplayCanvas::resized()
 
     invertSpikesButton->setBounds(270, getHeight()-40, 130,20);
 
+    densityButton->setBounds(410, getHeight()-40, 100,20);
+
 }
 
 void SpikeDisplayCanvas::paint(Graphics& g)
@@ -189,6 +198,10 @@ void SpikeDisplayCanvas::buttonClicked(Button* button)
     {
         spikeDisplay->invertSpikes(button->getToggleState());
     }
+    else if (button == densityButton)
+    {
+        spikeDisplay->setDensityMode(button->getToggleState());
+    }
 }
 
 void SpikeDisplayCanvas::saveVisualizerParameters(XmlElement* xml)
@@ -198,6 +211,7 @@ void SpikeDisplayCanvas::saveVisualizerParameters(XmlElement* xml)
 
     xmlNode->setAttribute("LockThresholds",lockThresholdsButton->getToggleState());
     xmlNode->setAttribute("InvertSpikes",invertSpikesButton->getToggleState());
+    xmlNode->setAttribute("DensityMode",densityButton->getToggleState());
 
     for (int i = 0; i < spikeDisplay->getNumPlots(); i++)
     {
@@ -221,6 +235,8 @@ void SpikeDisplayCanvas::loadVisualizerParameters(XmlElement* xml)
         {
             spikeDisplay->invertSpikes(xmlNode->getBoolAttribute("InvertSpikes"));
             invertSpikesButton->setToggleState(xmlNode->getBoolAttribute("InvertSpikes"), dontSendNotification);
+            spikeDisplay->setDensityMode(xmlNode->getBoolAttribute("DensityMode"));
+            densityButton->setToggleState(xmlNode->getBoolAttribute("DensityMode"), dontSendNotification);
             lockThresholdsButton->setToggleState(xmlNode->getBoolAttribute("LockThresholds"), sendNotification);
 
             int plotIndex = -1;
@@ -267,7 +283,7 @@ void SpikeDisplayCanvas::loadVisualizerParameters(XmlElement* xml)
 // ----------------------------------------------------------------
 
 SpikeDisplay::SpikeDisplay(SpikeDisplayCanvas* sdc, Viewport* v) :
-    canvas(sdc), viewport(v), shouldInvert(false), thresholdCoordinator(nullptr)
+    canvas(sdc), viewport(v), shouldInvert(false), showDensity(false), thresholdCoordinator(nullptr)
 {
 
     totalHeight = 1000;
@@ -307,6 +323,7 @@ SpikePlot* SpikeDisplay::addSpikePlot(int numChannels, int electrodeNum, String
     spikePlots.add(spikePlot);
     addAndMakeVisible(spikePlot);
     spikePlot->invertSpikes(shouldInvert);
+    spikePlot->setDensityMode(showDensity);
     if (thresholdCoordinator)
     {
         spikePlot->registerThresholdCoordinator(thresholdCoordinator);
@@ -450,7 +467,18 @@ void SpikeDisplay::invertSpikes(bool shouldInvert_)
     //std::cout << "Invert spikes? " << shouldInvert_ << std::endl;
 }
 
-void SpikeDisplay::plotSpike(const SpikeObject& spike, int electrodeNum)
+void SpikeDisplay::setDensityMode(bool showDensity_)
+{
+
+    showDensity = showDensity_;
+
+    for (int i = 0; i < spikePlots.size(); i++)
+    {
+        spikePlots[i]->setDensityMode(showDensity_);
+    }
+}
+
+void SpikeDisplay::plotSpike(const SpikeHandle& spike, int electrodeNum)
 {
     spikePlots[electrodeNum]->processSpikeObject(spike);
 }
@@ -581,7 +609,7 @@ void SpikePlot::paint(Graphics& g)
 
 }
 
-void SpikePlot::processSpikeObject(const SpikeObject& s)
+void SpikePlot::processSpikeObject(const SpikeHandle& s)
 {
     // std::cout << "ElectrodePlot::processSpikeObject()" << std::endl;
 
@@ -857,6 +885,14 @@ void SpikePlot::invertSpikes(bool shouldInvert)
     }
 }
 
+void SpikePlot::setDensityMode(bool shouldShowDensity)
+{
+    for (int i = 0; i < nWaveAx; i++)
+    {
+        wAxes[i]->setDensityMode(shouldShowDensity);
+    }
+}
+
 // --------------------------------------------------
 
 
@@ -871,7 +907,9 @@ WaveAxes::WaveAxes(int channel) : GenericAxes(channel),
     isOverThresholdSlider(false),
     isDraggingThresholdSlider(false),
     thresholdCoordinator(nullptr),
-    spikesInverted(false)
+    spikesInverted(false),
+    showDensity(false),
+    lastDecayTime(0), densityNumSamples(40)
 
 {
 
@@ -881,13 +919,17 @@ WaveAxes::WaveAxes(int channel) : GenericAxes(channel),
 
     font = Font("Small Text",10,Font::plain);
 
-    for (int n = 0; n < bufferSize; n++)
-    {
-        SpikeObject so;
-        generateEmptySpike(&so, 4, 40);
+    // all slots share one empty spike until real spikes arrive
+    spikeBuffer.insertMultiple(0, generateEmptySpike(4, 40), bufferSize);
 
-        spikeBuffer.add(so);
-    }
+    density.calloc(DENSITY_ROWS * DENSITY_COLUMNS);
+    densityImage = Image(Image::RGB, DENSITY_COLUMNS, DENSITY_ROWS, true);
+
+    ColourGradient heatMap(Colours::black, 0.0f, 0.0f, Colours::white, 1.0f, 0.0f, false);
+    heatMap.addColour(0.25, Colour(20,40,160));
+    heatMap.addColour(0.5, Colour(200,30,60));
+    heatMap.addColour(0.75, Colour(255,200,0));
+    heatMap.createLookupTable(densityColours, 256);
 }
 
 void WaveAxes::setRange(float r)
@@ -897,6 +939,17 @@ void WaveAxes::setRange(float r)
 
     range = r;
 
+    clearDensity(); // the amplitude bins depend on the range
+
+    repaint();
+}
+
+void WaveAxes::setDensityMode(bool shouldShowDensity)
+{
+    showDensity = shouldShowDensity;
+
+    clearDensity();
+
     repaint();
 }
 
@@ -922,20 +975,51 @@ void WaveAxes::paint(Graphics& g)
         return;
     }
 
+    if (showDensity)
+    {
+        updateDensityImage();
+
+        // the waveforms span nSamples-1 segments of width getWidth()/nSamples
+        const int nSamples = densityNumSamples;
+
+        g.setImageResamplingQuality(Graphics::lowResamplingQuality);
+        g.setOpacity(1.0f);
+        g.drawImage(densityImage,
+                    0, 0, getWidth()*(nSamples-1)/nSamples, getHeight(),
+                    0, 0, DENSITY_COLUMNS, DENSITY_ROWS);
+
+        if (drawGrid)
+            drawWaveformGrid(g);
 
-    for (int spikeNum = 0; spikeNum < bufferSize; spikeNum++)
+        drawThresholdSlider(g);
+
+        return;
+    }
+
+
+    // hold on to the spikes, so they aren't recycled while they're drawn
+    Array<SpikeHandle> spikes;
+    int currentIndex;
+
+    {
+        const SpinLock::ScopedLockType lock(spikeBufferLock);
+        spikes = spikeBuffer;
+        currentIndex = spikeIndex;
+    }
+
+    for (int spikeNum = 0; spikeNum < spikes.size(); spikeNum++)
     {
 
-        if (spikeNum != spikeIndex)
+        if (spikeNum != currentIndex)
         {
             g.setColour(Colours::grey);
-            plotSpike(spikeBuffer[spikeNum], g);
+            plotSpike(*spikes[spikeNum], g);
         }
 
     }
 
     
-    plotSpike(spikeBuffer[spikeIndex], g);
+    plotSpike(*spikes[currentIndex], g);
 
 
     spikesReceivedSinceLastRedraw = 0;
@@ -948,7 +1032,7 @@ void WaveAxes::plotSpike(const SpikeObject& s, Graphics& g)
     float h = getHeight();
 
     //compute the spatial width for each waveform sample
-    float dx = getWidth()/float(spikeBuffer[0].nSamples);
+    float dx = getWidth()/float(s.nSamples);
 
     if (s.sortedId > 0)
        g.setColour(Colour(s.color[0],s.color[1],s.color[2]));
@@ -957,7 +1041,10 @@ void WaveAxes::plotSpike(const SpikeObject& s, Graphics& g)
 
     // type corresponds to channel so we need to calculate the starting
     // sample based upon which channel is getting plotted
-    int sampIdx = 40*type; //spikeBuffer[0].nSamples * type; //
+    if (type >= s.nChannels)
+        return;
+
+    int sampIdx = s.nSamples * type;
 
     int dSamples = 1;
 
@@ -967,20 +1054,20 @@ void WaveAxes::plotSpike(const SpikeObject& s, Graphics& g)
     {
         //std::cout << s.data[sampIdx] << std::endl;
 
-        if (*s.gain != 0)
+        if (s.gain[type] != 0)
         {
 
             float s1, s2;
 
             if (spikesInverted)
             {
-                s1 = h/2 + float(s.data[sampIdx]-32768)/float(*s.gain)*1000.0f / range * h;
-                s2 = h/2 + float(s.data[sampIdx+1]-32768)/float(*s.gain)*1000.0f / range * h;
+                s1 = h/2 + float(s.data[sampIdx]-32768)/float(s.gain[type])*1000.0f / range * h;
+                s2 = h/2 + float(s.data[sampIdx+1]-32768)/float(s.gain[type])*1000.0f / range * h;
             }
             else
             {
-                s1 = h/2 - float(s.data[sampIdx]-32768)/float(*s.gain)*1000.0f / range * h;
-                s2 = h/2 - float(s.data[sampIdx+1]-32768)/float(*s.gain)*1000.0f / range * h;
+                s1 = h/2 - float(s.data[sampIdx]-32768)/float(s.gain[type])*1000.0f / range * h;
+                s2 = h/2 - float(s.data[sampIdx+1]-32768)/float(s.gain[type])*1000.0f / range * h;
 
             }
             g.drawLine(x,
@@ -1041,22 +1128,34 @@ void WaveAxes::drawWaveformGrid(Graphics& g)
 
 }
 
-bool WaveAxes::updateSpikeData(const SpikeObject& s)
+bool WaveAxes::updateSpikeData(const SpikeHandle& s)
 {
     if (!gotFirstSpike)
     {
         gotFirstSpike = true;
     }
 
+    // every spike goes into the density image, so paint() doesn't depend on the firing rate
+    if (showDensity)
+    {
+        addSpikeToDensity(*s);
+        return true;
+    }
+
     if (spikesReceivedSinceLastRedraw < bufferSize)
     {
+        // the spike is shared, not copied; the slot's previous spike goes back to the pool
+        SpikeHandle oldSpike;
 
-        SpikeObject newSpike = s;
+        {
+            const SpinLock::ScopedLockType lock(spikeBufferLock);
 
-        spikeIndex++;
-        spikeIndex %= bufferSize;
+            spikeIndex++;
+            spikeIndex %= bufferSize;
 
-        spikeBuffer.set(spikeIndex, newSpike);
+            oldSpike = spikeBuffer[spikeIndex];
+            spikeBuffer.set(spikeIndex, s);
+        }
 
         spikesReceivedSinceLastRedraw++;
 
@@ -1068,12 +1167,15 @@ bool WaveAxes::updateSpikeData(const SpikeObject& s)
 
 bool WaveAxes::checkThreshold(const SpikeObject& s)
 {
-    int sampIdx = 40*type;
+    if (type >= s.nChannels)
+        return false;
+
+    int sampIdx = s.nSamples*type;
 
     for (int i = 0; i < s.nSamples-1; i++)
     {
 
-        if (float(s.data[sampIdx]-32768)/float(*s.gain)*1000.0f > displayThresholdLevel)
+        if (float(s.data[sampIdx]-32768)/float(s.gain[type])*1000.0f > displayThresholdLevel)
         {
             return true;
         }
@@ -1088,20 +1190,102 @@ bool WaveAxes::checkThreshold(const SpikeObject& s)
 void WaveAxes::clear()
 {
 
-    spikeBuffer.clear();
-    spikeIndex = 0;
-
-    for (int n = 0; n < bufferSize; n++)
     {
-        SpikeObject so;
-        generateEmptySpike(&so, 4, 40);
+        const SpinLock::ScopedLockType lock(spikeBufferLock);
+
+        spikeBuffer.clear();
+        spikeIndex = 0;
 
-        spikeBuffer.add(so);
+        spikeBuffer.insertMultiple(0, generateEmptySpike(4, 40), bufferSize);
     }
 
+    clearDensity();
+
     repaint();
 }
 
+void WaveAxes::addSpikeToDensity(const SpikeObject& s)
+{
+    if (type >= s.nChannels || s.gain[type] == 0 || s.nSamples < 2)
+        return;
+
+    densityNumSamples = s.nSamples;
+
+    // type corresponds to channel so we need to calculate the starting
+    // sample based upon which channel is getting plotted
+    const uint16* data = s.data + s.nSamples*type;
+
+    const float binsPerUnit = float(DENSITY_ROWS) / range;
+    const float samplesPerColumn = float(s.nSamples-1) / float(DENSITY_COLUMNS);
+
+    const SpinLock::ScopedLockType lock(densityLock);
+
+    int lastBin = -1;
+
+    for (int col = 0; col < DENSITY_COLUMNS; col++)
+    {
+        // linear interpolation between the two nearest samples
+        const float t = (col + 0.5f) * samplesPerColumn;
+        const int i = jmin(int(t), s.nSamples-2);
+        const float alpha = t - i;
+
+        const float v = ((1.0f-alpha)*float(data[i]-32768) + alpha*float(data[i+1]-32768))
+                        / float(s.gain[type])*1000.0f; // in microvolts
+
+        const int bin = int(v*binsPerUnit + DENSITY_ROWS/2);
+
+        // fill the gap to the previous column, so steep edges stay connected
+        int from = (lastBin < 0) ? bin : jmin(bin, lastBin + 1);
+        int to = (lastBin < 0) ? bin : jmax(bin, lastBin - 1);
+
+        from = jmax(from, 0);
+        to = jmin(to, DENSITY_ROWS-1);
+
+        for (int row = from; row <= to; row++)
+            density[row*DENSITY_COLUMNS + col] += 1.0f;
+
+        lastBin = bin;
+    }
+}
+
+void WaveAxes::clearDensity()
+{
+    const SpinLock::ScopedLockType lock(densityLock);
+
+    FloatVectorOperations::clear(density, DENSITY_ROWS * DENSITY_COLUMNS);
+    lastDecayTime = Time::getMillisecondCounterHiRes();
+}
+
+void WaveAxes::updateDensityImage()
+{
+    const SpinLock::ScopedLockType lock(densityLock);
+
+    const int numBins = DENSITY_ROWS * DENSITY_COLUMNS;
+
+    // fade out old spikes according to the time since the last repaint
+    const double now = Time::getMillisecondCounterHiRes();
+    FloatVectorOperations::multiply(density, float(pow(0.5, (now - lastDecayTime) / DENSITY_HALF_LIFE_MS)), numBins);
+    lastDecayTime = now;
+
+    const float maxCount = FloatVectorOperations::findMaximum(density, numBins);
+    const float scale = (maxCount > 0.0f) ? 255.0f / log1p(maxCount) : 0.0f;
+
+    Image::BitmapData bitmap(densityImage, Image::BitmapData::writeOnly);
+
+    for (int row = 0; row < DENSITY_ROWS; row++)
+    {
+        // positive voltages at the top, unless the spikes are inverted
+        const int y = spikesInverted ? row : DENSITY_ROWS - 1 - row;
+        const float* counts = density + row*DENSITY_COLUMNS;
+
+        for (int col = 0; col < DENSITY_COLUMNS; col++)
+        {
+            const int level = jlimit(0, 255, int(log1p(counts[col]) * scale)); // log scale keeps rare waveforms visible
+            ((PixelRGB*) bitmap.getPixelPointer(col, y))->set(densityColours[level]);
+        }
+    }
+}
+
 void WaveAxes::mouseMove(const MouseEvent& event)
 {
 
@@ -1267,13 +1451,18 @@ void ProjectionAxes::paint(Graphics& g)
                 0, imageDim-rangeY, rangeX, rangeY);
 }
 
-bool ProjectionAxes::updateSpikeData(const SpikeObject& s)
+bool ProjectionAxes::updateSpikeData(const SpikeHandle& spike)
 {
     if (!gotFirstSpike)
     {
         gotFirstSpike = true;
     }
 
+    const SpikeObject& s = *spike;
+
+    if (ampDim1 >= s.nChannels || ampDim2 >= s.nChannels)
+        return false;
+
     int idx1, idx2;
     calcWaveformPeakIdx(s, ampDim1, ampDim2, &idx1, &idx2);
 
@@ -1402,7 +1591,7 @@ GenericAxes::~GenericAxes()
 
 }
 
-bool GenericAxes::updateSpikeData(const SpikeObject& newSpike)
+bool GenericAxes::updateSpikeData(const SpikeHandle& newSpike)
 {
     if (!gotFirstSpike)
     {
@@ -50,6 +50,10 @@
 #define MAX_NUMBER_OF_SPIKE_SOURCES 128
 #define MAX_N_CHAN 4
 
+#define DENSITY_COLUMNS 160          // time bins of the waveform density image
+#define DENSITY_ROWS 128             // amplitude bins of the waveform density image
+#define DENSITY_HALF_LIFE_MS 2000.0  // how quickly old spikes fade out of the density image
+
 class SpikeDisplayNode;
 
 class SpikeDisplay;
@@ -114,13 +118,13 @@ private:
     ScopedPointer<UtilityButton> clearButton;
 
     bool newSpike;
-    SpikeObject spike;
 
     int scrollBarThickness;
 
     ScopedPointer<SpikeThresholdCoordinator> thresholdCoordinator;
     ScopedPointer<UtilityButton> lockThresholdsButton;
     ScopedPointer<UtilityButton> invertSpikesButton;
+    ScopedPointer<UtilityButton> densityButton;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpikeDisplayCanvas);
 
@@ -143,9 +147,10 @@ public:
 
     void mouseDown(const MouseEvent& event);
 
-    void plotSpike(const SpikeObject& spike, int electrodeNum);
+    void plotSpike(const SpikeHandle& spike, int electrodeNum);
 
     void invertSpikes(bool);
+    void setDensityMode(bool);
 
     int getTotalHeight()
     {
@@ -178,6 +183,7 @@ private:
     OwnedArray<SpikePlot> spikePlots;
 
     bool shouldInvert;
+    bool showDensity;
 
     // float tetrodePlotMinWidth, stereotrodePlotMinWidth, singleElectrodePlotMinWidth;
     // float tetrodePlotRatio, stereotrodePlotRatio, singleElectrodePlotRatio;
@@ -206,7 +212,7 @@ public:
     void select();
     void deselect();
 
-    void processSpikeObject(const SpikeObject& s);
+    void processSpikeObject(const SpikeHandle& s);
 
     SpikeDisplayCanvas* canvas;
 
@@ -222,6 +228,7 @@ public:
     void clear();
 
     void invertSpikes(bool);
+    void setDensityMode(bool);
 
     float minWidth;
     float aspectRatio;
@@ -282,7 +289,7 @@ public:
 
     virtual ~GenericAxes();
 
-    virtual bool updateSpikeData(const SpikeObject& s);
+    virtual bool updateSpikeData(const SpikeHandle& s);
 
     void setXLims(double xmin, double xmax);
     void getXLims(double* xmin, double* xmax);
@@ -301,7 +308,7 @@ protected:
     double xlims[2];
     double ylims[2];
 
-    SpikeObject s;
+    SpikeHandle s;
 
     bool gotFirstSpike;
 
@@ -326,7 +333,7 @@ public:
     WaveAxes(int channel);
     ~WaveAxes() {}
 
-    bool updateSpikeData(const SpikeObject& s);
+    bool updateSpikeData(const SpikeHandle& s);
     bool checkThreshold(const SpikeObject& spike);
 
     void paint(Graphics& g);
@@ -361,6 +368,9 @@ public:
         repaint();
     }
 
+    /** Switches between overlaid waveforms and a decaying 2D histogram of all spikes. */
+    void setDensityMode(bool shouldShowDensity);
+
 private:
 
     Colour waveColour;
@@ -376,11 +386,16 @@ private:
 
     void drawThresholdSlider(Graphics& g);
 
+    void addSpikeToDensity(const SpikeObject& s);
+    void clearDensity();
+    void updateDensityImage();
+
     int spikesReceivedSinceLastRedraw;
 
     Font font;
 
-    Array<SpikeObject> spikeBuffer;
+    Array<SpikeHandle> spikeBuffer;
+    SpinLock spikeBufferLock; // replaced from the processing thread while paint() reads it
 
     int spikeIndex;
     int bufferSize;
@@ -395,6 +410,14 @@ private:
 
     bool spikesInverted;
 
+    bool showDensity;
+    HeapBlock<float> density; // DENSITY_ROWS x DENSITY_COLUMNS spike counts, row 0 = most negative
+    PixelARGB densityColours[256];
+    Image densityImage;
+    SpinLock densityLock; // updateSpikeData() is called from the processing thread
+    double lastDecayTime;
+    int densityNumSamples;
+
 };
 
 
@@ -413,7 +436,7 @@ public:
     ProjectionAxes(int projectionNum);
     ~ProjectionAxes() {}
 
-    bool updateSpikeData(const SpikeObject& s);
+    bool updateSpikeData(const SpikeHandle& s);
 
     void paint(Graphics& g);
 
@@ -30,8 +30,7 @@
 
 
 SpikeDisplayNode::SpikeDisplayNode()
-    : GenericProcessor("Spike Viewer"), displayBufferSize(5),  redrawRequested(false),
-	isRecording(false)
+    : GenericProcessor("Spike Viewer"), displayBufferSize(5),  redrawRequested(false)
 {
 
 
@@ -79,6 +78,7 @@ void SpikeDisplayNode::updateSettings()
             }
             
             elec.name = eventChannels[i]->getName();
+            elec.streamId = eventChannels[i]->getStreamId();
             elec.currentSpikeIndex = 0;
             elec.mostRecentSpikes.ensureStorageAllocated(displayBufferSize);
 
@@ -113,6 +113,7 @@ bool SpikeDisplayNode::enable()
 		recElec->name = elec.name;
 		recElec->numChannels = elec.numChannels;
 		recElec->sampleRate = settings.sampleRate;
+		recElec->streamId = elec.streamId;
 		elec.recordIndex = getProcessorGraph()->getRecordNode()->addSpikeElectrode(recElec);
 	}
 
@@ -176,33 +177,11 @@ int SpikeDisplayNode::getNumElectrodes()
 
 }
 
-void SpikeDisplayNode::startRecording()
-{
-
-    setParameter(1, 0.0f); // need to use the 'setParameter' method to interact with 'process'
-}
-
-void SpikeDisplayNode::stopRecording()
-{
-    setParameter(0, 0.0f); // need to use the 'setParameter' method to interact with 'process'
-}
-
-
 void SpikeDisplayNode::setParameter(int param, float val)
 {
     //std::cout<<"SpikeDisplayNode got Param:"<< param<< " with value:"<<val<<std::endl;
 
-    if (param == 0) // stop recording
-    {
-        isRecording = false;
-
-    }
-    else if (param == 1)   // start recording
-    {
-        isRecording = true;
-
-    }
-    else if (param == 2)   // redraw
+    if (param == 2)   // redraw
     {
         redrawRequested = true;
 
@@ -239,9 +218,10 @@ void SpikeDisplayNode::process(AudioSampleBuffer& buffer, MidiBuffer& events)
             {
                 //std::cout << "Transferring spikes." << std::endl;
                 e.spikePlot->processSpikeObject(e.mostRecentSpikes[j]);
-                e.currentSpikeIndex = 0;
             }
 
+            e.currentSpikeIndex = 0;
+
         }
 
         redrawRequested = false;
@@ -263,13 +243,11 @@ void SpikeDisplayNode::handleEvent(int eventType, MidiMessage& event, int sample
         if (bufferSize > 0)
         {
 
-            SpikeObject newSpike;
-
-            bool isValid = unpackSpike(&newSpike, dataptr, bufferSize);
+            SpikeHandle newSpike = unpackSpikeEvent(dataptr, bufferSize);
 
-            if (isValid)
+            if (!newSpike.isNull() && newSpike->source < electrodes.size())
             {
-                int electrodeNum = newSpike.source;
+                int electrodeNum = newSpike->source;
 
                 Electrode& e = electrodes.getReference(electrodeNum);
                 // std::cout << electrodeNum << std::endl;
@@ -277,11 +255,11 @@ void SpikeDisplayNode::handleEvent(int eventType, MidiMessage& event, int sample
                 bool aboveThreshold = false;
 
                 // update threshold / check threshold
-                for (int i = 0; i < e.numChannels; i++)
+                for (int i = 0; i < jmin(e.numChannels, int(newSpike->nChannels)); i++)
                 {
-                    e.detectorThresholds.set(i, float(newSpike.threshold[i])); // / float(newSpike.gain[i]));
+                    e.detectorThresholds.set(i, float(newSpike->threshold[i])); // / float(newSpike->gain[i]));
 
-                    aboveThreshold = aboveThreshold | checkThreshold(i, e.displayThresholds[i], newSpike);
+                    aboveThreshold = aboveThreshold | checkThreshold(i, e.displayThresholds[i], *newSpike);
                 }
 
                 if (aboveThreshold)
@@ -295,11 +273,9 @@ void SpikeDisplayNode::handleEvent(int eventType, MidiMessage& event, int sample
                         e.currentSpikeIndex++;
                     }
 
-                    // save spike
-                    if (isRecording)
-                    {
-						getProcessorGraph()->getRecordNode()->writeSpike(newSpike,e.recordIndex);
-                    }
+                    // save spike; the RecordNode keeps it for the pre-trigger
+                    // time even when it isn't recording yet
+					getProcessorGraph()->getRecordNode()->writeSpike(newSpike,e.recordIndex);
                 }
 
             }
@@ -310,14 +286,14 @@ void SpikeDisplayNode::handleEvent(int eventType, MidiMessage& event, int sample
 
 }
 
-bool SpikeDisplayNode::checkThreshold(int chan, float thresh, SpikeObject& s)
+bool SpikeDisplayNode::checkThreshold(int chan, float thresh, const SpikeObject& s)
 {
     int sampIdx = s.nSamples*chan;
 
     for (int i = 0; i < s.nSamples-1; i++)
     {
 
-        if (float(s.data[sampIdx]-32768)/float(*s.gain)*1000.0f > thresh)
+        if (float(s.data[sampIdx]-32768)/float(s.gain[chan])*1000.0f > thresh)
         {
             return true;
         }
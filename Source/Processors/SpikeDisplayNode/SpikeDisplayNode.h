@@ -67,9 +67,6 @@ public:
     bool enable();
     bool disable();
 
-    void startRecording();
-    void stopRecording();
-
     String getNameForElectrode(int i);
     int getNumberOfChannelsForElectrode(int i);
     int getNumElectrodes();
@@ -77,7 +74,7 @@ public:
     void addSpikePlotForElectrode(SpikePlot* sp, int i);
     void removeSpikePlots();
 
-    bool checkThreshold(int, float, SpikeObject&);
+    bool checkThreshold(int, float, const SpikeObject&);
 
 private:
 
@@ -90,12 +87,13 @@ private:
         Array<float> displayThresholds;
         Array<float> detectorThresholds;
 
-        Array<SpikeObject> mostRecentSpikes;
+        Array<SpikeHandle> mostRecentSpikes;
         int currentSpikeIndex;
 
         SpikePlot* spikePlot;
 
         int recordIndex;
+        int streamId;
 
     };
 
@@ -105,7 +103,6 @@ private:
     bool redrawRequested;
 
     // members for recording
-    bool isRecording;
  //   bool signalFilesShouldClose;
  //   RecordNode* recordNode;
  //   String baseDirectory;
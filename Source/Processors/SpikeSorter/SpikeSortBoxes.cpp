@@ -605,16 +605,13 @@ void BoxUnit::updateWaveform(SpikeObject *so)
 	 pc2max = 1;
 	 numChannels = numch;
 	 waveformLength = WaveFormLength;
+	 templateThreshold = DEFAULT_TEMPLATE_THRESHOLD;
+	 bTemplatesSeeded = false;
 
 	 pc1 = new float[numChannels * waveformLength];
 	 pc2 = new float[numChannels * waveformLength];
-    for (int n = 0; n < bufferSize; n++)
-    {
-        SpikeObject so;
-        generateEmptySpike(&so, 4,waveformLength);
-
-        spikeBuffer.add(so);
-    }
+	 spikeMicrovolts.resize(numChannels * waveformLength);
+    spikeBuffer.insertMultiple(0, generateEmptySpike(numChannels, waveformLength), bufferSize);
   }
 
   	void SpikeSortBoxes::resizeWaveform(int numSamples)
@@ -626,13 +623,9 @@ void BoxUnit::updateWaveform(SpikeObject *so)
 		delete pc2;
 		pc1 = new float[numChannels * waveformLength];
 		pc2 = new float[numChannels * waveformLength];
+		spikeMicrovolts.resize(numChannels * waveformLength);
         spikeBuffer.clear();
-	    for (int n = 0; n < bufferSize; n++)
-	    {
-		    SpikeObject so;
-	        generateEmptySpike(&so, 4,waveformLength);
-	        spikeBuffer.add(so);
-	    }
+        spikeBuffer.insertMultiple(0, generateEmptySpike(numChannels, waveformLength), bufferSize);
 		bPCAcomputed = false;
 		spikeBufferIndex = 0;
 		for (int k=0;k<pcaUnits.size();k++)
@@ -643,6 +636,9 @@ void BoxUnit::updateWaveform(SpikeObject *so)
 		{
 			boxUnits[k].resizeWaveform(waveformLength);
 		}
+		// templates of the old length cannot be compared with new spikes.
+		templateUnits.clear();
+		bTemplatesSeeded = false;
   	    //EndCriticalSection();
 	}
 
@@ -663,6 +659,8 @@ void BoxUnit::updateWaveform(SpikeObject *so)
 
 				pcaUnits.clear();
 				boxUnits.clear();
+				templateUnits.clear();
+				templateThreshold = spikesortNode->getDoubleAttribute("templateThreshold", DEFAULT_TEMPLATE_THRESHOLD);
 
 				forEachXmlChildElement(*spikesortNode, UnitNode)
 				{
@@ -749,6 +747,29 @@ void BoxUnit::updateWaveform(SpikeObject *so)
 						// add polygon unit	
 						pcaUnits.push_back(pcaUnit);
 					}
+					if (UnitNode->hasTagName("TEMPLATEUNIT"))
+					{
+						TemplateUnit templateUnit;
+
+						templateUnit.UnitID = UnitNode->getIntAttribute("UnitID");
+						templateUnit.localID = UnitNode->getIntAttribute("LocalID");
+						templateUnit.ColorRGB[0] = UnitNode->getIntAttribute("ColorR");
+						templateUnit.ColorRGB[1] = UnitNode->getIntAttribute("ColorG");
+						templateUnit.ColorRGB[2] = UnitNode->getIntAttribute("ColorB");
+						templateUnit.numSpikes = UnitNode->getIntAttribute("NumSpikes");
+
+						templateUnit.waveformTemplate.resize(UnitNode->getIntAttribute("Length"));
+						int sampleCounter = 0;
+						forEachXmlChildElement(*UnitNode, sampleNode)
+						{
+							if (sampleNode->hasTagName("TEMPLATE_SAMPLE") && sampleCounter < templateUnit.waveformTemplate.size())
+							{
+								templateUnit.waveformTemplate[sampleCounter++] = sampleNode->getDoubleAttribute("v");
+							}
+						}
+						templateUnits.push_back(templateUnit);
+						bTemplatesSeeded = true;
+					}
 				}
 			}
 		}
@@ -762,6 +783,7 @@ void BoxUnit::updateWaveform(SpikeObject *so)
 	  spikesortNode->setAttribute("numPCAUnits", (int)pcaUnits.size());
 	  spikesortNode->setAttribute("selectedUnit",selectedUnit);
 	  spikesortNode->setAttribute("selectedBox",selectedBox);
+	  spikesortNode->setAttribute("templateThreshold",templateThreshold);
 
 
 	  XmlElement* pcaNode = electrodeNode->createNewChildElement("PCA");
@@ -821,6 +843,26 @@ void BoxUnit::updateWaveform(SpikeObject *so)
 			  PolygonNode->setAttribute("pointY", pcaUnits[pcaUnitIter].poly.pts[p].Y);
 		  }
 	  }
+
+	  for (int templateUnitIter=0;templateUnitIter<templateUnits.size();templateUnitIter++)
+	  {
+		  TemplateUnit& unit = templateUnits[templateUnitIter];
+		  XmlElement* TemplateUnitNode = spikesortNode->createNewChildElement("TEMPLATEUNIT");
+
+		  TemplateUnitNode->setAttribute("UnitID",unit.UnitID);
+		  TemplateUnitNode->setAttribute("LocalID",unit.localID);
+		  TemplateUnitNode->setAttribute("ColorR",unit.ColorRGB[0]);
+		  TemplateUnitNode->setAttribute("ColorG",unit.ColorRGB[1]);
+		  TemplateUnitNode->setAttribute("ColorB",unit.ColorRGB[2]);
+		  TemplateUnitNode->setAttribute("NumSpikes",unit.numSpikes);
+		  TemplateUnitNode->setAttribute("Length",(int)unit.waveformTemplate.size());
+
+		  for (int k=0;k<unit.waveformTemplate.size();k++)
+		  {
+			  XmlElement* SampleNode = TemplateUnitNode->createNewChildElement("TEMPLATE_SAMPLE");
+			  SampleNode->setAttribute("v", unit.waveformTemplate[k]);
+		  }
+	  }
     
 
 	//float *pc1, *pc2;
@@ -849,12 +891,16 @@ void SpikeSortBoxes::getSelectedUnitAndBox(int &unitID, int &boxid)
   boxid = selectedBox;
 }
   
-void SpikeSortBoxes::projectOnPrincipalComponents(SpikeObject *so)
+void SpikeSortBoxes::projectOnPrincipalComponents(const SpikeHandle& spike)
 {
-	SpikeObject copySpike = *so;
+	SpikeObject* so = spike.get();
 	spikeBufferIndex++;
 	spikeBufferIndex %= bufferSize;
-	spikeBuffer.set(spikeBufferIndex, copySpike);
+	{
+		// the templates are seeded from a copy of the buffer
+		const ScopedLock myScopedLock (mut);
+		spikeBuffer.set(spikeBufferIndex, spike); // shared with the PCA job, which only reads the waveform
+	}
 	if (bPCAjobFinished)
 	{
 		bPCAcomputed = true;
@@ -919,6 +965,7 @@ void SpikeSortBoxes::projectOnPrincipalComponents(SpikeObject *so)
 	  bPCAcomputed = false;
 	  bPCAJobSubmitted = false;
 	  bRePCA = true;
+	  bTemplatesSeeded = false;
   }
 
   void SpikeSortBoxes::addPCAunit(PCAUnit unit)
@@ -926,6 +973,7 @@ void SpikeSortBoxes::projectOnPrincipalComponents(SpikeObject *so)
 	  const ScopedLock myScopedLock (mut);
 	  //StartCriticalSection();
 	  pcaUnits.push_back(unit);
+	  bTemplatesSeeded = false;
 	  //EndCriticalSection();
   }
 
@@ -987,6 +1035,16 @@ void  SpikeSortBoxes::EndCriticalSection()
 				break;
 			}
 		}
+		for (int k = 0; k < templateUnits.size(); k++)
+		{
+			if (templateUnits[k].getUnitID() == UnitID)
+			{
+				R = templateUnits[k].ColorRGB[0];
+				G = templateUnits[k].ColorRGB[1];
+				B = templateUnits[k].ColorRGB[2];
+				break;
+			}
+		}
   }
 
     int SpikeSortBoxes::generateLocalID()
@@ -1040,7 +1098,13 @@ void  SpikeSortBoxes::EndCriticalSection()
 	}
 	for (int k=0;k<pcaUnits.size();k++)
 	{
-		pcaUnits[k].UnitID = generateUnitID();
+		int newID = generateUnitID();
+		for (int j=0;j<templateUnits.size();j++)
+		{
+			if (templateUnits[j].UnitID == pcaUnits[k].UnitID)
+				templateUnits[j].UnitID = newID;
+		}
+		pcaUnits[k].UnitID = newID;
 	}
  }
 
@@ -1049,11 +1113,22 @@ void SpikeSortBoxes::removeAllUnits()
 	const ScopedLock myScopedLock (mut);
 	boxUnits.clear();
 	pcaUnits.clear();
+	templateUnits.clear();
+	bTemplatesSeeded = false;
 }
 
 bool SpikeSortBoxes::removeUnit(int unitID)
 {
 	const ScopedLock myScopedLock (mut);
+	// a template shares the ID of the PCA unit it was seeded from
+	for (int k=templateUnits.size()-1;k>=0;k--)
+	{
+		if (templateUnits[k].getUnitID() == unitID)
+		{
+			templateUnits.erase(templateUnits.begin()+k);
+		}
+	}
+
 	 //StartCriticalSection();
 	for (int k=0;k<boxUnits.size();k++)
 	  {
@@ -1141,11 +1216,167 @@ std::vector<PCAUnit> SpikeSortBoxes::getPCAUnits()
 	return unitsCopy;
 }
 
+void SpikeSortBoxes::setTemplateThreshold(float microvoltsRMS)
+{
+	const ScopedLock myScopedLock (mut);
+	templateThreshold = microvoltsRMS;
+}
+
+float SpikeSortBoxes::getTemplateThreshold()
+{
+	return templateThreshold;
+}
+
+void SpikeSortBoxes::spikeToMicrovolts(SpikeObject *so, float *dest)
+{
+	for (int ch = 0; ch < so->nChannels; ch++)
+	{
+		const float scale = (so->gain[ch] != 0) ? 1000.0f / so->gain[ch] : 0.0f;
+		const uint16_t *src = so->data + ch*so->nSamples;
+		float *out = dest + ch*so->nSamples;
+		for (int k = 0; k < so->nSamples; k++)
+		{
+			out[k] = (float(src[k]) - 32768.0f) * scale;
+		}
+	}
+}
+
+bool SpikeSortBoxes::needsTemplates()
+{
+	return !bTemplatesSeeded && bPCAcomputed;
+}
+
+// Averages the buffered spikes that project inside each PCA polygon.
+// Returns the number of templates that were created.
+// Works on copies of the units, components and spikes, so sortSpike() is only
+// held up while they are copied and while the new templates are swapped in.
+int SpikeSortBoxes::seedTemplatesFromPCAUnits()
+{
+	std::vector<PCAUnit> units;
+	Array<SpikeHandle> spikes;
+	std::vector<float> component1, component2;
+	std::vector<TemplateUnit> newTemplates;
+	int dim;
+
+	{
+		const ScopedLock myScopedLock (mut);
+
+		bTemplatesSeeded = true; // until the PCA units change again
+		dim = numChannels * waveformLength;
+
+		if (bPCAcomputed)
+		{
+			units = pcaUnits;
+			spikes = spikeBuffer;
+			component1.assign(pc1, pc1 + dim);
+			component2.assign(pc2, pc2 + dim);
+		}
+	}
+
+	std::vector<std::vector<float> > sums(units.size(), std::vector<float>(dim, 0.0f));
+	std::vector<int> counts(units.size(), 0);
+	std::vector<float> waveform(dim);
+
+	for (int n = 0; n < spikes.size(); n++)
+	{
+		SpikeObject* so = spikes.getReference(n).get();
+		// skip the empty spikes the buffer was initialized with
+		if (so->timestamp == 0 || so->nChannels * so->nSamples != dim)
+			continue;
+
+		spikeToMicrovolts(so, &waveform[0]);
+
+		PointD proj(0, 0);
+		for (int k = 0; k < dim; k++)
+		{
+			proj.X += component1[k] * waveform[k];
+			proj.Y += component2[k] * waveform[k];
+		}
+
+		for (int u = 0; u < units.size(); u++)
+		{
+			if (units[u].isPointInsidePolygon(proj))
+			{
+				float *sum = &sums[u][0];
+				for (int k = 0; k < dim; k++)
+					sum[k] += waveform[k];
+				counts[u]++;
+				break;
+			}
+		}
+	}
+
+	for (int u = 0; u < units.size(); u++)
+	{
+		if (counts[u] == 0)
+			continue;
+
+		for (int k = 0; k < dim; k++)
+			sums[u][k] /= counts[u];
+
+		TemplateUnit unit(units[u].getUnitID(), units[u].getLocalID());
+		unit.ColorRGB[0] = units[u].ColorRGB[0];
+		unit.ColorRGB[1] = units[u].ColorRGB[1];
+		unit.ColorRGB[2] = units[u].ColorRGB[2];
+		unit.setTemplate(&sums[u][0], dim, counts[u]);
+		newTemplates.push_back(unit);
+	}
+
+	const ScopedLock myScopedLock (mut);
+
+	// the waveform may have been resized in the meantime
+	if (dim == numChannels * waveformLength)
+		templateUnits.swap(newTemplates);
+
+	return templateUnits.size();
+}
+
+// Assigns the spike to the template unit with the smallest euclidean distance.
+// Each distance computation gives up as soon as it exceeds the best distance
+// found so far (or the rejection threshold), so the cost per spike stays close
+// to a single full template comparison even with many units.
+bool SpikeSortBoxes::sortSpikeByTemplate(SpikeObject *so)
+{
+	const int dim = so->nChannels * so->nSamples;
+	if (templateUnits.size() == 0 || dim == 0 || dim > spikeMicrovolts.size())
+		return false;
+
+	spikeToMicrovolts(so, &spikeMicrovolts[0]);
+
+	float bestDistance = templateThreshold * templateThreshold * dim;
+	int bestUnit = -1;
+	for (int k = 0; k < templateUnits.size(); k++)
+	{
+		if (templateUnits[k].waveformTemplate.size() != dim)
+			continue;
+
+		float d = templateUnits[k].getSquaredDistance(&spikeMicrovolts[0], bestDistance);
+		if (d < bestDistance)
+		{
+			bestDistance = d;
+			bestUnit = k;
+		}
+	}
+
+	if (bestUnit < 0)
+		return false;
+
+	TemplateUnit& unit = templateUnits[bestUnit];
+	so->sortedId = unit.getUnitID();
+	so->color[0] = unit.ColorRGB[0];
+	so->color[1] = unit.ColorRGB[1];
+	so->color[2] = unit.ColorRGB[2];
+	unit.updateTemplate(&spikeMicrovolts[0]);
+	unit.updateWaveform(so);
+	return true;
+}
+
 void SpikeSortBoxes::updatePCAUnits(std::vector<PCAUnit> _units)
 {
 	//StartCriticalSection();
 	const ScopedLock myScopedLock (mut);
 	pcaUnits = _units;
+	bTemplatesSeeded = false;
 	//EndCriticalSection();
 }
 
@@ -1161,10 +1392,14 @@ void SpikeSortBoxes::updateBoxUnits(std::vector<BoxUnit> _units)
 
 
 // tests whether a candidate spike belongs to one of the defined units
-bool SpikeSortBoxes::sortSpike(SpikeObject *so, bool PCAfirst)
+bool SpikeSortBoxes::sortSpike(SpikeObject *so, SpikeSortingMode mode)
 {
 	const ScopedLock myScopedLock (mut);
-  if (PCAfirst) {
+  if (mode == SORT_TEMPLATES)
+  {
+	  return sortSpikeByTemplate(so);
+  }
+  else if (mode == SORT_PCA_FIRST) {
 
 	  for (int k=0;k<pcaUnits.size();k++)
 	  {
@@ -1682,6 +1917,87 @@ void PCAUnit::updateWaveform(SpikeObject *so)
 
 /***************************/
 
+TemplateUnit::TemplateUnit() : UnitID(0), localID(0), numSpikes(0)
+{
+}
+
+TemplateUnit::TemplateUnit(int ID, int localID_) : UnitID(ID), localID(localID_), numSpikes(0)
+{
+	BoxUnit::setDefaultColors(ColorRGB, localID);
+}
+
+int TemplateUnit::getUnitID()
+{
+	return UnitID;
+}
+
+int TemplateUnit::getLocalID()
+{
+	return localID;
+}
+
+void TemplateUnit::setTemplate(const float *waveform, int length, int numSpikesInTemplate)
+{
+	waveformTemplate.assign(waveform, waveform + length);
+	numSpikes = numSpikesInTemplate;
+}
+
+void TemplateUnit::updateTemplate(const float *waveform)
+{
+	if (numSpikes < TEMPLATE_MAX_SPIKES)
+		numSpikes++;
+
+	const float alpha = 1.0f / numSpikes;
+	float *t = &waveformTemplate[0];
+	const int n = waveformTemplate.size();
+	for (int k = 0; k < n; k++)
+	{
+		t[k] += alpha * (waveform[k] - t[k]);
+	}
+}
+
+// Squared euclidean distance to the template. The samples are accumulated in
+// eight independent lanes (which the compiler maps onto SIMD registers) one
+// block at a time; the partial sum is compared with bound after every block.
+float TemplateUnit::getSquaredDistance(const float *waveform, float bound) const
+{
+	const int lanes = 8;
+	const int blockSize = 32;
+	const float *t = &waveformTemplate[0];
+	const int n = waveformTemplate.size();
+
+	float distance = 0;
+	int k = 0;
+	while (k + blockSize <= n)
+	{
+		float acc[lanes] = {0, 0, 0, 0, 0, 0, 0, 0};
+		for (int end = k + blockSize; k < end; k += lanes)
+		{
+			for (int j = 0; j < lanes; j++)
+			{
+				const float d = waveform[k + j] - t[k + j];
+				acc[j] += d * d;
+			}
+		}
+		distance += ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+		if (distance > bound)
+			return distance;
+	}
+	for (; k < n; k++)
+	{
+		const float d = waveform[k] - t[k];
+		distance += d * d;
+	}
+	return distance;
+}
+
+void TemplateUnit::updateWaveform(SpikeObject *so)
+{
+	WaveformStat.update(so);
+}
+
+/***************************/
+
 
 /*
   An implementation of SVD from Numerical Recipes in C and Mike Erhdmann's lectures
@@ -1699,7 +2015,7 @@ static int iminarg1,iminarg2;
 static double sqrarg;
 #define SQR(a) ((sqrarg = (a)) == 0.0 ? 0.0 : sqrarg * sqrarg)
 
-PCAjob::PCAjob(Array<SpikeObject> _spikes, float *_pc1, float *_pc2,
+PCAjob::PCAjob(const Array<SpikeHandle>& _spikes, float *_pc1, float *_pc2,
 			float *pc1Min, float *pc2Min, float *pc1Max, float *pc2Max, bool *_reportDone) : spikes(_spikes), reportDone(_reportDone)
 {
 	cov = nullptr;
@@ -1709,7 +2025,7 @@ PCAjob::PCAjob(Array<SpikeObject> _spikes, float *_pc1, float *_pc2,
 	pc2min = pc2Min;
 	pc1max = pc1Max;
 	pc2max = pc2Max;
-    dim = spikes[0].nChannels*spikes[0].nSamples;
+    dim = spikes[0]->nChannels*spikes[0]->nSamples;
 
 };
 
@@ -1966,8 +2282,8 @@ void PCAjob::computeCov()
 		mean[j] = 0;
 		for (int i=0;i<spikes.size();i++) 
 		{
-            SpikeObject spike = spikes[i];
-			float v = spikeDataIndexToMicrovolts(&spike, j) ;
+            const SpikeObject* spike = spikes.getReference(i).get();
+			float v = spikeDataIndexToMicrovolts(spike, j) ;
 			mean[j] += v / dim;
 		}
 	}
@@ -1982,9 +2298,9 @@ void PCAjob::computeCov()
 			for (int k=0;k<spikes.size();k++) 
 			{
 
-                SpikeObject spike = spikes[k];
-				float vi = spikeDataIndexToMicrovolts(&spike, i);
-				float vj = spikeDataIndexToMicrovolts(&spike, j);
+                const SpikeObject* spike = spikes.getReference(k).get();
+				float vi = spikeDataIndexToMicrovolts(spike, i);
+				float vj = spikeDataIndexToMicrovolts(spike, j);
 				sum += (vi-mean[i]) * (vj-mean[j]);
 			}
 			cov[i][j] = sum / (dim-1); 
@@ -2063,9 +2379,9 @@ void PCAjob::computeSVD()
 		float sum1 = 0, sum2=0;
 		for (int k = 0; k < dim; k++)
 		{
-            SpikeObject spike = spikes[j];
-			sum1 += spikeDataIndexToMicrovolts(&spike,k) * pc1[k];
-			sum2 += spikeDataIndexToMicrovolts(&spike,k) * pc2[k];
+            const SpikeObject* spike = spikes.getReference(j).get();
+			sum1 += spikeDataIndexToMicrovolts(spike,k) * pc1[k];
+			sum2 += spikeDataIndexToMicrovolts(spike,k) * pc2[k];
 		}
 		if (sum1 < min1)
 			min1 = sum1;
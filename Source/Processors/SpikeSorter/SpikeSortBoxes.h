@@ -33,8 +33,22 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <list>
 #include <queue>
 
+#define TEMPLATE_MAX_SPIKES 200
+#define DEFAULT_TEMPLATE_THRESHOLD 40.0f // microvolts RMS
+
 class PCAcomputingThread;
 class UniqueIDgenerator;
+
+// The order in which units are tested when a spike arrives.
+// Template matching replaces the sequential box/polygon tests by a
+// nearest-template search over all template units of the electrode.
+enum SpikeSortingMode
+{
+	SORT_BOXES_FIRST = 0,
+	SORT_PCA_FIRST,
+	SORT_TEMPLATES
+};
+
 class PointD
 {
 public:
@@ -162,14 +176,14 @@ PCAjob();
 class PCAjob
 {
 public:
-	PCAjob(Array<SpikeObject> _spikes, float *_pc1, float *_pc2,
+	PCAjob(const Array<SpikeHandle>& _spikes, float *_pc1, float *_pc2,
 			float *, float *, float *, float *, bool *_reportDone);
 	~PCAjob();
 	void computeCov();
 	void computeSVD();
 
 	float **cov;
-	Array<SpikeObject> spikes;
+	Array<SpikeHandle> spikes;
 	float *pc1, *pc2;
 	float *pc1min, *pc2min, *pc1max, *pc2max;
 	bool *reportDone;
@@ -225,6 +239,30 @@ public:
 	Time timer;
 };
 
+// Template unit defines a single unit by a running mean waveform (in microvolts,
+// stored channel after channel like SpikeObject::data). The mean is a true
+// average for the first TEMPLATE_MAX_SPIKES spikes and an exponential average
+// afterwards, so the template follows slow drifts of the recording.
+class TemplateUnit
+{
+public:
+	TemplateUnit();
+	TemplateUnit(int ID, int localID);
+	int getUnitID();
+	int getLocalID();
+	void setTemplate(const float *waveform, int length, int numSpikesInTemplate);
+	void updateTemplate(const float *waveform);
+	float getSquaredDistance(const float *waveform, float bound) const;
+	void updateWaveform(SpikeObject *so);
+public:
+	int UnitID;
+	int localID; // used internally, for colors and position.
+	std::vector<float> waveformTemplate;
+	int numSpikes;
+	uint8_t ColorRGB[3];
+	RunningStats WaveformStat;
+};
+
 // Sort spikes from a single electrode (which could have any number of channels)
 // using the box method. Any electrode could have an arbitrary number of units specified.
 // Each unit is defined by a set of boxes, which can be placed on any of the given channels.
@@ -237,8 +275,8 @@ public:
 	void resizeWaveform(int numSamples);
 	
 	
-	void projectOnPrincipalComponents(SpikeObject *so);
-	bool sortSpike(SpikeObject *so, bool PCAfirst);
+	void projectOnPrincipalComponents(const SpikeHandle& spike);
+	bool sortSpike(SpikeObject *so, SpikeSortingMode mode);
 	void RePCA();
 	void addPCAunit(PCAUnit unit);
 	int addBoxUnit(int channel); 
@@ -259,6 +297,13 @@ public:
 	std::vector<Box> getUnitBoxes(int unitID);
 	std::vector<BoxUnit> getBoxUnits();
 	std::vector<PCAUnit> getPCAUnits();
+	/** builds one template per PCA unit, averaging the buffered spikes that fall inside its polygon.
+	    not real-time safe; the new templates replace the old ones at once */
+	int seedTemplatesFromPCAUnits();
+	/** true if the PCA units changed since the templates were seeded */
+	bool needsTemplates();
+	void setTemplateThreshold(float microvoltsRMS);
+	float getTemplateThreshold();
 
 	void getUnitColor(int UnitID, uint8 &R, uint8 &G, uint8 &B);
 	void updateBoxUnits(std::vector<BoxUnit> _units);
@@ -273,15 +318,21 @@ public:
 private:
 	//void  StartCriticalSection();
 	//void  EndCriticalSection();
+	bool sortSpikeByTemplate(SpikeObject *so);
+	void spikeToMicrovolts(SpikeObject *so, float *dest);
 	UniqueIDgenerator* uniqueIDgenerator;
 	int numChannels, waveformLength;
 	int selectedUnit, selectedBox;
 	CriticalSection mut;
 	std::vector<BoxUnit> boxUnits;
 	std::vector<PCAUnit> pcaUnits;
+	std::vector<TemplateUnit> templateUnits;
+	std::vector<float> spikeMicrovolts; // scratch buffer for template matching, sized with the waveform
+	float templateThreshold; // rejection threshold, RMS distance in microvolts
+	bool bTemplatesSeeded;
 	float *pc1, *pc2;
 	float pc1min, pc2min, pc1max, pc2max;
-	Array<SpikeObject> spikeBuffer;
+	Array<SpikeHandle> spikeBuffer;
 	int bufferSize,spikeBufferIndex;
 	PCAcomputingThread *computingThread;
 	bool bPCAJobSubmitted,bPCAcomputed,bRePCA,bPCAjobFinished ;
@@ -43,9 +43,10 @@ SpikeSorter::SpikeSorter()
 	ticksPerSec = (float) timer.getHighResolutionTicksPerSecond();
 	electrodeTypes.clear();
 	electrodeCounter.clear();
-    spikeBuffer = new uint8_t[MAX_SPIKE_BUFFER_LEN]; // MAX_SPIKE_BUFFER_LEN defined in SpikeObject.h
+    spikeBufferSize = MAX_SPIKE_BUFFER_LEN; // MAX_SPIKE_BUFFER_LEN defined in SpikeObject.h
+    spikeBuffer.malloc(spikeBufferSize);
 	channelBuffers=nullptr;
-	PCAbeforeBoxes = true;
+	sortingMode = SORT_PCA_FIRST;
 	autoDACassignment = false;
 	syncThresholds = false;
 	flipSignal = false;
@@ -72,6 +73,70 @@ void SpikeSorter::setFlipSignalState(bool state)
 
 }
 
+SpikeSortingMode SpikeSorter::getSortingMode()
+{
+	return sortingMode;
+}
+
+void SpikeSorter::setSortingMode(SpikeSortingMode mode)
+{
+	sortingMode = mode;
+
+	if (mode == SORT_TEMPLATES)
+		seedTemplatesIfNeeded();
+}
+
+// Electrodes are only added and removed on the message thread, so the sorters
+// can be used after the lock is released; seeding them under the lock would
+// hold up process().
+int SpikeSorter::seedTemplatesForActiveElectrode()
+{
+	SpikeSortBoxes* spikeSort = nullptr;
+
+	mut.enter();
+	if (currentElectrode >= 0 && currentElectrode < electrodes.size())
+		spikeSort = electrodes[currentElectrode]->spikeSort;
+	mut.exit();
+
+	return (spikeSort != nullptr) ? spikeSort->seedTemplatesFromPCAUnits() : 0;
+}
+
+void SpikeSorter::seedTemplatesIfNeeded()
+{
+	Array<SpikeSortBoxes*> sorters;
+
+	mut.enter();
+	for (int i = 0; i < electrodes.size(); i++)
+		sorters.add(electrodes[i]->spikeSort);
+	mut.exit();
+
+	for (int i = 0; i < sorters.size(); i++)
+	{
+		if (sorters[i]->needsTemplates())
+			sorters[i]->seedTemplatesFromPCAUnits();
+	}
+}
+
+void SpikeSorter::setTemplateThresholdForActiveElectrode(float microvoltsRMS)
+{
+	mut.enter();
+	if (currentElectrode >= 0 && currentElectrode < electrodes.size())
+		electrodes[currentElectrode]->spikeSort->setTemplateThreshold(microvoltsRMS);
+	mut.exit();
+}
+
+float SpikeSorter::getTemplateThresholdForActiveElectrode()
+{
+	float threshold = DEFAULT_TEMPLATE_THRESHOLD;
+
+	mut.enter();
+	if (currentElectrode >= 0 && currentElectrode < electrodes.size())
+		threshold = electrodes[currentElectrode]->spikeSort->getTemplateThreshold();
+	mut.exit();
+
+	return threshold;
+}
+
 int SpikeSorter::getNumPreSamples()
 {
 	return numPreSamples;
@@ -156,9 +221,6 @@ void SpikeSorter::increaseUniqueProbeID(String type)
 
 SpikeSorter::~SpikeSorter()
 {
-	delete spikeBuffer;
-	spikeBuffer = nullptr;
-
 	if (channelBuffers != nullptr)
 		delete channelBuffers;
 
@@ -207,6 +269,12 @@ void SpikeSorter::updateSettings()
                 break;
         }
 
+        // spike timestamps count the samples of the electrode's channels
+        const int firstChannel = *electrodes[i]->channels;
+
+        if (firstChannel >= 0 && firstChannel < channels.size())
+            ch->streamId = channels[firstChannel]->getStreamId();
+
         eventChannels.add(ch);
     }
 	
@@ -689,16 +757,23 @@ Electrode* SpikeSorter::getActiveElectrode()
 }
 
 
-void SpikeSorter::addSpikeEvent(SpikeObject* s, MidiBuffer& eventBuffer, int peakIndex)
+void SpikeSorter::addSpikeEvent(const SpikeHandle& s, MidiBuffer& eventBuffer, int peakIndex)
 {
 
     // std::cout << "Adding spike event for index " << peakIndex << std::endl;
 	
     s->eventType = SPIKE_EVENT_CODE;
 
-    int numBytes = packSpike(s,                        // SpikeObject
+    // only happens the first time a larger electrode fires
+    if (getSpikeEventSize(s.get()) > spikeBufferSize)
+    {
+        spikeBufferSize = getSpikeEventSize(s.get());
+        spikeBuffer.realloc(spikeBufferSize);
+    }
+
+    int numBytes = packSpikeEvent(s,                   // SpikeHandle
                              spikeBuffer,              // uint8_t*
-                             MAX_SPIKE_BUFFER_LEN);    // int
+                             spikeBufferSize);         // int
 
     if (numBytes > 0)
         eventBuffer.addEvent(spikeBuffer, numBytes, peakIndex);
@@ -966,22 +1041,23 @@ void SpikeSorter::process(AudioSampleBuffer& buffer,
                         peakIndex = sampleIndex;
                         sampleIndex -= (electrode->prePeakSamples+1);
 
-                        SpikeObject newSpike;
-						newSpike.sortedId = 0; // unsorted.
-                        newSpike.timestamp = getTimestamp(currentChannel) + peakIndex;
-						newSpike.electrodeID = electrode->electrodeID;
-						newSpike.channel = chan;
-                        newSpike.source = i;
-                        newSpike.nChannels = electrode->numChannels;
-						newSpike.samplingFrequencyHz = samplingFrequencyHz;
-						newSpike.color[0] = newSpike.color[1] = newSpike.color[2] = 127;
+                        SpikeHandle newSpike = SpikePool::getInstance().allocate(electrode->numChannels,
+                                                                                  electrode->prePeakSamples +
+                                                                                  electrode->postPeakSamples);
+						newSpike->sortedId = 0; // unsorted.
+                        newSpike->timestamp = getTimestamp(currentChannel) + peakIndex;
+						newSpike->electrodeID = electrode->electrodeID;
+						newSpike->channel = chan;
+                        newSpike->source = i;
+						newSpike->samplingFrequencyHz = samplingFrequencyHz;
+						newSpike->color[0] = newSpike->color[1] = newSpike->color[2] = 127;
                         currentIndex = 0;
 
                         // package spikes;
                         for (int channel = 0; channel < electrode->numChannels; channel++)
                         {
 
-                            addWaveformToSpikeObject(&newSpike,
+                            addWaveformToSpikeObject(newSpike.get(),
                                                      peakIndex,
                                                      i,
                                                      channel);
@@ -992,7 +1068,7 @@ void SpikeSorter::process(AudioSampleBuffer& buffer,
 						/*
 						bool perfectMatch = true;
 						for (int k=0;k<40;k++) {
-							perfectMatch = perfectMatch & (prevSpike.data[k] == newSpike.data[k]);
+							perfectMatch = perfectMatch & (prevSpike->data[k] == newSpike->data[k]);
 						}
 						if (perfectMatch)
 						{
@@ -1002,10 +1078,10 @@ void SpikeSorter::process(AudioSampleBuffer& buffer,
 						*/
 
                        //for (int xxx = 0; xxx < 1000; xxx++) // overload with spikes for testing purposes
-						electrode->spikeSort->projectOnPrincipalComponents(&newSpike);
+						electrode->spikeSort->projectOnPrincipalComponents(newSpike);
 
 						// Add spike to drawing buffer....
-						electrode->spikeSort->sortSpike(&newSpike, PCAbeforeBoxes);
+						electrode->spikeSort->sortSpike(newSpike.get(), sortingMode);
 						
 
 						  // transfer buffered spikes to spike plot
@@ -1023,7 +1099,7 @@ void SpikeSorter::process(AudioSampleBuffer& buffer,
 						}
 
 
-                            addSpikeEvent(&newSpike, events, peakIndex);
+                            addSpikeEvent(newSpike, events, peakIndex);
 							//prevSpike = newSpike;
                         // advance the sample index
                         sampleIndex = peakIndex + electrode->postPeakSamples;
@@ -1246,6 +1322,7 @@ void SpikeSorter::saveCustomParametersToXml(XmlElement* parentElement)
 	mainNode->setAttribute("syncThresholds",syncThresholds);
 	mainNode->setAttribute("uniqueID",uniqueID);
 	mainNode->setAttribute("flipSignal",flipSignal);
+	mainNode->setAttribute("sortingMode",(int)sortingMode);
 
     XmlElement* countNode = mainNode->createNewChildElement("ELECTRODE_COUNTER");
 
@@ -1308,6 +1385,7 @@ void SpikeSorter::loadCustomParametersFromXml()
 				syncThresholds = mainNode->getBoolAttribute("syncThresholds");
 				uniqueID = mainNode->getIntAttribute("uniqueID");
 				flipSignal = mainNode->getBoolAttribute("flipSignal");
+				sortingMode = (SpikeSortingMode)mainNode->getIntAttribute("sortingMode", SORT_PCA_FIRST);
 
 				forEachXmlChildElement(*mainNode, xmlNode)
 				{
@@ -1807,11 +1885,7 @@ Histogram::~Histogram()
 void ContinuousCircularBuffer::reallocate(int NumCh)
 {
 	numCh =NumCh;
-	Buf.resize(numCh);
-	for (int k=0;k< numCh;k++)
-	{
-		Buf[k].resize(bufLen);
-	}
+	Buf.resize(numCh * bufLen);
 	numSamplesInBuf = 0;
 	ptr = 0; // points to a valid position in the buffer.
 
@@ -1830,13 +1904,7 @@ ContinuousCircularBuffer::ContinuousCircularBuffer(int NumCh, float SamplingRate
 	samplingRate = SamplingRate;
 	numCh =NumCh;
 	leftover_k = 0;
-	Buf.resize(numCh);
-
-
-	for (int k=0;k< numCh;k++)
-	{
-		Buf[k].resize(numSamplesToHoldPerChannel);
-	}
+	Buf.resize(numCh * numSamplesToHoldPerChannel);
 
 	hardwareTS.resize(numSamplesToHoldPerChannel);
 	softwareTS.resize(numSamplesToHoldPerChannel);
@@ -1855,7 +1923,7 @@ void ContinuousCircularBuffer::update(int channel, int64 hardware_ts, int64 soft
 	hardwareTS[ptr] = hardware_ts;
 	softwareTS[ptr] = software_ts;
 
-	Buf[channel][ptr] = (rise) ? 1.0 : 0.0;
+	getChannel(channel)[ptr] = (rise) ? 1.0 : 0.0;
 
 	ptr++;
 	if (ptr == bufLen)
@@ -1887,7 +1955,7 @@ void ContinuousCircularBuffer::update(AudioSampleBuffer& buffer, int64 hardware_
 
 		for (int ch = 0; ch < numCh; ch++)
 		{
-			Buf[ch][ptr] = *(buffer.getReadPointer(ch,k));
+			Buf[ch * bufLen + ptr] = *(buffer.getReadPointer(ch,k));
 		}
 		ptr++;
 		if (ptr == bufLen)
@@ -1908,7 +1976,7 @@ void ContinuousCircularBuffer::update(AudioSampleBuffer& buffer, int64 hardware_
 }
 
 
-void ContinuousCircularBuffer::update(std::vector<std::vector<bool>> contdata, int64 hardware_ts, int64 software_ts, int numpts)
+void ContinuousCircularBuffer::update(const std::vector<std::vector<bool> > &contdata, int64 hardware_ts, int64 software_ts, int numpts)
 {
 	mut.enter();
 	
@@ -1925,7 +1993,7 @@ void ContinuousCircularBuffer::update(std::vector<std::vector<bool>> contdata, i
 
 		for (int ch = 0; ch < numCh; ch++)
 		{
-			Buf[ch][ptr] = contdata[ch][k];
+			Buf[ch * bufLen + ptr] = contdata[ch][k];
 		}
 		ptr++;
 		if (ptr == bufLen)
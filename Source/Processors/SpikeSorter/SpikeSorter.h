@@ -177,11 +177,14 @@ class ContinuousCircularBuffer
 public:
 	ContinuousCircularBuffer(int NumCh, float SamplingRate, int SubSampling, float NumSecInBuffer);
 	void reallocate(int N);
-	void update(std::vector<std::vector<bool>> contdata, int64 hardware_ts, int64 software_ts, int numpts);
+	void update(const std::vector<std::vector<bool> > &contdata, int64 hardware_ts, int64 software_ts, int numpts);
 	void update(AudioSampleBuffer& buffer, int64 hardware_ts, int64 software_ts, int numpts);
 	void update(int channel, int64 hardware_ts, int64 software_ts, bool rise);
 	int GetPtr();
 	void addTrialStartToSmartBuffer(int trialID);
+	// returns the start of a channel's samples inside the flat buffer
+	inline float* getChannel(int ch) { return &Buf[ch * bufLen]; }
+	inline const float* getChannel(int ch) const { return &Buf[ch * bufLen]; }
 	int numCh;
 	int subSampling;
 	float samplingRate;
@@ -193,7 +196,7 @@ public:
 	int leftover_k;
 	double buffer_dx;
 	
-	std::vector<std::vector<float> > Buf;
+	std::vector<float> Buf; // numCh x bufLen, channel after channel
 	std::vector<bool> valid;
 	std::vector<int64> hardwareTS,softwareTS;
 };
@@ -344,6 +347,15 @@ public:
 	void setThresholdSyncStatus(bool status);
 	bool getFlipSignalState();
 	void setFlipSignalState(bool state);
+	SpikeSortingMode getSortingMode();
+	void setSortingMode(SpikeSortingMode mode);
+	/** seeds the templates of the active electrode from its PCA units. returns the number of templates */
+	int seedTemplatesForActiveElectrode();
+	/** reseeds the templates of every electrode whose PCA units changed. not real-time safe */
+	void seedTemplatesIfNeeded();
+	/** rejection threshold of the template matching, RMS distance in microvolts */
+	void setTemplateThresholdForActiveElectrode(float microvoltsRMS);
+	float getTemplateThresholdForActiveElectrode();
 	void startRecording();
 	std::vector<float> getElectrodeVoltageScales(int electrodeID);
 	//void getElectrodePCArange(int electrodeID, float &minX,float &maxX,float &minY,float &maxY);
@@ -377,7 +389,7 @@ public:
 private:
 	UniqueIDgenerator uniqueIDgenerator;
 	long uniqueSpikeID;
-	SpikeObject prevSpike;
+	SpikeHandle prevSpike;
 
 	void addElectrode(Electrode* newElectrode);
 	void increaseUniqueProbeID(String type);
@@ -408,17 +420,18 @@ private:
 
 
 	int numPreSamples,numPostSamples;
-    uint8_t* spikeBuffer;///[256];
+    HeapBlock<uint8_t> spikeBuffer;
+    int spikeBufferSize;
     //int64 timestamp;
 		  int64 hardware_timestamp;
 		  int64 software_timestamp;
 
-	bool PCAbeforeBoxes;
+	SpikeSortingMode sortingMode;
  	ContinuousCircularBuffer* channelBuffers; // used to compute auto threshold
 
      void handleEvent(int eventType, MidiMessage& event, int sampleNum);
 
-    void addSpikeEvent(SpikeObject* s, MidiBuffer& eventBuffer, int peakIndex);
+    void addSpikeEvent(const SpikeHandle& s, MidiBuffer& eventBuffer, int peakIndex);
  
     void resetElectrode(Electrode*);
 	CriticalSection mut;
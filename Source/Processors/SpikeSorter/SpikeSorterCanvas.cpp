@@ -72,6 +72,32 @@ SpikeSorterCanvas::SpikeSorterCanvas(SpikeSorter* n) :
     deleteAllUnits->addListener(this);
     addAndMakeVisible(deleteAllUnits);
 
+    templateModeButton = new UtilityButton("Templates", Font("Small Text", 13, Font::plain));
+    templateModeButton->setRadius(3.0f);
+    templateModeButton->setClickingTogglesState(true);
+    templateModeButton->setToggleState(processor->getSortingMode() == SORT_TEMPLATES, dontSendNotification);
+    templateModeButton->addListener(this);
+    addAndMakeVisible(templateModeButton);
+
+    seedTemplatesButton = new UtilityButton("Seed templates", Font("Small Text", 13, Font::plain));
+    seedTemplatesButton->setRadius(3.0f);
+    seedTemplatesButton->addListener(this);
+    addAndMakeVisible(seedTemplatesButton);
+
+    templateThresholdCaption = new Label("Template threshold", "Threshold (uV):");
+    templateThresholdCaption->setFont(Font("Small Text", 13, Font::plain));
+    templateThresholdCaption->setColour(Label::textColourId, Colours::lightgrey);
+    addAndMakeVisible(templateThresholdCaption);
+
+    templateThresholdValue = new Label("Template threshold value", String(processor->getTemplateThresholdForActiveElectrode()));
+    templateThresholdValue->setFont(Font("Small Text", 13, Font::plain));
+    templateThresholdValue->setColour(Label::textColourId, Colours::white);
+    templateThresholdValue->setColour(Label::backgroundColourId, Colours::grey);
+    templateThresholdValue->setEditable(true);
+    templateThresholdValue->setTooltip("RMS distance from the nearest template above which a spike is left unsorted");
+    templateThresholdValue->addListener(this);
+    addAndMakeVisible(templateThresholdValue);
+
     nextElectrode = new UtilityButton("Next Electrode", Font("Small Text", 13, Font::plain));
     nextElectrode->setRadius(3.0f);
     nextElectrode->addListener(this);
@@ -129,6 +155,7 @@ void SpikeSorterCanvas::update()
         electrode->spikePlot->setFlipSignal(processor->getFlipSignalState());
         electrode->spikePlot->updateUnitsFromProcessor();
 
+        templateThresholdValue->setText(String(processor->getTemplateThresholdForActiveElectrode()), dontSendNotification);
     }
     spikeDisplay->resized();
     spikeDisplay->repaint();
@@ -160,6 +187,11 @@ void SpikeSorterCanvas::resized()
     newIDbuttons->setBounds(0, 270, 120,20);
     deleteAllUnits->setBounds(0, 300, 120,20);
 
+    templateModeButton->setBounds(0, 360, 120,20);
+    seedTemplatesButton->setBounds(0, 390, 120,20);
+    templateThresholdCaption->setBounds(0, 420, 90,20);
+    templateThresholdValue->setBounds(90, 420, 30,20);
+
 }
 
 void SpikeSorterCanvas::paint(Graphics& g)
@@ -174,6 +206,10 @@ void SpikeSorterCanvas::refresh()
     // called every 10 Hz
     processSpikeEvents();
 
+    // templates follow edits of the PCA units; seeding scans the spike buffer, so it's done here
+    if (processor->getSortingMode() == SORT_TEMPLATES)
+        processor->seedTemplatesIfNeeded();
+
     repaint();
 }
 
@@ -322,6 +358,19 @@ bool SpikeSorterCanvas::keyPressed(const KeyPress& key)
 
 }
 
+void SpikeSorterCanvas::labelTextChanged(Label* label)
+{
+    if (label == templateThresholdValue)
+    {
+        const float threshold = label->getText().getFloatValue();
+
+        if (threshold > 0)
+            processor->setTemplateThresholdForActiveElectrode(threshold);
+
+        label->setText(String(processor->getTemplateThresholdForActiveElectrode()), dontSendNotification);
+    }
+}
+
 void SpikeSorterCanvas::buttonClicked(Button* button)
 {
     int channel = 0;
@@ -375,6 +424,14 @@ void SpikeSorterCanvas::buttonClicked(Button* button)
     {
         processor->getActiveElectrode()->spikeSort->RePCA();
     }
+    else if (button == templateModeButton)
+    {
+        processor->setSortingMode(templateModeButton->getToggleState() ? SORT_TEMPLATES : SORT_PCA_FIRST);
+    }
+    else if (button == seedTemplatesButton)
+    {
+        processor->seedTemplatesForActiveElectrode();
+    }
     else if (button == nextElectrode)
     {
         SpikeSorterEditor* ed = (SpikeSorterEditor*)processor->getEditor();
@@ -492,7 +549,7 @@ void SpikeThresholdDisplay::mouseDown(const MouseEvent& event)
 
 }
 
-void SpikeThresholdDisplay::plotSpike(const SpikeObject& spike, int electrodeNum)
+void SpikeThresholdDisplay::plotSpike(const SpikeHandle& spike, int electrodeNum)
 {
     spikePlots[electrodeNum]->processSpikeObject(spike);
 
@@ -643,7 +700,7 @@ void SpikeHistogramPlot::setPCARange(float p1min, float p2min, float p1max, floa
     pAxes[0]->setPCARange(p1min, p2min, p1max, p2max);
 }
 
-void SpikeHistogramPlot::processSpikeObject(const SpikeObject& s)
+void SpikeHistogramPlot::processSpikeObject(const SpikeHandle& s)
 {
     const ScopedLock myScopedLock(mut);
     if (nWaveAx > 0)
@@ -909,7 +966,7 @@ GenericDrawAxes::~GenericDrawAxes()
 
 }
 
-bool GenericDrawAxes::updateSpikeData(const SpikeObject& newSpike)
+bool GenericDrawAxes::updateSpikeData(const SpikeHandle& newSpike)
 {
     if (!gotFirstSpike)
     {
@@ -1034,13 +1091,7 @@ WaveformAxes::WaveformAxes(SpikeHistogramPlot* plt, SpikeSorter* p,int electrode
 
     font = Font("Small Text",10,Font::plain);
     int numSamples = 40;
-    for (int n = 0; n < bufferSize; n++)
-    {
-        SpikeObject so;
-        generateEmptySpike(&so, 4, numSamples);
-
-        spikeBuffer.add(so);
-    }
+    spikeBuffer.insertMultiple(0, generateEmptySpike(4, numSamples), bufferSize);
 }
 
 void WaveformAxes::mouseWheelMove(const MouseEvent& event, const MouseWheelDetails& wheel)
@@ -1076,10 +1127,10 @@ void WaveformAxes::plotSpike(const SpikeObject& s, Graphics& g)
     g.setColour(Colour(s.color[0],s.color[1],s.color[2]));
     //g.setColour(Colours::pink);
     //compute the spatial width for each waveform sample
-    float dx = getWidth()/float(spikeBuffer[0].nSamples);
+    float dx = getWidth()/float(s.nSamples);
 
     /*
-    float align = 8 * getWidth()/float(spikeBuffer[0].nSamples);
+    float align = 8 * getWidth()/float(s.nSamples);
     g.drawLine(align,
                        0,
                        align,
@@ -1088,7 +1139,10 @@ void WaveformAxes::plotSpike(const SpikeObject& s, Graphics& g)
 
     // type corresponds to channel so we need to calculate the starting
     // sample based upon which channel is getting plotted
-    int offset = channel*s.nSamples; //spikeBuffer[0].nSamples * type; //
+    if (channel >= s.nChannels)
+        return;
+
+    int offset = channel*s.nSamples;
 
     int dSamples = 1;
 
@@ -1098,10 +1152,10 @@ void WaveformAxes::plotSpike(const SpikeObject& s, Graphics& g)
     {
         //std::cout << s.data[sampIdx] << std::endl;
 
-        if (*s.gain != 0)
+        if (s.gain[channel] != 0)
         {
-            float s1 =h- (h/2 + float(s.data[offset+i]-32768)/float(*s.gain)*1000.0f / (range) * h);
-            float s2 =h- (h/2 + float(s.data[offset+i+1]-32768)/float(*s.gain)*1000.0f / (range) * h);
+            float s1 =h- (h/2 + float(s.data[offset+i]-32768)/float(s.gain[channel])*1000.0f / (range) * h);
+            float s2 =h- (h/2 + float(s.data[offset+i+1]-32768)/float(s.gain[channel])*1000.0f / (range) * h);
             if (signalFlipped)
             {
                 s1=h-s1;
@@ -1157,7 +1211,7 @@ void WaveformAxes::drawWaveformGrid(Graphics& g)
 }
 
 
-bool WaveformAxes::updateSpikeData(const SpikeObject& s)
+bool WaveformAxes::updateSpikeData(const SpikeHandle& s)
 {
     if (!gotFirstSpike)
     {
@@ -1167,12 +1221,10 @@ bool WaveformAxes::updateSpikeData(const SpikeObject& s)
     if (spikesReceivedSinceLastRedraw < bufferSize)
     {
 
-        SpikeObject newSpike = s;
-
         spikeIndex++;
         spikeIndex %= bufferSize;
 
-        spikeBuffer.set(spikeIndex, newSpike);
+        spikeBuffer.set(spikeIndex, s);
 
         spikesReceivedSinceLastRedraw++;
 
@@ -1184,12 +1236,15 @@ bool WaveformAxes::updateSpikeData(const SpikeObject& s)
 
 bool WaveformAxes::checkThreshold(const SpikeObject& s)
 {
-    int sampIdx = 40*type;
+    if (type >= s.nChannels)
+        return false;
+
+    int sampIdx = s.nSamples*type;
 
     for (int i = 0; i < s.nSamples-1; i++)
     {
 
-        if (float(s.data[sampIdx]-32768)/float(*s.gain)*1000.0f > displayThresholdLevel)
+        if (float(s.data[sampIdx]-32768)/float(s.gain[type])*1000.0f > displayThresholdLevel)
         {
             return true;
         }
@@ -1207,13 +1262,7 @@ void WaveformAxes::clear()
     spikeBuffer.clear();
     spikeIndex = 0;
     int numSamples=40;
-    for (int n = 0; n < bufferSize; n++)
-    {
-        SpikeObject so;
-        generateEmptySpike(&so, 4,numSamples);
-
-        spikeBuffer.add(so);
-    }
+    spikeBuffer.insertMultiple(0, generateEmptySpike(4, numSamples), bufferSize);
 
     repaint();
 }
@@ -1693,13 +1742,13 @@ void WaveformAxes::paint(Graphics& g)
         if (spikeNum != spikeIndex)
         {
             g.setColour(Colours::grey);
-            plotSpike(spikeBuffer[spikeNum], g);
+            plotSpike(*spikeBuffer[spikeNum], g);
         }
 
     }
 
     g.setColour(Colours::white);
-    plotSpike(spikeBuffer[spikeIndex], g);
+    plotSpike(*spikeBuffer[spikeIndex], g);
 
     bool isRecorded = processor->isSelectedElectrodeRecorded(channel);
 
@@ -1875,9 +1924,9 @@ void PCAProjectionAxes::paint(Graphics& g)
         bool subsample = false;
         int dk = (subsample) ? 5 : 1;
 
-        for (int k=0; k<bufferSize; k+=dk)
+        for (int k=0; k<spikeBuffer.size(); k+=dk)
         {
-            drawProjectedSpike(spikeBuffer[k]);
+            drawProjectedSpike(*spikeBuffer.getReference(k));
         }
         redrawSpikes = false;
     }
@@ -1885,7 +1934,7 @@ void PCAProjectionAxes::paint(Graphics& g)
 }
 
 
-void PCAProjectionAxes::drawProjectedSpike(SpikeObject s)
+void PCAProjectionAxes::drawProjectedSpike(const SpikeObject& s)
 {
     if (rangeSet)
     {
@@ -1912,9 +1961,9 @@ void PCAProjectionAxes::redraw(bool subsample)
 
     int dk = (subsample) ? 5 : 1;
 
-    for (int k=0; k<bufferSize; k+=dk)
+    for (int k=0; k<spikeBuffer.size(); k+=dk)
     {
-        drawProjectedSpike(spikeBuffer[k]);
+        drawProjectedSpike(*spikeBuffer.getReference(k));
     }
 
 }
@@ -1932,18 +1981,16 @@ void PCAProjectionAxes::setPCARange(float p1min, float p2min, float p1max, float
 
 }
 
-bool PCAProjectionAxes::updateSpikeData(const SpikeObject& s)
+bool PCAProjectionAxes::updateSpikeData(const SpikeHandle& s)
 {
 
     if (spikesReceivedSinceLastRedraw < bufferSize)
     {
 
-        SpikeObject newSpike = s;
-
         spikeIndex++;
         spikeIndex %= bufferSize;
 
-        spikeBuffer.set(spikeIndex, newSpike);
+        spikeBuffer.set(spikeIndex, s);
 
         spikesReceivedSinceLastRedraw++;
         //drawProjectedSpike(newSpike);
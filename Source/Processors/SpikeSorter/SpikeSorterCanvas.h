@@ -69,7 +69,7 @@ class RecordNode;
 
 */
 
-class SpikeSorterCanvas : public Visualizer, public Button::Listener
+class SpikeSorterCanvas : public Visualizer, public Button::Listener, public Label::Listener
 
 {
 public:
@@ -98,13 +98,18 @@ public:
 
     void buttonClicked(Button* button);
 
+    void labelTextChanged(Label* label);
+
     void startRecording() { } // unused
     void stopRecording() { } // unused
     
     SpikeSorter* processor;
 	
     ScopedPointer<UtilityButton> addPolygonUnitButton,
-		addUnitButton, delUnitButton, addBoxButton, delBoxButton, rePCAButton,nextElectrode,prevElectrode,newIDbuttons,deleteAllUnits;
+		addUnitButton, delUnitButton, addBoxButton, delBoxButton, rePCAButton,nextElectrode,prevElectrode,newIDbuttons,deleteAllUnits,
+		templateModeButton, seedTemplatesButton;
+
+    ScopedPointer<Label> templateThresholdCaption, templateThresholdValue;
 
 private:
 	void removeUnitOrBox();
@@ -113,7 +118,6 @@ private:
 
 	bool inDrawingPolygonMode;
     bool newSpike;
-    SpikeObject spike;
 	Electrode *electrode;
     int scrollBarThickness;
 
@@ -139,7 +143,7 @@ public:
 	void setPolygonMode(bool on);
 	void mouseDown(const juce::MouseEvent& event);
 
-    void plotSpike(const SpikeObject& spike, int electrodeNum);
+    void plotSpike(const SpikeHandle& spike, int electrodeNum);
 
     int getTotalHeight()
     {
@@ -176,7 +180,7 @@ public:
 
     virtual ~GenericDrawAxes();
 
-    virtual bool updateSpikeData(const SpikeObject& s);
+    virtual bool updateSpikeData(const SpikeHandle& s);
 
     void setXLims(double xmin, double xmax);
     void getXLims(double* xmin, double* xmax);
@@ -195,7 +199,7 @@ protected:
     double xlims[2];
     double ylims[2];
 
-    SpikeObject s;
+    SpikeHandle s;
 
     bool gotFirstSpike;
 
@@ -214,7 +218,7 @@ public:
     ~WaveformAxes() {}
 
 	
-    bool updateSpikeData(const SpikeObject& s);
+    bool updateSpikeData(const SpikeHandle& s);
     bool checkThreshold(const SpikeObject& spike);
 
 	void setSignalFlip(bool state);
@@ -269,7 +273,7 @@ private:
     Font font;
 	float mouseDownX, mouseDownY;
 	float mouseOffsetX,mouseOffsetY;
-    Array<SpikeObject> spikeBuffer;
+    Array<SpikeHandle> spikeBuffer;
 
     int spikeIndex;
     int bufferSize;
@@ -297,7 +301,7 @@ public:
     ~PCAProjectionAxes() {}
 
 	void setPCARange(float p1min, float p2min, float p1max, float p2max);
-    bool updateSpikeData(const SpikeObject& s);
+    bool updateSpikeData(const SpikeHandle& s);
 	void resized();
     void paint(Graphics& g);
 	void setPolygonDrawingMode(bool on);
@@ -321,7 +325,7 @@ public:
 private:
 	float prevx,prevy;
 	bool inPolygonDrawingMode;
-	void drawProjectedSpike(SpikeObject s);
+	void drawProjectedSpike(const SpikeObject& s);
 
 	bool rangeSet;
 	SpikeSorter* processor;
@@ -329,7 +333,7 @@ private:
 	void updateRange(const SpikeObject& s);
 	ScopedPointer<UtilityButton> rangeDownButton, rangeUpButton;
 
-	Array<SpikeObject> spikeBuffer;
+	Array<SpikeHandle> spikeBuffer;
 	int bufferSize;
     int spikeIndex;
 	bool updateProcessor;
@@ -375,7 +379,7 @@ public:
 	void setPCARange(float p1min, float p2min, float p1max, float p2max);
 	void modifyRange(int index,bool up);
 	void updateUnitsFromProcessor();
-    void processSpikeObject(const SpikeObject& s);
+    void processSpikeObject(const SpikeHandle& s);
 
     SpikeSorterCanvas* canvas;
 	
@@ -608,7 +608,7 @@ void AxesComponent::paint(Graphics &g)
 
 }
 /*************************************************************************/
-XYline::XYline(float x0_, float dx_, std::vector<float> y_, float gain_, juce::Colour color_) : x0(x0_), y(y_), dx(dx_),color(color_), gain(gain_)
+XYline::XYline(float x0_, float dx_, const std::vector<float> &y_, float gain_, juce::Colour color_) : x0(x0_), y(y_), dx(dx_),color(color_), gain(gain_)
 {
 	// adjust gain
 	numpts = y.size();
@@ -638,7 +638,7 @@ int XYline::getNumPoints()
 	return numpts;
 }
 
-void XYline::smooth(std::vector<float> smoothKernel)
+void XYline::smooth(const std::vector<float> &smoothKernel)
 {
 	std::vector<float> smoothy;
 	smoothy.resize(y.size());
@@ -46,7 +46,7 @@ class XYline
 {
 public:
 	//XYline(std::vector<float> x_, std::vector<float> y_, float gain, juce::Colour color_);
-	XYline(float x0, float dx, std::vector<float> y_, float gain, juce::Colour color_);
+	XYline(float x0, float dx, const std::vector<float> &y_, float gain, juce::Colour color_);
 
 	// for pure vertical lines
 	XYline(float x0_, float ymin, float ymax, juce::Colour color_) ;
@@ -54,7 +54,7 @@ public:
 	void draw(Graphics &g, float xmin, float xmax, float ymin, float ymax, int width, int height, bool showBounds);
 	void getYRange(float xmin, float xmax, double &lowestValue, double &highestValue);
 	void removeMean();
-	void smooth(std::vector<float> kernel);
+	void smooth(const std::vector<float> &kernel);
 	int getNumPoints();
 private:
 	void four1(std::vector<float> &data, int nn, int isign);
@@ -29,6 +29,221 @@
 #define MIN(a,b)((a)<(b)?(a):(b))
 #define MAX(a,b)((a)<(b)?(b):(a))
 
+SpikeHandle::SpikeHandle(SpikeObject* s) noexcept : spike(s)
+{
+
+}
+
+SpikeHandle::SpikeHandle(const SpikeHandle& other) noexcept : spike(other.spike)
+{
+    if (spike != nullptr)
+        ++(spike->refCount);
+}
+
+SpikeHandle::~SpikeHandle()
+{
+    reset();
+}
+
+SpikeHandle& SpikeHandle::operator= (const SpikeHandle& other)
+{
+    if (other.spike != spike)
+    {
+        if (other.spike != nullptr)
+            ++(other.spike->refCount);
+
+        reset();
+        spike = other.spike;
+    }
+
+    return *this;
+}
+
+void SpikeHandle::reset()
+{
+    if (spike != nullptr)
+    {
+        if (--(spike->refCount) == 0)
+            SpikePool::getInstance().release(spike);
+
+        spike = nullptr;
+    }
+}
+
+// ---------------------------------------------------------------
+
+SpikePool::SpikePool()
+{
+    const int numBytes[SPIKE_POOL_NUM_CLASSES] = {256, 512, 1024, 4096, 16384};
+    const int blocksPerSlab[SPIKE_POOL_NUM_CLASSES] = {1024, 1024, 256, 64, 16};
+
+    for (int i = 0; i < SPIKE_POOL_NUM_CLASSES; i++)
+    {
+        SizeClass* sizeClass = new SizeClass();
+        sizeClass->numBytes = numBytes[i];
+        sizeClass->blocksPerSlab = blocksPerSlab[i];
+        sizeClass->numFree = 0;
+        sizeClass->freeList.malloc((size_t) SPIKE_POOL_NUM_SLABS * sizeClass->blocksPerSlab);
+        sizeClasses.add(sizeClass);
+
+        for (int j = 0; j < SPIKE_POOL_NUM_SLABS; j++)
+            addSlab(sizeClass);
+    }
+
+    for (int i = 0; i < SPIKE_POOL_NUM_SHARED; i++)
+        sharedSpikes[i].ticket = 0;
+}
+
+SpikePool::~SpikePool()
+{
+    // while the size classes are still there to take the spikes back
+    for (int i = 0; i < SPIKE_POOL_NUM_SHARED; i++)
+        sharedSpikes[i].spike.reset();
+}
+
+SpikePool& SpikePool::getInstance()
+{
+    static SpikePool pool;
+    return pool;
+}
+
+int SpikePool::getNumBytes(int nChannels, int nSamples)
+{
+    // gains first, so that everything stays aligned
+    return (int) (sizeof(SpikeObject) + 7) / 8 * 8
+           + nChannels * int(sizeof(float) + sizeof(uint16_t))
+           + nChannels * nSamples * int(sizeof(uint16_t));
+}
+
+SpikeObject* SpikePool::createInBlock(char* block, int sizeClass, int nChannels, int nSamples)
+{
+    SpikeObject* s = new (block) SpikeObject();
+
+    char* payload = block + (sizeof(SpikeObject) + 7) / 8 * 8;
+
+    s->gain = (float*) payload;
+    s->threshold = (uint16_t*) (payload + nChannels * sizeof(float));
+    s->data = s->threshold + nChannels;
+
+    s->sizeClass = sizeClass;
+    s->refCount.set(1);
+
+    s->eventType = SPIKE_EVENT_CODE;
+    s->timestamp = 0;
+    s->timestamp_software = 0;
+    s->source = 0;
+    s->nChannels = nChannels;
+    s->nSamples = nSamples;
+    s->sortedId = 0;
+    s->electrodeID = 0;
+    s->channel = 0;
+    s->color[0] = s->color[1] = s->color[2] = 0;
+    s->pcProj[0] = s->pcProj[1] = 0;
+    s->samplingFrequencyHz = 0;
+
+    return s;
+}
+
+void SpikePool::addSlab(SizeClass* sizeClass)
+{
+    MemoryBlock* slab = new MemoryBlock((size_t) sizeClass->numBytes * sizeClass->blocksPerSlab);
+    sizeClass->slabs.add(slab);
+
+    for (int i = 0; i < sizeClass->blocksPerSlab; i++)
+        sizeClass->freeList[sizeClass->numFree++] = (SpikeObject*) ((char*) slab->getData() + i * sizeClass->numBytes);
+}
+
+SpikeHandle SpikePool::allocate(int nChannels, int nSamples)
+{
+    nChannels = jmax(nChannels, 0);
+    nSamples = jmax(nSamples, 0);
+
+    const int numBytes = getNumBytes(nChannels, nSamples);
+
+    for (int i = 0; i < sizeClasses.size(); i++)
+    {
+        SizeClass* sizeClass = sizeClasses.getUnchecked(i);
+
+        if (numBytes <= sizeClass->numBytes)
+        {
+            char* block = nullptr;
+
+            {
+                const SpinLock::ScopedLockType lock(sizeClass->lock);
+
+                // if all spikes of this size are in use, try the next class up
+                if (sizeClass->numFree > 0)
+                    block = (char*) sizeClass->freeList[--(sizeClass->numFree)];
+            }
+
+            if (block != nullptr)
+                return SpikeHandle(createInBlock(block, i, nChannels, nSamples));
+        }
+    }
+
+    // too large for the pool, or the pool is exhausted
+    return SpikeHandle(createInBlock(new char[numBytes], -1, nChannels, nSamples));
+}
+
+void SpikePool::release(SpikeObject* s)
+{
+    const int sizeClass = s->sizeClass;
+
+    s->~SpikeObject();
+
+    if (sizeClass < 0)
+    {
+        delete[] (char*) s;
+        return;
+    }
+
+    SizeClass* c = sizeClasses.getUnchecked(sizeClass);
+
+    const SpinLock::ScopedLockType lock(c->lock);
+    c->freeList[c->numFree++] = s;
+}
+
+uint32 SpikePool::share(const SpikeHandle& spike)
+{
+    uint32 ticket = ++lastTicket;
+
+    if (ticket == 0) // 0 is never a valid ticket
+        ticket = ++lastTicket;
+
+    SharedSpike& shared = sharedSpikes[ticket % SPIKE_POOL_NUM_SHARED];
+
+    SpikeHandle dropped;
+
+    {
+        const SpinLock::ScopedLockType lock(shared.lock);
+        dropped = shared.spike;
+        shared.spike = spike;
+        shared.ticket = ticket;
+    }
+
+    // the dropped spike goes back to the pool outside the lock
+    return ticket;
+}
+
+SpikeHandle SpikePool::claimShared(uint32 ticket)
+{
+    SharedSpike& shared = sharedSpikes[ticket % SPIKE_POOL_NUM_SHARED];
+
+    const SpinLock::ScopedLockType lock(shared.lock);
+
+    if (ticket != 0 && shared.ticket == ticket)
+        return shared.spike;
+
+    return SpikeHandle();
+}
+
+// ---------------------------------------------------------------
+
+int getPackedSpikeSize(const SpikeObject* s)
+{
+    return SPIKE_METADATA_SIZE + s->nChannels * s->nSamples * 2 + s->nChannels * 4 + s->nChannels * 2;
+}
+
 // Simple method for serializing a SpikeObject into a string of bytes
 int packSpike(const SpikeObject* s, uint8_t* buffer, int bufferSize)
 {
@@ -37,7 +252,12 @@ int packSpike(const SpikeObject* s, uint8_t* buffer, int bufferSize)
     // a pointer to a uint8_t buffer (which will hold the serialized SpikeObject,
     // and a integer indicating the bufferSize.
 
-    //int reqBytes = 1 + 4 + 2+2 + 2 + 2 + 2 * s->nChannels * s->nSamples + 2 * s->nChannels * 2;
+    if (getPackedSpikeSize(s) > bufferSize)
+    {
+        std::cout << "Spike is larger than the buffer. Size was: " << getPackedSpikeSize(s)
+                  << " Buffer size is: " << bufferSize << std::endl;
+        return 0;
+    }
 
     int idx = 0;
 
@@ -83,22 +303,15 @@ int packSpike(const SpikeObject* s, uint8_t* buffer, int bufferSize)
 
     memcpy(buffer+idx, &(s->samplingFrequencyHz), 2);
     idx +=2;
-    memcpy(buffer+idx, &(s->data), s->nChannels * s->nSamples * 2);
+    memcpy(buffer+idx, s->data, s->nChannels * s->nSamples * 2);
     idx += s->nChannels * s->nSamples * 2;
 
-    memcpy(buffer+idx, &(s->gain), s->nChannels * 4); // 4 bytes for a float
+    memcpy(buffer+idx, s->gain, s->nChannels * 4); // 4 bytes for a float
     idx += s->nChannels * 4;
 
-    memcpy(buffer+idx, &(s->threshold), s->nChannels * 2);
+    memcpy(buffer+idx, s->threshold, s->nChannels * 2);
     idx += s->nChannels * 2;
 
-    if (idx >= MAX_SPIKE_BUFFER_LEN)
-    {
-        std::cout << "Spike is larger than it should be. Size was: " << idx
-                  << " Max size is: " << MAX_SPIKE_BUFFER_LEN << std::endl;
-
-    }
-
     //makeBufferValid(buffer, idx);
 
     return idx;
@@ -106,10 +319,38 @@ int packSpike(const SpikeObject* s, uint8_t* buffer, int bufferSize)
 }
 
 // Simple method for deserializing a string of bytes into a Spike object
-bool unpackSpike(SpikeObject* s, const uint8_t* buffer, int bufferSize)
+SpikeHandle unpackSpike(const uint8_t* buffer, int bufferSize)
 {
     //if (!isBufferValid(buffer, bufferSize))
-    //  return false;
+    //  return SpikeHandle();
+
+    if (bufferSize < SPIKE_METADATA_SIZE)
+    {
+        std::cout << "received invalid spike -- buffer too short" << std::endl;
+        return SpikeHandle();
+    }
+
+    uint16_t source, nChannels, nSamples;
+
+    memcpy(&source, buffer+17, 2);
+    memcpy(&nChannels, buffer+19, 2);
+    memcpy(&nSamples, buffer+21, 2);
+
+    if (source > 100)
+    {
+        std::cout << "received invalid spike -- incorrect source" << std::endl;
+        return SpikeHandle();
+    }
+
+    // the number of channels and samples is only limited by the size of the event
+    if (SPIKE_METADATA_SIZE + nChannels * nSamples * 2 + nChannels * 6 > bufferSize)
+    {
+        std::cout << "received invalid spike -- incorrect number of channels or samples" << std::endl;
+        return SpikeHandle();
+    }
+
+    SpikeHandle handle = SpikePool::getInstance().allocate(nChannels, nSamples);
+    SpikeObject* s = handle.get();
 
     int idx = 0;
 
@@ -119,7 +360,7 @@ bool unpackSpike(SpikeObject* s, const uint8_t* buffer, int bufferSize)
    // if (s->eventType != 4)
    // {
    //     std::cout << "received invalid spike -- incorrect event code" << std::endl;
-   //     return false;
+   //     return SpikeHandle();
    // }
 
     memcpy(&(s->timestamp), buffer+idx, 8);
@@ -128,77 +369,83 @@ bool unpackSpike(SpikeObject* s, const uint8_t* buffer, int bufferSize)
     memcpy(&(s->timestamp_software), buffer+idx, 8);
     idx += 8;
 
-    memcpy(&(s->source), buffer+idx, 2);
-    idx += 2;
+    // source, nChannels and nSamples were read above
+    idx += 6;
 
-    if (s->source < 0 || s->source > 100)
-    {
-        std::cout << "received invalid spike -- incorrect source" << std::endl;
-        return false;
-    }
-
-    memcpy(&(s->nChannels), buffer+idx, 2);
-    idx +=2;
-
-    if (s->nChannels > 4)
-    {
-        std::cout << "received invalid spike -- incorrect number of channels" << std::endl;
-        return false;
-    }
-
-    memcpy(&(s->nSamples), buffer+idx, 2);
-    idx +=2;
-
-    if (s->nSamples > 100)
-    {
-        std::cout << "received invalid spike -- incorrect number of samples" << std::endl;
-        return false;
-    }
-
-
-    
     memcpy(&(s->sortedId), buffer+idx, 2);
     idx +=2;
 
-        memcpy(&(s->electrodeID), buffer+idx, 2);
+    memcpy(&(s->electrodeID), buffer+idx, 2);
     idx +=2;
 
-        memcpy(&(s->channel), buffer+idx, 2);
+    memcpy(&(s->channel), buffer+idx, 2);
     idx +=2;
 
-  memcpy(&(s->color[0]), buffer+idx, 1);
+    memcpy(&(s->color[0]), buffer+idx, 1);
     idx +=1;
-  memcpy(&(s->color[1]), buffer+idx, 1);
+    memcpy(&(s->color[1]), buffer+idx, 1);
     idx +=1;
-  memcpy(&(s->color[2]), buffer+idx, 1);
+    memcpy(&(s->color[2]), buffer+idx, 1);
     idx +=1;
 
-    
-
-     memcpy(&(s->pcProj[0]), buffer+idx, sizeof(float));
+    memcpy(&(s->pcProj[0]), buffer+idx, sizeof(float));
     idx +=sizeof(float);
-     memcpy(&(s->pcProj[1]), buffer+idx, sizeof(float));
+    memcpy(&(s->pcProj[1]), buffer+idx, sizeof(float));
     idx +=sizeof(float);
 
     memcpy(&(s->samplingFrequencyHz), buffer+idx, 2);
     idx +=2;
 
-
-    memcpy(&(s->data), buffer+idx, s->nChannels * s->nSamples * 2);
+    memcpy(s->data, buffer+idx, s->nChannels * s->nSamples * 2);
     idx += s->nChannels * s->nSamples * 2;
 
-    memcpy(&(s->gain), buffer+idx, s->nChannels * 4);
+    memcpy(s->gain, buffer+idx, s->nChannels * 4);
     idx += s->nChannels * 4;
 
-    memcpy(&(s->threshold), buffer+idx, s->nChannels *2);
+    memcpy(s->threshold, buffer+idx, s->nChannels *2);
     idx += s->nChannels * 2;
 
-    //if (idx >= bufferSize)
-    //    std::cout << "Buffer Overrun! More data extracted than was given!" << std::endl;
+    s->source = source;
 
-    return true;
+    return handle;
 
+}
 
+int getSpikeEventSize(const SpikeObject* s)
+{
+    return getPackedSpikeSize(s) + SPIKE_TICKET_SIZE;
+}
+
+int packSpikeEvent(const SpikeHandle& s, uint8_t* buffer, int bufferSize)
+{
+    if (getSpikeEventSize(s.get()) > bufferSize)
+        return 0;
+
+    const int numBytes = packSpike(s.get(), buffer, bufferSize);
+
+    const uint32 ticket = SpikePool::getInstance().share(s);
+    memcpy(buffer + numBytes, &ticket, SPIKE_TICKET_SIZE);
+
+    return numBytes + SPIKE_TICKET_SIZE;
+}
+
+SpikeHandle unpackSpikeEvent(const uint8_t* buffer, int bufferSize)
+{
+    if (bufferSize < SPIKE_METADATA_SIZE + SPIKE_TICKET_SIZE)
+    {
+        std::cout << "received invalid spike event -- buffer too short" << std::endl;
+        return SpikeHandle();
+    }
+
+    uint32 ticket;
+    memcpy(&ticket, buffer + bufferSize - SPIKE_TICKET_SIZE, SPIKE_TICKET_SIZE);
+
+    SpikeHandle shared = SpikePool::getInstance().claimShared(ticket);
+
+    if (!shared.isNull())
+        return shared;
+
+    return unpackSpike(buffer, bufferSize - SPIKE_TICKET_SIZE);
 }
 
 // Checks the validity of the buffer, this should be run before unpacking and after packing the buffer
@@ -248,7 +495,7 @@ void makeBufferValid(uint8_t* buffer, int bufferSize)
 
 }
 
-void generateSimulatedSpike(SpikeObject* s, uint64_t timestamp, int noise)
+SpikeHandle generateSimulatedSpike(uint64_t timestamp, int noise)
 {
     //std::cout<<"generateSimulatedSpike()"<<std::endl;
 
@@ -282,6 +529,9 @@ void generateSimulatedSpike(SpikeObject* s, uint64_t timestamp, int noise)
 
     uint16_t gain = 2000;
 
+    SpikeHandle spike = SpikePool::getInstance().allocate(4, 32);
+    SpikeObject* s = spike.get();
+
     s->eventType = SPIKE_EVENT_CODE;
     s->timestamp = timestamp;
     s->source = 0;
@@ -313,17 +563,16 @@ void generateSimulatedSpike(SpikeObject* s, uint64_t timestamp, int noise)
         }
     }
 
+    return spike;
+
 }
 
-void generateEmptySpike(SpikeObject* s, int nChannels, int numSamples)
+SpikeHandle generateEmptySpike(int nChannels, int numSamples)
 {
 
-    s->eventType = SPIKE_EVENT_CODE;
-    s->timestamp = 0;
-    s->source = 0;
-    s->nChannels = 1;
-    s->nSamples = numSamples;
-    s->electrodeID = 0;
+    SpikeHandle spike = SpikePool::getInstance().allocate(nChannels, numSamples);
+    SpikeObject* s = spike.get();
+
     s->samplingFrequencyHz = 30000;
     s->sortedId = 0;
     s->color[0] = s->color[1] = s->color[2] = 128;
@@ -341,9 +590,11 @@ void generateEmptySpike(SpikeObject* s, int nChannels, int numSamples)
             idx = idx+1;
         }
     }
+
+    return spike;
 }
 
-void printSpike(SpikeObject* s)
+void printSpike(const SpikeObject* s)
 {
 
     std::cout<< " SpikeObject:\n";
@@ -357,7 +608,7 @@ void printSpike(SpikeObject* s)
     std::cout<<std::endl;
 }
 
-float spikeDataBinToMicrovolts(SpikeObject *s, int bin, int ch)
+float spikeDataBinToMicrovolts(const SpikeObject *s, int bin, int ch)
 {
     jassert(ch >= 0 && ch < s->nChannels);
     jassert(bin >= 0 && ch < s->nSamples);
@@ -366,7 +617,7 @@ float spikeDataBinToMicrovolts(SpikeObject *s, int bin, int ch)
 }
 
 
-float spikeDataIndexToMicrovolts(SpikeObject *s, int index)
+float spikeDataIndexToMicrovolts(const SpikeObject *s, int index)
 {
     int gain_index = index / s->nSamples;
     jassert(gain_index >= 0 && gain_index < s->nChannels);
@@ -376,7 +627,7 @@ float spikeDataIndexToMicrovolts(SpikeObject *s, int index)
 
 
 
-int microVoltsToSpikeDataBin(SpikeObject *s, float uV, int ch)
+int microVoltsToSpikeDataBin(const SpikeObject *s, float uV, int ch)
 {
     return uV/1000.0f*float(s->gain[ch])+32768;
 }
@@ -384,13 +635,13 @@ int microVoltsToSpikeDataBin(SpikeObject *s, float uV, int ch)
 
 
 
-float spikeTimeBinToMicrosecond(SpikeObject *s, int bin, int ch)
+float spikeTimeBinToMicrosecond(const SpikeObject *s, int bin, int ch)
 {
     float spikeTimeSpan = 1.0f/s->samplingFrequencyHz * s->nSamples * 1e6;
     return float(bin)/(s->nSamples-1) * spikeTimeSpan;
 }
 
-int microSecondsToSpikeTimeBin(SpikeObject *s, float t, int ch)
+int microSecondsToSpikeTimeBin(const SpikeObject *s, float t, int ch)
 {
     // Lets say we have 32 samples per wave form
 
@@ -30,19 +30,37 @@
 #include <math.h>
 
 #define SPIKE_METADATA_SIZE 42
-#define MAX_NUMBER_OF_SPIKE_CHANNELS 4
-#define MAX_NUMBER_OF_SPIKE_CHANNEL_SAMPLES 80
 #define CHECK_BUFFER_VALIDITY true
 #define SPIKE_EVENT_CODE 4;
-#define MAX_SPIKE_BUFFER_LEN 512 // max length of spike buffer in bytes
-                                 // the true max calculated from the spike values below is actually 507
+#define MAX_SPIKE_BUFFER_LEN 1024 // initial size of spike packing buffers in bytes (a packed 4 x 60 sample spike takes 546);
+                                  // buffers grow when a larger spike has to be packed
 
 #define SPIKE_BASE_CODE 100
 
+#define SPIKE_POOL_NUM_CLASSES 5 // record sizes of 256, 512, 1024, 4096 and 16384 bytes
+#define SPIKE_POOL_NUM_SLABS 4 // slabs allocated per size class when the pool is created
+#define SPIKE_POOL_NUM_SHARED 4096 // spikes in flight between processors that the pool keeps a reference to
+#define SPIKE_TICKET_SIZE 4 // bytes after the packed spike in a spike event
+
+class SpikePool;
+
 /**
 
   Allows spikes to be transmitted between processors.
 
+  A SpikeObject holds the metadata of a spike followed by a variable-length
+  block with its waveform (nChannels * nSamples values, channel after channel),
+  gains and thresholds, so a single-channel 32-sample spike only takes a few
+  hundred bytes. SpikeObjects are taken from the SpikePool and are only ever
+  accessed through a SpikeHandle: copying a handle shares the spike instead of
+  copying it, and the spike goes back to the pool when its last handle is gone.
+  The waveform of a spike should not be changed once it has been handed to another processor
+  or thread. Between processors spikes travel in events made by packSpikeEvent(),
+  which hold the packed spike followed by a ticket from SpikePool::share();
+  unpackSpikeEvent() claims the sender's SpikeObject with that ticket, so
+  detectors, sorters, displays and record engines all share one copy. The
+  packed spike is only read when the ticket has expired, and by the NetworkSink.
+
   For transmission between processors SpikeObjects must be packaged up into buffers that can fit into MidiEvents
   The following two methods can be used to package the above spike object into a buffer and  unpackage a buffer
   into a SpikeObject.
@@ -56,6 +74,8 @@
   (except the last 16 bit integer) is taken and the sum should equal that 16 bit integer. If not then the data is corrupted
   and should be dropped or dealt with another way.
 
+  @see SpikeHandle, SpikePool
+
 */
 
 struct SpikeObject
@@ -73,25 +93,170 @@ struct SpikeObject
     uint8_t     color[3];
     float       pcProj[2];
     uint16_t    samplingFrequencyHz;
-    uint16_t    data[MAX_NUMBER_OF_SPIKE_CHANNELS * MAX_NUMBER_OF_SPIKE_CHANNEL_SAMPLES];
-    float       gain[MAX_NUMBER_OF_SPIKE_CHANNELS];
-    uint16_t    threshold[MAX_NUMBER_OF_SPIKE_CHANNELS];
+    uint16_t*   data; // nChannels * nSamples values
+    float*      gain; // nChannels values
+    uint16_t*   threshold; // nChannels values
+
+private:
+    friend class SpikePool;
+    friend class SpikeHandle;
+
+    SpikeObject() {}
+    ~SpikeObject() {}
+
+    Atomic<int> refCount;
+    int sizeClass; // index of the pool's size class, or -1 if the spike was allocated separately
+
+    JUCE_DECLARE_NON_COPYABLE(SpikeObject);
 };
 
+/**
+
+  Reference-counted pointer to a SpikeObject.
+
+  @see SpikeObject, SpikePool
+
+*/
 
+class SpikeHandle
+{
+public:
+    SpikeHandle() noexcept : spike(nullptr) {}
+    SpikeHandle(const SpikeHandle& other) noexcept;
+    ~SpikeHandle();
 
-float spikeDataIndexToMicrovolts(SpikeObject *s, int index);
+    SpikeHandle& operator= (const SpikeHandle& other);
 
-float spikeDataBinToMicrovolts(SpikeObject *s, int bin, int ch = 0);
-int microVoltsToSpikeDataBin(SpikeObject *s, float uV, int ch = 0);
-float spikeTimeBinToMicrosecond(SpikeObject *s, int bin, int ch=0);
-int microSecondsToSpikeTimeBin(SpikeObject *s, float t, int ch=0);
+    SpikeObject* get() const noexcept
+    {
+        return spike;
+    }
 
-/** Simple method for serializing a SpikeObject into a string of bytes, returns true is the packaged spike buffer is valid */
+    SpikeObject* operator->() const noexcept
+    {
+        return spike;
+    }
+
+    SpikeObject& operator*() const noexcept
+    {
+        return *spike;
+    }
+
+    bool isNull() const noexcept
+    {
+        return spike == nullptr;
+    }
+
+    /** Drops this handle's reference. */
+    void reset();
+
+private:
+    friend class SpikePool;
+
+    explicit SpikeHandle(SpikeObject* s) noexcept; // takes over the initial reference
+
+    SpikeObject* spike;
+};
+
+/**
+
+  Preallocated storage for SpikeObjects.
+
+  Spikes are grouped in a few size classes, each with its own free list.
+  All slabs are allocated when the pool is created, so taking or returning a
+  spike never allocates under a lock. When a class runs out, the spike is
+  taken from a larger class; spikes that don't fit anywhere are allocated
+  separately.
+
+  @see SpikeObject, SpikeHandle
+
+*/
+
+class SpikePool
+{
+public:
+
+    /** Returns the pool shared by all processors. */
+    static SpikePool& getInstance();
+
+    /** Returns a spike with room for the given number of channels and samples.
+        The metadata is cleared; the waveform, gains and thresholds are not. */
+    SpikeHandle allocate(int nChannels, int nSamples);
+
+    /** Called when the last handle to a spike goes away. */
+    void release(SpikeObject* s);
+
+    /** Keeps a reference to a spike that is sent to other processors, and
+        returns the ticket they can claim it with (never 0). The reference is
+        dropped after SPIKE_POOL_NUM_SHARED more spikes have been shared, which
+        is long after the end of the block. */
+    uint32 share(const SpikeHandle& spike);
+
+    /** Returns the spike shared with this ticket, or a null handle if it has
+        already been dropped. */
+    SpikeHandle claimShared(uint32 ticket);
+
+private:
+    SpikePool();
+    ~SpikePool();
+
+    struct SizeClass
+    {
+        int numBytes;
+        int blocksPerSlab;
+        HeapBlock<SpikeObject*> freeList; // room for every spike of this size, so release() never allocates
+        int numFree;
+        OwnedArray<MemoryBlock> slabs;
+        SpinLock lock;
+    };
+
+    struct SharedSpike
+    {
+        SpikeHandle spike;
+        uint32 ticket;
+        SpinLock lock;
+    };
+
+    void addSlab(SizeClass* sizeClass);
+
+    static int getNumBytes(int nChannels, int nSamples);
+    static SpikeObject* createInBlock(char* block, int sizeClass, int nChannels, int nSamples);
+
+    OwnedArray<SizeClass> sizeClasses;
+
+    SharedSpike sharedSpikes[SPIKE_POOL_NUM_SHARED]; // indexed by ticket
+    Atomic<uint32> lastTicket;
+
+    JUCE_DECLARE_NON_COPYABLE(SpikePool);
+};
+
+
+float spikeDataIndexToMicrovolts(const SpikeObject *s, int index);
+
+float spikeDataBinToMicrovolts(const SpikeObject *s, int bin, int ch = 0);
+int microVoltsToSpikeDataBin(const SpikeObject *s, float uV, int ch = 0);
+float spikeTimeBinToMicrosecond(const SpikeObject *s, int bin, int ch=0);
+int microSecondsToSpikeTimeBin(const SpikeObject *s, float t, int ch=0);
+
+/** Returns the number of bytes packSpike() needs for this spike. */
+int getPackedSpikeSize(const SpikeObject* s);
+
+/** Simple method for serializing a SpikeObject into a string of bytes, returns the number of bytes written (0 if the buffer is too small) */
 int packSpike(const SpikeObject* s, uint8_t* buffer, int bufferLength);
 
-/** Simple method for deserializing a string of bytes into a Spike object, returns true is the provided spike buffer is valid */
-bool unpackSpike(SpikeObject* s, const uint8_t* buffer, int bufferLength);
+/** Simple method for deserializing a string of bytes into a new SpikeObject from the SpikePool, returns a null handle if the buffer is invalid */
+SpikeHandle unpackSpike(const uint8_t* buffer, int bufferLength);
+
+/** Returns the number of bytes packSpikeEvent() needs for this spike. */
+int getSpikeEventSize(const SpikeObject* s);
+
+/** Packs a spike for a spike event and shares it with the processors that receive it,
+    returns the number of bytes written (0 if the buffer is too small) */
+int packSpikeEvent(const SpikeHandle& s, uint8_t* buffer, int bufferLength);
+
+/** Returns the spike sent in a spike event: the sender's SpikeObject while the pool still
+    holds it, otherwise a copy unpacked from the event. Returns a null handle if the event is invalid */
+SpikeHandle unpackSpikeEvent(const uint8_t* buffer, int bufferLength);
 
 /** Checks the validity of the buffer, this should be run before unpacking the buffer */
 bool isBufferValid(const uint8_t* buffer, int bufferLength);
@@ -102,15 +267,15 @@ void makeBufferValid(uint8_t* buffer, int bufferLength);
 /** Helper function for generating fake spikes in the absence of a real spike source.
   Can be used to generate a sign wave with a fixed Frequency of 1000 hz or a basic spike waveform
   Additionally noise can be added to the waveform for help in diagnosing projection plots */
-void generateSimulatedSpike(SpikeObject* s, uint64_t timestamp, int noise);
+SpikeHandle generateSimulatedSpike(uint64_t timestamp, int noise);
 
 // Define the << operator for the SpikeObject
 // std::ostream& operator<<(std::ostream &strm, const SpikeObject s);
 
-/** Helper function for zeroing out a spike object with a specified number of channels */
-void generateEmptySpike(SpikeObject* s, int nChannels, int numSamples);
+/** Helper function for creating a zeroed-out spike object with a specified number of channels */
+SpikeHandle generateEmptySpike(int nChannels, int numSamples);
 
-void printSpike(SpikeObject* s);
+void printSpike(const SpikeObject* s);
 
 static const int N_WAVEFORM_SAMPLES = 120;
 static const double SPIKE_WAVEFORMS[5][N_WAVEFORM_SAMPLES] =
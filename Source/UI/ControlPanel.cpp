@@ -463,6 +463,14 @@ ControlPanel::ControlPanel(ProcessorGraph* graph_, AudioComponent* audio_)
     addChildComponent(appendText);
     appendText->setTooltip("Append to name of data directory");
 
+    preTriggerText = new Label("Pre-trigger","");
+    preTriggerText->setEditable(true);
+    preTriggerText->addListener(this);
+    preTriggerText->setColour(Label::backgroundColourId, Colours::lightgrey);
+    preTriggerText->setTooltip("Seconds of data to keep from before the record button is pressed");
+    addChildComponent(preTriggerText);
+    updatePreTriggerText();
+
     //diskMeter->updateDiskSpace(graph->getRecordNode()->getFreeSpace());
     //diskMeter->repaint();
     //refreshMeters();
@@ -635,7 +643,10 @@ void ControlPanel::resized()
         recordOptionsButton->setBounds((w - 435) > 40 ? 140 : w-350,topBound, h-10, h-10);
         recordOptionsButton->setVisible(true);
 
-        filenameComponent->setBounds(165, topBound, w-500, h-10);
+        preTriggerText->setBounds(165, topBound, 50, h-10);
+        preTriggerText->setVisible(true);
+
+        filenameComponent->setBounds(220, topBound, w-555, h-10);
         filenameComponent->setVisible(true);
 
         newDirectoryButton->setBounds(w-h+4, topBound, h-10, h-10);
@@ -658,6 +669,7 @@ void ControlPanel::resized()
         prependText->setVisible(false);
         dateText->setVisible(false);
         appendText->setVisible(false);
+        preTriggerText->setVisible(false);
         recordSelector->setVisible(false);
         recordOptionsButton->setVisible(false);
     }
@@ -678,6 +690,13 @@ void ControlPanel::openState(bool os)
 
 void ControlPanel::labelTextChanged(Label* label)
 {
+    if (label == preTriggerText)
+    {
+        graph->getRecordNode()->setPreTriggerTime(label->getText().getFloatValue());
+        updatePreTriggerText();
+        return;
+    }
+
     graph->getRecordNode()->newDirectoryNeeded = true;
     newDirectoryButton->setEnabledState(false);
     masterClock->resetRecordTime();
@@ -751,6 +770,7 @@ void ControlPanel::buttonClicked(Button* button)
             }
             recordSelector->setEnabled(false);
             recordOptionsButton->setEnabled(false);
+            preTriggerText->setEditable(false); // the buffer is sized when acquisition starts
         }
         else
         {
@@ -769,6 +789,7 @@ void ControlPanel::buttonClicked(Button* button)
             audioEditor->enable();
             recordSelector->setEnabled(true);
             recordOptionsButton->setEnabled(true);
+            preTriggerText->setEditable(true);
 
         }
 
@@ -802,6 +823,7 @@ void ControlPanel::buttonClicked(Button* button)
                     playButton->setToggleState(true, dontSendNotification);
                     recordSelector->setEnabled(false);
                     recordOptionsButton->setEnabled(false);
+                    preTriggerText->setEditable(false);
 
                 }
             }
@@ -874,6 +896,7 @@ void ControlPanel::disableCallbacks()
     playButton->setToggleState(false, dontSendNotification);
     recordButton->setToggleState(false, dontSendNotification);
     recordSelector->setEnabled(true);
+    preTriggerText->setEditable(true);
     masterClock->stopRecording();
     masterClock->stop();
 
@@ -977,6 +1000,11 @@ void ControlPanel::setDateText(String t)
 }
 
 
+void ControlPanel::updatePreTriggerText()
+{
+    preTriggerText->setText(String(graph->getRecordNode()->getPreTriggerTime(), 1) + " s", dontSendNotification);
+}
+
 void ControlPanel::saveStateToXml(XmlElement* xml)
 {
 
@@ -985,6 +1013,7 @@ void ControlPanel::saveStateToXml(XmlElement* xml)
     controlPanelState->setAttribute("prependText",prependText->getText());
     controlPanelState->setAttribute("appendText",appendText->getText());
     controlPanelState->setAttribute("recordEngine",recordSelector->getSelectedId());
+    controlPanelState->setAttribute("preTriggerTime",graph->getRecordNode()->getPreTriggerTime());
 
     audioEditor->saveStateToXml(xml);
 
@@ -1010,6 +1039,8 @@ void ControlPanel::loadStateFromXml(XmlElement* xml)
             appendText->setText(xmlNode->getStringAttribute("appendText", ""), dontSendNotification);
             prependText->setText(xmlNode->getStringAttribute("prependText", ""), dontSendNotification);
             recordSelector->setSelectedId(xmlNode->getIntAttribute("recordEngine",1), sendNotificationSync);
+            graph->getRecordNode()->setPreTriggerTime(xmlNode->getDoubleAttribute("preTriggerTime", 0.0));
+            updatePreTriggerText();
 
             bool isOpen = xmlNode->getBoolAttribute("isOpen");
             openState(isOpen);
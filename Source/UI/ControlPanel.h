@@ -357,6 +357,10 @@ private:
     ScopedPointer<Label> prependText;
     ScopedPointer<Label> dateText;
     ScopedPointer<Label> appendText;
+    ScopedPointer<Label> preTriggerText;
+
+    /** Shows the RecordNode's pre-trigger time in the preTriggerText label. */
+    void updatePreTriggerText();
 
     ProcessorGraph* graph;
     AudioComponent* audio;
@@ -26,11 +26,12 @@
 #include "SignalChainManager.h"
 #include "GraphViewer.h"
 #include "EditorViewportButtons.h"
+#include "../Processors/Parameter/ParameterSnapshot.h"
 
 EditorViewport::EditorViewport()
     : leftmostEditor(0),
       message("Drag-and-drop some rows from the top-left box onto this component!"),
-      somethingIsBeingDraggedOver(false), shiftDown(false), canEdit(true),
+      somethingIsBeingDraggedOver(false), shiftDown(false), canEdit(true), loadingState(false),
       lastEditorClicked(0), selectionIndex(0), borderSize(6), tabSize(30),
       tabButtonSize(15), insertionPoint(0), componentWantsToMove(false),
       indexOfMovingComponent(-1), currentTab(-1)
@@ -88,10 +89,25 @@ void EditorViewport::signalChainCanBeEdited(bool t)
     canEdit = t;
 
     if (!canEdit)
+    {
         std::cout << "Filter Viewport disabled." << std::endl;
+        startTimer(500);
+    }
     else
+    {
         std::cout << "Filter Viewport enabled." << std::endl;
+        stopTimer();
+        timerCallback(); // last update, shown until the next acquisition
+    }
+
+}
+
+void EditorViewport::timerCallback()
+{
+    for (int i = 0; i < editorArray.size(); i++)
+        editorArray[i]->repaint();
 
+    getGraphViewer()->setCallbackSummary(getProcessorGraph()->getCallbackMonitor().getSummary());
 }
 
 void EditorViewport::paint(Graphics& g)
@@ -314,6 +330,13 @@ void EditorViewport::makeEditorVisible(GenericEditor* editor, bool highlight, bo
     if (editor == 0)
         return;
 
+    // while loading, only the structure of the chain is kept up to date
+    if (loadingState)
+    {
+        signalChainManager->updateVisibleEditors(editor, 0, 0, updateSettings ? UPDATE : ACTIVATE);
+        return;
+    }
+
     if (!updateSettings)
         signalChainManager->updateVisibleEditors(editor, 0, 0, ACTIVATE);
     else
@@ -373,6 +396,9 @@ void EditorViewport::deleteNode(GenericEditor* editor)
 void EditorViewport::refreshEditors()
 {
 
+    if (loadingState)
+        return;
+
     int lastBound = borderSize+tabSize;
     int totalWidth = 0;
 
@@ -986,6 +1012,11 @@ void EditorViewport::checkScrollButtons(int topTab)
 
 }
 
+bool EditorViewport::isLoadingState()
+{
+    return loadingState;
+}
+
 bool EditorViewport::isSignalChainEmpty()
 {
 
@@ -1213,7 +1244,7 @@ XmlElement* EditorViewport::switchNodeXml(GenericProcessor* processor)
 
 }
 
-const String EditorViewport::saveState(File fileToUse)
+const String EditorViewport::saveState(File fileToUse, bool writeSnapshot)
 {
 
     String error;
@@ -1383,10 +1414,18 @@ const String EditorViewport::saveState(File fileToUse)
     getUIComponent()->saveStateToXml(xml);  // save the UI settings
 
     if (! xml->writeToFile(currentFile, String::empty))
+    {
         error = "Couldn't write to file ";
+    }
     else
+    {
         error = "Saved configuration as ";
 
+        // the XML is enough on its own; the snapshot only speeds up loading
+        if (writeSnapshot && !ParameterSnapshot::write(currentFile, getProcessorGraph()->getListOfProcessors()))
+            std::cout << "Couldn't write the parameter snapshot." << std::endl;
+    }
+
     error += currentFile.getFileName();
 
     delete xml;
@@ -1476,10 +1515,18 @@ const String EditorViewport::loadState(File fileToLoad)
     }
     clearSignalChain();
 
+    ParameterSnapshot snapshot;
+    bool hasSnapshot = snapshot.read(currentFile);
+
     String description;// = " ";
     int loadOrder = 0;
 
     GenericProcessor* p;
+    Array<GenericProcessor*> loadedProcessors;
+
+    // settings are updated once the whole chain has been built, rather
+    // than along the whole chain for every processor that is added
+    loadingState = true;
 
     forEachXmlChildElement(*xml, element)
     {
@@ -1518,8 +1565,10 @@ const String EditorViewport::loadState(File fileToLoad)
                     p->loadOrder = loadOrder;
                     p->parametersAsXml = processor;
 
-                    //Sets parameters based on XML files
-                    setParametersByXML(p, processor);
+                    if (hasSnapshot)
+                        p->parametersAsSnapshot = snapshot.getBlock(currentId);
+
+                    loadedProcessors.add(p);
                     loadOrder++;
 
                     if (p->isSplitter() || p->isMerger())
@@ -1577,6 +1626,21 @@ const String EditorViewport::loadState(File fileToLoad)
 
     }
 
+    loadingState = false;
+
+    // one pass over every chain gives each processor its channels...
+    if (editorArray.size() > 0)
+        signalChainManager->updateVisibleEditors(editorArray[0], 0, 0, UPDATE);
+
+    // ...so that the parameters saved for them can be set; any updates
+    // these ask for are covered by the one below
+    loadingState = true;
+
+    for (int i = 0; i < loadedProcessors.size(); i++)
+        setParametersByXML(loadedProcessors[i], loadedProcessors[i]->parametersAsXml);
+
+    loadingState = false;
+
     for (int i = 0; i < editorArray.size(); i++)
     {
         // deselect everything initially
@@ -1647,7 +1711,6 @@ void EditorViewport::setParametersByXML(GenericProcessor* targetProcessor, XmlEl
                     parameterFloat=parameterValue.getFloatValue();
                     targetProcessor->setParameter(j, parameterFloat);
                     // testGrab=targetProcessor->getParameterVar(j, currentChannel);
-                    std::cout <<"Channel:" <<currentChannel<<"Parameter:" << parameterNameForXML << "Intended Value:" << parameterFloat << std::endl;
                 }
 
             }
@@ -65,7 +65,8 @@ class EditorViewport  : public Component,
     public DragAndDropTarget,
     public AccessClass,
     public Button::Listener,
-    public Label::Listener
+    public Label::Listener,
+    public Timer
 
 {
 public:
@@ -98,6 +99,9 @@ public:
     ProcessorGraph when data acquisition begins and ends. */
     void signalChainCanBeEdited(bool canEdit);
 
+    /** Refreshes the processing times shown on the editors and in the GraphViewer. */
+    void timerCallback();
+
     /** Determines whether or not the EditorViewport should respond to
     the component that is currently being dragged. */
     bool isInterestedInDragSource(const SourceDetails& dragSourceDetails);
@@ -149,8 +153,10 @@ public:
         return signalChainArray;
     }
 
-    /** Save the current configuration as an XML file. */
-    const String saveState(File filename);
+    /** Save the current configuration as an XML file. A binary parameter
+        snapshot is written next to it only if writeSnapshot is set, i.e. for
+        configurations the user saves. */
+    const String saveState(File filename, bool writeSnapshot = false);
 
     /** Load a saved configuration from an XML file. */
     const String loadState(File filename);
@@ -167,6 +173,10 @@ public:
     /** Checks whether or not the signal chain scroll buttons need to be activated. */
     void checkScrollButtons(int topTab);
 
+    /** True while loadState() builds the signal chain. Settings updates and
+        layout are left until the whole chain is in place. */
+    bool isLoadingState();
+
     /** Returns a boolean indicating whether or not the signal chain is empty. */
     bool isSignalChainEmpty();
 
@@ -182,6 +192,7 @@ private:
     bool shiftDown;
 
     bool canEdit;
+    bool loadingState;
     GenericEditor* lastEditor;
     GenericEditor* lastEditorClicked;
     GenericEditor* editorToUpdate;
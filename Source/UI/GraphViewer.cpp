@@ -244,6 +244,12 @@ int GraphViewer::getHorizontalShift(GraphNode* gn)
 }
 
 
+void GraphViewer::setCallbackSummary(const String& summary)
+{
+    callbackSummary = summary;
+    repaint();
+}
+
 void GraphViewer::paint(Graphics& g)
 {
     g.fillAll(Colours::darkgrey);
@@ -262,6 +268,8 @@ void GraphViewer::paint(Graphics& g)
     g.setFont(Font("Small Text", 14, Font::plain));
     g.drawFittedText(text, 40, 40, getWidth()-50, getHeight()-45, Justification::bottomRight, 100);
 
+    g.drawFittedText(callbackSummary, 20, 40, getWidth()-50, getHeight()-45, Justification::bottomLeft, 100);
+
     // draw connections
 
     for (int i = 0; i < availableNodes.size(); i++)
@@ -475,4 +483,8 @@ void GraphNode::paint(Graphics& g)
 
     g.drawText(getName(), 25, 0, getWidth()-25, 20, Justification::left, true);
 
+    // processing time of recent blocks (mean / p99)
+    g.setFont(Font("Small Text", 10, Font::plain));
+    g.drawText(editor->getProcessor()->getProfile().getSummary(), 25, 16, getWidth()-25, 12, Justification::left, true);
+
 }
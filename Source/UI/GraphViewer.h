@@ -105,6 +105,9 @@ public:
     int getHorizontalShift(GraphNode*);
     GraphNode* getNodeForEditor(GenericEditor* editor);
 
+    /** Shows the audio callback timing and repaints the processing times of the nodes. */
+    void setCallbackSummary(const String& summary);
+
 private:
 
     void connectNodes(int, int, Graphics&);
@@ -116,6 +119,8 @@ private:
 
     int rootNum;
 
+    String callbackSummary;
+
     OwnedArray<GraphNode> availableNodes;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GraphViewer);
@@ -61,6 +61,8 @@ ProcessorList::ProcessorList()
 #endif
 #endif
     sources->addSubItem(new ProcessorListItem("File Reader"));
+    sources->addSubItem(new ProcessorListItem("Network Stream"));
+    sources->addSubItem(new ProcessorListItem("Neural Simulator"));
 #ifdef ZEROMQ
     sources->addSubItem(new ProcessorListItem("Network Events"));
 #endif
@@ -84,7 +86,7 @@ ProcessorList::ProcessorList()
     //sinks->addSubItem(new ProcessorListItem("LFP Trig. Avg."));
     sinks->addSubItem(new ProcessorListItem("Spike Viewer"));
     sinks->addSubItem(new ProcessorListItem("PSTH"));
-    //sinks->addSubItem(new ProcessorListItem("Network Sink"));
+    sinks->addSubItem(new ProcessorListItem("Network Sink"));
     //sinks->addSubItem(new ProcessorListItem("WiFi Output"));
     sinks->addSubItem(new ProcessorListItem("Arduino Output"));
     // sinks->addSubItem(new ProcessorListItem("FPGA Output"));
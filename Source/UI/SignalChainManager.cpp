@@ -504,8 +504,8 @@ void SignalChainManager::updateVisibleEditors(GenericEditor* activeEditor,
         }
     }
 
-    // Step 7: update all settings
-    if (action != ACTIVATE)
+    // Step 7: update all settings (left for the end while a configuration is loading)
+    if (action != ACTIVATE && !ev->isLoadingState())
     {
 
         // std::cout << "Updating settings." << std::endl;
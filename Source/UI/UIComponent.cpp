@@ -294,6 +294,9 @@ PopupMenu UIComponent::getMenuForIndex(int menuIndex, const String& menuName)
         menu.addCommandItem(commandManager, saveConfigurationAs);
         menu.addSeparator();
         menu.addCommandItem(commandManager, reloadOnStartup);
+        menu.addSeparator();
+        menu.addCommandItem(commandManager, exportProfilingTrace);
+        menu.addCommandItem(commandManager, showSignalChainTiming);
 
 #if !JUCE_MAC
         menu.addSeparator();
@@ -352,6 +355,8 @@ void UIComponent::getAllCommands(Array <CommandID>& commands)
                              saveConfiguration,
                              saveConfigurationAs,
                              reloadOnStartup,
+                             exportProfilingTrace,
+                             showSignalChainTiming,
                              undo,
                              redo,
                              copySignalChain,
@@ -397,6 +402,15 @@ void UIComponent::getCommandInfo(CommandID commandID, ApplicationCommandInfo& re
             result.setTicked(mainWindow->shouldReloadOnStartup);
             break;
 
+        case exportProfilingTrace:
+            result.setInfo("Export profiling trace...", "Save the processing times of the last run as a Chrome trace.", "General", 0);
+            result.setActive(!acquisitionStarted);
+            break;
+
+        case showSignalChainTiming:
+            result.setInfo("Signal chain timing...", "Show the time spent in each branch of the signal chain.", "General", 0);
+            break;
+
         case undo:
             result.setInfo("Undo", "Undo the last action.", "General", 0);
             result.addDefaultKeypress('Z', ModifierKeys::commandModifier);
@@ -489,7 +503,7 @@ bool UIComponent::perform(const InvocationInfo& info)
 
                 if (currentConfigFile.exists())
                 {
-                    sendActionMessage(getEditorViewport()->saveState(currentConfigFile));
+                    sendActionMessage(getEditorViewport()->saveState(currentConfigFile, true));
                 }
                 else
                 {
@@ -502,7 +516,7 @@ bool UIComponent::perform(const InvocationInfo& info)
                     {
                         currentConfigFile = fc.getResult();
                         std::cout << currentConfigFile.getFileName() << std::endl;
-                        sendActionMessage(getEditorViewport()->saveState(currentConfigFile));
+                        sendActionMessage(getEditorViewport()->saveState(currentConfigFile, true));
                     }
                     else
                     {
@@ -525,7 +539,7 @@ bool UIComponent::perform(const InvocationInfo& info)
                 {
                     currentConfigFile = fc.getResult();
                     std::cout << currentConfigFile.getFileName() << std::endl;
-                    sendActionMessage(getEditorViewport()->saveState(currentConfigFile));
+                    sendActionMessage(getEditorViewport()->saveState(currentConfigFile, true));
                 }
                 else
                 {
@@ -542,6 +556,31 @@ bool UIComponent::perform(const InvocationInfo& info)
             }
             break;
 
+        case exportProfilingTrace:
+            {
+                FileChooser fc("Choose the trace file...",
+                               File::getCurrentWorkingDirectory().getChildFile("profile.json"),
+                               "*.json",
+                               true);
+
+                if (fc.browseForFileToSave(true))
+                {
+                    sendActionMessage(getProcessorGraph()->exportProfilingTrace(fc.getResult()));
+                }
+                else
+                {
+                    sendActionMessage("No file chosen.");
+                }
+
+                break;
+            }
+
+        case showSignalChainTiming:
+            AlertWindow::showMessageBoxAsync(AlertWindow::InfoIcon,
+                                             "Signal chain timing",
+                                             getProcessorGraph()->getTimingReport());
+            break;
+
         case clearSignalChain:
             {
                 getEditorViewport()->clearSignalChain();